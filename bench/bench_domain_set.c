@@ -0,0 +1,206 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file bench_domain_set.c
+ * @brief Microbenchmark of the lookup of a host among the banned domains.
+ *
+ * Loads from 10 to 10 million generated domains in a domain set and prints the time per
+ * lookup of hosts that are banned and hosts that are not, next to the linear scan of the
+ * domain lists the set replaced while it stays affordable, and behind the domain filter
+ * which rules most allowed hosts out. The same domains are then loaded as "*.domain" rules
+ * in the suffix trie, looked up with subdomains.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../includes/domain_filter.h"
+#include "../includes/domain_set.h"
+#include "../includes/domain_trie.h"
+
+/**
+ * @brief Hosts looked up per measure.
+ */
+#define BENCH_LOOKUPS 1000000
+
+/**
+ * @brief Largest list scanned linearly, beyond it the scan takes too long to be measured.
+ */
+#define BENCH_MAX_LINEAR 10000
+
+/**
+ * @brief Longest generated domain, NUL included.
+ */
+#define BENCH_DOMAIN_LEN 32
+
+/**
+ * @brief Keeps the compiler from dropping the work measured.
+ */
+static volatile long sink;
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Small xorshift generator, the benchmark does not depend on the libc one.
+ */
+static unsigned long long next_random(unsigned long long* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+/**
+ * @brief Looks each query up in the set and prints the time per lookup.
+ */
+static void bench_set(const domain_set_t* set, char** queries, const char* name) {
+  long found = 0;
+  double start = now_ns();
+  for (int i = 0; i < BENCH_LOOKUPS; i++) found += domain_set_find(set, queries[i], strlen(queries[i])) >= 0;
+  printf("  %-26s %8.1f ns/lookup\n", name, (now_ns() - start) / BENCH_LOOKUPS);
+  sink = found;
+}
+
+/**
+ * @brief Looks each query up in the filter, then in the set if it may be there, and prints the time per lookup.
+ */
+static void bench_filtered(const domain_filter_t* filter, const domain_set_t* set, char** queries, const char* name) {
+  long found = 0;
+  double start = now_ns();
+  for (int i = 0; i < BENCH_LOOKUPS; i++) {
+    size_t len = strlen(queries[i]);
+    if (domain_filter_contains(filter, domain_hash64(queries[i], len))) found += domain_set_find(set, queries[i], len) >= 0;
+  }
+  printf("  %-26s %8.1f ns/lookup\n", name, (now_ns() - start) / BENCH_LOOKUPS);
+  sink = found;
+}
+
+/**
+ * @brief Looks each query up in the trie and prints the time per lookup.
+ */
+static void bench_trie(const domain_trie_t* trie, char** queries, const char* name) {
+  long found = 0;
+  double start = now_ns();
+  for (int i = 0; i < BENCH_LOOKUPS; i++) found += domain_trie_find(trie, queries[i], strlen(queries[i])) >= 0;
+  printf("  %-26s %8.1f ns/lookup\n", name, (now_ns() - start) / BENCH_LOOKUPS);
+  sink = found;
+}
+
+/**
+ * @brief Scans the domain list for each query, as rules.c did, and prints the time per lookup.
+ */
+static void bench_linear(char* const* domains, size_t count, char** queries, const char* name) {
+  int lookups = BENCH_LOOKUPS / (int)(count / 10 + 1);
+  long found = 0;
+  double start = now_ns();
+  for (int i = 0; i < lookups; i++) {
+    for (size_t j = 0; j < count; j++) {
+      if (strcmp(queries[i], domains[j]) == 0) {
+        found++;
+        break;
+      }
+    }
+  }
+  printf("  %-26s %8.1f ns/lookup\n", name, (now_ns() - start) / lookups);
+  sink = found;
+}
+
+int main() {
+  static const size_t counts[] = { 10, 1000, 100000, 1000000, 10000000 };
+  size_t max_count = counts[sizeof(counts) / sizeof(counts[0]) - 1];
+
+  char* arena = malloc(max_count * BENCH_DOMAIN_LEN);
+  char* missing = malloc(BENCH_LOOKUPS * BENCH_DOMAIN_LEN);
+  char* subdomains = malloc(BENCH_LOOKUPS * (BENCH_DOMAIN_LEN + 8));
+  char** domains = malloc(max_count * sizeof(char*));
+  char** hits = malloc(BENCH_LOOKUPS * sizeof(char*));
+  char** misses = malloc(BENCH_LOOKUPS * sizeof(char*));
+  char** subdomain_hits = malloc(BENCH_LOOKUPS * sizeof(char*));
+  if (!arena || !missing || !subdomains || !domains || !hits || !misses || !subdomain_hits) return 1;
+
+  unsigned long long state = 0x9e3779b97f4a7c15ULL;
+  for (size_t i = 0; i < max_count; i++) {
+    domains[i] = arena + i * BENCH_DOMAIN_LEN;
+    snprintf(domains[i], BENCH_DOMAIN_LEN, "%llx-%zu.example.com", next_random(&state) & 0xffff, i);
+  }
+  for (int i = 0; i < BENCH_LOOKUPS; i++) {
+    misses[i] = missing + (size_t)i * BENCH_DOMAIN_LEN;
+    snprintf(misses[i], BENCH_DOMAIN_LEN, "www-%d.allowed.org", i);
+  }
+
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+    size_t count = counts[c];
+    printf("\n%zu banned domains\n", count);
+
+    domain_set_t set;
+    init_domain_set(&set);
+    double start = now_ns();
+    if (domain_set_reserve(&set, count) != 0) return 1;
+    for (size_t i = 0; i < count; i++) domain_set_add(&set, domains[i], i % 3);
+    printf("  %-26s %8.1f ns/domain (%zu slots, %zu MB)\n", "load", (now_ns() - start) / count,
+           set.capacity, (set.capacity * sizeof(domain_slot_t) + set.text_capacity) >> 20);
+
+    for (int i = 0; i < BENCH_LOOKUPS; i++) hits[i] = domains[next_random(&state) % count];
+    bench_set(&set, hits, "set, banned host");
+    bench_set(&set, misses, "set, allowed host");
+    if (count <= BENCH_MAX_LINEAR) {
+      bench_linear(domains, count, hits, "linear scan, banned host");
+      bench_linear(domains, count, misses, "linear scan, allowed host");
+    }
+
+    domain_filter_t filter;
+    init_domain_filter(&filter);
+    start = now_ns();
+    if (domain_filter_reserve(&filter, count) != 0) return 1;
+    for (size_t i = 0; i < count; i++) domain_filter_add(&filter, domain_hash64(domains[i], strlen(domains[i])));
+    printf("  %-26s %8.1f ns/domain (%zu KB, %.3f%% false positives)\n", "load filter", (now_ns() - start) / count,
+           domain_filter_size(&filter) >> 10, domain_filter_false_positive_rate(&filter) * 100);
+    bench_filtered(&filter, &set, hits, "filter+set, banned host");
+    bench_filtered(&filter, &set, misses, "filter+set, allowed host");
+    free_domain_filter(&filter);
+    free_domain_set(&set);
+
+    domain_trie_t trie;
+    init_domain_trie(&trie);
+    start = now_ns();
+    for (size_t i = 0; i < count; i++) domain_trie_add(&trie, domains[i], i % 3);
+    printf("  %-26s %8.1f ns/suffix (%zu nodes, %zu MB)\n", "load *.domain", (now_ns() - start) / count, trie.nb_nodes,
+           (trie.nodes_capacity * sizeof(int32_t) + trie.edges_capacity * sizeof(domain_trie_edge_t) + trie.labels_capacity) >> 20);
+    for (int i = 0; i < BENCH_LOOKUPS; i++) {
+      subdomain_hits[i] = subdomains + (size_t)i * (BENCH_DOMAIN_LEN + 8);
+      snprintf(subdomain_hits[i], BENCH_DOMAIN_LEN + 8, "cdn.www.%s", hits[i]);
+    }
+    bench_trie(&trie, subdomain_hits, "trie, banned subdomain");
+    bench_trie(&trie, misses, "trie, allowed host");
+    free_domain_trie(&trie);
+  }
+
+  free(arena);
+  free(missing);
+  free(subdomains);
+  free(subdomain_hits);
+  free(domains);
+  free(hits);
+  free(misses);
+  return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file bench_http_scan.c
+ * @brief Microbenchmark of the delimiter scanning of the HTTP parser.
+ *
+ * Runs the header checks of http_helper.c (strstr based) and the parser of http_message.c at
+ * each level of the scanning kernels on realistic request heads, and prints the time per head.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../includes/buffer_chain.h"
+#include "../includes/http_helper.h"
+#include "../includes/http_message.h"
+#include "../includes/http_scan.h"
+
+/**
+ * @brief Heads parsed per measure.
+ */
+#define BENCH_ITERATIONS 200000
+
+/**
+ * @brief Keeps the compiler from dropping the work measured.
+ */
+static volatile size_t sink;
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * @brief Builds a request head as sent by a browser, with a cookie of cookie_len bytes.
+ */
+static size_t build_head(char* head, size_t size, size_t cookie_len) {
+  size_t len = snprintf(head, size,
+    "GET http://www.example.com/articles/2024/performance-of-http-parsers?ref=home&page=2 HTTP/1.1\r\n"
+    "Host: www.example.com\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+    "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate\r\n"
+    "Referer: http://www.example.com/\r\n"
+    "Connection: keep-alive\r\n"
+    "Upgrade-Insecure-Requests: 1\r\n"
+    "Priority: u=0, i\r\n"
+    "Cookie: session=");
+  for (size_t i = 0; i < cookie_len && len < size - 8; i++) head[len++] = 'a' + i % 26;
+  len += snprintf(head + len, size - len, "\r\n\r\n");
+  return len;
+}
+
+/**
+ * @brief Checks and reads the host of a head with the strstr based helpers.
+ */
+static void bench_helpers(const char* head) {
+  char host[256];
+  double start = now_ns();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    sink += is_http_request_complete(head);
+    sink += get_http_host(head, host, sizeof(host));
+  }
+  printf("  %-34s %8.1f ns/head\n", "http_helper (strstr)", (now_ns() - start) / BENCH_ITERATIONS);
+}
+
+/**
+ * @brief Finds the end of a head and indexes it with the parser.
+ */
+static void bench_parser(const buffer_chain_t* chain, const char* name) {
+  http_head_t head;
+  size_t head_len;
+  double start = now_ns();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    sink += find_http_head_end(chain, &head_len);
+    sink += parse_http_head(chain, 0, &head) + head.nb_headers;
+  }
+  printf("  parser, %-26s %8.1f ns/head\n", name, (now_ns() - start) / BENCH_ITERATIONS);
+}
+
+/**
+ * @brief Finds every line end of a head, with memchr() then with the kernels.
+ */
+static void bench_lines(const char* head, size_t len, const char* name, int use_memchr) {
+  double start = now_ns();
+  for (int i = 0; i < BENCH_ITERATIONS; i++) {
+    size_t lines = 0;
+    for (const char* p = head; p < head + len; p++, lines++) {
+      if (use_memchr) {
+        p = memchr(p, '\n', head + len - p);
+        if (!p) break;
+      } else {
+        p += http_scan_byte(p, head + len - p, '\n');
+      }
+    }
+    sink += lines;
+  }
+  printf("  lines, %-27s %8.1f ns/head\n", name, (now_ns() - start) / BENCH_ITERATIONS);
+}
+
+int main() {
+  static const size_t cookies[] = { 32, 512, 3000 };
+  static const http_scan_level_t levels[] = { HTTP_SCAN_SCALAR, HTTP_SCAN_SSE2, HTTP_SCAN_AVX2 };
+  http_scan_level_t best = http_scan_level();
+  printf("Scanning kernels selected at startup: %s\n", http_scan_level_name(best));
+
+  for (size_t c = 0; c < sizeof(cookies) / sizeof(cookies[0]); c++) {
+    char head[8192];
+    size_t len = build_head(head, sizeof(head), cookies[c]);
+    printf("\nHead of %zu bytes (cookie of %zu bytes)\n", len, cookies[c]);
+
+    buffer_chain_t chain;
+    init_buffer_chain(&chain, NULL);
+    if (buffer_chain_append(&chain, head, len) != 0) return 1;
+
+    bench_helpers(head);
+    bench_lines(head, len, "memchr", 1);
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+      if (http_scan_select(levels[l]) != 0) continue;
+      bench_lines(head, len, http_scan_level_name(levels[l]), 0);
+      bench_parser(&chain, http_scan_level_name(levels[l]));
+    }
+    http_scan_select(best);
+    buffer_chain_clear(&chain);
+  }
+  return 0;
+}
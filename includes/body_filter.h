@@ -0,0 +1,55 @@
+/**
+ * @file body_filter.h
+ * @brief Header file for the scanner of response bodies.
+ *
+ * A filtered response body is searched for banned words as it is relayed, never stored:
+ * the scanner follows its own copy of the framing to skip the chunk sizes, inflates a
+ * gzip or deflate coding through a small window, and drives the automaton of the banned
+ * words over the decoded bytes. A word split between two reads, two chunks or two
+ * inflated windows is still found, and the state kept per response is bounded: the
+ * framing, the state of the automaton and, for a compressed body, the inflater.
+ */
+
+#ifndef BODY_FILTER_H
+#define BODY_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <zlib.h>
+
+#include "http_message.h"
+#include "word_matcher.h"
+
+/**
+ * @brief Size of the window the compressed bodies are inflated through.
+ */
+#define BODY_FILTER_WINDOW 4096
+
+/**
+ * @brief Content coding of a body.
+ */
+typedef enum {
+  BODY_CODING_IDENTITY,            /**< Not encoded */
+  BODY_CODING_GZIP,                /**< gzip (or x-gzip) */
+  BODY_CODING_DEFLATE              /**< zlib-wrapped deflate */
+} body_coding_t;
+
+/**
+ * @brief Scanner of a body.
+ */
+typedef struct {
+  http_body_t framing;             /**< Framing of the body, followed apart from the relay */
+  body_coding_t coding;            /**< Content coding of the body */
+  z_stream inflater;               /**< Inflater of a compressed body */
+  int inflating;                   /**< Set while the inflater is initialized */
+  const word_matcher_t* matcher;   /**< Automaton of the banned words */
+  uint32_t state;                  /**< State of the automaton after the bytes decoded so far */
+  int error;                       /**< Set when the body could not be decoded, the rest is not scanned */
+} body_filter_t;
+
+int body_filter_applies(const http_head_t* response, body_coding_t* coding);
+int init_body_filter(body_filter_t* filter, const http_body_t* framing, body_coding_t coding, const word_matcher_t* matcher);
+int body_filter_feed(body_filter_t* filter, const char* data, size_t len);
+void free_body_filter(body_filter_t* filter);
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file buffer_chain.h
+ * @brief Header file for the chains of pooled buffer segments.
+ *
+ * A chain holds more bytes than one buffer without ever copying them into a contiguous
+ * block: bytes are appended to the last segment, a new segment is taken from the pool when
+ * it is full, and the chain is written with writev().
+ */
+
+#ifndef BUFFER_CHAIN_H
+#define BUFFER_CHAIN_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "pool.h"
+
+/**
+ * @brief Most segments written by one call to writev().
+ */
+#define BUFFER_CHAIN_IOV 64
+
+/**
+ * @brief Segment of a chain, taken from a buffer pool.
+ *
+ * The bytes are followed by a '\0', so the string functions can run over one segment.
+ */
+typedef struct buffer_segment {
+  struct buffer_segment* next;     /**< Next segment of the chain */
+  size_t len;                      /**< Number of bytes in the segment */
+  size_t sent;                     /**< Bytes of the segment already written */
+  char data[];                     /**< The bytes, up to BUFFER_SEGMENT_CAPACITY */
+} buffer_segment_t;
+
+/**
+ * @brief Number of bytes a segment holds, one byte is kept for the '\0'.
+ */
+#define BUFFER_SEGMENT_CAPACITY (BUFFER_SIZE - sizeof(buffer_segment_t) - 1)
+
+/**
+ * @brief Chain of segments.
+ */
+typedef struct {
+  buffer_segment_t* head;          /**< First segment, written first */
+  buffer_segment_t* tail;          /**< Last segment, bytes are appended to it */
+  size_t len;                      /**< Number of bytes not written yet */
+  int nb_segments;                 /**< Number of segments in the chain */
+  buffer_pool_t* pool;             /**< Pool the segments come from, NULL to allocate them directly */
+} buffer_chain_t;
+
+/**
+ * @brief Bytes gathered from several places, written to a socket in one vectored write.
+ *
+ * Used to send a message edited on the fly: the pieces are taken where they lie, and only
+ * those the socket does not accept at once are copied, to a chain written later.
+ */
+typedef struct {
+  int fd;                          /**< Socket written to */
+  buffer_chain_t* rest;            /**< Chain receiving the bytes the socket did not accept */
+  struct iovec iov[BUFFER_CHAIN_IOV]; /**< Pieces of the next write */
+  int count;                       /**< Number of pieces gathered */
+  size_t sent;                     /**< Bytes written so far */
+  int error;                       /**< Set once a write or a copy failed */
+} buffer_chain_writer_t;
+
+void init_buffer_chain(buffer_chain_t* chain, buffer_pool_t* pool);
+char* buffer_chain_reserve(buffer_chain_t* chain, int keep_lines, size_t* room);
+void buffer_chain_commit(buffer_chain_t* chain, size_t len);
+int buffer_chain_append(buffer_chain_t* chain, const char* data, size_t len);
+int buffer_chain_split(buffer_chain_t* chain, size_t offset, buffer_chain_t* rest);
+ssize_t buffer_chain_send(buffer_chain_t* chain, int fd);
+void buffer_chain_clear(buffer_chain_t* chain);
+void init_buffer_chain_writer(buffer_chain_writer_t* writer, int fd, buffer_chain_t* rest);
+void buffer_chain_writer_add(buffer_chain_writer_t* writer, const char* data, size_t len);
+ssize_t buffer_chain_writer_flush(buffer_chain_writer_t* writer);
+
+#endif
@@ -11,6 +11,22 @@
  * the function declarations for loading the configuration from a file.
  */
 
+/**
+ * @brief Fewest clients WORKERS auto leaves to each worker.
+ */
+#define WORKER_MIN_CLIENTS 16
+
+/**
+ * @brief Bounds of MAX_HEADER_SIZE, in bytes.
+ */
+#define MIN_HEADER_SIZE 1024
+#define MAX_HEADER_SIZE_LIMIT (16 * 1024 * 1024)
+
+/**
+ * @brief Longest timeout accepted, in seconds.
+ */
+#define MAX_TIMEOUT 86400
+
 /**
  * @brief Structure to hold the configuration settings.
  * 
@@ -24,17 +40,33 @@ typedef struct {
     int max_client;                  /**< The maximum number of clients that can connect simultaneously. */
     char logger_filename[256];       /**< The filename where logs are recorded. */
     char rules_filename[256];        /**< The filename containing the filtering rules. */
+    int workers;                     /**< The number of worker threads, each with its own listener and event loop. */
+    int cpu_affinity;                /**< Pin each worker thread to a CPU when set. */
+    int header_timeout;              /**< Seconds a client has to send its complete request headers. */
+    int connect_timeout;             /**< Seconds allowed to establish the connection to the remote server. */
+    char dns_server[64];             /**< IPv4 address of the DNS resolver, empty to use /etc/resolv.conf. */
+    int dns_port;                    /**< Port of the DNS resolver. */
+    int dns_cache_size;              /**< Maximum number of hosts kept in the DNS cache. */
+    int splice;                      /**< Relay the payload with splice() instead of user-space buffers when set. */
+    int max_header_size;             /**< Maximum size in bytes of the headers of a request. */
+    int upstream_max_idle;           /**< Idle connections kept per origin server and worker, 0 to never reuse them. */
+    int upstream_idle_timeout;       /**< Seconds an idle connection to an origin server is kept. */
+    int filter_responses;            /**< Scan text response bodies for banned words when set. */
+    int verdict_cache_size;          /**< Hosts whose verdict each worker keeps, 0 to look the rules up every time. */
 } config_t;
 
 /** 
  * @brief Externally declared configuration structure.
  * 
  * This structure holds the global configuration settings that are initialized
- * when the proxy server starts.
+ * when the proxy server starts. The workers read current_config(), which
+ * reload_config() replaces.
  */
 extern config_t config;
 
 int init_config(const char* filename);
+const config_t* current_config();
+int reload_config(const char* filename);
 
 #endif
 
@@ -0,0 +1,90 @@
+/**
+ * @file dns_client.h
+ * @brief Header file for the non-blocking DNS client used by the event loops.
+ *
+ * Each event loop owns a UDP socket connected to the resolver. Queries are sent without
+ * waiting, answers are read when the socket becomes readable and the result is handed to
+ * a callback, so a slow resolver never blocks the other connections.
+ */
+
+#ifndef DNS_CLIENT_H
+#define DNS_CLIENT_H
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Port of the DNS service.
+ */
+#define DNS_PORT 53
+
+/**
+ * @brief Maximum size of a DNS message over UDP.
+ */
+#define DNS_MAX_MESSAGE 512
+
+/**
+ * @brief Delay in milliseconds before a query without answer is sent again.
+ */
+#define DNS_RETRY_MS 2000
+
+/**
+ * @brief Number of times a query is sent before the resolution fails.
+ */
+#define DNS_MAX_ATTEMPTS 3
+
+/**
+ * @brief Number of buckets of the table of pending queries, indexed by query id.
+ */
+#define DNS_PENDING_BUCKETS 256
+
+/**
+ * @brief Function called when a resolution ends.
+ *
+ * @param data The user data given to init_dns_client().
+ * @param ctx The context given to dns_client_query().
+ * @param host The hostname that was resolved.
+ * @param status 0 if the host was resolved, -1 otherwise.
+ * @param addr The IPv4 address of the host, NULL on failure.
+ * @param ttl The time to live of the answer in seconds.
+ */
+typedef void (*dns_callback_t)(void* data, void* ctx, const char* host, int status, const struct in_addr* addr, uint32_t ttl);
+
+/**
+ * @brief A query waiting for its answer.
+ */
+typedef struct dns_query {
+  uint16_t id;                     /**< Identifier of the query, echoed by the resolver */
+  char host[256];                  /**< The hostname to resolve */
+  int attempts;                    /**< Number of times the query has been sent */
+  long long retry_at;              /**< Monotonic time (ms) of the next retransmission */
+  void* ctx;                       /**< Context given back to the callback */
+  struct dns_query* next;          /**< Next query of the same bucket */
+} dns_query_t;
+
+/**
+ * @brief State of a DNS client.
+ */
+typedef struct {
+  int fd;                                      /**< UDP socket connected to the resolver */
+  struct sockaddr_in server;                   /**< Address of the resolver */
+  dns_callback_t callback;                     /**< Function called when a resolution ends */
+  void* data;                                  /**< User data given to the callback */
+  int nb_pending;                              /**< Number of queries waiting for an answer */
+  dns_query_t* pending[DNS_PENDING_BUCKETS];   /**< Pending queries, by id */
+} dns_client_t;
+
+int get_default_dns_server(char* server, size_t size);
+int init_dns_client(dns_client_t* client, const char* server_ip, int port, dns_callback_t callback, void* data);
+int dns_client_query(dns_client_t* client, const char* host, void* ctx);
+void dns_client_cancel(dns_client_t* client, void* ctx);
+void dns_client_read(dns_client_t* client);
+void dns_client_expire(dns_client_t* client, long long now);
+void free_dns_client(dns_client_t* client);
+int dns_build_query(uint16_t id, const char* host, unsigned char* buffer, size_t size);
+int dns_response_id(const unsigned char* buffer, size_t len, uint16_t* id);
+int dns_parse_response(const unsigned char* buffer, size_t len, const char* host, struct in_addr* addr, uint32_t* ttl);
+
+#endif
@@ -8,6 +8,17 @@
 
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <stdint.h>
+
+/**
+ * @brief Lifetime in seconds of the addresses resolved by getaddrinfo(), which hides the TTL.
+ */
+#define DNS_CACHE_DEFAULT_TTL 60
+
+/**
+ * @brief Longest time in seconds an address is kept, whatever its TTL.
+ */
+#define DNS_CACHE_MAX_TTL 3600
 
 /**
  * @struct dns_cache_entry
@@ -17,20 +28,34 @@ typedef struct dns_cache_entry {
     char host[256];                    /**< The hostname. */
     char ipstr[INET6_ADDRSTRLEN];      /**< The IP address as a string. */
     struct addrinfo *addr_info;        /**< The deep-copied addrinfo structure. */
-    struct dns_cache_entry *next;      /**< Pointer to the next cache entry. */
+    uint32_t hash;                     /**< Hash of the hostname. */
+    long long expires_at;              /**< Monotonic time (ms) after which the entry is stale. */
+    struct dns_cache_entry *next;      /**< Next entry of the same bucket. */
+    struct dns_cache_entry *lru_prev;  /**< More recently used entry. */
+    struct dns_cache_entry *lru_next;  /**< Less recently used entry. */
 } dns_cache_entry_t;
 
 /**
  * @struct dns_cache
  * @brief Represents the DNS cache.
+ *
+ * Entries are indexed by a hash of their hostname and kept in least recently used order,
+ * the oldest one is evicted when the cache is full. The hash table has as many buckets as
+ * the cache has entries at most, rounded up to a power of two.
  */
 typedef struct dns_cache {
-    dns_cache_entry_t *head;           /**< Pointer to the head of the cache entries list. */
+    dns_cache_entry_t **buckets;       /**< Hash table of the entries. */
+    uint32_t bucket_mask;              /**< Number of buckets minus one. */
+    dns_cache_entry_t *lru_head;       /**< Most recently used entry. */
+    dns_cache_entry_t *lru_tail;       /**< Least recently used entry, evicted first. */
+    int nb_entries;                    /**< Number of entries in the cache. */
+    int max_entries;                   /**< Maximum number of entries. */
 } dns_cache_t;
 
-int init_dns_cache();
-dns_cache_entry_t* find_in_cache(const char* host);
-int add_in_cache(const char* host, const char* ipstr, struct addrinfo* addr_info);
+int init_dns_cache(int max_entries);
+int find_in_cache(const char* host, char* ipstr, struct addrinfo** res);
+int add_in_cache(const char* host, const char* ipstr, const struct addrinfo* addr_info, uint32_t ttl);
+int dns_cache_count();
 int resolve_dns(const char* host, struct addrinfo** res, char* ipstr);
 void free_dns_cache();
 struct addrinfo *copy_addrinfo(const struct addrinfo *src);
@@ -0,0 +1,47 @@
+/**
+ * @file domain_filter.h
+ * @brief Header file for the prefilter of the banned domains.
+ *
+ * Most hosts are allowed, yet finding that out in the domain set and the suffix trie reads
+ * tables far larger than the caches. The filter is a split block Bloom filter built beside
+ * them: each key sets one bit in each of the 8 words of a single block of 32 bytes, so a
+ * lookup reads one cache line. A key never added is reported absent, except for a small
+ * rate of false positives; a key added is always reported present.
+ */
+
+#ifndef DOMAIN_FILTER_H
+#define DOMAIN_FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Bits of filter per key, about 0.5% of false positives.
+ */
+#define DOMAIN_FILTER_BITS_PER_KEY 12
+
+/**
+ * @brief Block of the filter, within a single cache line once the filter is aligned on 64 bytes.
+ */
+typedef struct {
+  uint32_t words[8];               /**< Each key sets one bit in every word */
+} domain_filter_block_t;
+
+/**
+ * @brief Filter of the hashes of a set of keys.
+ */
+typedef struct {
+  domain_filter_block_t* blocks;   /**< Blocks, aligned on 64 bytes */
+  size_t nb_blocks;                /**< Number of blocks, 0 for an empty filter */
+  size_t nb_keys;                  /**< Number of keys added */
+} domain_filter_t;
+
+void init_domain_filter(domain_filter_t* filter);
+int domain_filter_reserve(domain_filter_t* filter, size_t count);
+void domain_filter_add(domain_filter_t* filter, uint64_t hash);
+int domain_filter_contains(const domain_filter_t* filter, uint64_t hash);
+size_t domain_filter_size(const domain_filter_t* filter);
+double domain_filter_false_positive_rate(const domain_filter_t* filter);
+void free_domain_filter(domain_filter_t* filter);
+
+#endif
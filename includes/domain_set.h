@@ -0,0 +1,55 @@
+/**
+ * @file domain_set.h
+ * @brief Header file for the set of banned domains.
+ *
+ * The domains of every category are stored in a single open-addressing table, probed
+ * linearly and kept at most half full. Each slot keeps the hash of its domain, so a lookup
+ * costs one hash of the host and, in most cases, a single string comparison, whatever
+ * the number of domains loaded.
+ */
+
+#ifndef DOMAIN_SET_H
+#define DOMAIN_SET_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Number of slots of an empty set, a power of two.
+ */
+#define DOMAIN_SET_MIN_CAPACITY 16
+
+/**
+ * @brief Slot of the table.
+ */
+typedef struct {
+  uint32_t domain;                 /**< Offset of the domain in the text, NUL terminated, 0 for a free slot */
+  uint32_t hash;                   /**< Hash of the domain, computed once when it is added */
+  uint32_t category;               /**< Index of the category banning the domain */
+} domain_slot_t;
+
+/**
+ * @brief Set of domains, each one mapped to a category.
+ *
+ * The domains are copied one after the other in a single text, which the slots refer to
+ * by offset: the set holds no pointer, so it can be written to a file and mapped back as is.
+ */
+typedef struct {
+  domain_slot_t* slots;            /**< Table of capacity slots */
+  size_t capacity;                 /**< Number of slots, a power of two */
+  size_t count;                    /**< Number of domains */
+  char* text;                      /**< Domains, NUL terminated, the first byte is unused so no domain is at 0 */
+  size_t text_len;                 /**< Bytes of text used */
+  size_t text_capacity;            /**< Bytes of text allocated */
+} domain_set_t;
+
+void init_domain_set(domain_set_t* set);
+uint64_t domain_hash64(const char* domain, size_t len);
+uint32_t domain_hash(const char* domain, size_t len);
+int domain_set_reserve(domain_set_t* set, size_t count);
+int domain_set_add(domain_set_t* set, const char* domain, uint32_t category);
+int domain_set_find(const domain_set_t* set, const char* host, size_t len);
+int domain_set_check(const domain_set_t* set, size_t nb_categories);
+void free_domain_set(domain_set_t* set);
+
+#endif
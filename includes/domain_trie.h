@@ -0,0 +1,54 @@
+/**
+ * @file domain_trie.h
+ * @brief Header file for the trie of banned domain suffixes.
+ *
+ * A rule "*.example.com" bans every subdomain of example.com. The suffixes are stored as
+ * a trie of labels read from the right (com, then example), so a host is matched by
+ * walking its labels once, whatever the number of rules. The trie lives in three flat
+ * arrays: the category of each node, the edges in an open-addressing table keyed by the
+ * parent node and the label, and the text of the labels.
+ */
+
+#ifndef DOMAIN_TRIE_H
+#define DOMAIN_TRIE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Longest label of a domain name.
+ */
+#define DOMAIN_TRIE_MAX_LABEL 63
+
+/**
+ * @brief Edge of the trie, from a node to the child reached by one label.
+ */
+typedef struct {
+  uint32_t hash;                   /**< Hash of the parent and the label */
+  uint32_t parent;                 /**< Index of the parent node */
+  uint32_t child;                  /**< Index of the child node, 0 for a free slot (the root is no child) */
+  uint32_t label;                  /**< Offset of the label in the text, a length byte then the label */
+} domain_trie_edge_t;
+
+/**
+ * @brief Trie of domain suffixes, each one mapped to a category.
+ */
+typedef struct {
+  int32_t* categories;             /**< Category of the rule ending at each node, -1 if none, node 0 is the root */
+  size_t nb_nodes;                 /**< Number of nodes, root included */
+  size_t nodes_capacity;           /**< Number of nodes allocated */
+  domain_trie_edge_t* edges;       /**< Table of edges, a power of two slots kept at most half full */
+  size_t edges_capacity;           /**< Number of slots of the edges */
+  char* labels;                    /**< Text of the labels */
+  size_t labels_len;               /**< Bytes of text used */
+  size_t labels_capacity;          /**< Bytes of text allocated */
+  size_t nb_rules;                 /**< Number of suffixes added */
+} domain_trie_t;
+
+void init_domain_trie(domain_trie_t* trie);
+int domain_trie_add(domain_trie_t* trie, const char* suffix, uint32_t category);
+int domain_trie_find(const domain_trie_t* trie, const char* host, size_t len);
+int domain_trie_check(const domain_trie_t* trie, size_t nb_categories);
+void free_domain_trie(domain_trie_t* trie);
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ * @file epoch.h
+ * @brief Header file for the epoch based reclamation of shared snapshots.
+ *
+ * Data read by every worker, the rules and the configuration, is published as an immutable
+ * snapshot behind an atomic pointer. Workers read it without locking, within a read-side
+ * section entered once per batch of events. A writer replacing a snapshot waits for a grace
+ * period, until every reader has left the section it was in, before freeing the old one:
+ * lookups in progress finish against the old snapshot, the next ones see the new one.
+ */
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <stdint.h>
+
+/**
+ * @brief Maximum number of readers registered at once, one per event loop.
+ */
+#define EPOCH_MAX_READERS 1024
+
+/**
+ * @brief Delay in milliseconds between two checks of the readers during a grace period.
+ */
+#define EPOCH_POLL_MS 1
+
+int epoch_register(void);
+void epoch_unregister(int reader);
+void epoch_enter(int reader);
+void epoch_exit(int reader);
+void epoch_synchronize(void);
+
+#endif
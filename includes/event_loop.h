@@ -0,0 +1,54 @@
+/**
+ * @file event_loop.h
+ * @brief Header file for the epoll based event loop of the proxy.
+ *
+ * The event loop owns the listening socket and every client/server connection accepted on it.
+ * Sockets are registered in edge-triggered mode and each ready event carries a pointer to the
+ * owning connection, so the cost of a wakeup does not depend on the number of open connections.
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include "server.h"
+
+/**
+ * @brief Maximum number of events handled per call to epoll_wait().
+ */
+#define EVENT_LOOP_MAX_EVENTS 256
+
+/**
+ * @brief Interval in milliseconds between two checks of the connection deadlines.
+ */
+#define EVENT_LOOP_TICK_MS 1000
+
+/**
+ * @brief State of an event loop.
+ */
+typedef struct {
+  int epoll_fd;                    /**< File descriptor of the epoll instance */
+  int listen_fd;                   /**< Listening socket accepting new clients */
+  int wake_fd;                     /**< eventfd used by other threads to wake the loop up */
+  conn_handle_t listen_handle;     /**< Handle registered for the listening socket */
+  conn_handle_t wake_handle;       /**< Handle registered for the wake-up eventfd */
+  dns_client_t dns;                /**< DNS client resolving the hosts of this loop, fd is -1 if unavailable */
+  conn_handle_t dns_handle;        /**< Handle registered for the socket of the DNS client */
+  int max_connections;             /**< Maximum number of simultaneous connections */
+  int nb_connections;              /**< Number of connections currently open */
+  int accept_paused;               /**< Set when accepting stopped because the loop was full */
+  connection_t* connections;       /**< List of open connections */
+  connection_t* closed;            /**< Connections closed during the current batch, freed after it */
+  pool_t connection_pool;          /**< Slabs the connections are allocated from */
+  buffer_pool_t buffer_pool;       /**< I/O buffers attached to the connections while bytes are in flight */
+  upstream_pool_t upstreams;       /**< Idle connections to the servers, kept for the next requests */
+  verdict_cache_t verdicts;        /**< Verdicts of the rules on the hosts requested through this loop */
+  int epoch_reader;                /**< Reader of the published rules and configuration, see epoch.h */
+} event_loop_t;
+
+int init_event_loop(event_loop_t* loop, int listen_fd, int max_connections);
+int run_event_loop(event_loop_t* loop, volatile int* running);
+void wake_event_loop(event_loop_t* loop);
+void close_connection(event_loop_t* loop, connection_t* conn);
+void free_event_loop(event_loop_t* loop);
+
+#endif
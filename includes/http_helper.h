@@ -12,6 +12,25 @@
 
 #include <stdlib.h>
 
+/**
+ * @brief HTTP 400 Bad Request response.
+ *
+ * This macro defines the response sent to a client whose request head is malformed or
+ * ambiguous, before its connection is closed.
+ */
+#define HTTP_400_RESPONSE "HTTP/1.1 400 Bad Request\r\n" \
+                          "Content-Type: text/html\r\n" \
+                          "Content-Length: 165\r\n" \
+                          "Connection: close\r\n" \
+                          "\r\n" \
+                          "<html>\r\n" \
+                          "<head><title>400 Bad Request</title></head>\r\n" \
+                          "<body>\r\n" \
+                          "    <h1>400 Bad Request</h1>\r\n" \
+                          "    <p>The proxy could not understand the request.</p>\r\n" \
+                          "</body>\r\n" \
+                          "</html>\r\n"
+
 /**
  * @brief HTTP 404 Not Found response.
  *
@@ -53,6 +72,44 @@
                           "</body>\r\n" \
                           "</html>\r\n"
 
+/**
+ * @brief HTTP 408 Request Timeout response.
+ *
+ * This macro defines the response sent to a client that did not send its complete request
+ * headers within the configured delay.
+ */
+#define HTTP_408_RESPONSE "HTTP/1.1 408 Request Timeout\r\n" \
+                          "Content-Type: text/html\r\n" \
+                          "Content-Length: 185\r\n" \
+                          "Connection: close\r\n" \
+                          "\r\n" \
+                          "<html>\r\n" \
+                          "<head><title>408 Request Timeout</title></head>\r\n" \
+                          "<body>\r\n" \
+                          "    <h1>408 Request Timeout</h1>\r\n" \
+                          "    <p>The proxy did not receive the complete request in time.</p>\r\n" \
+                          "</body>\r\n" \
+                          "</html>\r\n"
+
+/**
+ * @brief HTTP 504 Gateway Timeout response.
+ *
+ * This macro defines the response sent to a client when the connection to the remote server
+ * is not established within the configured delay.
+ */
+#define HTTP_504_RESPONSE "HTTP/1.1 504 Gateway Timeout\r\n" \
+                          "Content-Type: text/html\r\n" \
+                          "Content-Length: 186\r\n" \
+                          "Connection: close\r\n" \
+                          "\r\n" \
+                          "<html>\r\n" \
+                          "<head><title>504 Gateway Timeout</title></head>\r\n" \
+                          "<body>\r\n" \
+                          "    <h1>504 Gateway Timeout</h1>\r\n" \
+                          "    <p>The remote server did not accept the connection in time.</p>\r\n" \
+                          "</body>\r\n" \
+                          "</html>\r\n"
+
 /**
  * @file http_helper.h
  * @brief Helper functions for handling HTTP requests.
@@ -62,7 +119,10 @@
  */
 
 int is_http_method(const char* buffer);
+int is_http_method_name(const char* method, size_t len);
+int is_idempotent_method(const char* method, size_t len);
 int is_http_request_complete(const char* buffer);
+int is_http_request_line(const char* buffer);
 int get_http_host(const char* buffer, char* host, size_t host_size);
 
 #endif
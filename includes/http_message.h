@@ -0,0 +1,123 @@
+/**
+ * @file http_message.h
+ * @brief Header file for the framing of HTTP/1.1 messages.
+ *
+ * Messages are never buffered whole: the head of a request or a response is parsed to learn
+ * how its body is delimited, then the body is followed as it is relayed, so the proxy knows
+ * where each message ends and whether the connection can carry the next one.
+ */
+
+#ifndef HTTP_MESSAGE_H
+#define HTTP_MESSAGE_H
+
+#include <stddef.h>
+
+#include "buffer_chain.h"
+
+/**
+ * @brief How the body of a message is delimited.
+ */
+typedef enum {
+  HTTP_BODY_NONE,                  /**< No body */
+  HTTP_BODY_LENGTH,                /**< Content-Length bytes */
+  HTTP_BODY_CHUNKED,               /**< Chunked transfer coding */
+  HTTP_BODY_UNTIL_CLOSE            /**< Every byte until the connection is closed */
+} http_body_kind_t;
+
+/**
+ * @brief Position of the decoder in a chunked body.
+ */
+typedef enum {
+  CHUNK_SIZE,                      /**< Hexadecimal size of the chunk */
+  CHUNK_EXTENSION,                 /**< Extensions following the size, ignored */
+  CHUNK_SIZE_LF,                   /**< Line feed ending the size line */
+  CHUNK_DATA,                      /**< Data of the chunk */
+  CHUNK_DATA_CR,                   /**< Carriage return following the data */
+  CHUNK_DATA_LF,                   /**< Line feed following the data */
+  CHUNK_TRAILER                    /**< Trailer fields, up to the empty line */
+} http_chunk_state_t;
+
+/**
+ * @brief Progress of a message body.
+ */
+typedef struct {
+  unsigned long long remaining;    /**< Bytes left in the body, or in the current chunk */
+  size_t line_len;                 /**< Length of the current trailer line */
+  http_body_kind_t kind;           /**< How the body is delimited */
+  http_chunk_state_t chunk_state;  /**< Position of the decoder in a chunked body */
+  int digits;                      /**< Digits of the chunk size read so far */
+  unsigned char done;              /**< Set once the whole body has been seen */
+  unsigned char error;             /**< Set when the chunked coding is malformed, the body then lasts until close */
+} http_body_t;
+
+/**
+ * @brief Progress of the search for the end of a head, kept between two reads.
+ */
+typedef struct {
+  size_t scanned;                  /**< Bytes of the message already examined */
+  int matched;                     /**< Bytes of "\r\n\r\n" matched by the last bytes examined */
+} http_head_scanner_t;
+
+/**
+ * @brief Maximum number of header lines indexed in the head of a message.
+ */
+#define HTTP_MAX_HEADERS 64
+
+/**
+ * @brief Bytes of a message, pointed to where they were received.
+ */
+typedef struct {
+  const char* data;                /**< First byte, inside a segment of the chain */
+  size_t len;                      /**< Number of bytes */
+} http_slice_t;
+
+/**
+ * @brief A header line of a message, its value without the surrounding white space.
+ */
+typedef struct {
+  http_slice_t name;               /**< Name of the header, as sent */
+  http_slice_t value;              /**< Value of the header */
+} http_header_t;
+
+/**
+ * @brief Index of the head of a message and what it tells about its framing.
+ */
+typedef struct {
+  http_slice_t method;             /**< Method of a request */
+  http_slice_t target;             /**< Target of a request, as sent */
+  http_slice_t version;            /**< Protocol version, "HTTP/1.x" */
+  char* start_line;                /**< Copy of a request line longer than a segment, which its slices point into, NULL otherwise */
+  size_t start_line_len;           /**< Length of the copied request line, with its line feed */
+  http_header_t headers[HTTP_MAX_HEADERS]; /**< Header lines in the order received */
+  int nb_headers;                  /**< Number of indexed header lines */
+  const char* end;                 /**< Empty line ending the head, inside a segment of the chain */
+  http_slice_t host;               /**< Value of the Host header of a request, data is NULL if absent */
+  int status;                      /**< Status code of a response, 0 for a request */
+  int head_method;                 /**< Set for a HEAD request, whose response has no body */
+  int minor_version;               /**< 1 for HTTP/1.1, 0 for HTTP/1.0 */
+  long long content_length;        /**< Value of Content-Length, -1 if absent */
+  int transfer_encoding;           /**< Set when a Transfer-Encoding header is present */
+  int chunked;                     /**< Set when chunked is the last transfer coding */
+  int connection_close;            /**< Set when Connection lists close */
+  int connection_keep_alive;       /**< Set when Connection lists keep-alive */
+  int invalid;                     /**< Set when the start line or a header line is malformed */
+} http_head_t;
+
+void init_http_head_scanner(http_head_scanner_t* scanner);
+int http_head_scan(http_head_scanner_t* scanner, const buffer_chain_t* chain, size_t* head_len);
+int find_http_head_end(const buffer_chain_t* chain, size_t* head_len);
+int parse_http_head(const buffer_chain_t* chain, int response, http_head_t* head);
+void free_http_head(http_head_t* head);
+const http_header_t* http_head_find(const http_head_t* head, const char* name);
+int http_header_hop_by_hop(const http_head_t* head, const http_header_t* header);
+int http_target_origin_form(const http_slice_t* target, size_t* prefix_len);
+int http_head_keep_alive(const http_head_t* head);
+void init_http_body(http_body_t* body, http_body_kind_t kind, unsigned long long length);
+int init_request_body(http_body_t* body, const http_head_t* request);
+void init_response_body(http_body_t* body, const http_head_t* response, int head_request);
+size_t http_body_consume(http_body_t* body, const char* data, size_t len);
+size_t http_body_consume_chain(http_body_t* body, const buffer_chain_t* chain, size_t offset);
+size_t http_body_raw_limit(const http_body_t* body);
+void http_body_skip(http_body_t* body, size_t len);
+
+#endif
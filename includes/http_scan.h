@@ -0,0 +1,35 @@
+/**
+ * @file http_scan.h
+ * @brief Header file for the delimiter scanning kernels of the HTTP parser.
+ *
+ * The parser spends its time looking for a few delimiters (CR, LF, ':' and spaces). The
+ * kernels compare 16 (SSE2) or 32 (AVX2) bytes at a time; the best one the CPU supports is
+ * selected once at startup, with a scalar loop as the fallback.
+ */
+
+#ifndef HTTP_SCAN_H
+#define HTTP_SCAN_H
+
+#include <stddef.h>
+
+/**
+ * @brief Most delimiters searched at once by http_scan_any().
+ */
+#define HTTP_SCAN_MAX_SET 4
+
+/**
+ * @brief Instruction set used by the kernels.
+ */
+typedef enum {
+  HTTP_SCAN_SCALAR,                /**< One byte at a time */
+  HTTP_SCAN_SSE2,                  /**< 16 bytes at a time */
+  HTTP_SCAN_AVX2                   /**< 32 bytes at a time */
+} http_scan_level_t;
+
+size_t http_scan_byte(const char* data, size_t len, char c);
+size_t http_scan_any(const char* data, size_t len, const char* set);
+int http_scan_select(http_scan_level_t level);
+http_scan_level_t http_scan_level();
+const char* http_scan_level_name(http_scan_level_t level);
+
+#endif
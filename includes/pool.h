@@ -0,0 +1,80 @@
+/**
+ * @file pool.h
+ * @brief Header file for the memory pools of the event loops.
+ *
+ * Connections are carved out of slabs and recycled through a free list, and their I/O
+ * buffers come from a separate pool, attached only while bytes are in flight. Each event
+ * loop owns its pools, so they are used without any lock.
+ */
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+
+/**
+ * @brief Size of the I/O buffers attached to the connections.
+ */
+#define BUFFER_SIZE 4096
+
+/**
+ * @brief Number of objects allocated at once by a slab pool.
+ */
+#define POOL_SLAB_OBJECTS 64
+
+/**
+ * @brief Number of free buffers a buffer pool keeps for reuse, the others are released.
+ */
+#define BUFFER_POOL_MAX_FREE 64
+
+/**
+ * @brief Object of a pool, linked in the free list while unused.
+ */
+typedef struct pool_object {
+  struct pool_object* next;        /**< Next free object */
+} pool_object_t;
+
+/**
+ * @brief Block of memory holding POOL_SLAB_OBJECTS objects.
+ */
+typedef struct pool_slab {
+  struct pool_slab* next;          /**< Next slab of the pool */
+} pool_slab_t;
+
+/**
+ * @brief Pool of fixed-size objects allocated by slabs.
+ *
+ * Objects go back to the free list of the pool, slabs are only released by free_pool().
+ */
+typedef struct {
+  size_t object_size;              /**< Size of an object, rounded up to keep them aligned */
+  pool_object_t* free_list;        /**< Objects ready to be handed out */
+  pool_slab_t* slabs;              /**< Every slab allocated by the pool */
+  int nb_slabs;                    /**< Number of slabs allocated */
+  int nb_used;                     /**< Number of objects handed out */
+} pool_t;
+
+/**
+ * @brief Pool of I/O buffers of one size.
+ *
+ * A buffer is taken when bytes must be held and given back as soon as they are sent.
+ * At most BUFFER_POOL_MAX_FREE free buffers are kept, so a burst does not pin memory.
+ */
+typedef struct {
+  size_t buffer_size;              /**< Size of every buffer */
+  pool_object_t* free_list;        /**< Buffers ready to be handed out */
+  int nb_free;                     /**< Number of buffers in the free list */
+  int nb_used;                     /**< Number of buffers handed out */
+} buffer_pool_t;
+
+void init_pool(pool_t* pool, size_t object_size);
+void* pool_alloc(pool_t* pool);
+void pool_free(pool_t* pool, void* object);
+void free_pool(pool_t* pool);
+
+void init_buffer_pool(buffer_pool_t* pool, size_t buffer_size);
+char* buffer_pool_get(buffer_pool_t* pool);
+void buffer_pool_put(buffer_pool_t* pool, char* buffer);
+void free_buffer_pool(buffer_pool_t* pool);
+
+#endif
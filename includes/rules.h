@@ -1,8 +1,15 @@
 #ifndef RULES_H
 #define RULES_H
 
+#include <stdatomic.h>
 #include <stdlib.h>
 
+#include "domain_filter.h"
+#include "domain_set.h"
+#include "domain_trie.h"
+#include "verdict_cache.h"
+#include "word_matcher.h"
+
 /**
  * @file rules.h
  * @brief Definitions and structures for managing content filtering rules.
@@ -21,6 +28,7 @@
  * 
  * [categorie]
  * BAN_DOMAIN some_domain.com
+ * BAN_DOMAIN *.some_domain.com
  * BAN_WORD some_word
  * ```
  */
@@ -50,18 +58,33 @@ typedef struct {
 typedef struct {
   categories* rules;               /**< Array of rules (categories) */
   size_t nb_rules;                 /**< Number of categories (rules) */
+  domain_set_t domains;            /**< Banned domains of every category, mapped to their category */
+  domain_trie_t suffixes;          /**< Domains banned with their subdomains ("*.domain"), mapped to their category */
+  domain_filter_t filter;          /**< Prefilter of the domains and the suffixes, rules most allowed hosts out alone */
+  word_matcher_t words;            /**< Banned words of every category, compiled in a single automaton */
+  const void* image;               /**< Mapping the indexes point into when loaded from an image, NULL otherwise */
+  size_t image_len;                /**< Size of the mapping */
+  atomic_int refs;                 /**< References on the snapshot: one while published, one per response scanner */
+  uint64_t generation;             /**< Number of the load which filled the snapshot, the verdict caches key on it */
 } rules_t;
 
 /**
  * @brief Global variable holding the filtering rules.
  *
  * This global variable holds the set of rules that are loaded from the configuration
- * file and used to filter domains and words based on categories.
+ * file at startup and used to filter domains and words based on categories. Once the
+ * workers run, the lookups go through current_rules(), which reload_rules() replaces.
  */
 extern rules_t rules;
 
 int init_rules(const char* filename);
 void free_rules();
-int is_host_deny(const char* host);
+const rules_t* current_rules();
+rules_t* acquire_rules();
+void release_rules(rules_t* set);
+int reload_rules(const char* filename);
+int find_host_category(const rules_t* set, const char* host);
+int is_host_deny(verdict_cache_t* verdicts, const char* host);
+int find_banned_word(const rules_t* set, const char* data, size_t len, const char** word);
 
 #endif
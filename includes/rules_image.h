@@ -0,0 +1,98 @@
+/**
+ * @file rules_image.h
+ * @brief Header file for the compiled image of the filtering rules.
+ *
+ * An image holds the category names and the indexes built from a rules file: the domain
+ * set, the suffix trie, the domain filter and the automaton of the banned words, laid out as they are used in
+ * memory. The proxy maps it read-only and looks hosts up in place, so loading costs no
+ * parsing, no allocation per rule, and the pages are shared with every process mapping
+ * the same file. Images are written by the proxy-rulec tool.
+ */
+
+#ifndef RULES_IMAGE_H
+#define RULES_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rules.h"
+
+/**
+ * @brief First bytes of an image, telling it apart from a rules file.
+ */
+#define RULES_IMAGE_MAGIC "PXRULES\x01"
+
+/**
+ * @brief Version of the layout, bumped whenever one of the indexes changes.
+ */
+#define RULES_IMAGE_VERSION 2
+
+/**
+ * @brief Value written in native byte order, an image is only read by machines of the same order.
+ */
+#define RULES_IMAGE_BYTE_ORDER 0x01020304u
+
+/**
+ * @brief Alignment of the sections, a cache line so no block of the domain filter straddles two.
+ */
+#define RULES_IMAGE_ALIGN 64
+
+/**
+ * @brief Sections of an image, in the order they are written.
+ */
+typedef enum {
+  RULES_IMAGE_NAMES,               /**< Names of the categories, NUL terminated, in order */
+  RULES_IMAGE_DOMAIN_SLOTS,        /**< Slots of the domain set */
+  RULES_IMAGE_DOMAIN_TEXT,         /**< Text of the domain set */
+  RULES_IMAGE_TRIE_CATEGORIES,     /**< Category of each node of the suffix trie */
+  RULES_IMAGE_TRIE_EDGES,          /**< Edges of the suffix trie */
+  RULES_IMAGE_TRIE_LABELS,         /**< Labels of the suffix trie */
+  RULES_IMAGE_WORDS,               /**< Banned words, as rules_image_word_t */
+  RULES_IMAGE_WORD_TEXT,           /**< Text of the banned words, NUL terminated */
+  RULES_IMAGE_WORD_TRANSITIONS,    /**< Transitions of the word automaton */
+  RULES_IMAGE_WORD_MATCHES,        /**< Word matched at each state of the automaton */
+  RULES_IMAGE_DOMAIN_FILTER,       /**< Blocks of the domain filter */
+  RULES_IMAGE_NB_SECTIONS
+} rules_image_section_id_t;
+
+/**
+ * @brief Place of a section in the image.
+ */
+typedef struct {
+  uint64_t offset;                 /**< Offset from the start of the image, aligned */
+  uint64_t len;                    /**< Number of bytes */
+} rules_image_section_t;
+
+/**
+ * @brief A banned word in the image.
+ */
+typedef struct {
+  uint32_t text;                   /**< Offset of the word in RULES_IMAGE_WORD_TEXT */
+  uint32_t category;               /**< Index of the category banning the word */
+} rules_image_word_t;
+
+/**
+ * @brief Header at the start of an image.
+ *
+ * The number of entries of each index follows from the length of its sections.
+ */
+typedef struct {
+  char magic[8];                   /**< RULES_IMAGE_MAGIC */
+  uint32_t version;                /**< RULES_IMAGE_VERSION */
+  uint32_t byte_order;             /**< RULES_IMAGE_BYTE_ORDER */
+  uint64_t size;                   /**< Size of the whole image */
+  uint64_t nb_categories;          /**< Number of categories */
+  uint64_t nb_domains;             /**< Number of domains in the set */
+  uint64_t nb_suffixes;            /**< Number of suffixes in the trie */
+  uint64_t nb_classes;             /**< Number of byte classes of the word automaton */
+  uint64_t nb_filter_keys;         /**< Number of keys in the domain filter */
+  uint8_t classes[256];            /**< Class of each byte in the word automaton */
+  rules_image_section_t sections[RULES_IMAGE_NB_SECTIONS]; /**< Place of each section */
+} rules_image_header_t;
+
+int is_rules_image(const char* filename);
+int write_rules_image(const rules_t* rules, const char* filename);
+int map_rules_image(rules_t* rules, const char* filename);
+void unmap_rules_image(rules_t* rules);
+
+#endif
@@ -20,8 +20,67 @@
 #include <errno.h>
 
 #include "http_helper.h"
+#include "dns_client.h"
+#include "pool.h"
+#include "buffer_chain.h"
+#include "http_message.h"
+#include "upstream_pool.h"
+#include "body_filter.h"
+#include "rules.h"
 
-#define BUFFER_SIZE 4096
+/**
+ * @brief Value returned by handle_connection() while the request headers are not complete.
+ */
+#define CONN_PENDING 2
+
+/**
+ * @brief Value returned when a reused server connection closed before answering, the request is sent again.
+ */
+#define CONN_RETRY 3
+
+/**
+ * @brief Most bytes moved by one splice() into a relay pipe, the default capacity of a pipe.
+ */
+#define RELAY_PIPE_SIZE 65536
+
+struct connection;
+
+/**
+ * @brief Identifies which side of a connection a file descriptor belongs to.
+ */
+typedef enum {
+  CONN_SIDE_CLIENT,                      /**< The socket accepted from the client */
+  CONN_SIDE_SERVER                       /**< The socket opened to the remote server */
+} conn_side_t;
+
+/**
+ * @brief Processing state of a connection.
+ */
+typedef enum {
+  CONN_STATE_READING_REQUEST,            /**< Waiting for the complete request headers of the client */
+  CONN_STATE_RESOLVING,                  /**< Waiting for the DNS client to resolve the host */
+  CONN_STATE_CONNECTING,                 /**< Non-blocking connect() to the server in progress */
+  CONN_STATE_RELAYING                    /**< Connected to the server, bytes are queued and relayed both ways */
+} conn_state_t;
+
+/**
+ * @brief Scanner of a response body and the rules whose automaton it runs.
+ */
+typedef struct {
+  body_filter_t scanner;                 /**< Progress of the scan */
+  rules_t* rules;                        /**< Snapshot of the rules, referenced until the scanner is released */
+} response_filter_t;
+
+/**
+ * @brief Handle stored in the event loop for every registered socket.
+ *
+ * The event loop receives a pointer to this handle with each ready event, so it can
+ * go straight to the owning connection without searching any table.
+ */
+typedef struct {
+  struct connection* conn;               /**< Connection owning the socket */
+  conn_side_t side;                      /**< Side of the connection the socket belongs to */
+} conn_handle_t;
 
 /**
  * @brief Represents a connection between a client and a server.
@@ -29,21 +88,73 @@
  * This structure stores all data for handling a connection, including file descriptors for
  * the client and server, buffers for storing client and server data, the length of data in those buffers,
  * and the IP addresses of both the client and server.
+ * The buffers are only attached while they hold bytes, so an idle connection costs a few hundred bytes.
  */
-typedef struct {
+typedef struct connection {
   int client_fd;                         /**< File descriptor for the client socket */
   int server_fd;                         /**< File descriptor for the server socket */
-  char client_buffer[BUFFER_SIZE];       /**< Buffer for storing data received from the client */
-  char server_buffer[BUFFER_SIZE];       /**< Buffer for storing data to send to the server */
+  char* client_buffer;                   /**< Buffer for storing data received from the client, NULL while empty */
+  char* server_buffer;                   /**< Buffer for storing data received from the server, NULL while empty */
+  buffer_pool_t* buffers;                /**< Pool the buffers come from, NULL to allocate them directly */
+  buffer_chain_t request;                /**< Request headers until they are sent, short lines never span segments */
+  buffer_chain_t response;               /**< Response headers until they are sent */
+  http_head_t* request_head;             /**< Index of the request headers, attached from the buffer pool until the next request */
+  response_filter_t* response_filter;    /**< Scanner of the response body, attached from the buffer pool while a response is filtered */
+  http_head_scanner_t request_scan;      /**< Search for the end of the request headers, resumed at each read */
+  http_head_scanner_t response_scan;     /**< Search for the end of the response headers, resumed at each read */
+  buffer_chain_t pipelined;              /**< Bytes the client sent past the current request, the start of the next one */
+  http_body_t request_body;              /**< Framing of the request body being relayed */
+  http_body_t response_body;             /**< Framing of the response body being relayed */
+  int response_started;                  /**< Set once the response headers have been parsed */
+  int head_request;                      /**< Set for a HEAD request, its response has no body */
+  int keep_server;                       /**< Set while the server connection can carry another request */
+  int keep_client;                       /**< Set while the client connection can carry another request */
   ssize_t client_buffer_len;             /**< Length of data in the client buffer */
   ssize_t server_buffer_len;             /**< Length of data in the server buffer */
+  ssize_t client_buffer_sent;            /**< Bytes of the client buffer already written to the server */
+  ssize_t server_buffer_sent;            /**< Bytes of the server buffer already written to the client */
+  int client_eof;                        /**< Set once the client shut down its side */
+  int server_shutdown;                   /**< Set once the end of the request stream has been forwarded to the server */
+  int server_eof;                        /**< Set once the server closed, the connection closes when its pipe is flushed */
+  int splicing;                          /**< Set while the payload is relayed with splice() through the pipes below */
+  int client_pipe[2];                    /**< Pipe queuing the bytes of the client for the server */
+  int server_pipe[2];                    /**< Pipe queuing the bytes of the server for the client */
+  size_t client_pipe_len;                /**< Bytes waiting in the client pipe */
+  size_t server_pipe_len;                /**< Bytes waiting in the server pipe */
   char client_ip[INET_ADDRSTRLEN];       /**< IP address of the client as a string */
   char server_ip[INET_ADDRSTRLEN];       /**< IP address of the server as a string */
+  conn_handle_t client_handle;           /**< Event loop handle of the client socket */
+  conn_handle_t server_handle;           /**< Event loop handle of the server socket */
+  conn_state_t state;                    /**< Processing state of the connection */
+  int nb_requests;                       /**< Number of requests received on the client connection */
+  dns_client_t* resolver;                /**< DNS client of the event loop, NULL to resolve synchronously */
+  upstream_pool_t* upstreams;            /**< Idle server connections of the event loop, NULL to always connect */
+  verdict_cache_t* verdicts;             /**< Verdicts of the rules cached by the event loop, NULL to always look the rules up */
+  struct sockaddr_in server_addr;        /**< Address and port of the server */
+  long long deadline;                    /**< Monotonic time (ms) after which the current state times out, 0 if none */
+  int closed;                            /**< Set once the connection is closed, it is freed after the current batch of events */
+  int retryable;                         /**< Set while the server connection came from the pool and the request is kept whole, to be sent again if it closes before answering */
+  struct connection* prev;               /**< Previous connection in the event loop list */
+  struct connection* next;               /**< Next connection in the event loop list */
 } connection_t;
 
 int init_listen_socket(const char* address, int port, int max_client);
 int accept_connection(int listen_fd, struct sockaddr_in* client_addr, char* client_ip, int max_client, int nb_client);
 int handle_connection(connection_t* conn);
 int handle_http(connection_t* conn);
+int handle_dns_resolved(connection_t* conn, const char* host, int status, const struct in_addr* addr, uint32_t ttl);
+int handle_server_connected(connection_t* conn);
+int handle_response(connection_t* conn);
+int retry_request(connection_t* conn);
+void relay_until_close(connection_t* conn);
+void start_next_request(connection_t* conn);
+int attach_buffer(connection_t* conn, conn_side_t side);
+void release_buffer(connection_t* conn, conn_side_t side);
+int attach_request_head(connection_t* conn);
+void release_request_head(connection_t* conn);
+int filter_response_body(connection_t* conn, const char* data, size_t len);
+void release_response_filter(connection_t* conn);
+int open_relay_pipes(connection_t* conn);
+void close_relay_pipes(connection_t* conn);
 
 #endif
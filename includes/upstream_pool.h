@@ -0,0 +1,60 @@
+/**
+ * @file upstream_pool.h
+ * @brief Header file for the pool of idle connections to the origin servers.
+ *
+ * Once a response has been relayed, the connection to its server can carry the next
+ * request for the same address and port. Each event loop keeps such connections idle,
+ * grouped by origin, so most requests to a busy host skip the TCP handshake.
+ */
+
+#ifndef UPSTREAM_POOL_H
+#define UPSTREAM_POOL_H
+
+#include <netinet/in.h>
+
+#include "pool.h"
+
+/**
+ * @brief Number of buckets of the table of origins, a power of two.
+ */
+#define UPSTREAM_POOL_BUCKETS 64
+
+/**
+ * @brief Idle connection to an origin.
+ */
+typedef struct upstream_idle {
+  int fd;                              /**< Socket connected to the origin */
+  long long idle_since;                /**< Monotonic time (ms) the connection became idle */
+  struct upstream_idle* next;          /**< Connection idle for longer */
+} upstream_idle_t;
+
+/**
+ * @brief Origin server with idle connections.
+ */
+typedef struct upstream_origin {
+  struct in_addr addr;                 /**< Address of the origin */
+  in_port_t port;                      /**< Port of the origin, in network byte order */
+  int nb_idle;                         /**< Number of idle connections */
+  upstream_idle_t* idle;               /**< Idle connections, most recent first */
+  struct upstream_origin* next;        /**< Next origin of the same bucket */
+} upstream_origin_t;
+
+/**
+ * @brief Pool of idle connections of an event loop.
+ */
+typedef struct {
+  upstream_origin_t* buckets[UPSTREAM_POOL_BUCKETS];   /**< Origins, by address and port */
+  pool_t entries;                      /**< Slabs the idle connections are allocated from */
+  int max_idle_per_origin;             /**< Most idle connections kept for one origin */
+  int max_idle;                        /**< Most idle connections kept in total */
+  long long idle_timeout;              /**< Milliseconds an idle connection is kept */
+  int nb_idle;                         /**< Number of idle connections */
+} upstream_pool_t;
+
+void init_upstream_pool(upstream_pool_t* pool, int max_idle_per_origin, int max_idle, long long idle_timeout);
+int upstream_pool_get(upstream_pool_t* pool, const struct sockaddr_in* addr);
+int upstream_pool_put(upstream_pool_t* pool, const struct sockaddr_in* addr, int fd, long long now);
+void upstream_pool_expire(upstream_pool_t* pool, long long now);
+void free_upstream_pool(upstream_pool_t* pool);
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file verdict_cache.h
+ * @brief Header file for the cache of the verdicts of the rules on hosts.
+ *
+ * Most requests go to the same few thousand hosts. Each event loop keeps the verdict of the
+ * rules on the hosts it looked up, the category banning them or none, so a host visited
+ * again costs one probe of a small table instead of the lookups of the rules. Entries are
+ * evicted with the CLOCK policy. Every load of the rules has its own generation: the cache
+ * forgets its verdicts as soon as it is asked about rules of another generation.
+ */
+
+#ifndef VERDICT_CACHE_H
+#define VERDICT_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Longest host kept in the cache, longer ones are looked up in the rules every time.
+ */
+#define VERDICT_CACHE_MAX_HOST 54
+
+/**
+ * @brief Verdict on a host, on a cache line of its own.
+ */
+typedef struct {
+  uint32_t hash;                   /**< Hash of the host */
+  int32_t category;                /**< Category banning the host, -1 if it is allowed */
+  uint8_t len;                     /**< Length of the host */
+  uint8_t referenced;              /**< Set when the verdict is used, cleared by the clock hand */
+  char host[VERDICT_CACHE_MAX_HOST]; /**< The host, not NUL terminated */
+} verdict_entry_t;
+
+/**
+ * @brief Slot of the index of the entries.
+ */
+typedef struct {
+  uint32_t hash;                   /**< Hash of the host of the entry */
+  uint32_t entry;                  /**< Index of the entry plus one, 0 for a free slot */
+} verdict_slot_t;
+
+/**
+ * @brief Cache of an event loop, only used by its thread.
+ */
+typedef struct {
+  verdict_entry_t* entries;        /**< Entries, swept in order by the clock hand */
+  verdict_slot_t* slots;           /**< Index of the entries by hash, a power of two slots kept at most half full */
+  size_t capacity;                 /**< Most entries kept */
+  size_t nb_slots;                 /**< Number of slots of the index */
+  size_t nb_entries;               /**< Number of entries in use */
+  size_t hand;                     /**< Next entry the clock hand looks at */
+  uint64_t generation;             /**< Generation of the rules the verdicts come from */
+} verdict_cache_t;
+
+void init_verdict_cache(verdict_cache_t* cache, size_t capacity);
+int verdict_cache_get(verdict_cache_t* cache, uint64_t generation, const char* host, size_t len, uint32_t hash, int* category);
+void verdict_cache_put(verdict_cache_t* cache, uint64_t generation, const char* host, size_t len, uint32_t hash, int category);
+void free_verdict_cache(verdict_cache_t* cache);
+
+#endif
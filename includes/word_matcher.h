@@ -0,0 +1,54 @@
+/**
+ * @file word_matcher.h
+ * @brief Header file for the matcher of banned words.
+ *
+ * Every banned word is compiled into a single Aho-Corasick automaton, so a text is scanned
+ * once, one transition per byte, whatever the number of words. Case is ignored. Bytes are
+ * first mapped to the classes of the bytes the words use, which keeps the transition
+ * table small, one row of a few dozen entries per state, in a single array.
+ *
+ * The automaton is driven by a state the caller keeps, so a text received in pieces is
+ * scanned as it arrives and a word split between two pieces is still found.
+ */
+
+#ifndef WORD_MATCHER_H
+#define WORD_MATCHER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief State of the automaton before the first byte of a text.
+ */
+#define WORD_MATCHER_START 0
+
+/**
+ * @brief Banned word.
+ */
+typedef struct {
+  const char* word;                /**< Word, NUL terminated, owned by the caller */
+  uint32_t category;               /**< Index of the category banning the word */
+} word_matcher_word_t;
+
+/**
+ * @brief Automaton matching a set of words.
+ */
+typedef struct {
+  word_matcher_word_t* words;      /**< Words added, in order */
+  size_t nb_words;                 /**< Number of words */
+  size_t words_capacity;           /**< Number of words allocated */
+  uint8_t classes[256];            /**< Class of each byte, 0 for the bytes no word uses */
+  size_t nb_classes;               /**< Number of classes, the width of a row of transitions */
+  uint32_t* transitions;           /**< Next state for each state and class, NULL until compiled */
+  int32_t* matches;                /**< Word ending at each state, itself or as a suffix, -1 if none */
+  size_t nb_states;                /**< Number of states, the start state included */
+} word_matcher_t;
+
+void init_word_matcher(word_matcher_t* matcher);
+int word_matcher_add(word_matcher_t* matcher, const char* word, uint32_t category);
+int word_matcher_compile(word_matcher_t* matcher);
+int word_matcher_scan(const word_matcher_t* matcher, uint32_t* state, const char* data, size_t len);
+int word_matcher_check(const word_matcher_t* matcher, size_t nb_categories);
+void free_word_matcher(word_matcher_t* matcher);
+
+#endif
@@ -0,0 +1,34 @@
+/**
+ * @file worker.h
+ * @brief Header file for the worker threads of the proxy.
+ *
+ * Each worker owns a listening socket bound with SO_REUSEPORT, an event loop and the
+ * connections accepted on it. The kernel spreads new clients over the listeners, so the
+ * workers never share a connection and run without any lock on the hot path.
+ */
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <pthread.h>
+
+#include "config.h"
+#include "event_loop.h"
+
+/**
+ * @brief State of a worker thread.
+ */
+typedef struct {
+  int id;                          /**< Index of the worker, also used in the logs */
+  int cpu;                         /**< CPU the worker is pinned to, -1 if not pinned */
+  int listen_fd;                   /**< Listening socket of this worker */
+  pthread_t thread;                /**< Thread running the event loop */
+  int started;                     /**< Set once the thread has been created */
+  volatile int* running;           /**< Shared flag stopping every worker when cleared */
+  event_loop_t loop;               /**< Event loop of this worker */
+} worker_t;
+
+int start_workers(worker_t* workers, int nb_workers, const config_t* conf, volatile int* running);
+void stop_workers(worker_t* workers, int nb_workers);
+
+#endif
@@ -0,0 +1,59 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/*
+ * @file rulec.c
+ * @brief Entry point of proxy-rulec, the compiler of rules files.
+ *
+ * The rules file is loaded as the proxy would load it, then its indexes are written to an
+ * image, which RULES_FILENAME can name instead of the rules file: the proxy maps it at
+ * startup instead of parsing and indexing every rule.
+ *
+ * Usage: proxy-rulec <rules file> <image file>
+ */
+
+#include "includes/rules.h"
+#include "includes/rules_image.h"
+#include "includes/utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <rules file> <image file>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (is_rules_image(argv[1])) {
+    ERROR("%s is already a rules image\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  if (init_rules(argv[1]) != 0) {
+    ERROR("Loading rules failed...\n");
+    free_rules();
+    return EXIT_FAILURE;
+  }
+
+  if (write_rules_image(&rules, argv[2]) != 0) {
+    ERROR("Writing the rules image %s failed\n", argv[2]);
+    free_rules();
+    return EXIT_FAILURE;
+  }
+  printf("%s: %zu categories, %zu domains, %zu suffixes, %zu words\n",
+         argv[2], rules.nb_rules, rules.domains.count, rules.suffixes.nb_rules, rules.words.nb_words);
+  printf("domain filter: %zu bytes, %.3f%% of false positives\n",
+         domain_filter_size(&rules.filter), domain_filter_false_positive_rate(&rules.filter) * 100);
+  free_rules();
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,158 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file body_filter.c
+ * @brief Implementation of the scanner of response bodies.
+ */
+
+#include "../includes/body_filter.h"
+
+#include <string.h>
+#include <strings.h>
+
+/**
+ * @brief Tells if a response body is scanned, and how it is encoded.
+ *
+ * Text bodies (text/html, text/plain...) are scanned, without content coding or with a
+ * single gzip or deflate one. Other codings cannot be decoded, their bodies are relayed
+ * as they are.
+ *
+ * @param response The head of the response.
+ * @param coding Receives the content coding of the body.
+ *
+ * @return 1 if the body is scanned, 0 otherwise.
+ */
+int body_filter_applies(const http_head_t* response, body_coding_t* coding) {
+  const http_header_t* type = http_head_find(response, "Content-Type");
+  if (!type || type->value.len < 5 || strncasecmp(type->value.data, "text/", 5) != 0) return 0;
+
+  const http_header_t* encoding = http_head_find(response, "Content-Encoding");
+  const http_slice_t* value = encoding ? &encoding->value : NULL;
+  if (!value || (value->len == 8 && strncasecmp(value->data, "identity", 8) == 0)) {
+    *coding = BODY_CODING_IDENTITY;
+  } else if ((value->len == 4 && strncasecmp(value->data, "gzip", 4) == 0) ||
+             (value->len == 6 && strncasecmp(value->data, "x-gzip", 6) == 0)) {
+    *coding = BODY_CODING_GZIP;
+  } else if (value->len == 7 && strncasecmp(value->data, "deflate", 7) == 0) {
+    *coding = BODY_CODING_DEFLATE;
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Starts scanning a body.
+ *
+ * @param filter The scanner.
+ * @param framing The framing of the body, before any of its bytes was consumed.
+ * @param coding The content coding of the body.
+ * @param matcher The compiled automaton of the banned words, which must outlive the scanner.
+ *
+ * @return 0 on success, -1 if the inflater could not be initialized.
+ */
+int init_body_filter(body_filter_t* filter, const http_body_t* framing, body_coding_t coding, const word_matcher_t* matcher) {
+  memset(filter, 0, sizeof(body_filter_t));
+  filter->framing = *framing;
+  filter->coding = coding;
+  filter->matcher = matcher;
+  filter->state = WORD_MATCHER_START;
+
+  if (coding != BODY_CODING_IDENTITY) {
+    // 16 + MAX_WBITS expects a gzip header, MAX_WBITS a zlib one
+    int window_bits = coding == BODY_CODING_GZIP ? 16 + MAX_WBITS : MAX_WBITS;
+    if (inflateInit2(&filter->inflater, window_bits) != Z_OK) return -1;
+    filter->inflating = 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Inflates a piece of a compressed body and scans the bytes it yields.
+ *
+ * @return The index of the word found, or -1.
+ */
+static int scan_compressed(body_filter_t* filter, const char* data, size_t len) {
+  char window[BODY_FILTER_WINDOW];
+  z_stream* inflater = &filter->inflater;
+  inflater->next_in = (Bytef*)data;
+  inflater->avail_in = len;
+
+  while (1) {
+    inflater->next_out = (Bytef*)window;
+    inflater->avail_out = sizeof(window);
+    int ret = inflate(inflater, Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+      filter->error = 1;
+      return -1;
+    }
+
+    int found = word_matcher_scan(filter->matcher, &filter->state, window, sizeof(window) - inflater->avail_out);
+    if (found >= 0) return found;
+
+    // Bytes past the compressed stream are not part of the text
+    if (ret == Z_STREAM_END) {
+      if (inflater->avail_in > 0) filter->error = 1;
+      return -1;
+    }
+    // The window was not filled: the input is used up
+    if (inflater->avail_out > 0 || ret == Z_BUF_ERROR) return -1;
+  }
+}
+
+/**
+ * @brief Scans the next bytes of a body, as received.
+ *
+ * The chunk sizes and trailers are skipped, only the data is decoded and searched.
+ *
+ * @param filter The scanner.
+ * @param data The bytes of the body following the previous ones.
+ * @param len The number of bytes.
+ *
+ * @return The index of the banned word found in filter->matcher->words, or -1 if none was found.
+ *         After an error nothing is found anymore.
+ */
+int body_filter_feed(body_filter_t* filter, const char* data, size_t len) {
+  size_t offset = 0;
+  while (offset < len && !filter->error && !filter->framing.done) {
+    size_t raw = http_body_raw_limit(&filter->framing);
+    if (raw == 0) {
+      // A byte of chunk size or trailer
+      http_body_consume(&filter->framing, data + offset, 1);
+      if (filter->framing.error) filter->error = 1;
+      offset++;
+      continue;
+    }
+
+    size_t n = len - offset < raw ? len - offset : raw;
+    int found = filter->coding == BODY_CODING_IDENTITY
+              ? word_matcher_scan(filter->matcher, &filter->state, data + offset, n)
+              : scan_compressed(filter, data + offset, n);
+    http_body_skip(&filter->framing, n);
+    offset += n;
+    if (found >= 0) return found;
+  }
+  return -1;
+}
+
+/**
+ * @brief Frees the inflater of a scanner.
+ *
+ * @param filter The scanner.
+ */
+void free_body_filter(body_filter_t* filter) {
+  if (filter->inflating) inflateEnd(&filter->inflater);
+  filter->inflating = 0;
+}
@@ -0,0 +1,351 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file buffer_chain.c
+ * @brief Implementation of the chains of pooled buffer segments.
+ */
+
+#define _GNU_SOURCE
+
+#include "../includes/buffer_chain.h"
+#include "../includes/utils.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * @brief Initializes an empty chain.
+ *
+ * @param chain The chain to initialize.
+ * @param pool The pool the segments come from, NULL to allocate them directly.
+ */
+void init_buffer_chain(buffer_chain_t* chain, buffer_pool_t* pool) {
+  memset(chain, 0, sizeof(buffer_chain_t));
+  chain->pool = pool;
+}
+
+/**
+ * @brief Appends an empty segment to a chain.
+ *
+ * @param chain The chain.
+ *
+ * @return The new segment, or NULL if no memory is left.
+ */
+static buffer_segment_t* add_segment(buffer_chain_t* chain) {
+  buffer_segment_t* segment = (buffer_segment_t*)(chain->pool ? buffer_pool_get(chain->pool) : malloc(BUFFER_SIZE));
+  if (!segment) {
+    ERROR("Failed to allocate a buffer segment\n");
+    return NULL;
+  }
+  segment->next = NULL;
+  segment->len = 0;
+  segment->sent = 0;
+  segment->data[0] = '\0';
+
+  if (chain->tail) chain->tail->next = segment;
+  else chain->head = segment;
+  chain->tail = segment;
+  chain->nb_segments++;
+  return segment;
+}
+
+/**
+ * @brief Gives a segment back to the pool of its chain.
+ */
+static void release_segment(buffer_chain_t* chain, buffer_segment_t* segment) {
+  if (chain->pool) buffer_pool_put(chain->pool, (char*)segment);
+  else free(segment);
+  chain->nb_segments--;
+}
+
+/**
+ * @brief Returns where the next bytes of a chain must be written.
+ *
+ * When the last segment is full, a new one is appended. With keep_lines, the partial line
+ * ending the full segment is moved to the new one, so that every line shorter than a segment
+ * lies in a single segment and can be parsed in place. Longer lines go on in the new segment.
+ *
+ * @param chain The chain.
+ * @param keep_lines Keeps each line in a single segment when set.
+ * @param room Receives the number of bytes that can be written.
+ *
+ * @return Where to write, or NULL if no memory is left.
+ */
+char* buffer_chain_reserve(buffer_chain_t* chain, int keep_lines, size_t* room) {
+  buffer_segment_t* tail = chain->tail;
+  if (!tail || tail->len == BUFFER_SEGMENT_CAPACITY) {
+    size_t carry = 0;
+    if (tail && keep_lines) {
+      char* line_end = memrchr(tail->data, '\n', tail->len);
+      if (line_end) carry = tail->len - (line_end + 1 - tail->data);
+    }
+
+    buffer_segment_t* segment = add_segment(chain);
+    if (!segment) return NULL;
+    if (carry > 0) {
+      memcpy(segment->data, tail->data + tail->len - carry, carry);
+      tail->len -= carry;
+      tail->data[tail->len] = '\0';
+      segment->len = carry;
+      segment->data[carry] = '\0';
+    }
+    tail = segment;
+  }
+
+  *room = BUFFER_SEGMENT_CAPACITY - tail->len;
+  return tail->data + tail->len;
+}
+
+/**
+ * @brief Accounts for bytes written where buffer_chain_reserve() pointed.
+ *
+ * @param chain The chain.
+ * @param len The number of bytes written, at most the room given by buffer_chain_reserve().
+ */
+void buffer_chain_commit(buffer_chain_t* chain, size_t len) {
+  chain->tail->len += len;
+  chain->tail->data[chain->tail->len] = '\0';
+  chain->len += len;
+}
+
+/**
+ * @brief Copies bytes at the end of a chain, keeping short lines in single segments.
+ *
+ * @param chain The chain.
+ * @param data The bytes to append.
+ * @param len The number of bytes.
+ *
+ * @return 0 on success, -1 if no memory is left.
+ */
+int buffer_chain_append(buffer_chain_t* chain, const char* data, size_t len) {
+  while (len > 0) {
+    size_t room;
+    char* dest = buffer_chain_reserve(chain, 1, &room);
+    if (!dest) return -1;
+    if (room > len) room = len;
+    memcpy(dest, data, room);
+    buffer_chain_commit(chain, room);
+    data += room;
+    len -= room;
+  }
+  return 0;
+}
+
+/**
+ * @brief Moves the bytes of a chain past an offset to the end of another chain.
+ *
+ * The segments following the one holding the offset are moved as they are, so their
+ * lines stay in single segments. Both chains must use the same pool and nothing of the
+ * first one may have been written yet.
+ *
+ * @param chain The chain to cut.
+ * @param offset The number of bytes kept in the chain.
+ * @param rest The chain receiving the other bytes.
+ *
+ * @return 0 on success, -1 if no memory is left.
+ */
+int buffer_chain_split(buffer_chain_t* chain, size_t offset, buffer_chain_t* rest) {
+  buffer_segment_t* previous = NULL;
+  buffer_segment_t* segment = chain->head;
+  size_t before = 0;
+  while (segment && before + segment->len <= offset) {
+    before += segment->len;
+    previous = segment;
+    segment = segment->next;
+  }
+  if (!segment) return 0;
+
+  size_t cut = offset - before;
+  buffer_segment_t* moved;
+  if (cut > 0) {
+    if (buffer_chain_append(rest, segment->data + cut, segment->len - cut) != 0) return -1;
+    segment->len = cut;
+    segment->data[cut] = '\0';
+    moved = segment->next;
+    segment->next = NULL;
+    chain->tail = segment;
+  } else {
+    moved = segment;
+    if (previous) previous->next = NULL;
+    else chain->head = NULL;
+    chain->tail = previous;
+  }
+
+  while (moved) {
+    buffer_segment_t* next = moved->next;
+    moved->next = NULL;
+    if (rest->tail) rest->tail->next = moved;
+    else rest->head = moved;
+    rest->tail = moved;
+    rest->len += moved->len;
+    rest->nb_segments++;
+    chain->nb_segments--;
+    moved = next;
+  }
+  chain->len = offset;
+  return 0;
+}
+
+/**
+ * @brief Writes a chain to a socket in vectored writes, as far as the socket accepts without blocking.
+ *
+ * sendmsg() is the writev() of sockets, it also takes MSG_DONTWAIT and MSG_NOSIGNAL.
+ *
+ * The segments written are given back to the pool, the others stay queued.
+ *
+ * @param chain The chain.
+ * @param fd The socket.
+ *
+ * @return The number of bytes written, possibly 0 if the socket is full, or -1 on error.
+ */
+ssize_t buffer_chain_send(buffer_chain_t* chain, int fd) {
+  size_t total_sent = 0;
+
+  while (chain->len > 0) {
+    struct iovec iov[BUFFER_CHAIN_IOV];
+    int count = 0;
+    for (buffer_segment_t* segment = chain->head; segment && count < BUFFER_CHAIN_IOV; segment = segment->next) {
+      if (segment->len == segment->sent) continue;
+      iov[count].iov_base = segment->data + segment->sent;
+      iov[count].iov_len = segment->len - segment->sent;
+      count++;
+    }
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
+    ssize_t sent = sendmsg(fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (sent < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      if (errno == EINTR) continue;
+      ERROR("writev on fd %d\n", fd);
+      return -1;
+    }
+
+    total_sent += sent;
+    chain->len -= sent;
+    while (sent > 0) {
+      buffer_segment_t* head = chain->head;
+      size_t left = head->len - head->sent;
+      if ((size_t)sent < left) {
+        head->sent += sent;
+        break;
+      }
+      sent -= left;
+      chain->head = head->next;
+      if (!chain->head) chain->tail = NULL;
+      release_segment(chain, head);
+    }
+  }
+
+  if (chain->len == 0) buffer_chain_clear(chain);
+  return total_sent;
+}
+
+/**
+ * @brief Starts gathering bytes for a socket.
+ *
+ * @param writer The writer.
+ * @param fd The socket.
+ * @param rest The chain receiving the bytes the socket does not accept, it must be empty.
+ */
+void init_buffer_chain_writer(buffer_chain_writer_t* writer, int fd, buffer_chain_t* rest) {
+  writer->fd = fd;
+  writer->rest = rest;
+  writer->count = 0;
+  writer->sent = 0;
+  writer->error = 0;
+}
+
+/**
+ * @brief Adds bytes to the next vectored write, they are not copied.
+ *
+ * The bytes must stay valid until buffer_chain_writer_flush(). When the vector is full, it
+ * is written first.
+ *
+ * @param writer The writer.
+ * @param data The bytes.
+ * @param len The number of bytes.
+ */
+void buffer_chain_writer_add(buffer_chain_writer_t* writer, const char* data, size_t len) {
+  if (len == 0) return;
+  if (writer->count == BUFFER_CHAIN_IOV) buffer_chain_writer_flush(writer);
+  writer->iov[writer->count].iov_base = (void*)data;
+  writer->iov[writer->count].iov_len = len;
+  writer->count++;
+}
+
+/**
+ * @brief Writes the gathered bytes to the socket in one vectored write.
+ *
+ * The bytes the socket does not accept without blocking are copied to the rest chain, and
+ * so are all the following ones, so that they are written in order with it.
+ *
+ * @param writer The writer.
+ *
+ * @return The number of bytes written since the writer was started, or -1 on error.
+ */
+ssize_t buffer_chain_writer_flush(buffer_chain_writer_t* writer) {
+  size_t sent = 0;
+  if (!writer->error && writer->count > 0 && writer->rest->len == 0) {
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = writer->iov;
+    msg.msg_iovlen = writer->count;
+
+    ssize_t bytes;
+    do {
+      bytes = sendmsg(writer->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+    } while (bytes < 0 && errno == EINTR);
+    if (bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      ERROR("writev on fd %d\n", writer->fd);
+      writer->error = 1;
+    }
+    if (bytes > 0) sent = bytes;
+  }
+  writer->sent += sent;
+
+  for (int i = 0; i < writer->count && !writer->error; i++) {
+    if (sent >= writer->iov[i].iov_len) {
+      sent -= writer->iov[i].iov_len;
+      continue;
+    }
+    if (buffer_chain_append(writer->rest, (char*)writer->iov[i].iov_base + sent, writer->iov[i].iov_len - sent) != 0) {
+      writer->error = 1;
+    }
+    sent = 0;
+  }
+  writer->count = 0;
+  return writer->error ? -1 : (ssize_t)writer->sent;
+}
+
+/**
+ * @brief Gives every segment of a chain back, the bytes they hold are dropped.
+ *
+ * @param chain The chain.
+ */
+void buffer_chain_clear(buffer_chain_t* chain) {
+  while (chain->head) {
+    buffer_segment_t* next = chain->head->next;
+    release_segment(chain, chain->head);
+    chain->head = next;
+  }
+  chain->tail = NULL;
+  chain->len = 0;
+}
@@ -21,28 +21,101 @@
  */
 
 #include "../includes/config.h"
+#include "../includes/epoch.h"
 #include "../includes/logger.h"
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-config_t config = {
-  .port = 8080,
-  .address = "127.0.0.1", 
-  .max_client = 10,
-  .logger_filename = "logs/proxy.log",
-  .rules_filename = "conf/proxy.rules"
-};
+/**
+ * @brief Values of the parameters missing from the configuration file.
+ */
+#define DEFAULT_CONFIG { \
+  .port = 8080, \
+  .address = "127.0.0.1", \
+  .max_client = 10, \
+  .logger_filename = "logs/proxy.log", \
+  .rules_filename = "conf/proxy.rules", \
+  .workers = 1, \
+  .cpu_affinity = 0, \
+  .header_timeout = 10, \
+  .connect_timeout = 5, \
+  .dns_server = "", \
+  .dns_port = 53, \
+  .dns_cache_size = 1024, \
+  .splice = 1, \
+  .max_header_size = 65536, \
+  .upstream_max_idle = 8, \
+  .upstream_idle_timeout = 30, \
+  .filter_responses = 0, \
+  .verdict_cache_size = 4096 \
+}
+
+config_t config = DEFAULT_CONFIG;
 
 /**
- * @brief Initializes the configuration from a file.
- * 
- * Reads the configuration file specified by `filename` and loads the proxy
- * server's configuration settings.
+ * @brief Snapshot of the configuration the workers read, replaced as a whole by reload_config().
+ */
+static _Atomic(config_t*) current = &config;
+
+/**
+ * @brief Resolves WORKERS auto, and warns when each worker only gets a few clients.
+ *
+ * MAX_CLIENT is shared between the workers, and the kernel spreads the connections between
+ * their listeners whether they are full or not: a worker with a tiny share turns clients
+ * away while the others idle. auto starts one worker per online CPU, but no more than
+ * leaves WORKER_MIN_CLIENTS clients to each one.
+ */
+static void resolve_workers(config_t* conf) {
+  if (conf->workers == 0) {
+    long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    long nb_shares = conf->max_client / WORKER_MIN_CLIENTS;
+    conf->workers = (int)(nb_cpus < nb_shares ? nb_cpus : nb_shares);
+    if (conf->workers < 1) conf->workers = 1;
+  } else if (conf->workers > 1 && conf->max_client / conf->workers < WORKER_MIN_CLIENTS) {
+    WARN("MAX_CLIENT %d leaves %d clients to each of the %d workers, raise it or lower WORKERS\n",
+         conf->max_client, conf->max_client / conf->workers, conf->workers);
+    Log(LOG_LEVEL_WARN, "[CONFIG] MAX_CLIENT %d leaves %d clients to each of the %d workers, raise it or lower WORKERS",
+        conf->max_client, conf->max_client / conf->workers, conf->workers);
+  }
+}
+
+/**
+ * @brief Reads an integer parameter, which must be a number within its bounds.
+ *
+ * A value out of its bounds, or not a number, is refused with a warning: the parameter
+ * keeps its previous value, the default one unless the file set it before.
+ *
+ * @param key The name of the parameter.
+ * @param value The value read from the file.
+ * @param min The smallest value accepted.
+ * @param max The largest value accepted.
+ * @param number Receives the value when it is accepted.
+ * @param line The line of the parameter in the file.
+ */
+static void parse_bounded(const char* key, const char* value, long min, long max, int* number, int line) {
+  char* end;
+  errno = 0;
+  long parsed = strtol(value, &end, 10);
+  if (errno != 0 || end == value || *end != '\0' || parsed < min || parsed > max) {
+    WARN("%s '%s' at line %d is not between %ld and %ld, keeping %d\n", key, value, line, min, max, *number);
+    Log(LOG_LEVEL_WARN, "[CONFIG] %s '%s' at line %d is not between %ld and %ld, keeping %d", key, value, line, min, max, *number);
+    return;
+  }
+  *number = (int)parsed;
+}
+
+/**
+ * @brief Reads a configuration file into a configuration.
  * 
+ * @param conf The configuration, holding the values of the parameters missing from the file.
  * @param filename The path to the configuration file.
  * 
  * @return 0 on success, -1 if the file cannot be opened.
  */
-int init_config(const char* filename){
+static int load_config(config_t* conf, const char* filename) {
   INFO("Loading config from %s\n", filename);
 
   FILE* file = fopen(filename, "r");
@@ -65,15 +138,57 @@ int init_config(const char* filename){
 
     if (sscanf(line, "%s %s", key, value) == 2){
       if (strcmp(key, "PORT") == 0) {
-        config.port = atoi(value);
+        conf->port = atoi(value);
       } else if (strcmp(key, "ADDRESS") == 0) {
-        strncpy(config.address, value, sizeof(config.address));
+        strncpy(conf->address, value, sizeof(conf->address));
       } else if (strcmp(key, "MAX_CLIENT") == 0) {
-        config.max_client = atoi(value);
+        conf->max_client = atoi(value);
       } else if (strcmp(key, "LOGGER_FILENAME") == 0) {
-        strncpy(config.logger_filename, value, sizeof(config.logger_filename));
+        strncpy(conf->logger_filename, value, sizeof(conf->logger_filename));
       } else if (strcmp(key, "RULES_FILENAME") == 0) {
-        strncpy(config.rules_filename, value, sizeof(config.rules_filename));
+        strncpy(conf->rules_filename, value, sizeof(conf->rules_filename));
+      } else if (strcmp(key, "WORKERS") == 0) {
+        // "auto" is resolved once MAX_CLIENT is known
+        if (strcmp(value, "auto") == 0) {
+          conf->workers = 0;
+        } else {
+          conf->workers = atoi(value);
+          if (conf->workers < 1) conf->workers = 1;
+        }
+      } else if (strcmp(key, "CPU_AFFINITY") == 0) {
+        conf->cpu_affinity = strcmp(value, "on") == 0 || strcmp(value, "1") == 0;
+      } else if (strcmp(key, "HEADER_TIMEOUT") == 0) {
+        parse_bounded(key, value, 1, MAX_TIMEOUT, &conf->header_timeout, i);
+      } else if (strcmp(key, "CONNECT_TIMEOUT") == 0) {
+        parse_bounded(key, value, 1, MAX_TIMEOUT, &conf->connect_timeout, i);
+      } else if (strcmp(key, "DNS_SERVER") == 0) {
+        // IP or IP:PORT
+        char* colon = strchr(value, ':');
+        if (colon) {
+          *colon = '\0';
+          conf->dns_port = atoi(colon + 1);
+        }
+        size_t len = strlen(value);
+        if (len < sizeof(conf->dns_server)) {
+          memcpy(conf->dns_server, value, len + 1);
+        } else {
+          WARN("DNS_SERVER '%s' is too long at line %d\n", value, i);
+          Log(LOG_LEVEL_WARN, "DNS_SERVER '%s' is too long at line %d\n", value, i);
+        }
+      } else if (strcmp(key, "SPLICE") == 0) {
+        conf->splice = strcmp(value, "on") == 0 || strcmp(value, "1") == 0;
+      } else if (strcmp(key, "DNS_CACHE_SIZE") == 0) {
+        conf->dns_cache_size = atoi(value);
+      } else if (strcmp(key, "MAX_HEADER_SIZE") == 0) {
+        parse_bounded(key, value, MIN_HEADER_SIZE, MAX_HEADER_SIZE_LIMIT, &conf->max_header_size, i);
+      } else if (strcmp(key, "UPSTREAM_MAX_IDLE") == 0) {
+        conf->upstream_max_idle = atoi(value);
+      } else if (strcmp(key, "UPSTREAM_IDLE_TIMEOUT") == 0) {
+        parse_bounded(key, value, 1, MAX_TIMEOUT, &conf->upstream_idle_timeout, i);
+      } else if (strcmp(key, "FILTER_RESPONSES") == 0) {
+        conf->filter_responses = strcmp(value, "on") == 0 || strcmp(value, "1") == 0;
+      } else if (strcmp(key, "VERDICT_CACHE_SIZE") == 0) {
+        conf->verdict_cache_size = atoi(value);
       } else {
         WARN("Unknow parameter '%s' at line %d\n", key, i);
         Log(LOG_LEVEL_WARN, "Unknow parameter '%s' at line %d\n", key, i);
@@ -87,5 +202,98 @@ int init_config(const char* filename){
   }
   
   fclose(file);
+  resolve_workers(conf);
+  return 0;
+}
+
+/**
+ * @brief Initializes the configuration from a file.
+ * 
+ * Reads the configuration file specified by `filename` and loads the proxy
+ * server's configuration settings.
+ * 
+ * @param filename The path to the configuration file.
+ * 
+ * @return 0 on success, -1 if the file cannot be opened.
+ */
+int init_config(const char* filename) {
+  return load_config(&config, filename);
+}
+
+/**
+ * @brief Returns the snapshot of the configuration the workers read.
+ *
+ * A worker loads it within the read-side section of its event loop (see epoch.h).
+ *
+ * @return The current configuration.
+ */
+const config_t* current_config() {
+  return atomic_load(&current);
+}
+
+/**
+ * @brief Keeps the parameters set up once at startup, warning when the file changed them.
+ *
+ * Sockets, workers, the logger and the DNS client are created with the first configuration,
+ * a new value only applies after a restart.
+ */
+static void keep_startup_parameters(config_t* conf, const config_t* old) {
+  const char* changed = NULL;
+  if (conf->port != old->port) changed = "PORT";
+  if (strcmp(conf->address, old->address) != 0) changed = "ADDRESS";
+  if (conf->max_client != old->max_client) changed = "MAX_CLIENT";
+  if (strcmp(conf->logger_filename, old->logger_filename) != 0) changed = "LOGGER_FILENAME";
+  if (conf->workers != old->workers) changed = "WORKERS";
+  if (conf->cpu_affinity != old->cpu_affinity) changed = "CPU_AFFINITY";
+  if (strcmp(conf->dns_server, old->dns_server) != 0 || conf->dns_port != old->dns_port) changed = "DNS_SERVER";
+  if (conf->dns_cache_size != old->dns_cache_size) changed = "DNS_CACHE_SIZE";
+  if (conf->upstream_max_idle != old->upstream_max_idle) changed = "UPSTREAM_MAX_IDLE";
+  if (conf->upstream_idle_timeout != old->upstream_idle_timeout) changed = "UPSTREAM_IDLE_TIMEOUT";
+  if (conf->verdict_cache_size != old->verdict_cache_size) changed = "VERDICT_CACHE_SIZE";
+  if (changed) {
+    WARN("%s and the other startup parameters only change after a restart\n", changed);
+    Log(LOG_LEVEL_WARN, "[CONFIG] %s and the other startup parameters only change after a restart", changed);
+  }
+
+  conf->port = old->port;
+  memcpy(conf->address, old->address, sizeof(conf->address));
+  conf->max_client = old->max_client;
+  memcpy(conf->logger_filename, old->logger_filename, sizeof(conf->logger_filename));
+  conf->workers = old->workers;
+  conf->cpu_affinity = old->cpu_affinity;
+  memcpy(conf->dns_server, old->dns_server, sizeof(conf->dns_server));
+  conf->dns_port = old->dns_port;
+  conf->dns_cache_size = old->dns_cache_size;
+  conf->upstream_max_idle = old->upstream_max_idle;
+  conf->upstream_idle_timeout = old->upstream_idle_timeout;
+  conf->verdict_cache_size = old->verdict_cache_size;
+}
+
+/**
+ * @brief Reads the configuration file again and publishes it while the workers keep running.
+ *
+ * The timeouts, the header size limit, SPLICE, FILTER_RESPONSES and RULES_FILENAME apply
+ * to the next connections; the other parameters keep their startup value. The previous
+ * snapshot is freed once no worker can be reading it anymore.
+ *
+ * @param filename The path to the configuration file.
+ *
+ * @return 0 on success, -1 if the file cannot be read, the current configuration is then kept.
+ */
+int reload_config(const char* filename) {
+  config_t* conf = malloc(sizeof(config_t));
+  if (!conf) return -1;
+  *conf = (config_t)DEFAULT_CONFIG;
+  if (load_config(conf, filename) != 0) {
+    free(conf);
+    return -1;
+  }
+
+  config_t* old = atomic_load(&current);
+  keep_startup_parameters(conf, old);
+  atomic_store(&current, conf);
+  epoch_synchronize();
+  if (old != &config) free(old);
+  Log(LOG_LEVEL_INFO, "[CONFIG] Configuration reloaded from %s", filename);
   return 0;
 }
@@ -0,0 +1,566 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file dns_client.c
+ * @brief Implementation of the non-blocking DNS client.
+ *
+ * Only what the proxy needs is implemented: recursive queries for the A record of a host,
+ * sent over UDP to a single resolver, with retransmission on timeout. Queries get random
+ * identifiers, and an answer is only accepted if its identifier and its question match a
+ * pending query. The CNAME chain of the host is followed through the answer section, only
+ * the records owned by the host or by a name of its chain are read, and the smallest TTL
+ * of the chain is reported.
+ */
+
+#include "../includes/dns_client.h"
+#include "../includes/utils.h"
+#include "../includes/logger.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/**
+ * @brief Size of the fixed header of a DNS message.
+ */
+#define DNS_HEADER_SIZE 12
+
+/**
+ * @brief Type and class of an IPv4 address record.
+ */
+#define DNS_TYPE_A 1
+#define DNS_CLASS_IN 1
+
+/**
+ * @brief Type of an alias record.
+ */
+#define DNS_TYPE_CNAME 5
+
+/**
+ * @brief Size of a buffer holding a decoded domain name.
+ */
+#define DNS_MAX_NAME 256
+
+/**
+ * @brief Most aliases followed from the host to its address.
+ */
+#define DNS_MAX_CNAMES 8
+
+/**
+ * @brief Reads a 16 bits big endian integer.
+ */
+static uint16_t read_u16(const unsigned char* p) {
+  return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+/**
+ * @brief Reads a 32 bits big endian integer.
+ */
+static uint32_t read_u32(const unsigned char* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+/**
+ * @brief Returns the current time of the monotonic clock in milliseconds.
+ */
+static long long monotonic_now_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Finds the first IPv4 name server of /etc/resolv.conf.
+ *
+ * @param server Buffer receiving the address of the name server.
+ * @param size Size of the buffer.
+ *
+ * @return 0 if a name server was found, -1 otherwise.
+ */
+int get_default_dns_server(char* server, size_t size) {
+  FILE* file = fopen("/etc/resolv.conf", "r");
+  if (!file) return -1;
+
+  char line[256];
+  char value[INET_ADDRSTRLEN + 1];
+  struct in_addr addr;
+  int found = -1;
+  while (found != 0 && fgets(line, sizeof(line), file)) {
+    if (sscanf(line, "nameserver %16s", value) == 1 && inet_pton(AF_INET, value, &addr) == 1) {
+      snprintf(server, size, "%s", value);
+      found = 0;
+    }
+  }
+  fclose(file);
+  return found;
+}
+
+/**
+ * @brief Opens the UDP socket of a DNS client.
+ *
+ * @param client The client to initialize.
+ * @param server_ip The IPv4 address of the resolver.
+ * @param port The port of the resolver, usually DNS_PORT.
+ * @param callback Function called each time a resolution ends.
+ * @param data User data given to the callback.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int init_dns_client(dns_client_t* client, const char* server_ip, int port, dns_callback_t callback, void* data) {
+  memset(client, 0, sizeof(dns_client_t));
+  client->fd = -1;
+  client->callback = callback;
+  client->data = data;
+
+  client->server.sin_family = AF_INET;
+  client->server.sin_port = htons(port);
+  if (inet_pton(AF_INET, server_ip, &client->server.sin_addr) != 1) {
+    ERROR("Invalid DNS server %s\n", server_ip);
+    Log(LOG_LEVEL_ERROR, "[DNS] Invalid DNS server %s", server_ip);
+    return -1;
+  }
+
+  client->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (client->fd < 0) {
+    ERROR("DNS socket creation failed\n");
+    Log(LOG_LEVEL_ERROR, "[DNS] DNS socket creation failed");
+    return -1;
+  }
+
+  // A connected UDP socket only receives datagrams coming from the resolver
+  if (connect(client->fd, (struct sockaddr*)&client->server, sizeof(client->server)) != 0) {
+    ERROR("Failed to connect the DNS socket to %s\n", server_ip);
+    Log(LOG_LEVEL_ERROR, "[DNS] Failed to connect the DNS socket to %s", server_ip);
+    close(client->fd);
+    client->fd = -1;
+    return -1;
+  }
+
+  INFO("DNS client ready on fd %d, resolver %s:%d\n", client->fd, server_ip, port);
+  return 0;
+}
+
+/**
+ * @brief Encodes the query for the A record of a host.
+ *
+ * @param id Identifier of the query.
+ * @param host The hostname to resolve.
+ * @param buffer Buffer receiving the message.
+ * @param size Size of the buffer.
+ *
+ * @return The length of the message, or -1 if the hostname is not valid.
+ */
+int dns_build_query(uint16_t id, const char* host, unsigned char* buffer, size_t size) {
+  size_t host_len = strlen(host);
+  if (host_len == 0 || host_len > 253 || size < DNS_HEADER_SIZE + host_len + 2 + 4) return -1;
+
+  memset(buffer, 0, DNS_HEADER_SIZE);
+  buffer[0] = id >> 8;
+  buffer[1] = id & 0xff;
+  buffer[2] = 0x01;   // RD: recursion desired
+  buffer[5] = 1;      // QDCOUNT
+
+  size_t pos = DNS_HEADER_SIZE;
+  const char* label = host;
+  while (*label) {
+    const char* dot = strchr(label, '.');
+    size_t label_len = dot ? (size_t)(dot - label) : strlen(label);
+    if (label_len == 0 || label_len > 63) return -1;
+
+    buffer[pos++] = (unsigned char)label_len;
+    memcpy(buffer + pos, label, label_len);
+    pos += label_len;
+
+    label += label_len;
+    if (*label == '.') label++;
+  }
+  buffer[pos++] = 0;
+
+  buffer[pos++] = 0;
+  buffer[pos++] = DNS_TYPE_A;
+  buffer[pos++] = 0;
+  buffer[pos++] = DNS_CLASS_IN;
+  return (int)pos;
+}
+
+/**
+ * @brief Decodes a domain name, following its compression pointers.
+ *
+ * @param buffer The DNS message.
+ * @param len Length of the message.
+ * @param pos Position of the name.
+ * @param name Buffer receiving the name, its labels separated by dots, without final dot.
+ * @param size Size of the buffer.
+ *
+ * @return The position following the name where it is written, or -1 if it is malformed.
+ */
+static long read_name(const unsigned char* buffer, size_t len, size_t pos, char* name, size_t size) {
+  long next = -1;
+  size_t out = 0;
+  while (pos < len) {
+    unsigned char label_len = buffer[pos];
+    if (label_len == 0) {
+      name[out > 0 ? out - 1 : 0] = '\0';
+      return next >= 0 ? next : (long)pos + 1;
+    }
+    if ((label_len & 0xc0) == 0xc0) {
+      // Compression pointer: the rest of the name comes earlier, so pointers cannot loop
+      if (pos + 2 > len) return -1;
+      size_t target = ((size_t)(label_len & 0x3f) << 8) | buffer[pos + 1];
+      if (target >= pos) return -1;
+      if (next < 0) next = (long)pos + 2;
+      pos = target;
+      continue;
+    }
+    if (label_len & 0xc0) return -1;
+    if (pos + 1 + label_len > len || out + label_len + 1 >= size) return -1;
+    memcpy(name + out, buffer + pos + 1, label_len);
+    out += label_len;
+    name[out++] = '.';
+    pos += 1 + label_len;
+  }
+  return -1;
+}
+
+/**
+ * @brief Reads the identifier of an answer, to find the query it belongs to.
+ *
+ * @param buffer The DNS message.
+ * @param len Length of the message.
+ * @param id Receives the identifier of the message.
+ *
+ * @return 0 on success, or -1 if the message is not a response.
+ */
+int dns_response_id(const unsigned char* buffer, size_t len, uint16_t* id) {
+  if (len < DNS_HEADER_SIZE || !(buffer[2] & 0x80)) return -1;   // QR: not a response
+  *id = read_u16(buffer);
+  return 0;
+}
+
+/**
+ * @brief Decodes the answer of the resolver to the query for the A record of a host.
+ *
+ * The question must be the one of the query, otherwise the answer is forged or stale. The
+ * answer section is then read from the host: an A record owned by the current name ends the
+ * resolution, a CNAME owned by it leads to the next name. Records owned by other names are
+ * ignored, the resolver has no authority to tell the addresses of unrelated hosts.
+ *
+ * @param buffer The DNS message.
+ * @param len Length of the message.
+ * @param host The hostname of the query.
+ * @param addr Receives the IPv4 address of the host.
+ * @param ttl Receives the smallest TTL of the records leading to the address.
+ *
+ * @return 0 if an address was found, 1 if the resolver answered without address
+ *         (unknown host, error code), or -1 if the message is malformed or does not
+ *         answer the query.
+ */
+int dns_parse_response(const unsigned char* buffer, size_t len, const char* host, struct in_addr* addr, uint32_t* ttl) {
+  if (len < DNS_HEADER_SIZE || !(buffer[2] & 0x80)) return -1;
+
+  char current[DNS_MAX_NAME];
+  snprintf(current, sizeof(current), "%s", host);
+  size_t host_len = strlen(current);
+  if (host_len > 0 && current[host_len - 1] == '.') current[host_len - 1] = '\0';
+
+  char name[DNS_MAX_NAME];
+  if (read_u16(buffer + 4) != 1) return -1;
+  long pos = read_name(buffer, len, DNS_HEADER_SIZE, name, sizeof(name));
+  if (pos < 0 || (size_t)pos + 4 > len || strcasecmp(name, current) != 0 ||
+      read_u16(buffer + pos) != DNS_TYPE_A || read_u16(buffer + pos + 2) != DNS_CLASS_IN) {
+    return -1;
+  }
+  pos += 4;
+  if ((buffer[3] & 0x0f) != 0) return 1;        // RCODE: NXDOMAIN, SERVFAIL...
+
+  uint16_t ancount = read_u16(buffer + 6);
+  uint32_t min_ttl = UINT32_MAX;
+  int nb_cnames = 0;
+  int followed = 1;
+  // Aliases usually come in the order of the chain, a new pass follows those which do not
+  while (followed) {
+    followed = 0;
+    size_t record = pos;
+    for (uint16_t i = 0; i < ancount; i++) {
+      long next = read_name(buffer, len, record, name, sizeof(name));
+      if (next < 0 || (size_t)next + 10 > len) return -1;
+
+      uint16_t type = read_u16(buffer + next);
+      uint16_t class = read_u16(buffer + next + 2);
+      uint32_t record_ttl = read_u32(buffer + next + 4);
+      uint16_t rdlength = read_u16(buffer + next + 8);
+      next += 10;
+      if ((size_t)next + rdlength > len) return -1;
+      record = next + rdlength;
+
+      if (class != DNS_CLASS_IN || strcasecmp(name, current) != 0) continue;
+      if (type == DNS_TYPE_A && rdlength == 4) {
+        memcpy(addr, buffer + next, 4);
+        *ttl = record_ttl < min_ttl ? record_ttl : min_ttl;
+        return 0;
+      }
+      if (type == DNS_TYPE_CNAME) {
+        if (++nb_cnames > DNS_MAX_CNAMES) return 1;
+        if (read_name(buffer, len, next, current, sizeof(current)) < 0) return -1;
+        if (record_ttl < min_ttl) min_ttl = record_ttl;
+        followed = 1;
+      }
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Draws the identifier of a query from the random source of the kernel.
+ *
+ * An identifier guessed by an attacker would let a forged answer be taken for the real one.
+ *
+ * @return 0 on success, -1 if no random bytes could be read.
+ */
+static int random_id(uint16_t* id) {
+  ssize_t ret;
+  do {
+    ret = getrandom(id, sizeof(*id), 0);
+  } while (ret < 0 && errno == EINTR);
+  return ret == sizeof(*id) ? 0 : -1;
+}
+
+/**
+ * @brief Sends a query to the resolver.
+ *
+ * @param client The DNS client.
+ * @param query The query to send.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int send_query(dns_client_t* client, dns_query_t* query) {
+  unsigned char message[DNS_MAX_MESSAGE];
+  int len = dns_build_query(query->id, query->host, message, sizeof(message));
+  if (len < 0) return -1;
+
+  if (send(client->fd, message, len, 0) != len) {
+    ERROR("Failed to send the DNS query for %s\n", query->host);
+    Log(LOG_LEVEL_ERROR, "[DNS] Failed to send the DNS query for %s", query->host);
+    return -1;
+  }
+  query->attempts++;
+  return 0;
+}
+
+/**
+ * @brief Removes a query from the table of pending queries.
+ *
+ * @param client The DNS client.
+ * @param query The query to remove, it is not freed.
+ */
+static void unlink_query(dns_client_t* client, dns_query_t* query) {
+  dns_query_t** current = &client->pending[query->id % DNS_PENDING_BUCKETS];
+  while (*current) {
+    if (*current == query) {
+      *current = query->next;
+      client->nb_pending--;
+      return;
+    }
+    current = &(*current)->next;
+  }
+}
+
+/**
+ * @brief Finds the pending query with the given identifier.
+ */
+static dns_query_t* find_query(dns_client_t* client, uint16_t id) {
+  dns_query_t* query = client->pending[id % DNS_PENDING_BUCKETS];
+  while (query && query->id != id) query = query->next;
+  return query;
+}
+
+/**
+ * @brief Starts the resolution of a host.
+ *
+ * The callback of the client is called with ctx once the resolution ends, never from
+ * within this function.
+ *
+ * @param client The DNS client.
+ * @param host The hostname to resolve.
+ * @param ctx Context given back to the callback.
+ *
+ * @return 0 if the query has been sent, -1 on error.
+ */
+int dns_client_query(dns_client_t* client, const char* host, void* ctx) {
+  if (client->fd < 0 || strlen(host) >= sizeof(((dns_query_t*)0)->host)) return -1;
+
+  dns_query_t* query = malloc(sizeof(dns_query_t));
+  if (!query) {
+    ERROR("malloc\n");
+    return -1;
+  }
+
+  // Skip the identifiers still in use
+  do {
+    if (random_id(&query->id) != 0) {
+      ERROR("Failed to draw the identifier of the DNS query for %s\n", host);
+      Log(LOG_LEVEL_ERROR, "[DNS] Failed to draw the identifier of the DNS query for %s", host);
+      free(query);
+      return -1;
+    }
+  } while (find_query(client, query->id));
+
+  strcpy(query->host, host);
+  query->attempts = 0;
+  query->retry_at = monotonic_now_ms() + DNS_RETRY_MS;
+  query->ctx = ctx;
+
+  if (send_query(client, query) != 0) {
+    free(query);
+    return -1;
+  }
+
+  dns_query_t** bucket = &client->pending[query->id % DNS_PENDING_BUCKETS];
+  query->next = *bucket;
+  *bucket = query;
+  client->nb_pending++;
+
+  INFO("DNS query %u sent for %s\n", query->id, host);
+  return 0;
+}
+
+/**
+ * @brief Forgets the pending queries of a context, their callback will not be called.
+ *
+ * @param client The DNS client.
+ * @param ctx The context given to dns_client_query().
+ */
+void dns_client_cancel(dns_client_t* client, void* ctx) {
+  for (int i = 0; i < DNS_PENDING_BUCKETS && client->nb_pending > 0; i++) {
+    dns_query_t** current = &client->pending[i];
+    while (*current) {
+      dns_query_t* query = *current;
+      if (query->ctx == ctx) {
+        *current = query->next;
+        client->nb_pending--;
+        free(query);
+      } else {
+        current = &query->next;
+      }
+    }
+  }
+}
+
+/**
+ * @brief Reads every answer available on the socket and ends the matching resolutions.
+ *
+ * @param client The DNS client.
+ */
+void dns_client_read(dns_client_t* client) {
+  unsigned char message[DNS_MAX_MESSAGE];
+
+  while (1) {
+    ssize_t len = recv(client->fd, message, sizeof(message), 0);
+    if (len < 0) {
+      if (errno == EINTR) continue;
+      // EAGAIN, or an ICMP error reported for a previous datagram: the retry timer handles it
+      return;
+    }
+
+    uint16_t id = 0;
+    if (dns_response_id(message, len, &id) != 0) {
+      WARN("Malformed DNS answer ignored\n");
+      continue;
+    }
+
+    dns_query_t* query = find_query(client, id);
+    if (!query) {
+      INFO("DNS answer %u without pending query\n", id);
+      continue;
+    }
+
+    // An answer which does not match its query leaves it pending, the real one may follow
+    struct in_addr addr;
+    uint32_t ttl = 0;
+    int ret = dns_parse_response(message, len, query->host, &addr, &ttl);
+    if (ret < 0) {
+      WARN("DNS answer %u not matching the query for %s ignored\n", id, query->host);
+      Log(LOG_LEVEL_WARN, "[DNS] Answer %u not matching the query for %s ignored", id, query->host);
+      continue;
+    }
+
+    unlink_query(client, query);
+    if (ret == 0) {
+      INFO("DNS resolution successful for %s (ttl %u)\n", query->host, ttl);
+      client->callback(client->data, query->ctx, query->host, 0, &addr, ttl);
+    } else {
+      WARN("DNS resolution failed for %s\n", query->host);
+      Log(LOG_LEVEL_WARN, "[DNS] Resolution failed for %s", query->host);
+      client->callback(client->data, query->ctx, query->host, -1, NULL, 0);
+    }
+    free(query);
+  }
+}
+
+/**
+ * @brief Sends again the queries without answer and fails those out of attempts.
+ *
+ * @param client The DNS client.
+ * @param now The current monotonic time in milliseconds.
+ */
+void dns_client_expire(dns_client_t* client, long long now) {
+  for (int i = 0; i < DNS_PENDING_BUCKETS && client->nb_pending > 0; i++) {
+    dns_query_t** current = &client->pending[i];
+    while (*current) {
+      dns_query_t* query = *current;
+      if (query->retry_at > now) {
+        current = &query->next;
+        continue;
+      }
+
+      if (query->attempts < DNS_MAX_ATTEMPTS && send_query(client, query) == 0) {
+        query->retry_at = now + DNS_RETRY_MS;
+        current = &query->next;
+        continue;
+      }
+
+      *current = query->next;
+      client->nb_pending--;
+      WARN("DNS resolution of %s timed out\n", query->host);
+      Log(LOG_LEVEL_WARN, "[DNS] Resolution of %s timed out", query->host);
+      client->callback(client->data, query->ctx, query->host, -1, NULL, 0);
+      free(query);
+    }
+  }
+}
+
+/**
+ * @brief Closes the socket of a DNS client and forgets its pending queries.
+ *
+ * @param client The DNS client.
+ */
+void free_dns_client(dns_client_t* client) {
+  for (int i = 0; i < DNS_PENDING_BUCKETS; i++) {
+    while (client->pending[i]) {
+      dns_query_t* next = client->pending[i]->next;
+      free(client->pending[i]);
+      client->pending[i] = next;
+    }
+  }
+  client->nb_pending = 0;
+  if (client->fd >= 0) close(client->fd);
+  client->fd = -1;
+}
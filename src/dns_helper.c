@@ -21,153 +21,292 @@
 #include "../includes/dns_helper.h"
 #include "../includes/utils.h"
 #include "../includes/logger.h"
+#include <ctype.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 #include <unistd.h>
 
 static dns_cache_t *dns_cache = NULL;
 
+/**
+ * @brief Lock protecting the DNS cache, shared by every worker thread.
+ */
+static pthread_mutex_t dns_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * @brief Returns the current time of the monotonic clock in milliseconds.
+ */
+static long long now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Hashes a hostname with FNV-1a, ignoring the case.
+ * @param host The hostname.
+ * @return The hash of the hostname.
+ */
+static uint32_t hash_host(const char* host) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char* c = (const unsigned char*)host; *c; c++) {
+        hash ^= (uint32_t)tolower(*c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ * @brief Removes an entry from the least recently used list.
+ */
+static void lru_unlink(dns_cache_entry_t* entry) {
+    if (entry->lru_prev) entry->lru_prev->lru_next = entry->lru_next;
+    else dns_cache->lru_head = entry->lru_next;
+    if (entry->lru_next) entry->lru_next->lru_prev = entry->lru_prev;
+    else dns_cache->lru_tail = entry->lru_prev;
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+/**
+ * @brief Puts an entry at the head of the least recently used list.
+ */
+static void lru_push_front(dns_cache_entry_t* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = dns_cache->lru_head;
+    if (dns_cache->lru_head) dns_cache->lru_head->lru_prev = entry;
+    else dns_cache->lru_tail = entry;
+    dns_cache->lru_head = entry;
+}
+
+/**
+ * @brief Removes an entry from the cache and frees it, the caller must hold dns_cache_lock.
+ * @param entry The entry to remove.
+ */
+static void remove_entry(dns_cache_entry_t* entry) {
+    dns_cache_entry_t **current = &dns_cache->buckets[entry->hash & dns_cache->bucket_mask];
+    while (*current && *current != entry) current = &(*current)->next;
+    if (*current) *current = entry->next;
+
+    lru_unlink(entry);
+    if (entry->addr_info) freeaddrinfo(entry->addr_info);
+    free(entry);
+    dns_cache->nb_entries--;
+}
+
+/**
+ * @brief Looks a host up in the cache, the caller must hold dns_cache_lock.
+ *
+ * A stale entry is removed and reported as missing, a fresh one becomes the most recently used.
+ *
+ * @param host The hostname to search for.
+ * @return Pointer to the cache entry if found, NULL otherwise.
+ */
+static dns_cache_entry_t* lookup_in_cache(const char* host) {
+    uint32_t hash = hash_host(host);
+    dns_cache_entry_t *current = dns_cache->buckets[hash & dns_cache->bucket_mask];
+    while (current) {
+        if (current->hash == hash && strcasecmp(current->host, host) == 0) {
+            if (current->expires_at <= now_ms()) {
+                INFO("DNS cache entry for host %s has expired\n", host);
+                remove_entry(current);
+                return NULL;
+            }
+            INFO("Found DNS cache entry for host: %s -> %s\n", current->host, current->ipstr);
+            lru_unlink(current);
+            lru_push_front(current);
+            return current;
+        }
+        current = current->next;
+    }
+
+    INFO("No DNS cache entry found for host: %s\n", host);
+    return NULL;
+}
+
 /**
  * @brief Creates a deep copy of an addrinfo structure.
+ *
+ * Like the nodes made by getaddrinfo(), each node is allocated in a single block followed by
+ * its address, so the copy is released with freeaddrinfo().
+ *
  * @param src The source addrinfo structure.
  * @return Pointer to the copied addrinfo structure, or NULL on failure.
  */
 struct addrinfo *copy_addrinfo(const struct addrinfo *src) {
-    if (src == NULL) {
-        return NULL;
-    }
-
     struct addrinfo *head = NULL;
     struct addrinfo **current = &head;
-    if (src == NULL) Log(LOG_LEVEL_ERROR, "ERROR SRC == NULL DNS HELPER !");
+
     while (src != NULL) {
-        *current = malloc(sizeof(struct addrinfo));
-        if (*current == NULL) {
-            ERROR("Current NULL\n");
+        size_t addr_len = src->ai_addr ? src->ai_addrlen : 0;
+        struct addrinfo *node = malloc(sizeof(struct addrinfo) + addr_len);
+        if (node == NULL) {
+            ERROR("Failed to copy addrinfo\n");
             freeaddrinfo(head);
-            freeaddrinfo(*current);
             return NULL;
         }
 
-        memcpy(*current, src, sizeof(struct addrinfo));
+        memcpy(node, src, sizeof(struct addrinfo));
+        node->ai_next = NULL;
+        node->ai_canonname = NULL;
+        node->ai_addr = NULL;
+        *current = node;
 
-        // Copy ai_addr
         if (src->ai_addr != NULL) {
-            (*current)->ai_addr = malloc(src->ai_addrlen);
-            if ((*current)->ai_addr == NULL) {
-                ERROR("(*Current)->ai_addr NULL\n");
-                freeaddrinfo(head);
-                freeaddrinfo(*current);
-                return NULL;
-            }
-            memcpy((*current)->ai_addr, src->ai_addr, src->ai_addrlen);
+            node->ai_addr = (struct sockaddr *)(node + 1);
+            memcpy(node->ai_addr, src->ai_addr, addr_len);
         }
 
-        // Copy ai_canonname
         if (src->ai_canonname != NULL) {
-            (*current)->ai_canonname = strdup(src->ai_canonname);
-            if ((*current)->ai_canonname == NULL) {
-                ERROR("(*Current)->ai_canonname NULL\n");
+            node->ai_canonname = strdup(src->ai_canonname);
+            if (node->ai_canonname == NULL) {
+                ERROR("Failed to copy ai_canonname\n");
                 freeaddrinfo(head);
-                freeaddrinfo(*current);
                 return NULL;
             }
         }
         src = src->ai_next;
-        current = &((*current)->ai_next);
+        current = &node->ai_next;
     }
-    freeaddrinfo(*current);
-    *current = NULL;
     return head;
 }
 
 /**
  * @brief Initializes the DNS cache.
+ * @param max_entries Maximum number of hosts kept in the cache.
  * @return 0 on success, -1 on failure.
  */
-int init_dns_cache() {
+int init_dns_cache(int max_entries) {
     if (dns_cache != NULL) {
         INFO("DNS cache is already initialized.\n");
         return 0;
     }
 
-    dns_cache = malloc(sizeof(dns_cache_t));
-    if (!dns_cache) {
+    if (max_entries < 1) max_entries = 1;
+    size_t nb_buckets = 1;
+    while (nb_buckets < (size_t)max_entries) nb_buckets *= 2;
+
+    dns_cache = calloc(1, sizeof(dns_cache_t));
+    if (dns_cache) dns_cache->buckets = calloc(nb_buckets, sizeof(dns_cache_entry_t*));
+    if (!dns_cache || !dns_cache->buckets) {
         ERROR("Failed to allocate memory for DNS cache.\n");
+        free(dns_cache);
+        dns_cache = NULL;
         return -1;
     }
-    dns_cache->head = NULL;
-    INFO("DNS cache initialized.\n");
+    dns_cache->bucket_mask = (uint32_t)(nb_buckets - 1);
+    dns_cache->max_entries = max_entries;
+    INFO("DNS cache initialized (%d entries max).\n", dns_cache->max_entries);
     return 0;
 }
 
 /**
- * @brief Adds a new entry to the DNS cache.
+ * @brief Adds an entry to the DNS cache, or refreshes the entry of the host.
+ *
+ * When the cache is full, the least recently used entry is evicted.
+ *
  * @param host The hostname.
  * @param ipstr The IP address as a string.
- * @param addr_info Pointer to the addrinfo structure.
+ * @param addr_info Pointer to the addrinfo structure, copied in the cache.
+ * @param ttl Number of seconds the address remains valid, 0 not to cache it.
  * @return 0 on success, -1 on failure.
  */
-int add_in_cache(const char* host, const char* ipstr, struct addrinfo* addr_info) {
+int add_in_cache(const char* host, const char* ipstr, const struct addrinfo* addr_info, uint32_t ttl) {
     if (!dns_cache || !host || !ipstr || !addr_info) {
         ERROR("Invalid arguments for add_in_cache.\n");
         return -1;
     }
-
-    if (find_in_cache(host) != NULL) {
-        INFO("Entry for %s already exists in DNS cache.\n", host);
+    if (ttl == 0) {
+        INFO("TTL of %s is 0, not cached\n", host);
         return 0;
     }
+    if (ttl > DNS_CACHE_MAX_TTL) ttl = DNS_CACHE_MAX_TTL;
 
-    dns_cache_entry_t *new_entry = malloc(sizeof(dns_cache_entry_t));
-    if (!new_entry) {
-        ERROR("Failed to allocate memory for DNS cache entry.\n");
-        Log(LOG_LEVEL_ERROR, "[DNS CACHE] Failed to allocate memory for DNS cache entry");
+    struct addrinfo *copy = copy_addrinfo(addr_info);
+    if (!copy) {
+        ERROR("Failed to copy addrinfo.\n");
         return -1;
     }
 
-    strncpy(new_entry->host, host, sizeof(new_entry->host) - 1);
-    new_entry->host[sizeof(new_entry->host) - 1] = '\0';
-    strncpy(new_entry->ipstr, ipstr, sizeof(new_entry->ipstr) - 1);
-    new_entry->ipstr[INET6_ADDRSTRLEN - 1] = '\0';
+    pthread_mutex_lock(&dns_cache_lock);
+    dns_cache_entry_t *entry = lookup_in_cache(host);
+    if (entry) {
+        freeaddrinfo(entry->addr_info);
+    } else {
+        if (dns_cache->nb_entries >= dns_cache->max_entries) {
+            INFO("DNS cache full, evicting %s\n", dns_cache->lru_tail->host);
+            remove_entry(dns_cache->lru_tail);
+        }
 
-    new_entry->addr_info = copy_addrinfo(addr_info);
-    if (!new_entry->addr_info) {
-        ERROR("Failed to copy addrinfo.\n");
-        free(new_entry);
-        return -1;
+        entry = calloc(1, sizeof(dns_cache_entry_t));
+        if (!entry) {
+            ERROR("Failed to allocate memory for DNS cache entry.\n");
+            Log(LOG_LEVEL_ERROR, "[DNS CACHE] Failed to allocate memory for DNS cache entry");
+            pthread_mutex_unlock(&dns_cache_lock);
+            freeaddrinfo(copy);
+            return -1;
+        }
+
+        strncpy(entry->host, host, sizeof(entry->host) - 1);
+        entry->hash = hash_host(entry->host);
+        dns_cache_entry_t **bucket = &dns_cache->buckets[entry->hash & dns_cache->bucket_mask];
+        entry->next = *bucket;
+        *bucket = entry;
+        lru_push_front(entry);
+        dns_cache->nb_entries++;
     }
 
-    new_entry->next = dns_cache->head;
-    dns_cache->head = new_entry;
+    strncpy(entry->ipstr, ipstr, sizeof(entry->ipstr) - 1);
+    entry->ipstr[sizeof(entry->ipstr) - 1] = '\0';
+    entry->addr_info = copy;
+    entry->expires_at = now_ms() + (long long)ttl * 1000;
+    pthread_mutex_unlock(&dns_cache_lock);
 
-    INFO("Added DNS cache entry: %s -> %s\n", host, ipstr);
+    INFO("Added DNS cache entry: %s -> %s (ttl %u)\n", host, ipstr, ttl);
     return 0;
 }
 
 /**
- * @brief Finds a DNS cache entry for a given host.
+ * @brief Looks a host up in the DNS cache, without ever resolving it.
  * @param host The hostname to search for.
- * @return Pointer to the cache entry if found, NULL otherwise.
+ * @param ipstr Buffer receiving the IP address as a string.
+ * @param res If not NULL, receives a copy of the cached addrinfo, to release with freeaddrinfo().
+ * @return 0 if a fresh entry was found, 1 otherwise.
  */
-dns_cache_entry_t* find_in_cache(const char* host) {
+int find_in_cache(const char* host, char* ipstr, struct addrinfo** res) {
     if (!dns_cache || !host) {
         ERROR("Invalid arguments for find_in_cache.\n");
-        return NULL;
+        return 1;
     }
 
-    dns_cache_entry_t *current = dns_cache->head;
-    while (current) {
-        if (strcmp(current->host, host) == 0) {
-            INFO("Found DNS cache entry for host: %s -> %s\n", current->host, current->ipstr);
-            return current;
+    pthread_mutex_lock(&dns_cache_lock);
+    dns_cache_entry_t *entry = lookup_in_cache(host);
+    if (entry) {
+        strncpy(ipstr, entry->ipstr, INET6_ADDRSTRLEN - 1);
+        ipstr[INET6_ADDRSTRLEN - 1] = '\0';
+        if (res) {
+            *res = copy_addrinfo(entry->addr_info);
+            if (!*res) entry = NULL;
         }
-        current = current->next;
     }
+    pthread_mutex_unlock(&dns_cache_lock);
+    return entry ? 0 : 1;
+}
 
-    INFO("No DNS cache entry found for host: %s\n", host);
-    return NULL;
+/**
+ * @brief Returns the number of entries in the DNS cache.
+ * @return The number of entries, stale ones included until they are looked up or evicted.
+ */
+int dns_cache_count() {
+    if (!dns_cache) return 0;
+
+    pthread_mutex_lock(&dns_cache_lock);
+    int count = dns_cache->nb_entries;
+    pthread_mutex_unlock(&dns_cache_lock);
+    return count;
 }
 
 /**
@@ -179,15 +318,16 @@ void free_dns_cache() {
         return;
     }
 
-    dns_cache_entry_t *current = dns_cache->head;
+    dns_cache_entry_t *current = dns_cache->lru_head;
     while (current) {
-        dns_cache_entry_t *next = current->next;
+        dns_cache_entry_t *next = current->lru_next;
         if (current->addr_info) {
             freeaddrinfo(current->addr_info);
         }
         free(current);
         current = next;
     }
+    free(dns_cache->buckets);
     free(dns_cache);
     dns_cache = NULL;
     INFO("DNS cache freed.\n");
@@ -195,8 +335,11 @@ void free_dns_cache() {
 
 /**
  * @brief Resolves a hostname to an IP address and caches the result.
+ *
+ * A fresh cache entry is handed back without resolving the host again.
+ *
  * @param host The hostname to resolve.
- * @param res Pointer to store the resulting addrinfo structure.
+ * @param res Pointer to store the resulting addrinfo structure, to release with freeaddrinfo().
  * @param ipstr Buffer to store the IP address as a string.
  * @return 0 on success, non-zero on failure.
  */
@@ -208,16 +351,7 @@ int resolve_dns(const char* host, struct addrinfo** res, char* ipstr) {
 
     INFO("Resolving DNS for %s\n", host);
 
-    dns_cache_entry_t *cached_entry = find_in_cache(host);
-    if (cached_entry) {
-        strncpy(ipstr, cached_entry->ipstr, INET6_ADDRSTRLEN - 1);
-        ipstr[INET6_ADDRSTRLEN - 1] = '\0';
-
-        *res = copy_addrinfo(cached_entry->addr_info);
-        if (!*res) {
-            ERROR("Failed to copy addrinfo from cache.\n");
-            return -1;
-        }
+    if (find_in_cache(host, ipstr, res) == 0) {
         return 0;
     }
 
@@ -244,7 +378,8 @@ int resolve_dns(const char* host, struct addrinfo** res, char* ipstr) {
 
     INFO("DNS resolution successful for %s -> %s\n", host, ipstr);
 
-    if (add_in_cache(host, ipstr, *res) != 0) {
+    // getaddrinfo() does not give the TTL of the answer
+    if (add_in_cache(host, ipstr, *res, DNS_CACHE_DEFAULT_TTL) != 0) {
         ERROR("Failed to add DNS resolution to cache.\n");
         Log(LOG_LEVEL_ERROR, "[DNS CACHE] failled to add DNS resolution");
     }
@@ -0,0 +1,145 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file domain_filter.c
+ * @brief Implementation of the prefilter of the banned domains.
+ */
+
+#include "../includes/domain_filter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Odd multipliers picking the bit set in each word of a block.
+ */
+static const uint32_t salts[8] = {
+  0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du, 0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+};
+
+/**
+ * @brief Initializes an empty filter, which contains no key.
+ *
+ * @param filter The filter.
+ */
+void init_domain_filter(domain_filter_t* filter) {
+  memset(filter, 0, sizeof(domain_filter_t));
+}
+
+/**
+ * @brief Allocates an empty filter sized for a number of keys, replacing its blocks.
+ *
+ * @param filter The filter.
+ * @param count The number of keys to be added.
+ *
+ * @return 0 on success, -1 if the blocks could not be allocated.
+ */
+int domain_filter_reserve(domain_filter_t* filter, size_t count) {
+  free_domain_filter(filter);
+  if (count == 0) return 0;
+
+  size_t nb_blocks = (count * DOMAIN_FILTER_BITS_PER_KEY + 255) / 256;
+  if (nb_blocks > UINT32_MAX) return -1;
+  size_t size = (nb_blocks * sizeof(domain_filter_block_t) + 63) & ~(size_t)63;
+  filter->blocks = aligned_alloc(64, size);
+  if (!filter->blocks) return -1;
+  memset(filter->blocks, 0, size);
+  filter->nb_blocks = nb_blocks;
+  return 0;
+}
+
+/**
+ * @brief Selects the block of a hash from its high bits, without a division.
+ */
+static inline const domain_filter_block_t* find_block(const domain_filter_t* filter, uint64_t hash) {
+  return &filter->blocks[(hash >> 32) * filter->nb_blocks >> 32];
+}
+
+/**
+ * @brief Adds the hash of a key to the filter.
+ *
+ * @param filter The filter, reserved for its keys.
+ * @param hash The hash of the key, its high bits well mixed (see domain_hash64()).
+ */
+void domain_filter_add(domain_filter_t* filter, uint64_t hash) {
+  if (filter->nb_blocks == 0) return;
+
+  domain_filter_block_t* block = (domain_filter_block_t*)find_block(filter, hash);
+  uint32_t key = (uint32_t)hash;
+  for (int i = 0; i < 8; i++) block->words[i] |= 1u << ((key * salts[i]) >> 27);
+  filter->nb_keys++;
+}
+
+/**
+ * @brief Tells whether the hash of a key may have been added to the filter.
+ *
+ * @param filter The filter.
+ * @param hash The hash of the key.
+ *
+ * @return 0 if the key has not been added, 1 if it may have been.
+ */
+int domain_filter_contains(const domain_filter_t* filter, uint64_t hash) {
+  if (filter->nb_blocks == 0) return 0;
+
+  const domain_filter_block_t* block = find_block(filter, hash);
+  uint32_t key = (uint32_t)hash;
+  uint32_t missing = 0;
+  for (int i = 0; i < 8; i++) missing |= ~block->words[i] & (1u << ((key * salts[i]) >> 27));
+  return missing == 0;
+}
+
+/**
+ * @brief Returns the memory taken by the blocks of the filter.
+ *
+ * @param filter The filter.
+ *
+ * @return The size of the blocks in bytes.
+ */
+size_t domain_filter_size(const domain_filter_t* filter) {
+  return filter->nb_blocks * sizeof(domain_filter_block_t);
+}
+
+/**
+ * @brief Estimates the rate of false positives from the bits actually set.
+ *
+ * A key never added lands in any block with the same probability, and is reported present
+ * when the bit it picks in each word is set. The whole filter is read, so the estimate is
+ * meant for statistics at load time, not for the lookups.
+ *
+ * @param filter The filter.
+ *
+ * @return The probability that a key never added is reported present.
+ */
+double domain_filter_false_positive_rate(const domain_filter_t* filter) {
+  if (filter->nb_blocks == 0) return 0.0;
+
+  double sum = 0.0;
+  for (size_t b = 0; b < filter->nb_blocks; b++) {
+    double rate = 1.0;
+    for (int i = 0; i < 8; i++) rate *= __builtin_popcount(filter->blocks[b].words[i]) / 32.0;
+    sum += rate;
+  }
+  return sum / filter->nb_blocks;
+}
+
+/**
+ * @brief Frees the blocks of a filter, leaving it empty.
+ *
+ * @param filter The filter.
+ */
+void free_domain_filter(domain_filter_t* filter) {
+  free(filter->blocks);
+  init_domain_filter(filter);
+}
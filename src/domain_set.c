@@ -0,0 +1,232 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file domain_set.c
+ * @brief Implementation of the set of banned domains.
+ */
+
+#include "../includes/domain_set.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/**
+ * @brief Initializes an empty set, the table is allocated by the first domain added.
+ *
+ * @param set The set.
+ */
+void init_domain_set(domain_set_t* set) {
+  memset(set, 0, sizeof(domain_set_t));
+}
+
+/**
+ * @brief Lowers the case of the ASCII letters of 8 bytes at once.
+ */
+static inline uint64_t fold_case(uint64_t word) {
+  const uint64_t ones = 0x0101010101010101ULL;
+  uint64_t low = word & (0x7f * ones);
+  uint64_t above_z = low + (0x7f - 'Z') * ones;
+  uint64_t from_a = low + (0x80 - 'A') * ones;
+  uint64_t upper = ~word & (from_a ^ above_z) & (0x80 * ones);
+  return word | (upper >> 2);
+}
+
+/**
+ * @brief Hashes a domain on 64 bits, ignoring case.
+ *
+ * The domain is read 8 bytes at a time, each word mixed with a multiply: a host of 20
+ * bytes costs three rounds instead of twenty. The high bits are the best mixed.
+ *
+ * @param domain The domain, not necessarily NUL terminated.
+ * @param len The length of the domain.
+ *
+ * @return The hash of the domain.
+ */
+uint64_t domain_hash64(const char* domain, size_t len) {
+  const uint64_t multiplier = 0x9e3779b97f4a7c15ULL;
+  uint64_t hash = len * multiplier;
+  uint64_t word;
+
+  for (; len >= 8; domain += 8, len -= 8) {
+    memcpy(&word, domain, 8);
+    hash = (hash ^ fold_case(word)) * multiplier;
+    hash ^= hash >> 29;
+  }
+  if (len > 0) {
+    word = 0;
+    memcpy(&word, domain, len);
+    hash = (hash ^ fold_case(word)) * multiplier;
+  }
+  hash ^= hash >> 32;
+  return hash * multiplier;
+}
+
+/**
+ * @brief Hashes a domain, ignoring case.
+ *
+ * @param domain The domain, not necessarily NUL terminated.
+ * @param len The length of the domain.
+ *
+ * @return The hash of the domain, the high bits of domain_hash64().
+ */
+uint32_t domain_hash(const char* domain, size_t len) {
+  return (uint32_t)(domain_hash64(domain, len) >> 32);
+}
+
+/**
+ * @brief Moves the domains into a table of the given capacity.
+ */
+static int domain_set_resize(domain_set_t* set, size_t capacity) {
+  domain_slot_t* slots = calloc(capacity, sizeof(domain_slot_t));
+  if (!slots) return -1;
+
+  // The hashes are kept in the slots, nothing is hashed again
+  size_t mask = capacity - 1;
+  for (size_t i = 0; i < set->capacity; i++) {
+    if (!set->slots[i].domain) continue;
+    size_t index = set->slots[i].hash & mask;
+    while (slots[index].domain) index = (index + 1) & mask;
+    slots[index] = set->slots[i];
+  }
+
+  free(set->slots);
+  set->slots = slots;
+  set->capacity = capacity;
+  return 0;
+}
+
+/**
+ * @brief Grows the table so that it holds count domains without being resized.
+ *
+ * Loading a large list is faster when its size is reserved first.
+ *
+ * @param set The set.
+ * @param count The number of domains the set will hold.
+ *
+ * @return 0 on success, -1 if the table could not be allocated.
+ */
+int domain_set_reserve(domain_set_t* set, size_t count) {
+  size_t capacity = set->capacity ? set->capacity : DOMAIN_SET_MIN_CAPACITY;
+  while (capacity < count * 2) capacity *= 2;
+  return capacity == set->capacity ? 0 : domain_set_resize(set, capacity);
+}
+
+/**
+ * @brief Appends a domain to the text.
+ *
+ * @return The offset of the domain, or 0 if the text could not be grown.
+ */
+static uint32_t add_text(domain_set_t* set, const char* domain, size_t len) {
+  size_t start = set->text_len ? set->text_len : 1;
+  if (start + len + 1 > UINT32_MAX) return 0;
+  if (start + len + 1 > set->text_capacity) {
+    size_t capacity = set->text_capacity ? set->text_capacity : 256;
+    while (start + len + 1 > capacity) capacity *= 2;
+    char* text = realloc(set->text, capacity);
+    if (!text) return 0;
+    set->text = text;
+    set->text_capacity = capacity;
+  }
+  set->text[0] = '\0';
+  memcpy(set->text + start, domain, len + 1);
+  set->text_len = start + len + 1;
+  return start;
+}
+
+/**
+ * @brief Adds a domain to the set.
+ *
+ * @param set The set.
+ * @param domain The domain, NUL terminated, copied by the set.
+ * @param category The index of the category banning the domain.
+ *
+ * @return 0 if the domain has been added, 1 if it was already in the set, where it keeps
+ *         its first category, or -1 if memory is short.
+ */
+int domain_set_add(domain_set_t* set, const char* domain, uint32_t category) {
+  if (domain_set_reserve(set, set->count + 1) != 0) return -1;
+
+  size_t len = strlen(domain);
+  uint32_t hash = domain_hash(domain, len);
+  size_t mask = set->capacity - 1;
+  size_t index = hash & mask;
+  for (; set->slots[index].domain; index = (index + 1) & mask) {
+    const domain_slot_t* slot = &set->slots[index];
+    if (slot->hash == hash && strcasecmp(set->text + slot->domain, domain) == 0) return 1;
+  }
+
+  uint32_t offset = add_text(set, domain, len);
+  if (offset == 0) return -1;
+  set->slots[index] = (domain_slot_t){ offset, hash, category };
+  set->count++;
+  return 0;
+}
+
+/**
+ * @brief Checks a set mapped from a file before it is looked up.
+ *
+ * The text must end with a NUL byte, so no domain runs past it.
+ *
+ * @param set The set, its slots and text in place.
+ * @param nb_categories The number of categories the slots may refer to.
+ *
+ * @return 1 if every slot refers to the text and to a category and a slot is left free, 0 otherwise.
+ */
+int domain_set_check(const domain_set_t* set, size_t nb_categories) {
+  size_t used = 0;
+  for (size_t i = 0; i < set->capacity; i++) {
+    const domain_slot_t* slot = &set->slots[i];
+    if (!slot->domain) continue;
+    if (slot->domain >= set->text_len || slot->category >= nb_categories) return 0;
+    used++;
+  }
+  return used == set->count && (used == 0 || used < set->capacity);
+}
+
+/**
+ * @brief Looks a host up in the set, ignoring case.
+ *
+ * @param set The set.
+ * @param host The host, not necessarily NUL terminated.
+ * @param len The length of the host.
+ *
+ * @return The category of the host, or -1 if it is not in the set.
+ */
+int domain_set_find(const domain_set_t* set, const char* host, size_t len) {
+  if (set->count == 0) return -1;
+
+  uint32_t hash = domain_hash(host, len);
+  size_t mask = set->capacity - 1;
+  for (size_t index = hash & mask; set->slots[index].domain; index = (index + 1) & mask) {
+    const domain_slot_t* slot = &set->slots[index];
+    const char* domain = set->text + slot->domain;
+    if (slot->hash == hash && strncasecmp(domain, host, len) == 0 && domain[len] == '\0') {
+      return slot->category;
+    }
+  }
+  return -1;
+}
+
+/**
+ * @brief Frees the table and the domains of a set.
+ *
+ * @param set The set.
+ */
+void free_domain_set(domain_set_t* set) {
+  free(set->slots);
+  free(set->text);
+  init_domain_set(set);
+}
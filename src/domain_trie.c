@@ -0,0 +1,271 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file domain_trie.c
+ * @brief Implementation of the trie of banned domain suffixes.
+ */
+
+#define _GNU_SOURCE
+
+#include "../includes/domain_trie.h"
+#include "../includes/domain_set.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes an empty trie, the arrays are allocated by the first suffix added.
+ *
+ * @param trie The trie.
+ */
+void init_domain_trie(domain_trie_t* trie) {
+  memset(trie, 0, sizeof(domain_trie_t));
+}
+
+/**
+ * @brief Hashes the edge leaving a node with a label, ignoring the case of the label.
+ */
+static uint32_t edge_hash(uint32_t parent, const char* label, size_t len) {
+  uint32_t hash = (domain_hash(label, len) + parent) * 0x9e3779b1u;
+  return hash ^ (hash >> 16);
+}
+
+/**
+ * @brief Compares two labels of the same length, ignoring the case of ASCII letters.
+ */
+static inline int same_label(const char* a, const char* b, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    unsigned char x = a[i], y = b[i];
+    if (x >= 'A' && x <= 'Z') x |= 0x20;
+    if (y >= 'A' && y <= 'Z') y |= 0x20;
+    if (x != y) return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Finds the slot of the edge leaving a node with a label.
+ *
+ * @return The slot of the edge, or the free slot where it would be added.
+ */
+static size_t find_edge(const domain_trie_t* trie, uint32_t parent, const char* label, size_t len, uint32_t hash) {
+  size_t mask = trie->edges_capacity - 1;
+  size_t index = hash & mask;
+  for (; trie->edges[index].child; index = (index + 1) & mask) {
+    const domain_trie_edge_t* edge = &trie->edges[index];
+    const char* text = trie->labels + edge->label;
+    if (edge->hash == hash && edge->parent == parent && (unsigned char)text[0] == len && same_label(text + 1, label, len)) {
+      return index;
+    }
+  }
+  return index;
+}
+
+/**
+ * @brief Doubles the table of edges, the hashes kept in the slots place them again.
+ */
+static int grow_edges(domain_trie_t* trie) {
+  size_t capacity = trie->edges_capacity ? trie->edges_capacity * 2 : 16;
+  domain_trie_edge_t* edges = calloc(capacity, sizeof(domain_trie_edge_t));
+  if (!edges) return -1;
+
+  size_t mask = capacity - 1;
+  for (size_t i = 0; i < trie->edges_capacity; i++) {
+    if (!trie->edges[i].child) continue;
+    size_t index = trie->edges[i].hash & mask;
+    while (edges[index].child) index = (index + 1) & mask;
+    edges[index] = trie->edges[i];
+  }
+
+  free(trie->edges);
+  trie->edges = edges;
+  trie->edges_capacity = capacity;
+  return 0;
+}
+
+/**
+ * @brief Appends a node without rule.
+ *
+ * @return The index of the node, or 0 if the array could not be grown.
+ */
+static uint32_t add_node(domain_trie_t* trie) {
+  if (trie->nb_nodes == trie->nodes_capacity) {
+    size_t capacity = trie->nodes_capacity ? trie->nodes_capacity * 2 : 16;
+    int32_t* categories = realloc(trie->categories, capacity * sizeof(int32_t));
+    if (!categories) return 0;
+    trie->categories = categories;
+    trie->nodes_capacity = capacity;
+  }
+  trie->categories[trie->nb_nodes] = -1;
+  return trie->nb_nodes++;
+}
+
+/**
+ * @brief Appends a label to the text, after its length.
+ *
+ * @return The offset of the label, or (uint32_t)-1 if the text could not be grown.
+ */
+static uint32_t add_label(domain_trie_t* trie, const char* label, size_t len) {
+  if (trie->labels_len + len + 1 > trie->labels_capacity) {
+    size_t capacity = trie->labels_capacity ? trie->labels_capacity : 256;
+    while (trie->labels_len + len + 1 > capacity) capacity *= 2;
+    char* labels = realloc(trie->labels, capacity);
+    if (!labels) return (uint32_t)-1;
+    trie->labels = labels;
+    trie->labels_capacity = capacity;
+  }
+  uint32_t offset = trie->labels_len;
+  trie->labels[offset] = (char)len;
+  memcpy(trie->labels + offset + 1, label, len);
+  trie->labels_len += len + 1;
+  return offset;
+}
+
+/**
+ * @brief Checks that a name is made of labels of 1 to DOMAIN_TRIE_MAX_LABEL bytes.
+ */
+static int valid_labels(const char* name, size_t len) {
+  if (len == 0) return 0;
+  size_t label_len = 0;
+  for (size_t i = 0; i <= len; i++) {
+    if (i < len && name[i] != '.') {
+      if (++label_len > DOMAIN_TRIE_MAX_LABEL) return 0;
+    } else {
+      if (label_len == 0) return 0;
+      label_len = 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ * @brief Adds a suffix to the trie: its strict subdomains are then mapped to the category.
+ *
+ * @param trie The trie.
+ * @param suffix The domain whose subdomains are banned, "example.com" for the rule "*.example.com".
+ * @param category The index of the category of the rule.
+ *
+ * @return 0 if the suffix has been added, 1 if it was already in the trie, where it keeps
+ *         its first category, or -1 if the suffix is not a domain name or memory is short.
+ */
+int domain_trie_add(domain_trie_t* trie, const char* suffix, uint32_t category) {
+  size_t len = strlen(suffix);
+  if (!valid_labels(suffix, len)) return -1;
+  if (trie->nb_nodes == 0) {
+    add_node(trie);
+    if (trie->nb_nodes == 0) return -1;
+  }
+
+  uint32_t node = 0;
+  const char* end = suffix + len;
+  while (end > suffix) {
+    const char* dot = memrchr(suffix, '.', end - suffix);
+    const char* label = dot ? dot + 1 : suffix;
+    size_t label_len = end - label;
+
+    // Every node but the root is the child of one edge
+    if (trie->nb_nodes * 2 > trie->edges_capacity && grow_edges(trie) != 0) return -1;
+
+    uint32_t hash = edge_hash(node, label, label_len);
+    size_t index = find_edge(trie, node, label, label_len, hash);
+    if (!trie->edges[index].child) {
+      uint32_t offset = add_label(trie, label, label_len);
+      if (offset == (uint32_t)-1) return -1;
+      uint32_t child = add_node(trie);
+      if (child == 0) return -1;
+      trie->edges[index] = (domain_trie_edge_t){ hash, node, child, offset };
+    }
+    node = trie->edges[index].child;
+    end = dot ? dot : suffix;
+  }
+
+  if (trie->categories[node] >= 0) return 1;
+  trie->categories[node] = category;
+  trie->nb_rules++;
+  return 0;
+}
+
+/**
+ * @brief Checks a trie mapped from a file before it is looked up.
+ *
+ * @param trie The trie, its nodes, edges and labels in place.
+ * @param nb_categories The number of categories the nodes may refer to.
+ *
+ * @return 1 if every node refers to a category or none, every edge to nodes and a label
+ *         within the text, and an edge is left free; 0 otherwise.
+ */
+int domain_trie_check(const domain_trie_t* trie, size_t nb_categories) {
+  for (size_t i = 0; i < trie->nb_nodes; i++) {
+    if (trie->categories[i] < -1 || (trie->categories[i] >= 0 && (size_t)trie->categories[i] >= nb_categories)) return 0;
+  }
+
+  size_t used = 0;
+  for (size_t i = 0; i < trie->edges_capacity; i++) {
+    const domain_trie_edge_t* edge = &trie->edges[i];
+    if (!edge->child) continue;
+    if (edge->child >= trie->nb_nodes || edge->parent >= trie->nb_nodes) return 0;
+    if (edge->label >= trie->labels_len || (unsigned char)trie->labels[edge->label] >= trie->labels_len - edge->label) return 0;
+    used++;
+  }
+  return used == 0 || used < trie->edges_capacity;
+}
+
+/**
+ * @brief Looks up the most specific suffix of a host, ignoring case.
+ *
+ * The labels of the host are walked from the right, one probe of the edges each, so the
+ * cost depends on the number of labels of the host, not on the number of rules.
+ *
+ * @param trie The trie.
+ * @param host The host, not necessarily NUL terminated.
+ * @param len The length of the host.
+ *
+ * @return The category of the longest suffix of which the host is a strict subdomain,
+ *         or -1 if there is none.
+ */
+int domain_trie_find(const domain_trie_t* trie, const char* host, size_t len) {
+  if (trie->nb_rules == 0) return -1;
+
+  int category = -1;
+  uint32_t node = 0;
+  const char* end = host + len;
+  while (end > host) {
+    const char* dot = memrchr(host, '.', end - host);
+    const char* label = dot ? dot + 1 : host;
+    size_t label_len = end - label;
+    if (label_len == 0 || label_len > DOMAIN_TRIE_MAX_LABEL) break;
+
+    size_t index = find_edge(trie, node, label, label_len, edge_hash(node, label, label_len));
+    if (!trie->edges[index].child) break;
+    node = trie->edges[index].child;
+    end = dot ? dot : host;
+
+    // The rule of a node matches the hosts with labels left of its suffix
+    if (end > host && trie->categories[node] >= 0) category = trie->categories[node];
+  }
+  return category;
+}
+
+/**
+ * @brief Frees the arrays of a trie.
+ *
+ * @param trie The trie.
+ */
+void free_domain_trie(domain_trie_t* trie) {
+  free(trie->categories);
+  free(trie->edges);
+  free(trie->labels);
+  init_domain_trie(trie);
+}
@@ -0,0 +1,111 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file epoch.c
+ * @brief Implementation of the epoch based reclamation of shared snapshots.
+ *
+ * The global epoch is advanced by each grace period. A reader entering its section records
+ * the epoch it saw, and clears it when leaving. Once a writer has swapped a pointer and
+ * advanced the epoch to E, a reader whose recorded epoch is below E may still hold the old
+ * pointer; a reader which entered at E or later, or is outside its section, cannot.
+ */
+
+#include "../includes/epoch.h"
+
+#include <stdatomic.h>
+#include <time.h>
+
+/**
+ * @brief State of a reader, alone on its cache line so readers do not slow each other.
+ */
+typedef struct {
+  _Alignas(64) atomic_uint_fast64_t epoch; /**< Epoch seen when entering the section, 0 outside it */
+  atomic_int used;                 /**< Set while the slot belongs to a reader */
+} epoch_reader_t;
+
+static epoch_reader_t readers[EPOCH_MAX_READERS];
+static atomic_int nb_slots = 0;    /**< Slots ever used, the grace periods look no further */
+static atomic_uint_fast64_t global_epoch = 1;
+
+/**
+ * @brief Registers a reader, called once by each thread reading the snapshots.
+ *
+ * @return The index of the reader, or -1 if EPOCH_MAX_READERS are already registered.
+ */
+int epoch_register(void) {
+  for (int i = 0; i < EPOCH_MAX_READERS; i++) {
+    int expected = 0;
+    if (!atomic_compare_exchange_strong(&readers[i].used, &expected, 1)) continue;
+
+    atomic_store(&readers[i].epoch, 0);
+    int slots = atomic_load(&nb_slots);
+    while (slots <= i && !atomic_compare_exchange_weak(&nb_slots, &slots, i + 1));
+    return i;
+  }
+  return -1;
+}
+
+/**
+ * @brief Unregisters a reader, which must be outside its section.
+ *
+ * @param reader The index of the reader, ignored if negative.
+ */
+void epoch_unregister(int reader) {
+  if (reader < 0) return;
+  atomic_store(&readers[reader].epoch, 0);
+  atomic_store(&readers[reader].used, 0);
+}
+
+/**
+ * @brief Enters the read-side section: the snapshots loaded until epoch_exit() stay valid.
+ *
+ * The store is sequentially consistent, so the pointers loaded after it are either the
+ * new ones or seen by the grace period in progress.
+ *
+ * @param reader The index of the reader.
+ */
+void epoch_enter(int reader) {
+  atomic_store(&readers[reader].epoch, atomic_load(&global_epoch));
+}
+
+/**
+ * @brief Leaves the read-side section, the snapshots loaded in it must not be used anymore.
+ *
+ * @param reader The index of the reader.
+ */
+void epoch_exit(int reader) {
+  atomic_store_explicit(&readers[reader].epoch, 0, memory_order_release);
+}
+
+/**
+ * @brief Waits until no reader can hold a snapshot unpublished before the call.
+ *
+ * Called by the writer after swapping the pointer and before freeing the old snapshot.
+ * It waits for the readers in their section to leave it, at most the time a worker
+ * takes to handle one batch of events.
+ */
+void epoch_synchronize(void) {
+  uint_fast64_t target = atomic_fetch_add(&global_epoch, 1) + 1;
+  const struct timespec delay = { 0, EPOCH_POLL_MS * 1000000L };
+
+  int slots = atomic_load(&nb_slots);
+  for (int i = 0; i < slots; i++) {
+    while (1) {
+      uint_fast64_t epoch = atomic_load(&readers[i].epoch);
+      if (epoch == 0 || epoch >= target) break;
+      nanosleep(&delay, NULL);
+    }
+  }
+}
@@ -0,0 +1,878 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file event_loop.c
+ * @brief Implementation of the epoll based event loop.
+ *
+ * Every socket is registered in edge-triggered mode with a pointer to its conn_handle_t,
+ * so a ready event leads straight to the owning connection. Open connections are kept in
+ * a doubly linked list: closing one is O(1) and nothing has to be compacted between two
+ * calls to epoll_wait().
+ */
+
+#define _GNU_SOURCE
+
+#include "../includes/event_loop.h"
+#include "../includes/config.h"
+#include "../includes/epoch.h"
+#include "../includes/server_helper.h"
+#include "../includes/utils.h"
+#include "../includes/logger.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <time.h>
+
+/**
+ * @brief Registers a socket of a connection in the epoll instance.
+ *
+ * @param loop The event loop.
+ * @param fd The socket to watch.
+ * @param handle The handle given back with each event on this socket.
+ * @param events Additional events to watch besides input and hang-ups.
+ *
+ * @return 0 on success, -1 on error.
+ */
+static int watch_socket(event_loop_t* loop, int fd, conn_handle_t* handle, uint32_t events) {
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | events;
+  ev.data.ptr = handle;
+  return epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void dns_resolved(void* data, void* ctx, const char* host, int status, const struct in_addr* addr, uint32_t ttl);
+static void read_request(event_loop_t* loop, connection_t* conn);
+static void watch_server(event_loop_t* loop, connection_t* conn);
+
+/**
+ * @brief Opens the DNS client of a loop and registers its socket.
+ *
+ * The resolver is DNS_SERVER, or the name server of /etc/resolv.conf. Without DNS client,
+ * hosts are resolved synchronously by getaddrinfo().
+ *
+ * @param loop The event loop.
+ */
+static void open_dns_client(event_loop_t* loop) {
+  char server[sizeof(config.dns_server)] = "127.0.0.1";
+  if (config.dns_server[0] != '\0') {
+    snprintf(server, sizeof(server), "%s", config.dns_server);
+  } else if (get_default_dns_server(server, sizeof(server)) != 0) {
+    WARN("No name server in /etc/resolv.conf, using %s\n", server);
+  }
+
+  if (init_dns_client(&loop->dns, server, config.dns_port, dns_resolved, loop) != 0) {
+    WARN("DNS client unavailable, hosts are resolved synchronously\n");
+    Log(LOG_LEVEL_WARN, "[EVENT LOOP] DNS client unavailable, hosts are resolved synchronously");
+    return;
+  }
+
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.ptr = &loop->dns_handle;
+  if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->dns.fd, &ev) != 0) {
+    ERROR("epoll_ctl on the DNS socket\n");
+    Log(LOG_LEVEL_ERROR, "[EVENT LOOP] Failed to watch the DNS socket");
+    free_dns_client(&loop->dns);
+  }
+}
+
+/**
+ * @brief Initializes an event loop around a listening socket.
+ *
+ * The listening socket is switched to non-blocking mode so that it can be drained
+ * until EAGAIN each time the edge-triggered notification fires.
+ *
+ * @param loop The event loop to initialize.
+ * @param listen_fd The listening socket.
+ * @param max_connections The maximum number of simultaneous connections.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int init_event_loop(event_loop_t* loop, int listen_fd, int max_connections) {
+  memset(loop, 0, sizeof(event_loop_t));
+  loop->dns.fd = -1;
+  init_pool(&loop->connection_pool, sizeof(connection_t));
+  init_buffer_pool(&loop->buffer_pool, BUFFER_SIZE);
+  init_upstream_pool(&loop->upstreams, config.upstream_max_idle, max_connections, (long long)config.upstream_idle_timeout * 1000);
+  init_verdict_cache(&loop->verdicts, config.verdict_cache_size > 0 ? config.verdict_cache_size : 0);
+  loop->listen_fd = listen_fd;
+  loop->max_connections = max_connections;
+
+  loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (loop->epoll_fd < 0) {
+    ERROR("epoll_create1\n");
+    Log(LOG_LEVEL_ERROR, "[EVENT LOOP] Failed to create the epoll instance");
+    return -1;
+  }
+
+  if (set_socket_non_blocking(listen_fd) != 0) {
+    ERROR("Failed to set the listening socket non-blocking\n");
+    Log(LOG_LEVEL_ERROR, "[EVENT LOOP] Failed to set the listening socket non-blocking");
+    close(loop->epoll_fd);
+    return -1;
+  }
+
+  loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (loop->wake_fd < 0) {
+    ERROR("eventfd\n");
+    Log(LOG_LEVEL_ERROR, "[EVENT LOOP] Failed to create the wake-up eventfd");
+    close(loop->epoll_fd);
+    return -1;
+  }
+
+  // Loop-internal descriptors use handles without connection
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN | EPOLLET;
+  ev.data.ptr = &loop->listen_handle;
+  if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) != 0) {
+    ERROR("epoll_ctl on the listening socket\n");
+    Log(LOG_LEVEL_ERROR, "[EVENT LOOP] Failed to watch the listening socket %d", listen_fd);
+    close(loop->wake_fd);
+    close(loop->epoll_fd);
+    return -1;
+  }
+
+  ev.data.ptr = &loop->wake_handle;
+  if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &ev) != 0) {
+    ERROR("epoll_ctl on the wake-up eventfd\n");
+    Log(LOG_LEVEL_ERROR, "[EVENT LOOP] Failed to watch the wake-up eventfd");
+    close(loop->wake_fd);
+    close(loop->epoll_fd);
+    return -1;
+  }
+
+  open_dns_client(loop);
+
+  // The loop reads the published rules and configuration, see epoch.h
+  loop->epoch_reader = epoch_register();
+  if (loop->epoch_reader < 0) {
+    ERROR("Too many event loops\n");
+    Log(LOG_LEVEL_ERROR, "[EVENT LOOP] More than %d event loops", EPOCH_MAX_READERS);
+    free_dns_client(&loop->dns);
+    close(loop->wake_fd);
+    close(loop->epoll_fd);
+    return -1;
+  }
+
+  INFO("Event loop ready on epoll fd %d\n", loop->epoll_fd);
+  return 0;
+}
+
+/**
+ * @brief Wakes up a loop blocked in epoll_wait(), from any thread.
+ *
+ * Used to make the loop check its running flag again.
+ *
+ * @param loop The event loop to wake up.
+ */
+void wake_event_loop(event_loop_t* loop) {
+  uint64_t one = 1;
+  if (write(loop->wake_fd, &one, sizeof(one)) < 0) {
+    ERROR("write on wake-up eventfd\n");
+  }
+}
+
+/**
+ * @brief Closes both sockets of a connection and removes it from the loop.
+ *
+ * The connection itself is only freed at the end of the current batch of events,
+ * because a later event of the same batch may still point to it.
+ *
+ * @param loop The event loop owning the connection.
+ * @param conn The connection to close.
+ */
+void close_connection(event_loop_t* loop, connection_t* conn) {
+  if (conn->closed) return;
+
+  // The answer of the resolver must not reach a freed connection
+  if (conn->state == CONN_STATE_RESOLVING && conn->resolver) {
+    dns_client_cancel(conn->resolver, conn);
+  }
+
+  INFO("Closing connection client %d / server %d\n", conn->client_fd, conn->server_fd);
+  if (conn->client_fd != -1) close(conn->client_fd);
+  if (conn->server_fd != -1) close(conn->server_fd);
+  close_relay_pipes(conn);
+  buffer_chain_clear(&conn->request);
+  buffer_chain_clear(&conn->response);
+  buffer_chain_clear(&conn->pipelined);
+  release_request_head(conn);
+  release_response_filter(conn);
+  release_buffer(conn, CONN_SIDE_CLIENT);
+  release_buffer(conn, CONN_SIDE_SERVER);
+  conn->client_fd = -1;
+  conn->server_fd = -1;
+  conn->closed = 1;
+
+  if (conn->prev) conn->prev->next = conn->next;
+  else loop->connections = conn->next;
+  if (conn->next) conn->next->prev = conn->prev;
+
+  conn->prev = NULL;
+  conn->next = loop->closed;
+  loop->closed = conn;
+  loop->nb_connections--;
+}
+
+/**
+ * @brief Frees the connections closed during the last batch of events.
+ *
+ * @param loop The event loop.
+ */
+static void release_closed_connections(event_loop_t* loop) {
+  while (loop->closed) {
+    connection_t* next = loop->closed->next;
+    pool_free(&loop->connection_pool, loop->closed);
+    loop->closed = next;
+  }
+}
+
+/**
+ * @brief Returns the current time of the monotonic clock in milliseconds.
+ *
+ * @return The current monotonic time in milliseconds.
+ */
+static long long monotonic_ms() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Moves the bytes of one direction of a connection with splice(), through its pipe.
+ *
+ * The pipe is the queue of the direction: it is flushed to the sink first, then refilled from
+ * the source. When both the sink and the pipe are full, splice() from the source reports EAGAIN
+ * and the direction resumes on the EPOLLOUT edge of the sink, as with the buffers.
+ *
+ * Only the bytes the framing of the message lets through unread are spliced: the rest of a
+ * body of known length, or the data of a chunk. Chunk sizes and the bytes past the message
+ * are left to relay(), which reads them through the buffer once the pipe is flushed.
+ *
+ * @param loop The event loop.
+ * @param conn The connection.
+ * @param side The source side of the direction.
+ *
+ * @return 0 if the direction waits for the sockets, 1 if the pipe is flushed and the next
+ *         bytes must go through the buffer, or -1 if the connection has been closed.
+ */
+static int relay_splice(event_loop_t* loop, connection_t* conn, conn_side_t side) {
+  int src_fd = side == CONN_SIDE_CLIENT ? conn->client_fd : conn->server_fd;
+  int dst_fd = side == CONN_SIDE_CLIENT ? conn->server_fd : conn->client_fd;
+  int* pipe_fds = side == CONN_SIDE_CLIENT ? conn->client_pipe : conn->server_pipe;
+  size_t* pipe_len = side == CONN_SIDE_CLIENT ? &conn->client_pipe_len : &conn->server_pipe_len;
+  http_body_t* body = side == CONN_SIDE_CLIENT ? &conn->request_body : &conn->response_body;
+  const char* name = side == CONN_SIDE_CLIENT ? "client" : "server";
+
+  while (1) {
+    // Flush until the pipe is empty or the sink is full
+    while (*pipe_len > 0) {
+      ssize_t bytes = splice(pipe_fds[0], NULL, dst_fd, NULL, *pipe_len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      if (bytes < 0 && errno == EINTR) continue;
+      if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      if (bytes <= 0) {
+        ERROR("splice to %s\n", side == CONN_SIDE_CLIENT ? "server" : "client");
+        close_connection(loop, conn);
+        return -1;
+      }
+      *pipe_len -= bytes;
+    }
+
+    if (side == CONN_SIDE_SERVER && conn->server_eof) {
+      if (*pipe_len > 0) return 0;
+      INFO("Closing connection on server (%d), no more bits to read\n", src_fd);
+      Log(LOG_LEVEL_INFO, "[SERVER] Closing connection on server (%d), no more bits to read", src_fd);
+      close_connection(loop, conn);
+      return -1;
+    }
+    if (side == CONN_SIDE_CLIENT && conn->client_eof) {
+      if (*pipe_len == 0 && !conn->server_shutdown) {
+        INFO("Client %d shut down its side, shutting down the server side\n", src_fd);
+        shutdown(dst_fd, SHUT_WR);
+        conn->server_shutdown = 1;
+        conn->keep_server = 0;
+      }
+      return 0;
+    }
+
+    size_t limit = http_body_raw_limit(body);
+    if (limit == 0) return *pipe_len > 0 ? 0 : 1;
+    if (limit > RELAY_PIPE_SIZE) limit = RELAY_PIPE_SIZE;
+
+    ssize_t bytes = splice(src_fd, NULL, pipe_fds[1], NULL, limit, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (bytes < 0 && errno == EINTR) continue;
+    // Nothing to read, or the pipe is full because the sink is
+    if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+    if (bytes < 0) {
+      ERROR("splice from %s\n", name);
+      Log(LOG_LEVEL_ERROR, "[SERVER] splice from %s (%d) failed", name, src_fd);
+      close_connection(loop, conn);
+      return -1;
+    }
+    if (bytes == 0) {
+      if (side == CONN_SIDE_CLIENT) conn->client_eof = 1;
+      else conn->server_eof = 1;
+      continue;
+    }
+    http_body_skip(body, bytes);
+    *pipe_len += bytes;
+  }
+}
+
+/**
+ * @brief Ends an exchange once its response has been relayed.
+ *
+ * When both messages were delimited and the server did not ask to close, the connection to
+ * the server goes back to the pool of the loop for the next request to the same origin. When
+ * the client did not ask to close either, its connection goes back to reading its next
+ * request, which is filtered and routed on its own; otherwise the connection is closed.
+ *
+ * @param loop The event loop.
+ * @param conn The connection whose response has been flushed to the client.
+ *
+ * @return 0 if the client connection is kept, -1 if it has been closed.
+ */
+static int finish_response(event_loop_t* loop, connection_t* conn) {
+  // The whole request must have reached the server for the exchange to be over
+  int request_flushed = conn->request_body.done && conn->client_buffer_len == 0 && conn->client_pipe_len == 0;
+
+  if (conn->keep_server && conn->upstreams && request_flushed && !conn->server_eof && !conn->server_shutdown) {
+    // The pooled socket must not report events to this connection anymore
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, conn->server_fd, NULL);
+    if (upstream_pool_put(conn->upstreams, &conn->server_addr, conn->server_fd, monotonic_ms()) == 0) {
+      INFO("Connection %d to %s kept idle\n", conn->server_fd, conn->server_ip);
+      conn->server_fd = -1;
+    }
+  }
+
+  INFO("Response relayed to client %d\n", conn->client_fd);
+  if (!conn->keep_client || !request_flushed || conn->client_eof) {
+    close_connection(loop, conn);
+    return -1;
+  }
+
+  if (conn->server_fd != -1) {
+    close(conn->server_fd);
+    conn->server_fd = -1;
+  }
+  start_next_request(conn);
+  conn->deadline = monotonic_ms() + (long long)current_config()->header_timeout * 1000;
+  INFO("Client %d kept alive after %d requests\n", conn->client_fd, conn->nb_requests);
+
+  // The next request may already be pipelined, or have arrived without a new edge
+  read_request(loop, conn);
+  return conn->closed ? -1 : 0;
+}
+
+/**
+ * @brief Sends the request again on a new server connection, the reused one having closed.
+ *
+ * @param loop The event loop.
+ * @param conn The connection whose reused server connection closed before answering.
+ *
+ * @return 0 if the connection is still open, -1 if it has been closed.
+ */
+static int retry_server(event_loop_t* loop, connection_t* conn) {
+  if (retry_request(conn) != 0) {
+    close_connection(loop, conn);
+    return -1;
+  }
+  watch_server(loop, conn);
+  return conn->closed ? -1 : 0;
+}
+
+/**
+ * @brief Moves the bytes of one direction of a connection, as far as both sockets allow.
+ *
+ * Each direction has one queue, the buffer of its source, attached from the pool of the loop
+ * only while it holds bytes. Each direction first flushes the headers of its message, queued
+ * in their chain; the response headers are parsed by handle_response() before anything else is
+ * relayed to the client. The queue is flushed before the source is read again: when the sink is
+ * full, the source is left unread and the direction resumes on the EPOLLOUT edge of the sink, so
+ * a slow peer neither loses data nor makes the loop spin. Sockets are edge-triggered, so
+ * otherwise the source is read until EAGAIN.
+ *
+ * Bodies are followed as they are relayed, so that nothing is read past the end of the
+ * request, and the exchange ends with its response. When the client shuts down its side,
+ * the server side is shut down once the request is flushed. When the server closes, the
+ * connection is closed once the response is flushed. Whenever the buffer of a direction is
+ * flushed, a connection with relay pipes goes on with relay_splice().
+ *
+ * @param loop The event loop.
+ * @param conn The connection.
+ * @param side The source side of the direction.
+ *
+ * @return 0 if the connection is still open, -1 if it has been closed.
+ */
+static int relay(event_loop_t* loop, connection_t* conn, conn_side_t side) {
+  int src_fd = side == CONN_SIDE_CLIENT ? conn->client_fd : conn->server_fd;
+  int dst_fd = side == CONN_SIDE_CLIENT ? conn->server_fd : conn->client_fd;
+  char** buffer = side == CONN_SIDE_CLIENT ? &conn->client_buffer : &conn->server_buffer;
+  ssize_t* len = side == CONN_SIDE_CLIENT ? &conn->client_buffer_len : &conn->server_buffer_len;
+  ssize_t* sent = side == CONN_SIDE_CLIENT ? &conn->client_buffer_sent : &conn->server_buffer_sent;
+  size_t* pipe_len = side == CONN_SIDE_CLIENT ? &conn->client_pipe_len : &conn->server_pipe_len;
+  buffer_chain_t* head = side == CONN_SIDE_CLIENT ? &conn->request : &conn->response;
+  http_body_t* body = side == CONN_SIDE_CLIENT ? &conn->request_body : &conn->response_body;
+  const char* name = side == CONN_SIDE_CLIENT ? "client" : "server";
+
+  if (side == CONN_SIDE_SERVER && !conn->response_started) {
+    int ret = handle_response(conn);
+    if (ret == CONN_PENDING) return 0;
+    if (ret == CONN_RETRY) return retry_server(loop, conn);
+    if (ret != 0) {
+      close_connection(loop, conn);
+      return -1;
+    }
+  }
+
+  if (head->len > 0) {
+    if (buffer_chain_send(head, dst_fd) < 0) {
+      ERROR("write to %s\n", side == CONN_SIDE_CLIENT ? "server" : "client");
+      close_connection(loop, conn);
+      return -1;
+    }
+    if (head->len > 0) return 0;
+  }
+
+  while (1) {
+    if (*sent < *len) {
+      ssize_t bytes = send_non_blocking(dst_fd, *buffer + *sent, *len - *sent);
+      if (bytes < 0) {
+        ERROR("write to %s\n", side == CONN_SIDE_CLIENT ? "server" : "client");
+        close_connection(loop, conn);
+        return -1;
+      }
+      *sent += bytes;
+      // The sink is full: stop reading the source until EPOLLOUT
+      if (*sent < *len) return 0;
+    }
+    *len = 0;
+    *sent = 0;
+
+    // A filtered response body is read through the buffer, to be scanned
+    int filtered = side == CONN_SIDE_SERVER && conn->response_filter;
+    if (conn->splicing && !filtered && (*pipe_len > 0 || http_body_raw_limit(body) > 0)) {
+      release_buffer(conn, side);
+      int ret = relay_splice(loop, conn, side);
+      if (ret != 1) return ret;
+    }
+
+    // The request waits for its response, which ends the exchange
+    if (body->done) {
+      release_buffer(conn, side);
+      if (side == CONN_SIDE_SERVER) return finish_response(loop, conn);
+      return 0;
+    }
+
+    // Half-close: the request is flushed, the response can still come back
+    if (side == CONN_SIDE_CLIENT && conn->client_eof) {
+      if (!conn->server_shutdown) {
+        INFO("Client %d shut down its side, shutting down the server side\n", src_fd);
+        shutdown(dst_fd, SHUT_WR);
+        conn->server_shutdown = 1;
+        conn->keep_server = 0;
+      }
+      return 0;
+    }
+
+    if (attach_buffer(conn, side) != 0) {
+      close_connection(loop, conn);
+      return -1;
+    }
+    // A body of known length is read exactly, the next bytes belong to the next message
+    size_t room = BUFFER_SIZE;
+    if (body->kind == HTTP_BODY_LENGTH && body->remaining < room) room = body->remaining;
+
+    ssize_t bytes = recv(src_fd, *buffer, room, MSG_DONTWAIT);
+    if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // The queue is empty: the buffer goes back to the pool until the next bytes
+      release_buffer(conn, side);
+      return 0;
+    }
+    if (bytes < 0 && errno == EINTR) continue;
+    if (bytes == 0 && side == CONN_SIDE_CLIENT) {
+      conn->client_eof = 1;
+      continue;
+    }
+    if (bytes <= 0) {
+      INFO("Closing connection on %s (%d), no more bits to read\n", name, src_fd);
+      Log(LOG_LEVEL_INFO, "[SERVER] Closing connection on %s (%d), no more bits to read", name, src_fd);
+      close_connection(loop, conn);
+      return -1;
+    }
+    *len = bytes;
+
+    // Bytes past the end of the message: pipelined requests, or a server breaking its framing
+    size_t consumed = http_body_consume(body, *buffer, bytes);
+    if (body->error) {
+      if (side == CONN_SIDE_CLIENT) relay_until_close(conn);
+      else conn->keep_server = conn->keep_client = 0;
+    } else if (consumed < (size_t)bytes) {
+      if (side == CONN_SIDE_SERVER) {
+        conn->keep_server = 0;
+      } else if (buffer_chain_append(&conn->pipelined, *buffer + consumed, bytes - consumed) != 0) {
+        close_connection(loop, conn);
+        return -1;
+      }
+      *len = consumed;
+    }
+
+    // Part of the response may be sent already, it is cut before the banned word
+    if (side == CONN_SIDE_SERVER && filter_response_body(conn, *buffer, *len)) {
+      close_connection(loop, conn);
+      return -1;
+    }
+  }
+}
+
+/**
+ * @brief Relays both directions of a connection.
+ *
+ * Called on any event of either socket: readable means new bytes for one direction,
+ * writable means room for the queue of the other one.
+ *
+ * @param loop The event loop.
+ * @param conn The connection.
+ */
+static void relay_both(event_loop_t* loop, connection_t* conn) {
+  if (relay(loop, conn, CONN_SIDE_CLIENT) == 0 && conn->state == CONN_STATE_RELAYING) relay(loop, conn, CONN_SIDE_SERVER);
+}
+
+/**
+ * @brief Registers a new client in the loop, its request is read as it arrives.
+ *
+ * @param loop The event loop.
+ * @param client_fd The socket of the new client.
+ * @param client_ip The IP address of the new client.
+ */
+static void open_connection(event_loop_t* loop, int client_fd, const char* client_ip) {
+  connection_t* conn = pool_alloc(&loop->connection_pool);
+  if (conn == NULL) {
+    ERROR("malloc\n");
+    close(client_fd);
+    return;
+  }
+
+  memset(conn, 0, sizeof(connection_t));
+  conn->client_fd = client_fd;
+  conn->server_fd = -1;
+  conn->buffers = &loop->buffer_pool;
+  init_buffer_chain(&conn->request, &loop->buffer_pool);
+  init_buffer_chain(&conn->response, &loop->buffer_pool);
+  init_buffer_chain(&conn->pipelined, &loop->buffer_pool);
+  strcpy(conn->client_ip, client_ip);
+  conn->client_handle.conn = conn;
+  conn->client_handle.side = CONN_SIDE_CLIENT;
+  conn->server_handle.conn = conn;
+  conn->server_handle.side = CONN_SIDE_SERVER;
+  conn->state = CONN_STATE_READING_REQUEST;
+  conn->resolver = loop->dns.fd >= 0 ? &loop->dns : NULL;
+  conn->upstreams = config.upstream_max_idle > 0 ? &loop->upstreams : NULL;
+  conn->verdicts = config.verdict_cache_size > 0 ? &loop->verdicts : NULL;
+  conn->deadline = monotonic_ms() + (long long)current_config()->header_timeout * 1000;
+
+  conn->next = loop->connections;
+  if (loop->connections) loop->connections->prev = conn;
+  loop->connections = conn;
+  loop->nb_connections++;
+
+  // Bytes already received are reported by epoll as soon as the socket is added,
+  // EPOLLOUT resumes the responses queued while the client was not reading
+  if (watch_socket(loop, conn->client_fd, &conn->client_handle, EPOLLOUT) != 0) {
+    ERROR("epoll_ctl on client\n");
+    Log(LOG_LEVEL_ERROR, "[EVENT LOOP] Failed to watch client %d", conn->client_fd);
+    close_connection(loop, conn);
+  }
+}
+
+/**
+ * @brief Watches the socket of a connection whose connect() is in progress.
+ *
+ * @param loop The event loop.
+ * @param conn The connection in CONN_STATE_CONNECTING.
+ */
+static void watch_server(event_loop_t* loop, connection_t* conn) {
+  // The end of the handshake is reported by EPOLLOUT
+  if (watch_socket(loop, conn->server_fd, &conn->server_handle, EPOLLOUT) != 0) {
+    ERROR("epoll_ctl on server\n");
+    Log(LOG_LEVEL_ERROR, "[EVENT LOOP] Failed to watch server %d", conn->server_fd);
+    close_connection(loop, conn);
+    return;
+  }
+  conn->deadline = monotonic_ms() + (long long)current_config()->connect_timeout * 1000;
+  INFO("Connecting to the server, watching client %d and server %d\n", conn->client_fd, conn->server_fd);
+}
+
+/**
+ * @brief Feeds the bytes of a client to its request parser, then starts connecting to the server.
+ *
+ * @param loop The event loop.
+ * @param conn The connection waiting for its request headers.
+ */
+static void read_request(event_loop_t* loop, connection_t* conn) {
+  int ret = handle_connection(conn);
+  if (ret == CONN_PENDING) return;
+
+  if (ret != 0) {
+    WARN("Clossing connections for %d\n", conn->client_fd);
+    Log(LOG_LEVEL_WARN, "[SERVER] Closing connections for %d", conn->client_fd);
+    close_connection(loop, conn);
+    return;
+  }
+
+  // The DNS client retries and fails the query by itself
+  if (conn->state == CONN_STATE_RESOLVING) {
+    conn->deadline = 0;
+    return;
+  }
+  watch_server(loop, conn);
+}
+
+/**
+ * @brief Called by the DNS client of the loop when the host of a connection is resolved.
+ *
+ * @param data The event loop.
+ * @param ctx The connection in CONN_STATE_RESOLVING.
+ * @param host The hostname that was resolved.
+ * @param status 0 if the host was resolved, -1 otherwise.
+ * @param addr The IPv4 address of the host, NULL on failure.
+ * @param ttl The time to live of the answer in seconds.
+ */
+static void dns_resolved(void* data, void* ctx, const char* host, int status, const struct in_addr* addr, uint32_t ttl) {
+  event_loop_t* loop = data;
+  connection_t* conn = ctx;
+
+  if (handle_dns_resolved(conn, host, status, addr, ttl) != 0) {
+    close_connection(loop, conn);
+    return;
+  }
+  watch_server(loop, conn);
+}
+
+/**
+ * @brief Sends the buffered request once the server accepted the connection.
+ *
+ * @param loop The event loop.
+ * @param conn The connection whose server socket became writable.
+ */
+static void server_connected(event_loop_t* loop, connection_t* conn) {
+  int ret = handle_server_connected(conn);
+  if (ret == CONN_RETRY) {
+    retry_server(loop, conn);
+    return;
+  }
+  if (ret != 0) {
+    close_connection(loop, conn);
+    return;
+  }
+  conn->deadline = 0;
+
+  // Bytes sent by the client during the handshake did not trigger a new edge
+  relay_both(loop, conn);
+}
+
+/**
+ * @brief Closes the connections whose deadline has passed.
+ *
+ * Called about once per second, the clients still sending their request headers
+ * after HEADER_TIMEOUT seconds receive a 408 response, and those whose server did not
+ * accept the connection within CONNECT_TIMEOUT seconds receive a 504 response. A persistent
+ * client that did not start another request within HEADER_TIMEOUT seconds is closed silently.
+ *
+ * @param loop The event loop.
+ * @param now The current monotonic time in milliseconds.
+ */
+static void expire_connections(event_loop_t* loop, long long now) {
+  connection_t* conn = loop->connections;
+  while (conn) {
+    connection_t* next = conn->next;
+    if (conn->deadline != 0 && conn->deadline <= now) {
+      if (conn->state == CONN_STATE_READING_REQUEST && conn->request.len == 0 && conn->nb_requests > 0) {
+        INFO("Client %d kept alive without a new request, closing\n", conn->client_fd);
+      } else if (conn->state == CONN_STATE_READING_REQUEST) {
+        WARN("Client %d did not send its request in time\n", conn->client_fd);
+        Log(LOG_LEVEL_WARN, "[SERVER] Client %s (%d) did not send its request in time, closing", conn->client_ip, conn->client_fd);
+        write_on_socket_http_from_buffer(conn->client_fd, HTTP_408_RESPONSE, sizeof(HTTP_408_RESPONSE) - 1);
+      } else if (conn->state == CONN_STATE_CONNECTING) {
+        WARN("Connection to %s timed out\n", conn->server_ip);
+        Log(LOG_LEVEL_WARN, "[SERVER] Connection to %s timed out, sending 504 to %s", conn->server_ip, conn->client_ip);
+        write_on_socket_http_from_buffer(conn->client_fd, HTTP_504_RESPONSE, sizeof(HTTP_504_RESPONSE) - 1);
+      }
+      close_connection(loop, conn);
+    }
+    conn = next;
+  }
+}
+
+/**
+ * @brief Accepts every pending client on the listening socket.
+ *
+ * The listener is edge-triggered, so the backlog is drained until accept() reports EAGAIN.
+ * If the loop is full, accepting is paused until a connection is closed.
+ *
+ * @param loop The event loop.
+ */
+static void accept_clients(event_loop_t* loop) {
+  struct sockaddr_in client_addr;
+  char client_ip[INET_ADDRSTRLEN];
+
+  loop->accept_paused = 0;
+  while (1) {
+    if (loop->nb_connections >= loop->max_connections) {
+      INFO("Maximum number of clients reached, pausing accept.\n");
+      loop->accept_paused = 1;
+      return;
+    }
+
+    int new_client_fd = accept_connection(loop->listen_fd, &client_addr, client_ip, loop->max_connections, loop->nb_connections);
+    if (new_client_fd < 0) return;
+
+    Log(LOG_LEVEL_INFO, "[SERVER] New client connected on socket %d", new_client_fd);
+    open_connection(loop, new_client_fd, client_ip);
+  }
+}
+
+/**
+ * @brief Runs the event loop until the running flag is cleared.
+ *
+ * @param loop The event loop.
+ * @param running Flag checked after each wakeup, cleared by the signal handler.
+ *
+ * @return 0 when the loop stopped because of the flag, -1 on error.
+ */
+int run_event_loop(event_loop_t* loop, volatile int* running) {
+  struct epoll_event events[EVENT_LOOP_MAX_EVENTS];
+  int ret = 0;
+
+  long long next_expiry = monotonic_ms() + EVENT_LOOP_TICK_MS;
+
+  while (*running) {
+    // Only wake up periodically when some connection may time out
+    int timeout = loop->nb_connections > 0 || loop->upstreams.nb_idle > 0 ? EVENT_LOOP_TICK_MS : -1;
+    int activity = epoll_wait(loop->epoll_fd, events, EVENT_LOOP_MAX_EVENTS, timeout);
+    INFO("Activity: %d\n", activity);
+    if (activity < 0) {
+      if (errno == EINTR) continue;
+      ERROR("epoll_wait\n");
+      Log(LOG_LEVEL_ERROR, "[EVENT LOOP] epoll_wait failed");
+      ret = -1;
+      break;
+    }
+
+    // The snapshots loaded while handling the batch stay valid until it is over
+    epoch_enter(loop->epoch_reader);
+    for (int i = 0; i < activity; i++) {
+      conn_handle_t* handle = events[i].data.ptr;
+      if (handle == &loop->listen_handle) {
+        accept_clients(loop);
+        continue;
+      }
+      if (handle == &loop->wake_handle) {
+        uint64_t count;
+        while (read(loop->wake_fd, &count, sizeof(count)) > 0);
+        continue;
+      }
+      if (handle == &loop->dns_handle) {
+        dns_client_read(&loop->dns);
+        continue;
+      }
+
+      connection_t* conn = handle->conn;
+      if (conn->closed) continue;
+
+      // Only hang-ups of the client matter while its host is resolved
+      if (conn->state == CONN_STATE_RESOLVING) {
+        if (events[i].events & (EPOLLERR | EPOLLHUP)) close_connection(loop, conn);
+        continue;
+      }
+
+      // Writable or in error: the handshake is over, SO_ERROR tells how it went
+      if (conn->state == CONN_STATE_CONNECTING) {
+        if (handle->side == CONN_SIDE_SERVER && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+          server_connected(loop, conn);
+        } else if (handle->side == CONN_SIDE_CLIENT && (events[i].events & (EPOLLERR | EPOLLHUP))) {
+          close_connection(loop, conn);
+        }
+        continue;
+      }
+
+      // A reused server connection in error may only have been closed, the relay retries the request
+      if ((events[i].events & EPOLLERR) && !(handle->side == CONN_SIDE_SERVER && conn->retryable)) {
+        int fd = handle->side == CONN_SIDE_CLIENT ? conn->client_fd : conn->server_fd;
+        ERROR("Error (EPOLLERR) on socket %d, closing the connection\n", fd);
+        Log(LOG_LEVEL_ERROR, "[SERVER] Error (EPOLLERR) on socket %d, closing the connection", fd);
+        close_connection(loop, conn);
+        continue;
+      }
+
+      // EOF and hang-ups are detected by the read returning 0
+      if (conn->state == CONN_STATE_READING_REQUEST) {
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) read_request(loop, conn);
+      } else {
+        relay_both(loop, conn);
+      }
+    }
+
+    long long now = monotonic_ms();
+    if (now >= next_expiry) {
+      if (loop->dns.fd >= 0) dns_client_expire(&loop->dns, now);
+      expire_connections(loop, now);
+      upstream_pool_expire(&loop->upstreams, now);
+      next_expiry = now + EVENT_LOOP_TICK_MS;
+    }
+
+    release_closed_connections(loop);
+    if (loop->accept_paused && loop->nb_connections < loop->max_connections) {
+      accept_clients(loop);
+    }
+    epoch_exit(loop->epoch_reader);
+  }
+
+  INFO("Exiting main loop\n");
+  return ret;
+}
+
+/**
+ * @brief Closes every connection of the loop and releases its resources.
+ *
+ * The listening socket is not closed, it belongs to the caller.
+ *
+ * @param loop The event loop.
+ */
+void free_event_loop(event_loop_t* loop) {
+  while (loop->connections) {
+    close_connection(loop, loop->connections);
+  }
+  release_closed_connections(loop);
+  free_pool(&loop->connection_pool);
+  free_buffer_pool(&loop->buffer_pool);
+  free_upstream_pool(&loop->upstreams);
+  free_verdict_cache(&loop->verdicts);
+  free_dns_client(&loop->dns);
+  if (loop->wake_fd >= 0) close(loop->wake_fd);
+  if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+  epoch_unregister(loop->epoch_reader);
+  loop->wake_fd = -1;
+  loop->epoll_fd = -1;
+  loop->epoch_reader = -1;
+  INFO("Free of connections OK\n");
+}
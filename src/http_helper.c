@@ -20,6 +20,8 @@
  * handling and validating HTTP requests.
  */
 
+#define _GNU_SOURCE
+
 #include <string.h>
 
 #include "../includes/utils.h"
@@ -55,6 +57,39 @@ int is_http_method(const char* buffer) {
   return 0;
 }
 
+/**
+ * @brief Checks if a method parsed from a request line is a known HTTP method.
+ *
+ * @param method The method, not null-terminated.
+ * @param len The length of the method.
+ * @return 1 if the method is known, 0 otherwise.
+ */
+int is_http_method_name(const char* method, size_t len) {
+  for(size_t i = 0; i < sizeof(http_methods) / sizeof(http_methods[0]); i++) {
+    if (strlen(http_methods[i]) == len && strncmp(method, http_methods[i], len) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Checks if a method is idempotent, a request with it can be sent again safely.
+ *
+ * @param method The method, not null-terminated.
+ * @param len The length of the method.
+ * @return 1 if the method is idempotent, 0 otherwise.
+ */
+int is_idempotent_method(const char* method, size_t len) {
+  static const char* const idempotent_methods[] = { "GET", "HEAD", "PUT", "DELETE", "OPTIONS", "TRACE" };
+  for(size_t i = 0; i < sizeof(idempotent_methods) / sizeof(idempotent_methods[0]); i++) {
+    if (strlen(idempotent_methods[i]) == len && strncmp(method, idempotent_methods[i], len) == 0) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 /**
  * @brief Checks if an HTTP request is complete.
  *
@@ -69,25 +104,33 @@ int is_http_request_complete(const char* buffer) {
     
     if (strstr(buffer, "\r\n\r\n") == NULL) return 0;
     
+    return is_http_request_line(buffer) && strstr(buffer, "Host: ") != NULL;
+}
+
+/**
+ * @brief Checks if a buffer starts with a valid HTTP/1.1 request line.
+ *
+ * The line must be complete: a known method, a space, the target and "HTTP/1.1" before the
+ * first "\r\n". The target may be as long as the buffer allows.
+ *
+ * @param buffer The buffer containing the start of the HTTP request.
+ * @return 1 if the request line is valid, 0 otherwise.
+ */
+int is_http_request_line(const char* buffer) {
+    if (!buffer) return 0;
+
     const char* first_line_end = strstr(buffer, "\r\n");
     if (!first_line_end) return 0;
-    
-    size_t first_line_length = first_line_end - buffer;
-    if (first_line_length >= 256) return 0;
-    
-    char first_line[256];
-    strncpy(first_line, buffer, first_line_length);
-    first_line[first_line_length] = '\0';
+
     for (size_t i = 0; i < sizeof(http_methods) / sizeof(http_methods[0]); i++) {
         size_t method_len = strlen(http_methods[i]);
-        if (strncmp(first_line, http_methods[i], method_len) == 0) {
-            const char* path_start = first_line + method_len;
-            if (*path_start == ' ') {
-                const char* version_start = strstr(path_start + 1, "HTTP/1.1");
-                if (version_start && strcmp(version_start, "HTTP/1.1") == 0) {
-                    if (strstr(buffer, "Host: ") != NULL) {
-                        return 1;
-                    }
+        if (strncmp(buffer, http_methods[i], method_len) == 0) {
+            const char* path_start = buffer + method_len;
+            if (*path_start == ' ' && path_start + 1 < first_line_end) {
+                // The first "HTTP/1.1" of the line must end it
+                const char* version_start = memmem(path_start + 1, first_line_end - path_start - 1, "HTTP/1.1", 8);
+                if (version_start && version_start + 8 == first_line_end) {
+                    return 1;
                 }
             }
         }
@@ -0,0 +1,729 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file http_message.c
+ * @brief Implementation of the framing of HTTP/1.1 messages.
+ */
+
+#define _GNU_SOURCE
+
+#include "../includes/http_message.h"
+#include "../includes/http_scan.h"
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/**
+ * @brief Finds a delimiter with the vector kernels, as memchr() would.
+ */
+static const char* find_byte(const char* p, const char* end, char c) {
+  size_t index = http_scan_byte(p, end - p, c);
+  return p + index < end ? p + index : NULL;
+}
+
+/**
+ * @brief Resets a scanner for a new message.
+ *
+ * @param scanner The scanner to reset.
+ */
+void init_http_head_scanner(http_head_scanner_t* scanner) {
+  scanner->scanned = 0;
+  scanner->matched = 0;
+}
+
+/**
+ * @brief Looks for the empty line ending the head of a message in the bytes not scanned yet.
+ *
+ * The scanner keeps its offset in the message and how much of "\r\n\r\n" the last bytes
+ * matched, so each byte of the head is examined once however many reads it took to arrive.
+ * The offset is logical: it stays valid when buffer_chain_reserve() moves a partial line to
+ * a new segment.
+ *
+ * @param scanner The scanner of the message, reset with init_http_head_scanner().
+ * @param chain The chain holding the message.
+ * @param head_len Receives the length of the head, empty line included.
+ *
+ * @return 1 if the head is complete, 0 otherwise.
+ */
+int http_head_scan(http_head_scanner_t* scanner, const buffer_chain_t* chain, size_t* head_len) {
+  static const char delimiter[] = "\r\n\r\n";
+  size_t offset = 0;
+
+  if (scanner->matched == 4) {
+    *head_len = scanner->scanned;
+    return 1;
+  }
+
+  for (const buffer_segment_t* segment = chain->head; segment; segment = segment->next) {
+    if (offset + segment->len <= scanner->scanned) {
+      offset += segment->len;
+      continue;
+    }
+
+    const char* p = segment->data + (scanner->scanned - offset);
+    const char* end = segment->data + segment->len;
+    while (p < end) {
+      // Outside of a line ending, the next carriage return is the only candidate
+      if (scanner->matched == 0) {
+        p = find_byte(p, end, '\r');
+        if (!p) {
+          p = end;
+          break;
+        }
+      }
+
+      if (*p == delimiter[scanner->matched]) {
+        scanner->matched++;
+      } else {
+        scanner->matched = *p == '\r' ? 1 : 0;
+      }
+      p++;
+
+      if (scanner->matched == 4) {
+        scanner->scanned = offset + (p - segment->data);
+        *head_len = scanner->scanned;
+        return 1;
+      }
+    }
+    scanner->scanned = offset + segment->len;
+    offset += segment->len;
+  }
+  return 0;
+}
+
+/**
+ * @brief Finds the empty line ending the head of a message.
+ *
+ * Scans the whole chain, a message read in several steps is better followed with
+ * http_head_scan().
+ *
+ * @param chain The chain holding the message.
+ * @param head_len Receives the length of the head, empty line included.
+ *
+ * @return 1 if the head is complete, 0 otherwise.
+ */
+int find_http_head_end(const buffer_chain_t* chain, size_t* head_len) {
+  http_head_scanner_t scanner;
+  init_http_head_scanner(&scanner);
+  return http_head_scan(&scanner, chain, head_len);
+}
+
+/**
+ * @brief Checks if a slice holds a string, ignoring case.
+ */
+static int slice_is(const http_slice_t* slice, const char* str) {
+  size_t len = strlen(str);
+  return slice->len == len && strncasecmp(slice->data, str, len) == 0;
+}
+
+/**
+ * @brief Checks if a comma separated list contains a token, ignoring case.
+ *
+ * @param last Only compares the last token when set.
+ */
+static int list_has(const char* value, size_t len, const char* token, size_t token_len, int last) {
+  const char* end = value + len;
+  int found = 0;
+
+  while (value < end) {
+    const char* comma = memchr(value, ',', end - value);
+    const char* item_end = comma ? comma : end;
+    while (value < item_end && (*value == ' ' || *value == '\t')) value++;
+    const char* trimmed = item_end;
+    while (trimmed > value && (trimmed[-1] == ' ' || trimmed[-1] == '\t')) trimmed--;
+
+    found = (size_t)(trimmed - value) == token_len && strncasecmp(value, token, token_len) == 0;
+    if (found && !last) return 1;
+    value = comma ? comma + 1 : end;
+  }
+  return found;
+}
+
+/**
+ * @brief Checks if a comma separated list contains a string token, ignoring case.
+ */
+static int list_has_token(const char* value, size_t len, const char* token, int last) {
+  return list_has(value, len, token, strlen(token), last);
+}
+
+/**
+ * @brief Checks if a slice is "HTTP/1.x" and returns the minor version.
+ */
+static int parse_version(const http_slice_t* version) {
+  if (version->len != 8 || strncmp(version->data, "HTTP/1.", 7) != 0 || !isdigit((unsigned char)version->data[7])) return -1;
+  return version->data[7] - '0';
+}
+
+/**
+ * @brief Splits the start line of a message into its three parts.
+ */
+static void parse_start_line(const char* line, size_t len, int response, http_head_t* head) {
+  const char* end = line + len;
+  const char* first = find_byte(line, end, ' ');
+  const char* second = first ? find_byte(first + 1, end, ' ') : NULL;
+  if (!first || first == line) {
+    head->invalid = 1;
+    return;
+  }
+
+  if (response) {
+    // HTTP/1.x SSS reason, the reason may be empty or hold spaces
+    head->version = (http_slice_t){ line, first - line };
+    const char* status = first + 1;
+    if (end - status < 3 || (end - status > 3 && status[3] != ' ') || !isdigit((unsigned char)status[0]) ||
+        !isdigit((unsigned char)status[1]) || !isdigit((unsigned char)status[2])) {
+      head->invalid = 1;
+      return;
+    }
+    head->status = (status[0] - '0') * 100 + (status[1] - '0') * 10 + (status[2] - '0');
+  } else {
+    // METHOD target HTTP/1.x, the target holds no space
+    if (!second || second == first + 1 || find_byte(second + 1, end, ' ')) {
+      head->invalid = 1;
+      return;
+    }
+    head->method = (http_slice_t){ line, first - line };
+    head->target = (http_slice_t){ first + 1, second - first - 1 };
+    head->version = (http_slice_t){ second + 1, end - second - 1 };
+    head->head_method = slice_is(&head->method, "HEAD");
+  }
+
+  head->minor_version = parse_version(&head->version);
+  if (head->minor_version < 0) head->invalid = 1;
+}
+
+/**
+ * @brief Indexes a header line, and reads it if it tells the framing of the message.
+ *
+ * The name must be followed by the colon without white space, which would let two parsers
+ * disagree on the header. Folded lines are refused for the same reason. One scan finds the
+ * colon and checks that no white space comes before it.
+ */
+static void parse_header_line(const char* line, size_t len, int response, http_head_t* head) {
+  const char* colon = line + http_scan_any(line, len, ": \t");
+  if (colon == line + len || *colon != ':' || colon == line) {
+    head->invalid = 1;
+    return;
+  }
+
+  const char* value = colon + 1;
+  const char* end = line + len;
+  while (value < end && (*value == ' ' || *value == '\t')) value++;
+  while (end > value && (end[-1] == ' ' || end[-1] == '\t')) end--;
+
+  http_header_t header = { { line, colon - line }, { value, end - value } };
+  if (head->nb_headers < HTTP_MAX_HEADERS) {
+    head->headers[head->nb_headers++] = header;
+  } else if (!response) {
+    // Later stages look the request headers up in the index, it must hold them all
+    head->invalid = 1;
+  }
+  size_t value_len = header.value.len;
+
+  if (slice_is(&header.name, "Content-Length")) {
+    long long length = 0;
+    if (value_len == 0 || value_len > 18) head->invalid = 1;
+    for (size_t i = 0; i < value_len && !head->invalid; i++) {
+      if (!isdigit((unsigned char)value[i])) head->invalid = 1;
+      length = length * 10 + (value[i] - '0');
+    }
+    // Several lengths must agree, otherwise the end of the body is ambiguous
+    if (head->content_length >= 0 && head->content_length != length) head->invalid = 1;
+    if (!head->invalid) head->content_length = length;
+  } else if (slice_is(&header.name, "Transfer-Encoding")) {
+    head->transfer_encoding = 1;
+    head->chunked = list_has_token(value, value_len, "chunked", 1);
+  } else if (slice_is(&header.name, "Connection")) {
+    if (list_has_token(value, value_len, "close", 0)) head->connection_close = 1;
+    if (list_has_token(value, value_len, "keep-alive", 0)) head->connection_keep_alive = 1;
+  } else if (!response && slice_is(&header.name, "Host")) {
+    // Two hosts would let the filter and the server see different ones
+    if (head->host.data) head->invalid = 1;
+    head->host = header.value;
+  }
+}
+
+/**
+ * @brief Checks the part of a header line longer than a segment found in its first segment.
+ *
+ * Such a line is left out of the index, so it must not tell anything about the framing,
+ * the host or the connection: the server would read it while the proxy did not. Its name
+ * is checked like the one of an indexed line, and the line makes the head invalid if it is
+ * one of these headers.
+ */
+static void check_long_header_line(const char* line, size_t len, int response, http_head_t* head) {
+  const char* colon = line + http_scan_any(line, len, ": \t");
+  if (colon == line + len || *colon != ':' || colon == line) {
+    head->invalid = 1;
+    return;
+  }
+
+  http_slice_t name = { line, colon - line };
+  if (slice_is(&name, "Content-Length") || slice_is(&name, "Transfer-Encoding") || slice_is(&name, "Connection") ||
+      (!response && slice_is(&name, "Host"))) {
+    head->invalid = 1;
+  }
+}
+
+/**
+ * @brief Copies and parses a request line longer than a segment.
+ *
+ * Such a line fills the first segment and ends in a later one. It is gathered in a copy,
+ * which its slices point into, and parsing goes on in the segment holding its line feed.
+ *
+ * @return 0 on success, -1 if the line does not end or could not be copied.
+ */
+static int parse_long_start_line(http_head_t* head, const buffer_segment_t** segment, const char** line) {
+  const buffer_segment_t* last = *segment;
+  const char* line_end = NULL;
+  size_t len = 0;
+  for (; last; last = last->next) {
+    line_end = find_byte(last->data, last->data + last->len, '\n');
+    if (line_end) break;
+    len += last->len;
+  }
+  if (!line_end) return -1;
+  len += line_end + 1 - last->data;
+
+  char* copy = malloc(len);
+  if (!copy) return -1;
+  size_t offset = 0;
+  for (const buffer_segment_t* s = *segment; s != last; s = s->next) {
+    memcpy(copy + offset, s->data, s->len);
+    offset += s->len;
+  }
+  memcpy(copy + offset, last->data, line_end + 1 - last->data);
+  head->start_line = copy;
+  head->start_line_len = len;
+
+  len--;
+  if (len > 0 && copy[len - 1] == '\r') len--;
+  else head->invalid = 1;
+  parse_start_line(copy, len, 0, head);
+  *segment = last;
+  *line = line_end + 1;
+  return 0;
+}
+
+/**
+ * @brief Parses the head of a message held by a chain, in a single pass.
+ *
+ * The start line is split into its parts and each header line is indexed as a name and a
+ * value, both slices pointing into the segments of the chain: nothing is copied, so the
+ * index is valid as long as the head is neither modified nor sent. The framing headers
+ * are read on the way.
+ *
+ * The chain must have been filled keeping its lines in single segments: a segment which
+ * does not follow a line end continues a line longer than a segment, such lines are skipped
+ * and left out of the index. A skipped line naming a framing header, the connection or the
+ * host makes the head invalid, it would otherwise reach the server unseen. A request line
+ * longer than a segment, such as a long redirect URL, is the exception: it is copied so that
+ * its slices are contiguous, and the copy must be freed with free_http_head(). The status
+ * line of a response must fit in a segment.
+ *
+ * The lines of a request must end with "\r\n": a bare line feed would end the head before
+ * the empty line http_head_scan() looks for, and the bytes between would reach the server
+ * without being filtered. The lines of a response may end with a bare line feed.
+ *
+ * @param chain The chain holding the message, its head must be complete.
+ * @param response Set to parse the head of a response, otherwise of a request.
+ * @param head Receives the index of the head and what it tells about the framing of the message.
+ *
+ * @return 0 on success, or -1 if the head is invalid.
+ */
+int parse_http_head(const buffer_chain_t* chain, int response, http_head_t* head) {
+  memset(head, 0, sizeof(http_head_t));
+  head->content_length = -1;
+
+  int first = 1;
+  const buffer_segment_t* segment = chain->head;
+  const char* line = NULL;
+  if (!response && segment && segment->next && !find_byte(segment->data, segment->data + segment->len, '\n')) {
+    if (parse_long_start_line(head, &segment, &line) != 0) return -1;
+    first = 0;
+  }
+
+  const buffer_segment_t* previous = NULL;
+  for (; segment; segment = segment->next) {
+    const char* end = segment->data + segment->len;
+
+    if (!line) {
+      line = segment->data;
+      if (previous && previous->len > 0 && previous->data[previous->len - 1] != '\n') {
+        const char* line_end = find_byte(line, end, '\n');
+        line = line_end ? line_end + 1 : end;
+      }
+    }
+
+    while (line < end) {
+      const char* line_end = find_byte(line, end, '\n');
+      if (!line_end) break;
+
+      size_t len = line_end - line;
+      if (len > 0 && line[len - 1] == '\r') len--;
+      else if (!response) head->invalid = 1;
+      if (len == 0) {
+        head->end = line;
+        return head->invalid || first ? -1 : 0;
+      }
+
+      if (first) parse_start_line(line, len, response, head);
+      else parse_header_line(line, len, response, head);
+      first = 0;
+      line = line_end + 1;
+    }
+
+    // The status line must fit in the first segment
+    if (first) return -1;
+    if (line < end && segment->next) check_long_header_line(line, end - line, response, head);
+    previous = segment;
+    line = NULL;
+  }
+  return -1;
+}
+
+/**
+ * @brief Frees the copy of a long request line held by a head.
+ *
+ * @param head The head parsed by parse_http_head().
+ */
+void free_http_head(http_head_t* head) {
+  free(head->start_line);
+  head->start_line = NULL;
+  head->start_line_len = 0;
+}
+
+/**
+ * @brief Looks a header up in the index of a head, ignoring the case of its name.
+ *
+ * @param head The head parsed by parse_http_head().
+ * @param name The name of the header.
+ *
+ * @return The first header with this name, or NULL if there is none.
+ */
+const http_header_t* http_head_find(const http_head_t* head, const char* name) {
+  for (int i = 0; i < head->nb_headers; i++) {
+    if (slice_is(&head->headers[i].name, name)) return &head->headers[i];
+  }
+  return NULL;
+}
+
+/**
+ * @brief Tells if a header only concerns the connection it was received on.
+ *
+ * Connection, Proxy-Connection and Keep-Alive are hop-by-hop, as is every header named in
+ * a Connection header: a proxy must not forward them to the next hop.
+ *
+ * @param head The head parsed by parse_http_head().
+ * @param header A header of this head.
+ *
+ * @return 1 if the header is hop-by-hop, 0 if it is meant for the other end.
+ */
+int http_header_hop_by_hop(const http_head_t* head, const http_header_t* header) {
+  if (slice_is(&header->name, "Connection") || slice_is(&header->name, "Proxy-Connection") || slice_is(&header->name, "Keep-Alive")) {
+    return 1;
+  }
+  for (int i = 0; i < head->nb_headers; i++) {
+    const http_header_t* connection = &head->headers[i];
+    if (slice_is(&connection->name, "Connection") && list_has(connection->value.data, connection->value.len, header->name.data, header->name.len, 0)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief Finds the origin-form of the target of a request.
+ *
+ * A proxy receives targets in absolute form, "http://authority/path?query", which the
+ * server expects in origin form, "/path?query": the scheme and the authority are dropped,
+ * and the path is "/" when the target has none.
+ *
+ * @param target The target of the request.
+ * @param prefix_len Receives the number of bytes to drop from the start of the target.
+ *
+ * @return 1 if the target is in absolute form, 0 if it must be sent as is.
+ */
+int http_target_origin_form(const http_slice_t* target, size_t* prefix_len) {
+  if (target->len < 7 || strncasecmp(target->data, "http://", 7) != 0) return 0;
+
+  const char* authority = target->data + 7;
+  *prefix_len = 7 + http_scan_any(authority, target->len - 7, "/?");
+  return 1;
+}
+
+/**
+ * @brief Tells if the connection that carried a message can carry the next one.
+ *
+ * @param head The head of the message.
+ *
+ * @return 1 if the connection is persistent, 0 otherwise.
+ */
+int http_head_keep_alive(const http_head_t* head) {
+  if (head->invalid || head->connection_close) return 0;
+  return head->minor_version >= 1 || head->connection_keep_alive;
+}
+
+/**
+ * @brief Starts following a body.
+ *
+ * @param body The body.
+ * @param kind How the body is delimited.
+ * @param length The length of the body, for HTTP_BODY_LENGTH.
+ */
+void init_http_body(http_body_t* body, http_body_kind_t kind, unsigned long long length) {
+  memset(body, 0, sizeof(http_body_t));
+  body->kind = kind;
+  body->chunk_state = CHUNK_SIZE;
+  if (kind == HTTP_BODY_LENGTH) body->remaining = length;
+  body->done = kind == HTTP_BODY_NONE || (kind == HTTP_BODY_LENGTH && length == 0);
+}
+
+/**
+ * @brief Starts following the body of a request.
+ *
+ * A request has a body only when it says so, a Transfer-Encoding other than chunked or
+ * together with a Content-Length is refused, as its end could be read differently by the server.
+ *
+ * @param body The body.
+ * @param request The head of the request.
+ *
+ * @return 0 on success, or -1 if the framing of the request is invalid.
+ */
+int init_request_body(http_body_t* body, const http_head_t* request) {
+  init_http_body(body, HTTP_BODY_NONE, 0);
+  if (request->invalid) return -1;
+
+  if (request->transfer_encoding) {
+    if (!request->chunked || request->content_length >= 0) return -1;
+    init_http_body(body, HTTP_BODY_CHUNKED, 0);
+  } else if (request->content_length >= 0) {
+    init_http_body(body, HTTP_BODY_LENGTH, request->content_length);
+  }
+  return 0;
+}
+
+/**
+ * @brief Starts following the body of a response.
+ *
+ * @param body The body.
+ * @param response The head of the response.
+ * @param head_request Set when the response answers a HEAD request.
+ */
+void init_response_body(http_body_t* body, const http_head_t* response, int head_request) {
+  if (head_request || (response->status >= 100 && response->status < 200) || response->status == 204 || response->status == 304) {
+    init_http_body(body, HTTP_BODY_NONE, 0);
+  } else if (response->transfer_encoding) {
+    init_http_body(body, response->chunked ? HTTP_BODY_CHUNKED : HTTP_BODY_UNTIL_CLOSE, 0);
+  } else if (response->content_length >= 0) {
+    init_http_body(body, HTTP_BODY_LENGTH, response->content_length);
+  } else {
+    init_http_body(body, HTTP_BODY_UNTIL_CLOSE, 0);
+  }
+}
+
+/**
+ * @brief Gives up following a malformed chunked body, it is relayed until the connection closes.
+ */
+static void chunked_error(http_body_t* body) {
+  body->error = 1;
+  body->kind = HTTP_BODY_UNTIL_CLOSE;
+}
+
+/**
+ * @brief Moves to the data of a chunk, or to the trailer after the last chunk.
+ */
+static void end_chunk_size(http_body_t* body) {
+  body->digits = 0;
+  if (body->remaining == 0) {
+    body->chunk_state = CHUNK_TRAILER;
+    body->line_len = 0;
+  } else {
+    body->chunk_state = CHUNK_DATA;
+  }
+}
+
+/**
+ * @brief Follows the bytes of a chunked body.
+ *
+ * @return The number of bytes belonging to the body.
+ */
+static size_t consume_chunked(http_body_t* body, const char* data, size_t len) {
+  size_t i = 0;
+  while (i < len && !body->done) {
+    if (body->chunk_state == CHUNK_DATA) {
+      size_t n = body->remaining < len - i ? body->remaining : len - i;
+      http_body_skip(body, n);
+      i += n;
+      continue;
+    }
+
+    char c = data[i++];
+    switch (body->chunk_state) {
+      case CHUNK_SIZE:
+        if (isxdigit((unsigned char)c)) {
+          if (++body->digits > 15) {
+            chunked_error(body);
+            return len;
+          }
+          body->remaining = body->remaining * 16 + (isdigit((unsigned char)c) ? c - '0' : (tolower((unsigned char)c) - 'a' + 10));
+        } else if (body->digits == 0) {
+          chunked_error(body);
+          return len;
+        } else if (c == ';' || c == ' ' || c == '\t') {
+          body->chunk_state = CHUNK_EXTENSION;
+        } else if (c == '\r') {
+          body->chunk_state = CHUNK_SIZE_LF;
+        } else if (c == '\n') {
+          end_chunk_size(body);
+        } else {
+          chunked_error(body);
+          return len;
+        }
+        break;
+      case CHUNK_EXTENSION:
+        if (c == '\r') body->chunk_state = CHUNK_SIZE_LF;
+        else if (c == '\n') end_chunk_size(body);
+        break;
+      case CHUNK_SIZE_LF:
+        if (c != '\n') {
+          chunked_error(body);
+          return len;
+        }
+        end_chunk_size(body);
+        break;
+      case CHUNK_DATA_CR:
+        if (c == '\r') {
+          body->chunk_state = CHUNK_DATA_LF;
+        } else if (c == '\n') {
+          body->chunk_state = CHUNK_SIZE;
+        } else {
+          chunked_error(body);
+          return len;
+        }
+        break;
+      case CHUNK_DATA_LF:
+        if (c != '\n') {
+          chunked_error(body);
+          return len;
+        }
+        body->chunk_state = CHUNK_SIZE;
+        break;
+      case CHUNK_TRAILER:
+        // The trailer ends with an empty line
+        if (c == '\n') {
+          if (body->line_len == 0) body->done = 1;
+          body->line_len = 0;
+        } else if (c != '\r') {
+          body->line_len++;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return i;
+}
+
+/**
+ * @brief Follows bytes of a body as they are relayed.
+ *
+ * @param body The body.
+ * @param data The bytes read after the previous ones.
+ * @param len The number of bytes.
+ *
+ * @return The number of bytes belonging to the body, less than len if the body ended before.
+ */
+size_t http_body_consume(http_body_t* body, const char* data, size_t len) {
+  if (body->done) return 0;
+
+  switch (body->kind) {
+    case HTTP_BODY_UNTIL_CLOSE:
+      return len;
+    case HTTP_BODY_LENGTH: {
+      size_t n = body->remaining < len ? body->remaining : len;
+      http_body_skip(body, n);
+      return n;
+    }
+    case HTTP_BODY_CHUNKED:
+      return consume_chunked(body, data, len);
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief Follows the bytes of a body held by a chain, after its head.
+ *
+ * @param body The body.
+ * @param chain The chain holding the message.
+ * @param offset The number of bytes of the chain before the body.
+ *
+ * @return The number of bytes belonging to the body.
+ */
+size_t http_body_consume_chain(http_body_t* body, const buffer_chain_t* chain, size_t offset) {
+  size_t consumed = 0;
+  for (const buffer_segment_t* segment = chain->head; segment; segment = segment->next) {
+    if (offset >= segment->len) {
+      offset -= segment->len;
+      continue;
+    }
+    size_t start = offset;
+    offset = 0;
+
+    size_t available = segment->len - start;
+    size_t n = http_body_consume(body, segment->data + start, available);
+    consumed += n;
+    if (n < available) break;
+  }
+  return consumed;
+}
+
+/**
+ * @brief Returns how many bytes of a body can be relayed without being looked at.
+ *
+ * The whole rest of a body of known length, the data of the current chunk, or anything
+ * until close. Sizes and trailers of chunks must be read with http_body_consume().
+ *
+ * @param body The body.
+ *
+ * @return The number of bytes, 0 when the next ones must be parsed or the body is over.
+ */
+size_t http_body_raw_limit(const http_body_t* body) {
+  if (body->done) return 0;
+  if (body->kind == HTTP_BODY_UNTIL_CLOSE) return SIZE_MAX;
+  if (body->kind == HTTP_BODY_LENGTH || (body->kind == HTTP_BODY_CHUNKED && body->chunk_state == CHUNK_DATA)) {
+    return body->remaining < SIZE_MAX ? (size_t)body->remaining : SIZE_MAX;
+  }
+  return 0;
+}
+
+/**
+ * @brief Accounts for bytes of a body relayed without being looked at.
+ *
+ * @param body The body.
+ * @param len The number of bytes, at most http_body_raw_limit().
+ */
+void http_body_skip(http_body_t* body, size_t len) {
+  if (body->kind == HTTP_BODY_UNTIL_CLOSE || len == 0) return;
+
+  body->remaining -= len;
+  if (body->remaining > 0) return;
+  if (body->kind == HTTP_BODY_LENGTH) body->done = 1;
+  else body->chunk_state = CHUNK_DATA_CR;
+}
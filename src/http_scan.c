@@ -0,0 +1,216 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file http_scan.c
+ * @brief Implementation of the delimiter scanning kernels of the HTTP parser.
+ *
+ * The vector kernels load unaligned blocks, compare every byte with the delimiters and turn
+ * the result into a bit mask whose lowest set bit is the first match. They never read past
+ * the end of the data: the last bytes, fewer than a block, go through the narrower kernel
+ * and finally the scalar loop. The AVX2 kernels are compiled for that target only, so the
+ * binary still runs on CPUs without it.
+ */
+
+#include "../includes/http_scan.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HTTP_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Kernel returning the index of the first delimiter, or len if there is none.
+ */
+typedef size_t (*scan_byte_fn)(const char* data, size_t len, char c);
+typedef size_t (*scan_any_fn)(const char* data, size_t len, const char* set, size_t nb);
+
+static inline __attribute__((always_inline)) size_t scan_byte_scalar(const char* data, size_t len, char c) {
+  for (size_t i = 0; i < len; i++) {
+    if (data[i] == c) return i;
+  }
+  return len;
+}
+
+static inline __attribute__((always_inline)) size_t scan_any_scalar(const char* data, size_t len, const char* set, size_t nb) {
+  for (size_t i = 0; i < len; i++) {
+    for (size_t j = 0; j < nb; j++) {
+      if (data[i] == set[j]) return i;
+    }
+  }
+  return len;
+}
+
+#ifdef HTTP_SCAN_X86
+// The narrower kernels are inlined in the wider ones, which finish the last bytes with them:
+// compiled for AVX2 they keep the VEX encoding and avoid the SSE/AVX transition penalty
+static inline __attribute__((always_inline)) size_t scan_byte_sse2(const char* data, size_t len, char c) {
+  const __m128i needle = _mm_set1_epi8(c);
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  return i + scan_byte_scalar(data + i, len - i, c);
+}
+
+static inline __attribute__((always_inline)) size_t scan_any_sse2(const char* data, size_t len, const char* set, size_t nb) {
+  __m128i needles[HTTP_SCAN_MAX_SET];
+  for (size_t j = 0; j < nb; j++) needles[j] = _mm_set1_epi8(set[j]);
+
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+    __m128i hits = _mm_cmpeq_epi8(block, needles[0]);
+    for (size_t j = 1; j < nb; j++) hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[j]));
+    int mask = _mm_movemask_epi8(hits);
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  return i + scan_any_scalar(data + i, len - i, set, nb);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_byte_avx2(const char* data, size_t len, char c) {
+  const __m256i needle = _mm256_set1_epi8(c);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  return i + scan_byte_sse2(data + i, len - i, c);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_any_avx2(const char* data, size_t len, const char* set, size_t nb) {
+  __m256i needles[HTTP_SCAN_MAX_SET];
+  for (size_t j = 0; j < nb; j++) needles[j] = _mm256_set1_epi8(set[j]);
+
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+    __m256i hits = _mm256_cmpeq_epi8(block, needles[0]);
+    for (size_t j = 1; j < nb; j++) hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(block, needles[j]));
+    unsigned int mask = (unsigned int)_mm256_movemask_epi8(hits);
+    if (mask) return i + __builtin_ctz(mask);
+  }
+  return i + scan_any_sse2(data + i, len - i, set, nb);
+}
+#endif
+
+/**
+ * @brief Kernels in use, the best ones supported are selected before main().
+ */
+static http_scan_level_t scan_level = HTTP_SCAN_SCALAR;
+static scan_byte_fn scan_byte = scan_byte_scalar;
+static scan_any_fn scan_any = scan_any_scalar;
+
+__attribute__((constructor))
+static void init_http_scan() {
+#ifdef HTTP_SCAN_X86
+  __builtin_cpu_init();
+#endif
+  if (http_scan_select(HTTP_SCAN_AVX2) != 0) http_scan_select(HTTP_SCAN_SSE2);
+}
+
+/**
+ * @brief Selects the kernels of an instruction set.
+ *
+ * Called once before main() with the best level the CPU supports; tests and benchmarks
+ * call it to compare the levels. It must not be called while other threads are parsing.
+ *
+ * @param level The instruction set to use.
+ *
+ * @return 0 on success, or -1 if the CPU does not support it.
+ */
+int http_scan_select(http_scan_level_t level) {
+  switch (level) {
+    case HTTP_SCAN_SCALAR:
+      scan_byte = scan_byte_scalar;
+      scan_any = scan_any_scalar;
+      break;
+#ifdef HTTP_SCAN_X86
+    case HTTP_SCAN_SSE2:
+      if (!__builtin_cpu_supports("sse2")) return -1;
+      scan_byte = scan_byte_sse2;
+      scan_any = scan_any_sse2;
+      break;
+    case HTTP_SCAN_AVX2:
+      if (!__builtin_cpu_supports("avx2")) return -1;
+      scan_byte = scan_byte_avx2;
+      scan_any = scan_any_avx2;
+      break;
+#endif
+    default:
+      return -1;
+  }
+  scan_level = level;
+  return 0;
+}
+
+/**
+ * @brief Tells which instruction set the kernels use.
+ *
+ * @return The level selected by http_scan_select().
+ */
+http_scan_level_t http_scan_level() {
+  return scan_level;
+}
+
+/**
+ * @brief Gives the name of an instruction set, for the logs.
+ *
+ * @param level The instruction set.
+ *
+ * @return A static string.
+ */
+const char* http_scan_level_name(http_scan_level_t level) {
+  switch (level) {
+    case HTTP_SCAN_AVX2: return "avx2";
+    case HTTP_SCAN_SSE2: return "sse2";
+    default: return "scalar";
+  }
+}
+
+/**
+ * @brief Finds the first occurrence of a byte.
+ *
+ * @param data The bytes to scan, not necessarily null-terminated.
+ * @param len The number of bytes.
+ * @param c The byte to find.
+ *
+ * @return The index of the first occurrence, or len if there is none.
+ */
+size_t http_scan_byte(const char* data, size_t len, char c) {
+  return scan_byte(data, len, c);
+}
+
+/**
+ * @brief Finds the first byte belonging to a set of delimiters.
+ *
+ * @param data The bytes to scan, not necessarily null-terminated.
+ * @param len The number of bytes.
+ * @param set The delimiters, a string of 1 to HTTP_SCAN_MAX_SET bytes.
+ *
+ * @return The index of the first delimiter, or len if there is none.
+ */
+size_t http_scan_any(const char* data, size_t len, const char* set) {
+  size_t nb = strlen(set);
+  if (nb == 0) return len;
+  if (nb > HTTP_SCAN_MAX_SET) nb = HTTP_SCAN_MAX_SET;
+  return scan_any(data, len, set, nb);
+}
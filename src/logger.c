@@ -77,8 +77,9 @@ void close_logger() {
  */
 static void get_timestamp(char* buffer, size_t size) {
   time_t now = time(NULL);
-  struct tm* tstruct = localtime(&now);
-  strftime(buffer, size, "%Y-%m-%d %X", tstruct);
+  struct tm tstruct;
+  localtime_r(&now, &tstruct);
+  strftime(buffer, size, "%Y-%m-%d %X", &tstruct);
 }
 
 /**
@@ -113,6 +114,8 @@ void Log(LogLevel level, const char* format, ...) {
       break;
   }
 
+  // Workers log from several threads, keep each line in one piece
+  flockfile(log_file);
   fprintf(log_file, "[%s] [%s] ", timestamp, level_str);
 
   // https://www.ibm.com/docs/nl/zos/2.4.0?topic=functions-vfprintf-format-print-data-stream#d151044e205
@@ -123,4 +126,5 @@ void Log(LogLevel level, const char* format, ...) {
 
   fprintf(log_file, "\n");
   fflush(log_file);
+  funlockfile(log_file);
 }
@@ -0,0 +1,174 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file pool.c
+ * @brief Implementation of the slab pool and of the buffer pool.
+ */
+
+#include "../includes/pool.h"
+#include "../includes/utils.h"
+
+#include <stdalign.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Initializes an empty slab pool.
+ *
+ * @param pool The pool to initialize.
+ * @param object_size The size of the objects handed out by the pool.
+ */
+void init_pool(pool_t* pool, size_t object_size) {
+  memset(pool, 0, sizeof(pool_t));
+  size_t align = alignof(max_align_t);
+  if (object_size < sizeof(pool_object_t)) object_size = sizeof(pool_object_t);
+  pool->object_size = (object_size + align - 1) / align * align;
+}
+
+/**
+ * @brief Allocates a new slab and puts its objects in the free list.
+ *
+ * @param pool The pool.
+ *
+ * @return 0 on success, -1 if the slab cannot be allocated.
+ */
+static int grow_pool(pool_t* pool) {
+  size_t header = (sizeof(pool_slab_t) + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+  pool_slab_t* slab = malloc(header + pool->object_size * POOL_SLAB_OBJECTS);
+  if (!slab) {
+    ERROR("malloc\n");
+    return -1;
+  }
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->nb_slabs++;
+
+  char* objects = (char*)slab + header;
+  for (int i = POOL_SLAB_OBJECTS - 1; i >= 0; i--) {
+    pool_object_t* object = (pool_object_t*)(objects + i * pool->object_size);
+    object->next = pool->free_list;
+    pool->free_list = object;
+  }
+  return 0;
+}
+
+/**
+ * @brief Takes an object from a pool, its content is undefined.
+ *
+ * @param pool The pool.
+ *
+ * @return The object, or NULL if no memory is left.
+ */
+void* pool_alloc(pool_t* pool) {
+  if (!pool->free_list && grow_pool(pool) != 0) return NULL;
+
+  pool_object_t* object = pool->free_list;
+  pool->free_list = object->next;
+  pool->nb_used++;
+  return object;
+}
+
+/**
+ * @brief Gives an object back to its pool.
+ *
+ * @param pool The pool the object was taken from.
+ * @param object The object.
+ */
+void pool_free(pool_t* pool, void* object) {
+  pool_object_t* free_object = object;
+  free_object->next = pool->free_list;
+  pool->free_list = free_object;
+  pool->nb_used--;
+}
+
+/**
+ * @brief Releases every slab of a pool, the objects must no longer be used.
+ *
+ * @param pool The pool.
+ */
+void free_pool(pool_t* pool) {
+  while (pool->slabs) {
+    pool_slab_t* next = pool->slabs->next;
+    free(pool->slabs);
+    pool->slabs = next;
+  }
+  pool->free_list = NULL;
+  pool->nb_slabs = 0;
+  pool->nb_used = 0;
+}
+
+/**
+ * @brief Initializes an empty buffer pool.
+ *
+ * @param pool The pool to initialize.
+ * @param buffer_size The size of the buffers handed out by the pool.
+ */
+void init_buffer_pool(buffer_pool_t* pool, size_t buffer_size) {
+  memset(pool, 0, sizeof(buffer_pool_t));
+  pool->buffer_size = buffer_size;
+}
+
+/**
+ * @brief Takes a buffer from a pool.
+ *
+ * @param pool The pool.
+ *
+ * @return The buffer, or NULL if no memory is left.
+ */
+char* buffer_pool_get(buffer_pool_t* pool) {
+  char* buffer;
+  if (pool->free_list) {
+    buffer = (char*)pool->free_list;
+    pool->free_list = pool->free_list->next;
+    pool->nb_free--;
+  } else {
+    buffer = malloc(pool->buffer_size);
+    if (!buffer) return NULL;
+  }
+  pool->nb_used++;
+  return buffer;
+}
+
+/**
+ * @brief Gives a buffer back to its pool.
+ *
+ * @param pool The pool the buffer was taken from.
+ * @param buffer The buffer.
+ */
+void buffer_pool_put(buffer_pool_t* pool, char* buffer) {
+  pool->nb_used--;
+  if (pool->nb_free >= BUFFER_POOL_MAX_FREE) {
+    free(buffer);
+    return;
+  }
+  pool_object_t* object = (pool_object_t*)buffer;
+  object->next = pool->free_list;
+  pool->free_list = object;
+  pool->nb_free++;
+}
+
+/**
+ * @brief Releases the free buffers of a pool, the buffers handed out must have been given back.
+ *
+ * @param pool The pool.
+ */
+void free_buffer_pool(buffer_pool_t* pool) {
+  while (pool->free_list) {
+    pool_object_t* next = pool->free_list->next;
+    free(pool->free_list);
+    pool->free_list = next;
+  }
+  pool->nb_free = 0;
+}
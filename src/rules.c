@@ -20,7 +20,11 @@
  * free filtering rules from a configuration file.
  */
 
+#define _GNU_SOURCE
+
 #include "../includes/rules.h"
+#include "../includes/rules_image.h"
+#include "../includes/epoch.h"
 #include "../includes/utils.h"
 #include "../includes/logger.h"
 #include <stdio.h>
@@ -31,22 +35,129 @@
  */
 rules_t rules = {
   .rules = NULL,
-  .nb_rules = 0
+  .nb_rules = 0,
+  .domains = { 0 },
+  .suffixes = { 0 },
+  .filter = { 0 },
+  .words = { 0 },
+  .image = NULL,
+  .image_len = 0,
+  .refs = 0,
+  .generation = 0
 };
 
 /**
- * @brief Loads the filtering rules from a configuration file.
+ * @brief Snapshot of the rules the lookups use, replaced as a whole by reload_rules().
+ */
+static _Atomic(rules_t*) current = &rules;
+
+/**
+ * @brief Number of loads of rules so far, the generation of the last one.
+ */
+static atomic_uint_fast64_t generations = 0;
+
+/**
+ * @brief Key of a suffix rule in the domain filter, apart from the key of the same domain.
+ *
+ * Hosts are often the very domain of a "*.domain" rule, which does not ban it: keeping the
+ * keys apart spares them a lookup.
+ */
+static inline uint64_t suffix_key(const char* suffix, size_t len) {
+  return domain_hash64(suffix, len) ^ 0xc2b2ae3d27d4eb4fULL;
+}
+
+/**
+ * @brief Indexes the banned domains of every category.
+ *
+ * Plain domains go to the domain set, "*.domain" rules to the suffix trie, and both to the
+ * domain filter. Rules which are not domain names are ignored.
+ *
+ * @return 0 on success, -1 if the indexes could not be allocated.
+ */
+static int index_domains(rules_t* set) {
+  size_t count = 0;
+  for (size_t i = 0; i < set->nb_rules; i++) count += set->rules[i].domain_count;
+
+  free_domain_set(&set->domains);
+  free_domain_trie(&set->suffixes);
+  if (domain_set_reserve(&set->domains, count) != 0) return -1;
+  if (domain_filter_reserve(&set->filter, count) != 0) return -1;
+  for (size_t i = 0; i < set->nb_rules; i++) {
+    for (size_t j = 0; j < set->rules[i].domain_count; j++) {
+      const char* domain = set->rules[i].ban_domain_list[j];
+      if (strncmp(domain, "*.", 2) == 0) {
+        int added = domain_trie_add(&set->suffixes, domain + 2, i);
+        if (added < 0) {
+          WARN("Invalid domain rule '%s' ignored\n", domain);
+          Log(LOG_LEVEL_WARN, "[RULES] Invalid domain rule %s ignored", domain);
+        } else if (added == 0) {
+          domain_filter_add(&set->filter, suffix_key(domain + 2, strlen(domain + 2)));
+        }
+      } else {
+        int added = domain_set_add(&set->domains, domain, i);
+        if (added < 0) return -1;
+        if (added == 0) domain_filter_add(&set->filter, domain_hash64(domain, strlen(domain)));
+      }
+    }
+  }
+  INFO("%zu banned domains and %zu banned suffixes indexed\n", set->domains.count, set->suffixes.nb_rules);
+  return 0;
+}
+
+/**
+ * @brief Compiles the banned words of every category into the word matcher.
+ *
+ * @return 0 on success, -1 if the automaton could not be allocated.
+ */
+static int index_words(rules_t* set) {
+  free_word_matcher(&set->words);
+  for (size_t i = 0; i < set->nb_rules; i++) {
+    for (size_t j = 0; j < set->rules[i].word_count; j++) {
+      const char* word = set->rules[i].ban_word_list[j];
+      if (word[0] == '\0') {
+        WARN("Empty word rule ignored in category '%s'\n", set->rules[i].name);
+        continue;
+      }
+      if (word_matcher_add(&set->words, word, i) != 0) return -1;
+    }
+  }
+  if (word_matcher_compile(&set->words) != 0) return -1;
+  INFO("%zu banned words compiled into %zu states\n", set->words.nb_words, set->words.nb_states);
+  return 0;
+}
+
+/**
+ * @brief Logs the size of the domain filter and its estimated rate of false positives.
+ */
+static void log_filter_stats(const rules_t* set) {
+  const domain_filter_t* filter = &set->filter;
+  double rate = domain_filter_false_positive_rate(filter) * 100;
+  INFO("Domain filter: %zu keys in %zu KB, %.3f%% of false positives\n", filter->nb_keys, domain_filter_size(filter) >> 10, rate);
+  Log(LOG_LEVEL_INFO, "[RULES] Domain filter: %zu keys in %zu bytes, %.3f%% of false positives",
+      filter->nb_keys, domain_filter_size(filter), rate);
+}
+
+/**
+ * @brief Loads the filtering rules from a configuration file into a rule set.
  *
  * This function reads a configuration file that defines filtering rules in categories.
  * Each category can contain banned domains and banned words. The file is expected to 
  * follow a specific format, with categories enclosed in brackets and rules defined 
- * under each category.
+ * under each category. An image compiled by proxy-rulec is mapped instead of parsed.
  *
- * @param filename The path to the configuration file.
+ * @param set The rule set to fill, empty.
+ * @param filename The path to the configuration file, or to a rules image.
  * @return 0 on success, -1 if the file could not be opened or an error occurred.
  */
-int init_rules(const char* filename) {
+static int load_rules(rules_t* set, const char* filename) {
   INFO("Loading rules config from %s\n", filename);
+  set->generation = atomic_fetch_add(&generations, 1) + 1;
+
+  if (is_rules_image(filename)) {
+    if (map_rules_image(set, filename) != 0) return -1;
+    log_filter_stats(set);
+    return 0;
+  }
 
   FILE* file = fopen(filename, "r");
   if (!file) {
@@ -65,8 +176,8 @@ int init_rules(const char* filename) {
     line[strcspn(line, "\r\n")] = 0;
 
     if (line[0] == '[' || line[strlen(line) - 1] == ']') {
-      rules.rules = realloc(rules.rules, sizeof(categories) * (rules.nb_rules + 1));
-      current_categorie = &rules.rules[rules.nb_rules];
+      set->rules = realloc(set->rules, sizeof(categories) * (set->nb_rules + 1));
+      current_categorie = &set->rules[set->nb_rules];
       
       strncpy(current_categorie->name, line + 1, strlen(line) - 2);
       current_categorie->name[strlen(line) -2] = '\0';
@@ -76,7 +187,7 @@ int init_rules(const char* filename) {
       current_categorie->ban_word_list = NULL;
       current_categorie->word_count = 0;
 
-      rules.nb_rules ++;
+      set->nb_rules ++;
       
       INFO("Charging new categorie: %s\n", current_categorie->name);
     } else if (current_categorie) {
@@ -105,18 +216,41 @@ int init_rules(const char* filename) {
   }
   
   fclose(file);
+
+  if (index_domains(set) != 0) {
+    ERROR("Banned domains could not be indexed");
+    Log(LOG_LEVEL_ERROR, "[RULES] Banned domains could not be indexed");
+    return -1;
+  }
+  if (index_words(set) != 0) {
+    ERROR("Banned words could not be compiled");
+    Log(LOG_LEVEL_ERROR, "[RULES] Banned words could not be compiled");
+    return -1;
+  }
+  log_filter_stats(set);
   return 0;
 }
 
 /**
- * @brief Frees the memory allocated for the rules.
+ * @brief Loads the filtering rules from a configuration file.
  *
- * This function releases the memory allocated for all categories, including 
- * the banned domains and words within each category, and resets the rules.
+ * The rules are loaded into the global rule set, which becomes the snapshot the lookups use.
+ *
+ * @param filename The path to the configuration file, or to a rules image.
+ * @return 0 on success, -1 if the file could not be opened or an error occurred.
  */
-void free_rules() {
-  for (size_t i = 0; i < rules.nb_rules; i++) {
-    categories* cat = &rules.rules[i];
+int init_rules(const char* filename) {
+  atomic_store(&rules.refs, 1);
+  atomic_store(&current, &rules);
+  return load_rules(&rules, filename);
+}
+
+/**
+ * @brief Frees the categories and the indexes of a rule set, leaving it empty.
+ */
+static void clear_rules(rules_t* set) {
+  for (size_t i = 0; i < set->nb_rules; i++) {
+    categories* cat = &set->rules[i];
 
     for (size_t j = 0; j < cat->domain_count; j++) free(cat->ban_domain_list[j]);
     free(cat->ban_domain_list);
@@ -124,26 +258,201 @@ void free_rules() {
     for (size_t j = 0; j < cat->word_count; j++) free(cat->ban_word_list[j]);
     free(cat->ban_word_list);
   }
-  free(rules.rules);
-  rules.rules = NULL;
-  rules.nb_rules = 0;
+  free(set->rules);
+  if (set->image) {
+    unmap_rules_image(set);
+  } else {
+    free_domain_set(&set->domains);
+    free_domain_trie(&set->suffixes);
+    free_domain_filter(&set->filter);
+    free_word_matcher(&set->words);
+  }
+  set->rules = NULL;
+  set->nb_rules = 0;
+  // The empty set must not be mistaken for the rules it held
+  set->generation = atomic_fetch_add(&generations, 1) + 1;
+}
+
+/**
+ * @brief Frees the memory allocated for the rules.
+ *
+ * This function releases the memory allocated for all categories, including 
+ * the banned domains and words within each category, and resets the rules.
+ * The workers must be stopped: the snapshot they used is freed with them.
+ */
+void free_rules() {
+  rules_t* set = atomic_exchange(&current, &rules);
+  if (set != &rules) release_rules(set);
+  clear_rules(&rules);
+  atomic_store(&rules.refs, 0);
+}
+
+/**
+ * @brief Returns the snapshot of the rules to look hosts and words up in.
+ *
+ * A worker loads it once per lookup, within the read-side section of its event loop
+ * (see epoch.h), and must not keep it past the section unless it takes a reference.
+ *
+ * @return The current rule set.
+ */
+const rules_t* current_rules() {
+  return atomic_load(&current);
+}
+
+/**
+ * @brief Takes a reference on the current snapshot, which then outlives the read-side section.
+ *
+ * @return The current rule set, to give back with release_rules().
+ */
+rules_t* acquire_rules() {
+  rules_t* set = atomic_load(&current);
+  atomic_fetch_add(&set->refs, 1);
+  return set;
+}
+
+/**
+ * @brief Gives a reference on a snapshot back, the last one frees it.
+ *
+ * @param set The rule set, from acquire_rules().
+ */
+void release_rules(rules_t* set) {
+  if (atomic_fetch_sub(&set->refs, 1) != 1) return;
+
+  clear_rules(set);
+  if (set != &rules) free(set);
+}
+
+/**
+ * @brief Loads the rules again and publishes them while the workers keep running.
+ *
+ * The new rules are loaded beside the current ones, which the workers keep using until
+ * the new snapshot is swapped in. The old snapshot is freed once no worker can be
+ * looking it up anymore, or later by the last response scanner still using it.
+ * If the file cannot be loaded, the current rules stay in place.
+ *
+ * @param filename The path to the configuration file, or to a rules image.
+ * @return 0 on success, -1 if the rules could not be loaded.
+ */
+int reload_rules(const char* filename) {
+  rules_t* set = calloc(1, sizeof(rules_t));
+  if (!set) return -1;
+  atomic_init(&set->refs, 1);
+
+  if (load_rules(set, filename) != 0) {
+    clear_rules(set);
+    free(set);
+    ERROR("Rules could not be reloaded from %s, the previous ones are kept\n", filename);
+    Log(LOG_LEVEL_ERROR, "[RULES] Rules could not be reloaded from %s, the previous ones are kept", filename);
+    return -1;
+  }
+
+  rules_t* old = atomic_exchange(&current, set);
+  epoch_synchronize();
+  release_rules(old);
+  Log(LOG_LEVEL_INFO, "[RULES] Rules reloaded from %s: %zu categories, %zu domains, %zu suffixes, %zu words",
+      filename, set->nb_rules, set->domains.count, set->suffixes.nb_rules, set->words.nb_words);
+  return 0;
+}
+
+/**
+ * @brief Tells whether a host may be banned, from the domain filter alone.
+ *
+ * The host is probed as a domain, then each of its suffixes after a dot as a suffix rule,
+ * one cache line each. A "*.domain" rule can only match a host ending with ".domain".
+ *
+ * @return 0 if no rule bans the host, 1 if one may.
+ */
+static int may_be_banned(const rules_t* set, const char* host, size_t len, uint64_t hash) {
+  if (domain_filter_contains(&set->filter, hash)) return 1;
+  if (set->suffixes.nb_rules == 0) return 0;
+
+  const char* end = host + len;
+  for (const char* dot = memchr(host, '.', len); dot; dot = memchr(dot + 1, '.', end - dot - 1)) {
+    if (domain_filter_contains(&set->filter, suffix_key(dot + 1, end - dot - 1))) return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief Returns the length of the name of a host, without its port and its final dot.
+ */
+static size_t host_name_len(const char* host) {
+  size_t len = strlen(host);
+  const char* colon = memrchr(host, ':', len);
+  if (colon && (host[0] != '[' || colon[-1] == ']')) len = colon - host;
+  if (len > 0 && host[len - 1] == '.') len--;
+  return len;
+}
+
+/**
+ * @brief Finds the category banning the name of a host, given its hash.
+ */
+static int find_category(const rules_t* set, const char* host, size_t len, uint64_t hash) {
+  if (!may_be_banned(set, host, len, hash)) return -1;
+
+  int category = domain_set_find(&set->domains, host, len);
+  return category >= 0 ? category : domain_trie_find(&set->suffixes, host, len);
+}
+
+/**
+ * @brief Finds the category banning a host.
+ *
+ * The port and the final dot of the host are ignored. The domain filter rules most allowed
+ * hosts out; the others are looked up in the domain set, then their suffixes in the trie,
+ * ignoring case, so the cost does not depend on the number of rules.
+ *
+ * @param set The rule set, usually current_rules().
+ * @param host The host, as sent by the client.
+ * @return The index of the category in set->rules, or -1 if the host is allowed.
+ */
+int find_host_category(const rules_t* set, const char* host) {
+  size_t len = host_name_len(host);
+  return find_category(set, host, len, domain_hash64(host, len));
 }
 
 /**
  * @brief Returns 0 or 1 depending on whether the given host is denied.
  *
- * This function checks each host included in the rule set and returns
+ * This function looks the host up in the rule set and returns
  * a boolean indicating whether the host is denied (1) or not (0).
+ * A host whose verdict on the current rules is cached costs a single probe of the cache.
+ *
+ * @param verdicts The verdict cache of the event loop, NULL to always look the rules up.
+ * @param host The host, as sent by the client.
  */
-int is_host_deny(const char* host) {
-  for (size_t i = 0; i < rules.nb_rules; i++) {
-    for (size_t j = 0; j < rules.rules[i].domain_count; j++) {
-      if ( strcmp(host, rules.rules[i].ban_domain_list[j]) == 0) {
-        WARN("Domain '%s' is banned from the category '%s'\n", rules.rules[i].ban_domain_list[j], rules.rules[i].name );
-        Log(LOG_LEVEL_WARN, "[RULES] Domain %s banned from category : %s", rules.rules[i].ban_domain_list[j], rules.rules[i].name);
-        return 1;
-      }
-    }
+int is_host_deny(verdict_cache_t* verdicts, const char* host) {
+  const rules_t* set = current_rules();
+  size_t len = host_name_len(host);
+  uint64_t hash = domain_hash64(host, len);
+  int category;
+  if (!verdicts || !verdict_cache_get(verdicts, set->generation, host, len, (uint32_t)(hash >> 32), &category)) {
+    category = find_category(set, host, len, hash);
+    if (verdicts) verdict_cache_put(verdicts, set->generation, host, len, (uint32_t)(hash >> 32), category);
   }
-  return 0;
+  if (category < 0) return 0;
+
+  WARN("Domain '%s' is banned from the category '%s'\n", host, set->rules[category].name);
+  Log(LOG_LEVEL_WARN, "[RULES] Domain %s banned from category : %s", host, set->rules[category].name);
+  return 1;
+}
+
+/**
+ * @brief Finds a banned word in a text.
+ *
+ * The words of every category are searched in a single pass over the text, ignoring case.
+ * A word matches anywhere in the text, even inside a longer word.
+ *
+ * @param set The rule set, usually current_rules().
+ * @param data The text, not necessarily NUL terminated.
+ * @param len The length of the text.
+ * @param word Receives the word found, may be NULL.
+ * @return The index of the category of the word in set->rules, or -1 if the text has no banned word.
+ */
+int find_banned_word(const rules_t* set, const char* data, size_t len, const char** word) {
+  uint32_t state = WORD_MATCHER_START;
+  int index = word_matcher_scan(&set->words, &state, data, len);
+  if (index < 0) return -1;
+
+  if (word) *word = set->words.words[index].word;
+  return set->words.words[index].category;
 }
@@ -0,0 +1,363 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file rules_image.c
+ * @brief Implementation of the compiled image of the filtering rules.
+ */
+
+#include "../includes/rules_image.h"
+#include "../includes/utils.h"
+#include "../includes/logger.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Tells whether a file is an image rather than a rules file.
+ *
+ * @param filename The path of the file.
+ *
+ * @return 1 if the file starts with RULES_IMAGE_MAGIC, 0 otherwise.
+ */
+int is_rules_image(const char* filename) {
+  FILE* file = fopen(filename, "rb");
+  if (!file) return 0;
+
+  char magic[8];
+  int image = fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, RULES_IMAGE_MAGIC, sizeof(magic)) == 0;
+  fclose(file);
+  return image;
+}
+
+/**
+ * @brief Places a section after the previous ones.
+ */
+static void place_section(rules_image_header_t* header, rules_image_section_id_t id, uint64_t len) {
+  uint64_t offset = (header->size + RULES_IMAGE_ALIGN - 1) & ~(uint64_t)(RULES_IMAGE_ALIGN - 1);
+  header->sections[id] = (rules_image_section_t){ offset, len };
+  header->size = offset + len;
+}
+
+/**
+ * @brief Writes a section at its place, after the padding which precedes it.
+ */
+static int write_section(FILE* file, const rules_image_header_t* header, rules_image_section_id_t id, const void* data) {
+  static const char padding[RULES_IMAGE_ALIGN] = {0};
+  long position = ftell(file);
+  if (position < 0) return -1;
+
+  size_t pad = header->sections[id].offset - (uint64_t)position;
+  if (pad > 0 && fwrite(padding, 1, pad, file) != pad) return -1;
+  size_t len = header->sections[id].len;
+  return len == 0 || fwrite(data, 1, len, file) == len ? 0 : -1;
+}
+
+/**
+ * @brief Writes the indexes of a rule set to an image.
+ *
+ * The image is written next to the file and renamed over it once complete, so a proxy
+ * starting meanwhile reads either the previous image or the new one.
+ *
+ * @param rules The rules, loaded from a rules file.
+ * @param filename The path of the image.
+ *
+ * @return 0 on success, -1 if the image could not be written.
+ */
+int write_rules_image(const rules_t* rules, const char* filename) {
+  // Categories and words are small, their text is gathered before being written
+  size_t names_len = 0, words_text_len = 0;
+  for (size_t i = 0; i < rules->nb_rules; i++) names_len += strlen(rules->rules[i].name) + 1;
+  for (size_t i = 0; i < rules->words.nb_words; i++) words_text_len += strlen(rules->words.words[i].word) + 1;
+
+  char* names = malloc(names_len + 1);
+  char* words_text = malloc(words_text_len + 1);
+  rules_image_word_t* words = malloc((rules->words.nb_words + 1) * sizeof(rules_image_word_t));
+  if (!names || !words_text || !words) {
+    free(names);
+    free(words_text);
+    free(words);
+    return -1;
+  }
+  size_t offset = 0;
+  for (size_t i = 0; i < rules->nb_rules; i++) {
+    size_t len = strlen(rules->rules[i].name) + 1;
+    memcpy(names + offset, rules->rules[i].name, len);
+    offset += len;
+  }
+  offset = 0;
+  for (size_t i = 0; i < rules->words.nb_words; i++) {
+    size_t len = strlen(rules->words.words[i].word) + 1;
+    memcpy(words_text + offset, rules->words.words[i].word, len);
+    words[i] = (rules_image_word_t){ offset, rules->words.words[i].category };
+    offset += len;
+  }
+
+  rules_image_header_t header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, RULES_IMAGE_MAGIC, sizeof(header.magic));
+  header.version = RULES_IMAGE_VERSION;
+  header.byte_order = RULES_IMAGE_BYTE_ORDER;
+  header.nb_categories = rules->nb_rules;
+  header.nb_domains = rules->domains.count;
+  header.nb_suffixes = rules->suffixes.nb_rules;
+  header.nb_classes = rules->words.nb_classes;
+  header.nb_filter_keys = rules->filter.nb_keys;
+  memcpy(header.classes, rules->words.classes, sizeof(header.classes));
+
+  const domain_trie_t* trie = &rules->suffixes;
+  const word_matcher_t* matcher = &rules->words;
+  const void* data[RULES_IMAGE_NB_SECTIONS] = {
+    names, rules->domains.slots, rules->domains.text, trie->categories, trie->edges, trie->labels,
+    words, words_text, matcher->transitions, matcher->matches, rules->filter.blocks
+  };
+  header.size = sizeof(header);
+  place_section(&header, RULES_IMAGE_NAMES, names_len);
+  place_section(&header, RULES_IMAGE_DOMAIN_SLOTS, rules->domains.capacity * sizeof(domain_slot_t));
+  place_section(&header, RULES_IMAGE_DOMAIN_TEXT, rules->domains.text_len);
+  place_section(&header, RULES_IMAGE_TRIE_CATEGORIES, trie->nb_nodes * sizeof(int32_t));
+  place_section(&header, RULES_IMAGE_TRIE_EDGES, trie->edges_capacity * sizeof(domain_trie_edge_t));
+  place_section(&header, RULES_IMAGE_TRIE_LABELS, trie->labels_len);
+  place_section(&header, RULES_IMAGE_WORDS, matcher->nb_words * sizeof(rules_image_word_t));
+  place_section(&header, RULES_IMAGE_WORD_TEXT, words_text_len);
+  place_section(&header, RULES_IMAGE_WORD_TRANSITIONS, matcher->nb_states * matcher->nb_classes * sizeof(uint32_t));
+  place_section(&header, RULES_IMAGE_WORD_MATCHES, matcher->nb_states * sizeof(int32_t));
+  place_section(&header, RULES_IMAGE_DOMAIN_FILTER, domain_filter_size(&rules->filter));
+
+  char tmp_filename[512];
+  snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+  FILE* file = fopen(tmp_filename, "wb");
+  int ret = file ? 0 : -1;
+  if (file && fwrite(&header, sizeof(header), 1, file) != 1) ret = -1;
+  for (int id = 0; id < RULES_IMAGE_NB_SECTIONS && ret == 0; id++) {
+    ret = write_section(file, &header, id, data[id]);
+  }
+  if (file && fclose(file) != 0) ret = -1;
+  if (ret == 0 && rename(tmp_filename, filename) != 0) ret = -1;
+  if (ret != 0) remove(tmp_filename);
+
+  free(names);
+  free(words_text);
+  free(words);
+  return ret;
+}
+
+/**
+ * @brief Checks that a section lies within the image and holds whole entries.
+ */
+static int valid_section(const rules_image_header_t* header, rules_image_section_id_t id, size_t entry_size) {
+  const rules_image_section_t* section = &header->sections[id];
+  return section->offset % RULES_IMAGE_ALIGN == 0 && section->offset >= sizeof(rules_image_header_t)
+      && section->offset <= header->size && section->len <= header->size - section->offset
+      && section->len % entry_size == 0;
+}
+
+/**
+ * @brief Checks that the header of an image describes sections the indexes can be laid on.
+ *
+ * The entries of the sections are checked by map_rules_image() once the indexes point to them.
+ */
+static int valid_header(const rules_image_header_t* header, size_t size) {
+  if (memcmp(header->magic, RULES_IMAGE_MAGIC, sizeof(header->magic)) != 0) return 0;
+  if (header->version != RULES_IMAGE_VERSION || header->byte_order != RULES_IMAGE_BYTE_ORDER) return 0;
+  if (header->size != size) return 0;
+  // Every category has a name of one byte at least
+  if (header->nb_categories > header->sections[RULES_IMAGE_NAMES].len) return 0;
+
+  const size_t entry_sizes[RULES_IMAGE_NB_SECTIONS] = {
+    1, sizeof(domain_slot_t), 1, sizeof(int32_t), sizeof(domain_trie_edge_t), 1,
+    sizeof(rules_image_word_t), 1, sizeof(uint32_t), sizeof(int32_t), sizeof(domain_filter_block_t)
+  };
+  for (int id = 0; id < RULES_IMAGE_NB_SECTIONS; id++) {
+    if (!valid_section(header, id, entry_sizes[id])) return 0;
+  }
+
+  // The probes of the tables stop at a free slot, there must be one
+  uint64_t slots = header->sections[RULES_IMAGE_DOMAIN_SLOTS].len / sizeof(domain_slot_t);
+  if (header->nb_domains > 0 && ((slots & (slots - 1)) != 0 || header->nb_domains >= slots)) return 0;
+  uint64_t nodes = header->sections[RULES_IMAGE_TRIE_CATEGORIES].len / sizeof(int32_t);
+  uint64_t edges = header->sections[RULES_IMAGE_TRIE_EDGES].len / sizeof(domain_trie_edge_t);
+  if (header->nb_suffixes > 0 && (nodes == 0 || (edges & (edges - 1)) != 0 || nodes > edges)) return 0;
+
+  // An empty filter would rule every host out
+  uint64_t blocks = header->sections[RULES_IMAGE_DOMAIN_FILTER].len / sizeof(domain_filter_block_t);
+  if ((header->nb_domains > 0 || header->nb_suffixes > 0) && (blocks == 0 || blocks > UINT32_MAX)) return 0;
+
+  uint64_t words = header->sections[RULES_IMAGE_WORDS].len / sizeof(rules_image_word_t);
+  uint64_t states = header->sections[RULES_IMAGE_WORD_MATCHES].len / sizeof(int32_t);
+  if (header->nb_classes == 0 || header->nb_classes > 256) return 0;
+  if (header->sections[RULES_IMAGE_WORD_TRANSITIONS].len != states * header->nb_classes * sizeof(uint32_t)) return 0;
+  if (words > 0 && states == 0) return 0;
+  for (int c = 0; c < 256; c++) {
+    if (header->classes[c] >= header->nb_classes) return 0;
+  }
+
+  // Text sections end with a NUL byte, so no string runs past them
+  const char* base = (const char*)header;
+  const rules_image_section_id_t texts[] = { RULES_IMAGE_NAMES, RULES_IMAGE_DOMAIN_TEXT, RULES_IMAGE_WORD_TEXT };
+  for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+    const rules_image_section_t* section = &header->sections[texts[i]];
+    if (section->len > 0 && base[section->offset + section->len - 1] != '\0') return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Checks that the entries of the indexes of an image refer to their sections and categories.
+ *
+ * A lookup follows the offsets and indexes found in the entries without checking them, so
+ * they are all checked once, before the first lookup: an image truncated or corrupted
+ * past its header is refused instead of making the lookups read outside the mapping.
+ */
+static int valid_entries(const rules_t* rules, const rules_image_header_t* header) {
+  if (rules->nb_rules != header->nb_categories) return 0;
+
+  const rules_image_section_t* sections = header->sections;
+  const rules_image_word_t* words = (const rules_image_word_t*)((const char*)header + sections[RULES_IMAGE_WORDS].offset);
+  for (size_t i = 0; i < rules->words.nb_words; i++) {
+    if (words[i].text >= sections[RULES_IMAGE_WORD_TEXT].len) return 0;
+  }
+  return domain_set_check(&rules->domains, rules->nb_rules) && domain_trie_check(&rules->suffixes, rules->nb_rules)
+      && word_matcher_check(&rules->words, rules->nb_rules);
+}
+
+/**
+ * @brief Loads the rules from an image, mapping it instead of reading it.
+ *
+ * The indexes point into the mapping; only the category names and the list of the
+ * banned words are allocated. The header and every entry are checked before the rules
+ * are used, see valid_header() and valid_entries().
+ *
+ * @param rules The rules to fill, empty.
+ * @param filename The path of the image.
+ *
+ * @return 0 on success, -1 if the image could not be mapped or is not valid.
+ */
+int map_rules_image(rules_t* rules, const char* filename) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    ERROR("Rules image %s could not be opened\n", filename);
+    Log(LOG_LEVEL_ERROR, "[RULES] Rules image %s could not be opened", filename);
+    return -1;
+  }
+  struct stat st;
+  void* image = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(rules_image_header_t)) {
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (image == MAP_FAILED || !valid_header(image, st.st_size)) {
+    if (image != MAP_FAILED) munmap(image, st.st_size);
+    ERROR("Rules image %s is not valid, compile it again with proxy-rulec\n", filename);
+    Log(LOG_LEVEL_ERROR, "[RULES] Rules image %s is not valid", filename);
+    return -1;
+  }
+
+  const rules_image_header_t* header = image;
+  const char* base = image;
+  const rules_image_section_t* sections = header->sections;
+  size_t nb_words = sections[RULES_IMAGE_WORDS].len / sizeof(rules_image_word_t);
+  rules->rules = calloc(header->nb_categories ? header->nb_categories : 1, sizeof(categories));
+  rules->words.words = malloc((nb_words ? nb_words : 1) * sizeof(word_matcher_word_t));
+  if (!rules->rules || !rules->words.words) {
+    free(rules->rules);
+    free(rules->words.words);
+    rules->rules = NULL;
+    rules->words.words = NULL;
+    munmap(image, st.st_size);
+    return -1;
+  }
+  rules->image = image;
+  rules->image_len = st.st_size;
+
+  const char* name = base + sections[RULES_IMAGE_NAMES].offset;
+  const char* names_end = name + sections[RULES_IMAGE_NAMES].len;
+  for (; rules->nb_rules < header->nb_categories && name < names_end; rules->nb_rules++) {
+    snprintf(rules->rules[rules->nb_rules].name, MAX_STRING_LEN, "%s", name);
+    name += strlen(name) + 1;
+  }
+
+  domain_set_t* set = &rules->domains;
+  set->slots = (domain_slot_t*)(base + sections[RULES_IMAGE_DOMAIN_SLOTS].offset);
+  set->capacity = sections[RULES_IMAGE_DOMAIN_SLOTS].len / sizeof(domain_slot_t);
+  set->count = header->nb_domains;
+  set->text = (char*)(base + sections[RULES_IMAGE_DOMAIN_TEXT].offset);
+  set->text_len = sections[RULES_IMAGE_DOMAIN_TEXT].len;
+
+  domain_trie_t* trie = &rules->suffixes;
+  trie->categories = (int32_t*)(base + sections[RULES_IMAGE_TRIE_CATEGORIES].offset);
+  trie->nb_nodes = sections[RULES_IMAGE_TRIE_CATEGORIES].len / sizeof(int32_t);
+  trie->edges = (domain_trie_edge_t*)(base + sections[RULES_IMAGE_TRIE_EDGES].offset);
+  trie->edges_capacity = sections[RULES_IMAGE_TRIE_EDGES].len / sizeof(domain_trie_edge_t);
+  trie->labels = (char*)(base + sections[RULES_IMAGE_TRIE_LABELS].offset);
+  trie->labels_len = sections[RULES_IMAGE_TRIE_LABELS].len;
+  trie->nb_rules = header->nb_suffixes;
+
+  domain_filter_t* filter = &rules->filter;
+  filter->blocks = (domain_filter_block_t*)(base + sections[RULES_IMAGE_DOMAIN_FILTER].offset);
+  filter->nb_blocks = sections[RULES_IMAGE_DOMAIN_FILTER].len / sizeof(domain_filter_block_t);
+  filter->nb_keys = header->nb_filter_keys;
+
+  word_matcher_t* matcher = &rules->words;
+  const rules_image_word_t* words = (const rules_image_word_t*)(base + sections[RULES_IMAGE_WORDS].offset);
+  const char* words_text = base + sections[RULES_IMAGE_WORD_TEXT].offset;
+  for (size_t i = 0; i < nb_words; i++) {
+    matcher->words[i] = (word_matcher_word_t){ words_text + words[i].text, words[i].category };
+  }
+  matcher->nb_words = nb_words;
+  matcher->words_capacity = nb_words;
+  memcpy(matcher->classes, header->classes, sizeof(matcher->classes));
+  matcher->nb_classes = header->nb_classes;
+  matcher->matches = (int32_t*)(base + sections[RULES_IMAGE_WORD_MATCHES].offset);
+  matcher->nb_states = sections[RULES_IMAGE_WORD_MATCHES].len / sizeof(int32_t);
+  matcher->transitions = matcher->nb_states ? (uint32_t*)(base + sections[RULES_IMAGE_WORD_TRANSITIONS].offset) : NULL;
+
+  if (!valid_entries(rules, header)) {
+    unmap_rules_image(rules);
+    free(rules->rules);
+    rules->rules = NULL;
+    rules->nb_rules = 0;
+    ERROR("Rules image %s is corrupted, compile it again with proxy-rulec\n", filename);
+    Log(LOG_LEVEL_ERROR, "[RULES] Rules image %s is corrupted", filename);
+    return -1;
+  }
+
+  INFO("Rules image %s mapped: %zu categories, %zu domains, %zu suffixes, %zu words\n",
+       filename, rules->nb_rules, set->count, trie->nb_rules, matcher->nb_words);
+  return 0;
+}
+
+/**
+ * @brief Unmaps the image of a rule set, leaving its indexes empty.
+ *
+ * The category names are left to free_rules().
+ *
+ * @param rules The rules, loaded with map_rules_image().
+ */
+void unmap_rules_image(rules_t* rules) {
+  if (!rules->image) return;
+
+  free(rules->words.words);
+  init_domain_set(&rules->domains);
+  init_domain_trie(&rules->suffixes);
+  init_domain_filter(&rules->filter);
+  init_word_matcher(&rules->words);
+  munmap((void*)rules->image, rules->image_len);
+  rules->image = NULL;
+  rules->image_len = 0;
+}
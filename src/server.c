@@ -18,6 +18,8 @@
  * including socket initialization, connection acceptance, and HTTP request processing.
  */
 
+#define _GNU_SOURCE
+
 #include "../includes/server.h"
 #include "../includes/utils.h"
 #include "../includes/logger.h"
@@ -25,6 +27,8 @@
 #include "../includes/http_helper.h"
 #include "../includes/dns_helper.h"
 #include "../includes/rules.h"
+#include "../includes/config.h"
+#include <fcntl.h>
 #include <netdb.h>
 #include <stdio.h>
 
@@ -32,6 +36,7 @@
  * @brief Initializes a listening socket.
  * 
  * This function creates a socket, binds it to the specified address and port, and starts listening for incoming connections.
+ * The socket is created with SO_REUSEPORT so that each worker can open its own listener on the same address.
  * 
  * @param address The IP address to bind the socket.
  * @param port The port number to bind the socket.
@@ -58,6 +63,9 @@ int init_listen_socket(const char* address, int port, int max_client) {
   int option = 1;
   ret = setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
   INFO("setsockopt ret : %d\n", ret);
+  // Every worker binds its own listener on the same address, the kernel balances new connections
+  ret = setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option));
+  INFO("setsockopt SO_REUSEPORT ret : %d\n", ret);
   ret = bind(listen_fd, (struct sockaddr*)&server_addr, sizeof(server_addr));
   if (ret < 0) {
       ERROR("ERROR when binding the listen fd\n");
@@ -90,7 +98,8 @@ int init_listen_socket(const char* address, int port, int max_client) {
  * @param max_client The maximum number of clients allowed.
  * @param nb_client The current number of connected clients.
  * 
- * @return The file descriptor of the new client socket, or -1 in case of an error.
+ * @return The file descriptor of the new client socket, or -1 in case of an error or when
+ *         no connection is pending (errno is then EAGAIN).
  */
 int accept_connection(int listen_fd, struct sockaddr_in* client_addr, char* client_ip, int max_client, int nb_client) {
     socklen_t addr_len = sizeof(struct sockaddr_in);
@@ -102,6 +111,8 @@ int accept_connection(int listen_fd, struct sockaddr_in* client_addr, char* clie
     
     int new_client_fd = accept(listen_fd, (struct sockaddr*)client_addr, &addr_len);
     if (new_client_fd < 0) {
+        // Non-blocking listener: nothing left in the backlog
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return -1;
         ERROR("ERROR when accept client");
         Log(LOG_LEVEL_ERROR, "[SERVER] ERROR when accept client");
         return -1;
@@ -117,66 +128,253 @@ int accept_connection(int listen_fd, struct sockaddr_in* client_addr, char* clie
 }
 
 /**
- * @brief Handles communication with a connected client.
+ * @brief Reads the head of a message into a chain, as far as the socket allows without blocking.
+ * 
+ * Reading stops at the end of the head, so that the body is left to the relay. Only the
+ * bytes received since the previous call are scanned for the end of the head.
  * 
- * This function manages the entire lifecycle of a client connection, reading the client's data, 
- * processing HTTP requests, and checking the validity of the request. It handles different protocols, 
- * and logs relevant connection events.
+ * @param fd The socket the message comes from.
+ * @param chain The chain holding the head read so far.
+ * @param scanner The search for the end of the head, resumed where the previous call stopped.
+ * @param eof Set when the peer shut down its side.
+ * @param too_large Set when the head exceeds MAX_HEADER_SIZE bytes.
+ * @param head_len Receives the length of the head once it is complete.
+ * 
+ * @return 1 if the head is complete, 0 if not yet, or -1 on error.
+ */
+static int read_head(int fd, buffer_chain_t* chain, http_head_scanner_t* scanner, int* eof, int* too_large, size_t* head_len) {
+  size_t max_header_size = current_config()->max_header_size;
+
+  int head_end = http_head_scan(scanner, chain, head_len);
+  while (!head_end) {
+    size_t room;
+    char* dest = chain->len < max_header_size ? buffer_chain_reserve(chain, 1, &room) : NULL;
+    if (!dest) {
+      *too_large = 1;
+      break;
+    }
+    if (room > max_header_size - chain->len) room = max_header_size - chain->len;
+
+    ssize_t bytes_read = recv(fd, dest, room, MSG_DONTWAIT);
+
+    if (bytes_read < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      if (errno == EINTR) continue;
+      return -1;
+    }
+
+    if (bytes_read == 0) {
+      // The peer may shut down its side right after its message
+      *eof = 1;
+      break;
+    }
+
+    buffer_chain_commit(chain, bytes_read);
+    head_end = http_head_scan(scanner, chain, head_len);
+  }
+  return head_end;
+}
+
+/**
+ * @brief Length of the longest HTTP method, enough bytes to tell if the client speaks HTTP.
+ */
+#define HTTP_METHOD_MAX_LEN 7
+
+/**
+ * @brief Reads the request headers of a client as they arrive.
+ * 
+ * This function is called by the event loop each time the client socket becomes readable.
+ * It appends every byte available without blocking to the request chain of the connection,
+ * which keeps the parse state between two calls and grows segment by segment up to
+ * MAX_HEADER_SIZE bytes. Once the headers are complete, the request is handed to handle_http().
+ * A slow client therefore never blocks the other connections.
  * 
  * @param conn A pointer to a connection_t structure representing the client connection.
  * 
- * @return 0 on success, or 1 in case of an error.
+ * @return 0 once the request has been handled, CONN_PENDING if the headers are not complete yet,
+ *         or 1 in case of an error.
  */
 int handle_connection(connection_t* conn) {
   INFO("Handling connection...\n");
 
-  ssize_t total_bytes_read = 0;
-  conn->client_buffer_len = 0;
+  buffer_chain_t* request = &conn->request;
+  int too_large = 0;
+  size_t head_len = 0;
 
-  while(1) {
-    ssize_t bytes_read = read(conn->client_fd, conn->client_buffer + total_bytes_read, sizeof(conn->client_buffer) - total_bytes_read);
+  // Reading stops at the end of the headers, the body is relayed once connected
+  int headers_end = read_head(conn->client_fd, request, &conn->request_scan, &conn->client_eof, &too_large, &head_len);
+  if (headers_end < 0) {
+    ERROR("ERROR when reading client request");
+    Log(LOG_LEVEL_ERROR, "[SERVER] ERROR when reading client request");
+    return 1;
+  }
 
-    if (bytes_read < 0) {
-      ERROR("ERROR when reading client request");
-      Log(LOG_LEVEL_ERROR, "[SERVER] ERROR when reading client request");
+  // Nothing received: an idle client does not hold a buffer
+  if (request->len == 0 && !conn->client_eof && !too_large) {
+    buffer_chain_clear(request);
+    return CONN_PENDING;
+  }
+  const char* start = request->head ? request->head->data : "";
+
+  if (request->len >= HTTP_METHOD_MAX_LEN && !is_http_method(start)) {
+    WARN("Unknown protocol.\n");
+    Log(LOG_LEVEL_WARN, "[SERVER] Client have write %zu bytes and http havn't been recognize...", request->len);
+    return 1;
+  }
+
+  if (headers_end) {
+    // The head is indexed once, the later stages read the index
+    if (attach_request_head(conn) != 0) return 1;
+    http_head_t* head = conn->request_head;
+    free_http_head(head);
+    if (parse_http_head(request, 0, head) != 0 || !is_http_method_name(head->method.data, head->method.len) ||
+        !head->host.data || init_request_body(&conn->request_body, head) != 0) {
+      WARN("Invalid request, Sending HTTP 400 Bad Request\n");
+      Log(LOG_LEVEL_WARN, "[SERVER] Client %s sent an invalid request", conn->client_ip);
+      write_on_socket_http_from_buffer(conn->client_fd, HTTP_400_RESPONSE, sizeof(HTTP_400_RESPONSE) - 1);
       return 1;
     }
+    conn->head_request = head->head_method;
+    conn->keep_server = http_head_keep_alive(head);
+    conn->keep_client = conn->keep_server;
+    conn->response_started = 0;
+    conn->nb_requests++;
 
-    if (bytes_read == 0) {
-      INFO("Client closed the connection.\n");
-      Log(LOG_LEVEL_INFO, "[SERVER] Client %d closed the connection", conn->client_fd);
+    // Bytes read past the headers start the body, the bytes past the body are the next requests
+    size_t extra = request->len - head_len;
+    size_t consumed = http_body_consume_chain(&conn->request_body, request, head_len);
+    if (conn->request_body.error) {
+      relay_until_close(conn);
+    } else if (consumed < extra && buffer_chain_split(request, head_len + consumed, &conn->pipelined) != 0) {
       return 1;
     }
 
-    total_bytes_read += bytes_read;
-    conn->client_buffer_len = total_bytes_read;
-    if (conn->client_buffer_len < (ssize_t)sizeof(conn->client_buffer)) {
-      conn->client_buffer[conn->client_buffer_len] = '\0';
-    } else {
-      conn->client_buffer[sizeof(conn->client_buffer) - 1] = '\0';
+    // The chain is kept: it is sent once the connection to the server is established
+    int ret = handle_http(conn);
+    if (ret != 0) { return 1; }
+    return 0;
+  }
+
+  if (conn->client_eof) {
+    INFO("Client closed the connection.\n");
+    Log(LOG_LEVEL_INFO, "[SERVER] Client %d closed the connection", conn->client_fd);
+    return 1;
+  }
+
+  if (too_large) {
+    Log(LOG_LEVEL_WARN, "[SERVER] This http request is to huge to handle.");
+    WARN("Request too large to handle.\n");
+    return 1;
+  }
+
+  INFO("Request of client %d not complete yet (%zu bytes)\n", conn->client_fd, request->len);
+  return CONN_PENDING;
+}
+
+/**
+ * @brief Starts a new non-blocking connection to the remote server, without looking at the pool.
+ * 
+ * @param conn A pointer to a connection_t structure representing the client connection.
+ * @param addr The address of the remote server.
+ * @param addr_len The length of the address.
+ * 
+ * @return 0 if the connection is in progress, 3 if the socket cannot be created, 4 if connect() failed.
+ */
+static int open_server_connection(connection_t* conn, const struct sockaddr* addr, socklen_t addr_len) {
+    int sockfd = socket(addr->sa_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (sockfd == -1) {
+        ERROR("server socket creation failed");
+        Log(LOG_LEVEL_ERROR, "[SERVER] server socket creation failed");
+        return 3;
     }
-    
-    if (is_http_method(conn->client_buffer) && is_http_request_complete(conn->client_buffer)) {
-      int ret = handle_http(conn);
-      if (ret == 1) { return 1; }
-      memset(conn->client_buffer, 0, sizeof(conn->client_buffer));
-      conn->client_buffer_len = 0;
-      total_bytes_read = 0;
-      return 0;
-    }
-
-    if (total_bytes_read == BUFFER_SIZE) {
-      if (!is_http_method(conn->client_buffer)) {
-        WARN("Unknown protocol.\n");
-        Log(LOG_LEVEL_WARN, "[SERVER] Client have write %d bytes and http havn't been recognize...", total_bytes_read);
-      } else {
-        Log(LOG_LEVEL_WARN, "[SERVER] This http request is to huge to handle.");
-        WARN("Request too large to handle.\n");
-      }
-      return 1;
+
+    // A local server may accept at once, otherwise the handshake goes on in the background
+    if (connect(sockfd, addr, addr_len) == -1 && errno != EINPROGRESS) {
+        ERROR("Failed to connect");
+        Log(LOG_LEVEL_ERROR, "[SERVER] Failed to connect to %s", conn->server_ip);
+        close(sockfd);
+        return 4;
     }
-  }
-  return 0;
+
+    INFO("Connecting to %s (fd %d)\n", conn->server_ip, sockfd);
+    conn->server_fd = sockfd;
+    conn->state = CONN_STATE_CONNECTING;
+    return 0;
+}
+
+/**
+ * @brief Starts a non-blocking connection to the remote server.
+ * 
+ * The socket is stored in the connection, which switches to CONN_STATE_CONNECTING: the event
+ * loop reports the end of the handshake when the socket becomes writable. When the pool of the
+ * loop holds an idle connection to the same address and port, it is taken instead: its socket
+ * is writable at once, so the request is sent without a new handshake. The server may have
+ * closed it meanwhile: a request it can safely receive twice is then retried, see retry_request().
+ * 
+ * @param conn A pointer to a connection_t structure representing the client connection.
+ * @param addr The address of the remote server.
+ * @param addr_len The length of the address.
+ * 
+ * @return 0 if the connection is in progress, 3 if the socket cannot be created, 4 if connect() failed.
+ */
+static int connect_to_server(connection_t* conn, const struct sockaddr* addr, socklen_t addr_len) {
+    conn->retryable = 0;
+    if (addr->sa_family == AF_INET) {
+        memcpy(&conn->server_addr, addr, sizeof(struct sockaddr_in));
+        inet_ntop(AF_INET, &conn->server_addr.sin_addr, conn->server_ip, sizeof(conn->server_ip));
+
+        int idle_fd = conn->upstreams ? upstream_pool_get(conn->upstreams, &conn->server_addr) : -1;
+        if (idle_fd >= 0) {
+            INFO("Reusing connection %d to %s\n", idle_fd, conn->server_ip);
+            Log(LOG_LEVEL_INFO, "[SERVER] Reusing an idle connection to %s", conn->server_ip);
+            conn->server_fd = idle_fd;
+            conn->state = CONN_STATE_CONNECTING;
+            const http_head_t* head = conn->request_head;
+            conn->retryable = head && conn->request_body.done && is_idempotent_method(head->method.data, head->method.len);
+            return 0;
+        }
+    }
+    return open_server_connection(conn, addr, addr_len);
+}
+
+/**
+ * @brief Headers whose value is searched for banned words, along with the target of the request.
+ */
+static const char* const word_filtered_headers[] = { "Host", "Referer", NULL };
+
+/**
+ * @brief Searches the target and the filtered headers of a request for banned words.
+ * 
+ * Every word is searched in a single pass over each field, through the automaton of the rules.
+ * 
+ * @param conn A pointer to a connection_t structure whose request head is parsed.
+ * 
+ * @return 1 if a banned word was found, which is logged with its category, 0 otherwise.
+ */
+static int is_request_word_banned(const connection_t* conn) {
+    const rules_t* set = current_rules();
+    const http_head_t* head = conn->request_head;
+    const char* word = NULL;
+    const char* field = "target";
+    int category = find_banned_word(set, head->target.data, head->target.len, &word);
+
+    for (int i = 0; category < 0 && i < head->nb_headers; i++) {
+        const http_header_t* header = &head->headers[i];
+        for (int j = 0; word_filtered_headers[j]; j++) {
+            size_t len = strlen(word_filtered_headers[j]);
+            if (header->name.len == len && strncasecmp(header->name.data, word_filtered_headers[j], len) == 0) {
+                category = find_banned_word(set, header->value.data, header->value.len, &word);
+                field = word_filtered_headers[j];
+                break;
+            }
+        }
+    }
+    if (category < 0) return 0;
+
+    WARN("Word '%s' of the category '%s' found in the %s, Sending HTTP 403 Forbiden\n", word, set->rules[category].name, field);
+    Log(LOG_LEVEL_WARN, "[RULES] Word %s banned from category : %s, found in the %s of the request of %s",
+        word, set->rules[category].name, field, conn->client_ip);
+    return 1;
 }
 
 /**
@@ -185,16 +383,23 @@ int handle_connection(connection_t* conn) {
  * This function handles the logic for processing an HTTP request, including retrieving the host, checking 
  * if the host is allowed, resolving DNS if necessary, and connecting to the remote host. It also handles 
  * specific cases, such as requests to localhost or HTTPS format requests, and sends appropriate responses (e.g., 404, 403).
+ * The connection to the remote host is only started here, the request is sent by handle_server_connected().
+ * When the host is not in the DNS cache and the connection has a resolver, the query is sent and the
+ * connection switches to CONN_STATE_RESOLVING until handle_dns_resolved() is called.
  * 
  * @param conn A pointer to a connection_t structure representing the client connection.
  * 
- * @return 0 on success, or 1 in case of an error.
+ * @return 0 when the connection to the server or the resolution of the host is in progress,
+ *         or non-zero in case of an error.
  */
 int handle_http(connection_t* conn) {
     INFO("Handle HTTP function\n");
     
+    // The request has been indexed by parse_http_head()
+    const http_head_t* head = conn->request_head;
     char host[256] = {0};
-    if (get_http_host(conn->client_buffer, host, sizeof(host)) == 0) {
+    if (head && head->host.data && head->host.len > 0 && head->host.len < sizeof(host)) {
+        memcpy(host, head->host.data, head->host.len);
         INFO("Host: %s\n", host);
     } else {
         WARN("Failed to retrieve host from request.\n");
@@ -202,57 +407,33 @@ int handle_http(connection_t* conn) {
         return 1;
     }
 
-    Log(LOG_LEVEL_INFO, "[SERVER] %s asked for %s", conn->client_ip, host);
+    Log(LOG_LEVEL_INFO, "[SERVER] %s asked for %s (%.*s %.*s)", conn->client_ip, host,
+        (int)head->method.len, head->method.data, (int)head->target.len, head->target.data);
     INFO("Checking if host '%s's is allowed ...\n", host);
 
-    if (is_host_deny(host)) {
+    if (is_host_deny(conn->verdicts, host)) {
         WARN("%s is deny by the bocklist, Sending HTTP 403 Forbiden\n", host);
-        write_on_socket_http_from_buffer(conn->client_fd, HTTP_403_RESPONSE, sizeof(HTTP_403_RESPONSE));
+        write_on_socket_http_from_buffer(conn->client_fd, HTTP_403_RESPONSE, sizeof(HTTP_403_RESPONSE) - 1);
         return 1;
     };
 
+    if (is_request_word_banned(conn)) {
+        write_on_socket_http_from_buffer(conn->client_fd, HTTP_403_RESPONSE, sizeof(HTTP_403_RESPONSE) - 1);
+        return 1;
+    }
+
     INFO("The host %s is allowed\n", host);
     char* ip = NULL;
     char* port = NULL;
-    int sockfd = -1;
     struct addrinfo *res = NULL;
 
-    // handle the case where client ask for GET http://localhost:port/item HTTP/1.1
-    // serveur return 404 NOT FOUND, so we have to change the request to : GET /item HTTP/1.1
-    if (replace_localhost_with_ip(host)) {
-        char* get_pos = strstr(conn->client_buffer, "GET http://localhost");
-        if (get_pos) {
-            char* path_start = strchr(get_pos, '/');  // Find the first /
-            if (path_start) {
-                path_start = strchr(path_start + 2, '/');  // go to the last /
-                if (path_start) {
-                    char* http_version = strstr(path_start, " HTTP/1.1"); // got to the end (start of HTTP version protocol)
-                    if (http_version) {
-                        char new_line[1024];
-                        snprintf(new_line, sizeof(new_line), "GET %.*s HTTP/1.1\r\n", (int)(http_version - path_start), path_start); // write the new line;
-
-                        // find fisrt end of line
-                        char* end_of_line = strstr(conn->client_buffer, "\r\n");
-                        if (end_of_line) {
-                            memmove(get_pos, new_line, strlen(new_line)); // replace the line by new line
-
-                            // adjust the rest of the buffer
-                            // get_pos + strlen(new_line) => end of the line
-                            // end_of_line + 2 => for the \r\n
-                            // strlen(end_of_line + 2) +1 => to copy the rest of the buffer + 1 (\0)
-                            memmove(get_pos + strlen(new_line), end_of_line + 2, strlen(end_of_line + 2) + 1);
-                        }
-                    }
-                }
-            }
-        }
-        INFO("Localhost case handled\n");
-    }
+    // The request line is rewritten when it is sent, localhost is reached on its IP
+    replace_localhost_with_ip(host);
 
     if (is_host_https_format(host)) {
         WARN("client %s ask https format for %s\n, Sending a 404 not found", conn->client_ip, host);
         Log(LOG_LEVEL_WARN, "[SERVER] Client %s ask HTTPS format, Sending 404 not found", conn->client_ip);
-        write_on_socket_http_from_buffer(conn->client_fd, HTTP_404_RESPONSE, sizeof(HTTP_404_RESPONSE));
+        write_on_socket_http_from_buffer(conn->client_fd, HTTP_404_RESPONSE, sizeof(HTTP_404_RESPONSE) - 1);
         return 1;
     }
     // If the format of host is IP:Port, we don't solve the DNS and connect
@@ -273,73 +454,653 @@ int handle_http(connection_t* conn) {
             return 1;
         }
 
-        // Creating the server socket
-        sockfd = socket(AF_INET, SOCK_STREAM, 0);
-        if (sockfd == -1) {
-            ERROR("server socket creation failed");
-            Log(LOG_LEVEL_ERROR, "[SERVER] server socket creation failed");
-            write_on_socket_http_from_buffer(conn->client_fd, HTTP_404_RESPONSE, sizeof(HTTP_404_RESPONSE));
-            free(ip);
-            free(port);
-            return 3;
-        }
-
-        if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) == -1) {
-            ERROR("Failed to connect");
-            Log(LOG_LEVEL_ERROR, "[SERVER] Failed to connect to %s", ip);
-            write_on_socket_http_from_buffer(conn->client_fd, HTTP_404_RESPONSE, sizeof(HTTP_404_RESPONSE));
-            close(sockfd);
+        int ret = connect_to_server(conn, (struct sockaddr *)&serv_addr, sizeof(serv_addr));
+        if (ret != 0) {
+            write_on_socket_http_from_buffer(conn->client_fd, HTTP_404_RESPONSE, sizeof(HTTP_404_RESPONSE) - 1);
             free(ip);
             free(port);
-            return 4;
+            return ret;
         }
 
-        INFO("Connected to %s on port %s\n", ip, port);
-        Log(LOG_LEVEL_INFO, "[SERVER] Connected to %s on port %s", ip, port);
+        INFO("Connecting to %s on port %s\n", ip, port);
+        Log(LOG_LEVEL_INFO, "[SERVER] Connecting to %s on port %s", ip, port);
         free(ip);
         free(port);
     } else {
         // Else: DNS resolution and connection
         char ipstr[INET6_ADDRSTRLEN];
+        struct in_addr addr;
+
+        // Names the system resolves without network (numeric, localhost) are not sent to the DNS client
+        int is_local = inet_pton(AF_INET, host, &addr) == 1 || strcmp(host, "localhost") == 0;
+        if (find_in_cache(host, ipstr, NULL) != 0 && conn->resolver && !is_local) {
+            if (dns_client_query(conn->resolver, host, conn) == 0) {
+                INFO("Waiting for the resolution of %s\n", host);
+                conn->state = CONN_STATE_RESOLVING;
+                return 0;
+            }
+            WARN("DNS client unavailable, resolving %s synchronously\n", host);
+        }
 
         if (resolve_dns(host, &res, ipstr) != 0) {
             return 2; 
         }
 
-        // Creating the socket
-        sockfd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
-        if (sockfd == -1) {
-            ERROR("dns socket creation failed");
-            freeaddrinfo(res);
-            return 3;
+        int ret = connect_to_server(conn, res->ai_addr, res->ai_addrlen);
+        freeaddrinfo(res);
+        if (ret != 0) {
+            return ret;
         }
 
-        if (connect(sockfd, res->ai_addr, res->ai_addrlen) == -1) {
-            ERROR("Failed to connect");
-            close(sockfd);
-            freeaddrinfo(res);
-            return 4;
+        INFO("Connecting to %s on port 80\n", ipstr);
+        Log(LOG_LEVEL_INFO, "[SERVER] Connecting to %s on port 80", ipstr);
+    }
+
+    INFO("End of handle_http\n");
+    return 0;
+}
+
+/**
+ * @brief Connects to the server once the DNS client resolved the host of the request.
+ * 
+ * The address is added to the DNS cache, then the connection to port 80 is started and
+ * the connection switches to CONN_STATE_CONNECTING.
+ * 
+ * @param conn A pointer to a connection_t structure in CONN_STATE_RESOLVING.
+ * @param host The hostname that was resolved.
+ * @param status 0 if the host was resolved, -1 otherwise.
+ * @param addr The IPv4 address of the host, NULL on failure.
+ * @param ttl The time to live of the answer in seconds, the address is cached that long.
+ * 
+ * @return 0 when the connection to the server is in progress, or non-zero in case of an error.
+ */
+int handle_dns_resolved(connection_t* conn, const char* host, int status, const struct in_addr* addr, uint32_t ttl) {
+    if (status != 0) {
+        ERROR("Failed to resolve %s\n", host);
+        Log(LOG_LEVEL_ERROR, "[SERVER] Failed to resolve %s for %s", host, conn->client_ip);
+        return 2;
+    }
+
+    struct sockaddr_in serv_addr;
+    memset(&serv_addr, 0, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_port = htons(80);
+    serv_addr.sin_addr = *addr;
+
+    char ipstr[INET6_ADDRSTRLEN];
+    inet_ntop(AF_INET, addr, ipstr, sizeof(ipstr));
+
+    struct addrinfo info;
+    memset(&info, 0, sizeof(info));
+    info.ai_family = AF_INET;
+    info.ai_socktype = SOCK_STREAM;
+    info.ai_addr = (struct sockaddr *)&serv_addr;
+    info.ai_addrlen = sizeof(serv_addr);
+    if (add_in_cache(host, ipstr, &info, ttl) != 0) {
+        ERROR("Failed to add DNS resolution to cache.\n");
+        Log(LOG_LEVEL_ERROR, "[DNS CACHE] failled to add DNS resolution");
+    }
+
+    int ret = connect_to_server(conn, (struct sockaddr *)&serv_addr, sizeof(serv_addr));
+    if (ret != 0) {
+        return ret;
+    }
+
+    INFO("Connecting to %s on port 80\n", ipstr);
+    Log(LOG_LEVEL_INFO, "[SERVER] Connecting to %s on port 80", ipstr);
+    return 0;
+}
+
+/**
+ * @brief Change made to the request head while it is sent: bytes dropped, others inserted in their place.
+ */
+typedef struct {
+  const char* start;               /**< First byte dropped, inside a segment of the request chain */
+  size_t len;                      /**< Number of bytes dropped, within the same segment */
+  const char* insert;              /**< Bytes sent in their place, NULL if none */
+  size_t insert_len;               /**< Number of bytes inserted */
+} head_edit_t;
+
+/**
+ * @brief Most changes made to a request head: the target, every header line, and the lines added at its end.
+ */
+#define HEAD_MAX_EDITS (HTTP_MAX_HEADERS + 2)
+
+/**
+ * @brief Name under which the proxy appears in the Via header.
+ */
+#define VIA_PSEUDONYM "proxy"
+
+/**
+ * @brief Finds the end of a header line, past its line feed.
+ * 
+ * The parser found the line feed in the segment holding the header, after its value.
+ */
+static const char* header_line_end(const http_header_t* header) {
+    const char* p = header->value.data + header->value.len;
+    while (*p != '\n') p++;
+    return p + 1;
+}
+
+/**
+ * @brief Sends the request chain of a connection, edited on the fly.
+ * 
+ * An absolute-form target is sent in origin form, the hop-by-hop headers are dropped, and the
+ * client and the proxy are recorded in X-Forwarded-For and Via, appended to the headers of
+ * previous proxies when there are some. The changes are not made in the segments: the
+ * unchanged pieces of the chain and the inserted bytes are gathered in one vectored write,
+ * so nothing is shifted in memory. The bytes the server does not accept at once stay queued
+ * in the request chain, which the relay flushes. A retryable request accepted whole stays in
+ * its chain, marked as sent, until the response starts.
+ * 
+ * @param conn A pointer to a connection_t structure whose server is connected.
+ * 
+ * @return The number of bytes written, or -1 on error.
+ */
+static ssize_t send_request(connection_t* conn) {
+    head_edit_t edits[HEAD_MAX_EDITS];
+    int nb_edits = 0;
+    char forwarded[INET_ADDRSTRLEN + 2];
+    char via[sizeof(", 1.1 " VIA_PSEUDONYM)];
+    char added[sizeof("X-Forwarded-For: \r\nVia: 1.1 " VIA_PSEUDONYM "\r\n") + INET_ADDRSTRLEN];
+
+    const http_head_t* head = conn->request_head;
+    size_t prefix_len = 0;
+    int no_path = 0;
+    if (head && http_target_origin_form(&head->target, &prefix_len)) {
+        no_path = prefix_len == head->target.len || head->target.data[prefix_len] != '/';
+        // A request line longer than a segment is sent from its copy, edited the same way
+        if (!head->start_line) edits[nb_edits++] = (head_edit_t){ head->target.data, prefix_len, no_path ? "/" : NULL, no_path ? 1 : 0 };
+    }
+
+    if (head && head->end) {
+        const char* protocol = head->version.data + 5;
+        const http_header_t* last_forwarded = NULL;
+        const http_header_t* last_via = NULL;
+        char hop_by_hop[HTTP_MAX_HEADERS];
+        for (int i = 0; i < head->nb_headers; i++) {
+            const http_header_t* header = &head->headers[i];
+            hop_by_hop[i] = http_header_hop_by_hop(head, header);
+            if (hop_by_hop[i]) continue;
+            if (header->name.len == 15 && strncasecmp(header->name.data, "X-Forwarded-For", 15) == 0) last_forwarded = header;
+            else if (header->name.len == 3 && strncasecmp(header->name.data, "Via", 3) == 0) last_via = header;
         }
 
-        INFO("Connected to %s on port 80\n", ipstr);
-        Log(LOG_LEVEL_INFO, "[SERVER] Connected to %s on port 80", ipstr);
-        freeaddrinfo(res);
+        // Headers are indexed in the order received, so the edits stay sorted
+        for (int i = 0; i < head->nb_headers; i++) {
+            const http_header_t* header = &head->headers[i];
+            if (hop_by_hop[i]) {
+                edits[nb_edits++] = (head_edit_t){ header->name.data, header_line_end(header) - header->name.data, NULL, 0 };
+            } else if (header == last_forwarded) {
+                int len = snprintf(forwarded, sizeof(forwarded), ", %s", conn->client_ip);
+                edits[nb_edits++] = (head_edit_t){ header->value.data + header->value.len, 0, forwarded, len };
+            } else if (header == last_via) {
+                int len = snprintf(via, sizeof(via), ", %.3s " VIA_PSEUDONYM, protocol);
+                edits[nb_edits++] = (head_edit_t){ header->value.data + header->value.len, 0, via, len };
+            }
+        }
+
+        int len = 0;
+        if (!last_forwarded) len += snprintf(added + len, sizeof(added) - len, "X-Forwarded-For: %s\r\n", conn->client_ip);
+        if (!last_via) len += snprintf(added + len, sizeof(added) - len, "Via: %.3s " VIA_PSEUDONYM "\r\n", protocol);
+        if (len > 0) edits[nb_edits++] = (head_edit_t){ head->end, 0, added, len };
     }
 
-    // Writing the client's buffer on socker
-    if (write_on_socket_http_from_buffer(sockfd, conn->client_buffer, conn->client_buffer_len) != 0) {
-        ERROR("Error while writing on the socket to the host %s, IP %s", host, conn->server_ip);
-        Log(LOG_LEVEL_ERROR, "[SERVER] Error while writing on the socket to the host %s, IP %s", host, conn->server_ip);
+    buffer_chain_t rest;
+    init_buffer_chain(&rest, conn->request.pool);
+    buffer_chain_writer_t writer;
+    init_buffer_chain_writer(&writer, conn->server_fd, &rest);
 
-        close(sockfd);
+    size_t skip = 0;
+    if (head && head->start_line) {
+        const char* target = head->target.data;
+        const char* line_end = head->start_line + head->start_line_len;
+        buffer_chain_writer_add(&writer, head->start_line, target - head->start_line);
+        if (no_path) buffer_chain_writer_add(&writer, "/", 1);
+        buffer_chain_writer_add(&writer, target + prefix_len, line_end - target - prefix_len);
+        skip = head->start_line_len;
+    }
+
+    // Edits are sorted, each one lies in a single segment
+    int edit = 0;
+    for (buffer_segment_t* segment = conn->request.head; segment; segment = segment->next) {
+        const char* p = segment->data + segment->sent;
+        const char* end = segment->data + segment->len;
+        size_t skipped = skip < (size_t)(end - p) ? skip : (size_t)(end - p);
+        p += skipped;
+        skip -= skipped;
+        while (edit < nb_edits && edits[edit].start >= p && edits[edit].start < end) {
+            buffer_chain_writer_add(&writer, p, edits[edit].start - p);
+            if (edits[edit].insert) buffer_chain_writer_add(&writer, edits[edit].insert, edits[edit].insert_len);
+            p = edits[edit].start + edits[edit].len;
+            edit++;
+        }
+        buffer_chain_writer_add(&writer, p, end - p);
+    }
+
+    ssize_t sent = buffer_chain_writer_flush(&writer);
+    if (conn->retryable && (sent < 0 || rest.len == 0)) {
+        buffer_chain_clear(&rest);
+        if (sent < 0) return sent;
+        for (buffer_segment_t* segment = conn->request.head; segment; segment = segment->next) segment->sent = segment->len;
+        conn->request.len = 0;
+        return sent;
+    }
+    conn->retryable = 0;
+    buffer_chain_clear(&conn->request);
+    conn->request = rest;
+    return sent;
+}
+
+/**
+ * @brief Completes the connection to the remote server and sends it the client request.
+ * 
+ * Called by the event loop once the socket of a connection in CONN_STATE_CONNECTING becomes
+ * writable. The result of the handshake is read with SO_ERROR: on failure the client receives
+ * a 404, as when the host cannot be reached; on success the buffered request is written to
+ * the server without blocking, its target in origin form, and the connection switches to CONN_STATE_RELAYING, the part
+ * of the request the server did not accept yet is sent by the relay. With SPLICE enabled, the
+ * relay pipes are opened so that the payload is then moved without entering user space.
+ * 
+ * @param conn A pointer to a connection_t structure representing the client connection.
+ * 
+ * @return 0 on success, CONN_RETRY if a reused connection turned out closed, or 1 in case of an error.
+ */
+int handle_server_connected(connection_t* conn) {
+    int so_error = 0;
+    socklen_t len = sizeof(so_error);
+    if (getsockopt(conn->server_fd, SOL_SOCKET, SO_ERROR, &so_error, &len) != 0 || so_error != 0) {
+        if (conn->retryable) return CONN_RETRY;
+        ERROR("Failed to connect to %s: %s\n", conn->server_ip, strerror(so_error));
+        Log(LOG_LEVEL_ERROR, "[SERVER] Failed to connect to %s: %s", conn->server_ip, strerror(so_error));
+        write_on_socket_http_from_buffer(conn->client_fd, HTTP_404_RESPONSE, sizeof(HTTP_404_RESPONSE) - 1);
         return 1;
-    } else {
-        INFO("Writing OK\n");
-        Log(LOG_LEVEL_INFO, "[SERVER] Client %d have write %d bytes to server", conn->client_fd, conn->client_buffer_len);
     }
+    INFO("Connected to %s (fd %d)\n", conn->server_ip, conn->server_fd);
+    Log(LOG_LEVEL_INFO, "[SERVER] Connected to %s", conn->server_ip);
 
-    conn->server_fd = sockfd;
+    // Writing the request headers on socket, what the server does not accept yet stays queued
+    ssize_t sent = send_request(conn);
+    if (sent < 0) {
+        if (conn->retryable) return CONN_RETRY;
+        ERROR("Error while writing on the socket to IP %s", conn->server_ip);
+        Log(LOG_LEVEL_ERROR, "[SERVER] Error while writing on the socket to IP %s", conn->server_ip);
+        return 1;
+    }
+    INFO("Writing OK\n");
+    Log(LOG_LEVEL_INFO, "[SERVER] Client %d have write %zd bytes to server", conn->client_fd, sent);
 
-    INFO("End of handle_http\n");
+    conn->state = CONN_STATE_RELAYING;
+
+    // Without pipes, the payload goes through the buffers of the connection, the pipes
+    // of a persistent client connection are kept for its next requests
+    if (current_config()->splice && !conn->splicing) open_relay_pipes(conn);
+    return 0;
+}
+
+/**
+ * @brief Starts scanning the body of a response for banned words, when it is filtered.
+ * 
+ * Only text bodies are scanned, when FILTER_RESPONSES is on and some words are banned.
+ * The scanner follows the framing of the body from its first byte, with the words of the
+ * current rules, which it keeps a reference on so that a reload does not change them.
+ * 
+ * @param conn A pointer to a connection_t structure whose response body has been framed.
+ * @param head The head of the response.
+ * 
+ * @return 0 on success, or -1 if the scanner could not be attached.
+ */
+static int start_response_filter(connection_t* conn, const http_head_t* head) {
+    _Static_assert(sizeof(response_filter_t) <= BUFFER_SIZE, "the response scanner must fit in a pooled buffer");
+    body_coding_t coding;
+    if (!current_config()->filter_responses || current_rules()->words.nb_words == 0 || conn->response_body.done
+        || !body_filter_applies(head, &coding)) {
+        return 0;
+    }
+
+    conn->response_filter = conn->buffers ? (response_filter_t*)buffer_pool_get(conn->buffers) : malloc(sizeof(response_filter_t));
+    if (!conn->response_filter) {
+        ERROR("Failed to attach the response scanner\n");
+        Log(LOG_LEVEL_ERROR, "[SERVER] Failed to attach the response scanner to client %d", conn->client_fd);
+        return -1;
+    }
+    conn->response_filter->rules = acquire_rules();
+    if (init_body_filter(&conn->response_filter->scanner, &conn->response_body, coding, &conn->response_filter->rules->words) != 0) {
+        release_response_filter(conn);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Scans the next bytes of a filtered response body for banned words.
+ * 
+ * @param conn A pointer to a connection_t structure.
+ * @param data The bytes of the body, as received from the server.
+ * @param len The number of bytes.
+ * 
+ * @return 1 if a banned word was found, which is logged with its category, 0 otherwise.
+ */
+int filter_response_body(connection_t* conn, const char* data, size_t len) {
+    if (!conn->response_filter) return 0;
+
+    int index = body_filter_feed(&conn->response_filter->scanner, data, len);
+    if (index < 0) return 0;
+
+    const rules_t* set = conn->response_filter->rules;
+    const word_matcher_word_t* word = &set->words.words[index];
+    WARN("Word '%s' of the category '%s' found in the response of %s\n", word->word, set->rules[word->category].name, conn->server_ip);
+    Log(LOG_LEVEL_WARN, "[RULES] Word %s banned from category : %s, found in the response of %s to %s",
+        word->word, set->rules[word->category].name, conn->server_ip, conn->client_ip);
+    return 1;
+}
+
+/**
+ * @brief Gives the storage of the response scanner back.
+ * 
+ * @param conn A pointer to a connection_t structure.
+ */
+void release_response_filter(connection_t* conn) {
+    if (!conn->response_filter) return;
+
+    free_body_filter(&conn->response_filter->scanner);
+    release_rules(conn->response_filter->rules);
+    if (conn->buffers) buffer_pool_put(conn->buffers, (char*)conn->response_filter);
+    else free(conn->response_filter);
+    conn->response_filter = NULL;
+}
+
+/**
+ * @brief Reads the response headers of the server as they arrive.
+ * 
+ * Called by the relay until the headers are complete. They tell how the response body is
+ * delimited, so that the relay knows where the response ends and whether the connection to
+ * the server can carry another request. A response that is not HTTP/1.x, or an informational
+ * one (100 Continue, 101 Switching Protocols), is relayed as is until the connection closes.
+ * 
+ * @param conn A pointer to a connection_t structure in CONN_STATE_RELAYING.
+ * 
+ * @return 0 once the headers have been parsed, CONN_PENDING if they are not complete yet,
+ *         CONN_RETRY if a reused connection closed before answering, or 1 in case of an error.
+ */
+int handle_response(connection_t* conn) {
+    buffer_chain_t* response = &conn->response;
+    int too_large = 0;
+    size_t head_len = 0;
+
+    int head_end = read_head(conn->server_fd, response, &conn->response_scan, &conn->server_eof, &too_large, &head_len);
+    if (conn->retryable && response->len == 0 && (head_end < 0 || conn->server_eof)) return CONN_RETRY;
+    if (conn->retryable && response->len > 0) {
+        // The server answers, the request kept for a retry is not needed anymore
+        conn->retryable = 0;
+        buffer_chain_clear(&conn->request);
+    }
+    if (head_end < 0) {
+        ERROR("ERROR when reading server response");
+        Log(LOG_LEVEL_ERROR, "[SERVER] ERROR when reading the response of %s", conn->server_ip);
+        return 1;
+    }
+    if (too_large) {
+        WARN("Response headers too large to handle.\n");
+        Log(LOG_LEVEL_WARN, "[SERVER] Response headers of %s are too large", conn->server_ip);
+        return 1;
+    }
+
+    const char* start = response->head ? response->head->data : "";
+    int is_http = response->len < 5 ? strncmp(start, "HTTP/", response->len) == 0 : strncmp(start, "HTTP/", 5) == 0;
+    if (!head_end && is_http && !conn->server_eof) return CONN_PENDING;
+
+    http_head_t head;
+    if (!head_end || parse_http_head(response, 1, &head) != 0 || (head.status >= 100 && head.status < 200)) {
+        INFO("Relaying the response of %s until close\n", conn->server_ip);
+        relay_until_close(conn);
+        return 0;
+    }
+
+    conn->response_started = 1;
+    init_response_body(&conn->response_body, &head, conn->head_request);
+    if (start_response_filter(conn, &head) != 0) return 1;
+    if (!http_head_keep_alive(&head) || conn->response_body.kind == HTTP_BODY_UNTIL_CLOSE) {
+        conn->keep_server = 0;
+        conn->keep_client = 0;
+    }
+
+    // More bytes than the response: the server does not follow the framing it announced,
+    // the extra bytes are dropped so that the client only receives the response
+    size_t extra = response->len - head_len;
+    size_t consumed = http_body_consume_chain(&conn->response_body, response, head_len);
+    if (conn->response_body.error) {
+        conn->keep_server = 0;
+        conn->keep_client = 0;
+    } else if (consumed < extra) {
+        buffer_chain_t dropped;
+        init_buffer_chain(&dropped, response->pool);
+        if (buffer_chain_split(response, head_len + consumed, &dropped) != 0) return 1;
+        buffer_chain_clear(&dropped);
+        conn->keep_server = 0;
+    }
+    Log(LOG_LEVEL_INFO, "[SERVER] %s answered %d to %s", conn->server_ip, head.status, conn->client_ip);
+
+    // Nothing has been sent yet: a banned word in the first bytes blocks the whole response
+    if (conn->response_filter) {
+        for (const buffer_segment_t* segment = response->head; segment; segment = segment->next) {
+            size_t skip = head_len < segment->len ? head_len : segment->len;
+            head_len -= skip;
+            if (filter_response_body(conn, segment->data + skip, segment->len - skip)) {
+                write_on_socket_http_from_buffer(conn->client_fd, HTTP_403_RESPONSE, sizeof(HTTP_403_RESPONSE) - 1);
+                return 1;
+            }
+        }
+    }
     return 0;
 }
+
+/**
+ * @brief Sends the request again on a new connection, once a reused one closed before answering.
+ * 
+ * The server may close a connection kept idle in the pool just as it is reused. An idempotent
+ * request kept whole is then sent once more, on a connection which does not come from the pool.
+ * 
+ * @param conn A pointer to a connection_t structure whose reused server connection closed.
+ * 
+ * @return 0 if the new connection is in progress, or 1 in case of an error.
+ */
+int retry_request(connection_t* conn) {
+    INFO("Connection %d to %s closed before answering, sending the request again\n", conn->server_fd, conn->server_ip);
+    Log(LOG_LEVEL_INFO, "[SERVER] Idle connection to %s closed before answering, retrying on a new one", conn->server_ip);
+    close(conn->server_fd);
+    conn->server_fd = -1;
+    conn->retryable = 0;
+    conn->server_eof = 0;
+    conn->server_shutdown = 0;
+
+    conn->request.len = 0;
+    for (buffer_segment_t* segment = conn->request.head; segment; segment = segment->next) {
+        segment->sent = 0;
+        conn->request.len += segment->len;
+    }
+    buffer_chain_clear(&conn->response);
+    init_http_head_scanner(&conn->response_scan);
+    release_buffer(conn, CONN_SIDE_SERVER);
+
+    if (open_server_connection(conn, (struct sockaddr *)&conn->server_addr, sizeof(conn->server_addr)) != 0) {
+        write_on_socket_http_from_buffer(conn->client_fd, HTTP_404_RESPONSE, sizeof(HTTP_404_RESPONSE) - 1);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Gives up the framing of a connection, bytes are relayed both ways until it closes.
+ * 
+ * @param conn A pointer to a connection_t structure.
+ */
+void relay_until_close(connection_t* conn) {
+    init_http_body(&conn->request_body, HTTP_BODY_UNTIL_CLOSE, 0);
+    init_http_body(&conn->response_body, HTTP_BODY_UNTIL_CLOSE, 0);
+    conn->response_started = 1;
+    conn->keep_server = 0;
+    conn->keep_client = 0;
+}
+
+/**
+ * @brief Prepares a persistent client connection for its next request.
+ * 
+ * Called once the response has been relayed and the server connection released. The
+ * bytes the client sent past the previous request become the start of the next one, which
+ * is read, filtered and routed like the first.
+ * 
+ * @param conn A pointer to a connection_t structure whose exchange is over.
+ */
+void start_next_request(connection_t* conn) {
+    buffer_chain_clear(&conn->request);
+    buffer_chain_clear(&conn->response);
+    conn->request = conn->pipelined;
+    init_buffer_chain(&conn->pipelined, conn->request.pool);
+    init_http_head_scanner(&conn->request_scan);
+    init_http_head_scanner(&conn->response_scan);
+
+    release_request_head(conn);
+    release_response_filter(conn);
+    release_buffer(conn, CONN_SIDE_CLIENT);
+    release_buffer(conn, CONN_SIDE_SERVER);
+    conn->client_buffer_len = conn->client_buffer_sent = 0;
+    conn->server_buffer_len = conn->server_buffer_sent = 0;
+    init_http_body(&conn->request_body, HTTP_BODY_NONE, 0);
+    init_http_body(&conn->response_body, HTTP_BODY_NONE, 0);
+    conn->response_started = 0;
+    conn->head_request = 0;
+    conn->keep_server = 0;
+    conn->keep_client = 0;
+    conn->server_eof = 0;
+    conn->server_shutdown = 0;
+    conn->retryable = 0;
+    conn->server_ip[0] = '\0';
+    memset(&conn->server_addr, 0, sizeof(conn->server_addr));
+    conn->state = CONN_STATE_READING_REQUEST;
+}
+
+/**
+ * @brief Attaches an I/O buffer of BUFFER_SIZE bytes to one side of a connection, if it has none.
+ * 
+ * @param conn A pointer to a connection_t structure.
+ * @param side The side whose buffer is needed.
+ * 
+ * @return 0 on success, or -1 if no memory is left.
+ */
+int attach_buffer(connection_t* conn, conn_side_t side) {
+    char** buffer = side == CONN_SIDE_CLIENT ? &conn->client_buffer : &conn->server_buffer;
+    if (*buffer) return 0;
+
+    *buffer = conn->buffers ? buffer_pool_get(conn->buffers) : malloc(BUFFER_SIZE);
+    if (!*buffer) {
+        ERROR("Failed to attach a buffer\n");
+        Log(LOG_LEVEL_ERROR, "[SERVER] Failed to attach a buffer to client %d", conn->client_fd);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Gives the buffer of one side of a connection back, the bytes it holds are dropped.
+ * 
+ * @param conn A pointer to a connection_t structure.
+ * @param side The side whose buffer is released.
+ */
+void release_buffer(connection_t* conn, conn_side_t side) {
+    char** buffer = side == CONN_SIDE_CLIENT ? &conn->client_buffer : &conn->server_buffer;
+    if (!*buffer) return;
+
+    if (conn->buffers) buffer_pool_put(conn->buffers, *buffer);
+    else free(*buffer);
+    *buffer = NULL;
+}
+
+/**
+ * @brief Attaches the storage of the request index to a connection, if it has none.
+ * 
+ * The index is only needed while a request is in flight, so like the I/O buffers it is
+ * taken from the pool of the loop instead of growing every idle connection.
+ * 
+ * @param conn A pointer to a connection_t structure.
+ * 
+ * @return 0 on success, or -1 if no memory is left.
+ */
+int attach_request_head(connection_t* conn) {
+    _Static_assert(sizeof(http_head_t) <= BUFFER_SIZE, "the request index must fit in a pooled buffer");
+    if (conn->request_head) return 0;
+
+    conn->request_head = conn->buffers ? (http_head_t*)buffer_pool_get(conn->buffers) : malloc(sizeof(http_head_t));
+    if (!conn->request_head) {
+        ERROR("Failed to attach the request index\n");
+        Log(LOG_LEVEL_ERROR, "[SERVER] Failed to attach the request index to client %d", conn->client_fd);
+        return -1;
+    }
+    conn->request_head->start_line = NULL;
+    return 0;
+}
+
+/**
+ * @brief Gives the storage of the request index back.
+ * 
+ * @param conn A pointer to a connection_t structure.
+ */
+void release_request_head(connection_t* conn) {
+    if (!conn->request_head) return;
+
+    free_http_head(conn->request_head);
+    if (conn->buffers) buffer_pool_put(conn->buffers, (char*)conn->request_head);
+    else free(conn->request_head);
+    conn->request_head = NULL;
+}
+
+/**
+ * @brief Opens the pipes through which splice() relays the payload of a connection.
+ * 
+ * One pipe per direction, both non-blocking. splice() needs non-blocking sockets as well,
+ * so the client socket is switched to non-blocking mode.
+ * 
+ * @param conn A pointer to a connection_t structure in CONN_STATE_RELAYING.
+ * 
+ * @return 0 on success, or -1 if the pipes cannot be created, the buffers are then used.
+ */
+int open_relay_pipes(connection_t* conn) {
+    if (pipe2(conn->client_pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        WARN("Failed to create the relay pipes, relaying through buffers\n");
+        return -1;
+    }
+    if (pipe2(conn->server_pipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        WARN("Failed to create the relay pipes, relaying through buffers\n");
+        close(conn->client_pipe[0]);
+        close(conn->client_pipe[1]);
+        return -1;
+    }
+    if (set_socket_non_blocking(conn->client_fd) != 0) {
+        close(conn->client_pipe[0]);
+        close(conn->client_pipe[1]);
+        close(conn->server_pipe[0]);
+        close(conn->server_pipe[1]);
+        return -1;
+    }
+
+    conn->client_pipe_len = 0;
+    conn->server_pipe_len = 0;
+    conn->splicing = 1;
+    INFO("Relay pipes open for client %d / server %d\n", conn->client_fd, conn->server_fd);
+    return 0;
+}
+
+/**
+ * @brief Closes the relay pipes of a connection, if any.
+ * 
+ * @param conn A pointer to a connection_t structure.
+ */
+void close_relay_pipes(connection_t* conn) {
+    if (!conn->splicing) return;
+
+    close(conn->client_pipe[0]);
+    close(conn->client_pipe[1]);
+    close(conn->server_pipe[0]);
+    close(conn->server_pipe[1]);
+    conn->splicing = 0;
+}
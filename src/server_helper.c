@@ -25,9 +25,12 @@
 #include "../includes/utils.h"
 #include "../includes/logger.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <regex.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 #include <unistd.h>
 
 /**
@@ -216,6 +219,33 @@ int write_on_socket_http_from_buffer(int fd, char* buffer, int buffer_len) {
     return 0;
 }
 
+/**
+ * @brief Writes as much of a buffer as a socket accepts without blocking.
+ * 
+ * The caller keeps the bytes that were not sent and tries again once the socket is writable.
+ * 
+ * @param fd The file descriptor of the socket to write to.
+ * @param buffer The buffer containing the data to send.
+ * @param buffer_len The length of the buffer in bytes.
+ * 
+ * @return The number of bytes sent, possibly 0 if the socket is full, or -1 on error.
+ */
+ssize_t send_non_blocking(int fd, const char* buffer, size_t buffer_len) {
+  size_t total_sent = 0;
+
+  while (total_sent < buffer_len) {
+    ssize_t temp_send = send(fd, buffer + total_sent, buffer_len - total_sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (temp_send < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      if (errno == EINTR) continue;
+      ERROR("send on fd %d\n", fd);
+      return -1;
+    }
+    total_sent += temp_send;
+  }
+  return total_sent;
+}
+
 /**
  * @brief Reads data from a socket into a buffer.
  * 
@@ -248,3 +278,16 @@ int read_on_socket_http(int fd, char* buffer, int buffer_size) {
   return total_bytes_read;
 }
 
+/**
+ * @brief Switches a file descriptor to non-blocking mode.
+ * 
+ * @param fd The file descriptor to modify.
+ * 
+ * @return 0 on success, or -1 if the flags could not be read or written.
+ */
+int set_socket_non_blocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  if (flags == -1) return -1;
+  if (fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) return -1;
+  return 0;
+}
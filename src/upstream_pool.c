@@ -0,0 +1,215 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file upstream_pool.c
+ * @brief Implementation of the pool of idle connections to the origin servers.
+ */
+
+#include "../includes/upstream_pool.h"
+#include "../includes/utils.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * @brief Initializes an empty pool.
+ *
+ * @param pool The pool.
+ * @param max_idle_per_origin Most idle connections kept for one origin, 0 keeps none.
+ * @param max_idle Most idle connections kept in total.
+ * @param idle_timeout Milliseconds an idle connection is kept.
+ */
+void init_upstream_pool(upstream_pool_t* pool, int max_idle_per_origin, int max_idle, long long idle_timeout) {
+  memset(pool, 0, sizeof(upstream_pool_t));
+  init_pool(&pool->entries, sizeof(upstream_idle_t));
+  pool->max_idle_per_origin = max_idle_per_origin;
+  pool->max_idle = max_idle;
+  pool->idle_timeout = idle_timeout;
+}
+
+/**
+ * @brief Returns the bucket of an origin.
+ */
+static upstream_origin_t** origin_bucket(upstream_pool_t* pool, const struct sockaddr_in* addr) {
+  uint32_t hash = (uint32_t)addr->sin_addr.s_addr * 2654435761u ^ addr->sin_port;
+  return &pool->buckets[(hash ^ (hash >> 16)) & (UPSTREAM_POOL_BUCKETS - 1)];
+}
+
+/**
+ * @brief Finds an origin, its link in the bucket is returned so that it can be removed.
+ */
+static upstream_origin_t** find_origin(upstream_pool_t* pool, const struct sockaddr_in* addr) {
+  upstream_origin_t** link = origin_bucket(pool, addr);
+  while (*link && ((*link)->addr.s_addr != addr->sin_addr.s_addr || (*link)->port != addr->sin_port)) {
+    link = &(*link)->next;
+  }
+  return link;
+}
+
+/**
+ * @brief Closes an idle connection and gives its entry back.
+ */
+static void drop_idle(upstream_pool_t* pool, upstream_origin_t* origin, upstream_idle_t* idle) {
+  close(idle->fd);
+  pool_free(&pool->entries, idle);
+  origin->nb_idle--;
+  pool->nb_idle--;
+}
+
+/**
+ * @brief Removes an origin without idle connections.
+ */
+static void remove_origin(upstream_origin_t** link) {
+  upstream_origin_t* origin = *link;
+  *link = origin->next;
+  free(origin);
+}
+
+/**
+ * @brief Checks that the origin did not close an idle connection, or send bytes on it.
+ */
+static int is_idle_alive(int fd) {
+  char byte;
+  ssize_t ret = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  return ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+}
+
+/**
+ * @brief Takes an idle connection to an origin out of the pool.
+ *
+ * The most recently used connection is taken first. Connections the origin closed
+ * meanwhile are dropped.
+ *
+ * @param pool The pool.
+ * @param addr The address and port of the origin.
+ *
+ * @return The socket of the connection, or -1 if there is none.
+ */
+int upstream_pool_get(upstream_pool_t* pool, const struct sockaddr_in* addr) {
+  upstream_origin_t** link = find_origin(pool, addr);
+  upstream_origin_t* origin = *link;
+  if (!origin) return -1;
+
+  int fd = -1;
+  while (origin->idle && fd < 0) {
+    upstream_idle_t* idle = origin->idle;
+    origin->idle = idle->next;
+    if (is_idle_alive(idle->fd)) {
+      fd = idle->fd;
+      pool_free(&pool->entries, idle);
+      origin->nb_idle--;
+      pool->nb_idle--;
+    } else {
+      INFO("Idle connection %d closed by the origin\n", idle->fd);
+      drop_idle(pool, origin, idle);
+    }
+  }
+
+  if (!origin->idle) remove_origin(link);
+  return fd;
+}
+
+/**
+ * @brief Keeps a connection to an origin idle for the next request.
+ *
+ * @param pool The pool.
+ * @param addr The address and port of the origin.
+ * @param fd The socket, which must not be watched by the event loop anymore.
+ * @param now The current monotonic time in milliseconds.
+ *
+ * @return 0 if the connection is kept, -1 if the pool is full, the caller then closes it.
+ */
+int upstream_pool_put(upstream_pool_t* pool, const struct sockaddr_in* addr, int fd, long long now) {
+  if (pool->nb_idle >= pool->max_idle) return -1;
+
+  upstream_origin_t** link = find_origin(pool, addr);
+  upstream_origin_t* origin = *link;
+  if (origin && origin->nb_idle >= pool->max_idle_per_origin) return -1;
+  if (pool->max_idle_per_origin <= 0) return -1;
+
+  upstream_idle_t* idle = pool_alloc(&pool->entries);
+  if (!idle) return -1;
+  if (!origin) {
+    origin = calloc(1, sizeof(upstream_origin_t));
+    if (!origin) {
+      pool_free(&pool->entries, idle);
+      return -1;
+    }
+    origin->addr = addr->sin_addr;
+    origin->port = addr->sin_port;
+    *link = origin;
+  }
+
+  idle->fd = fd;
+  idle->idle_since = now;
+  idle->next = origin->idle;
+  origin->idle = idle;
+  origin->nb_idle++;
+  pool->nb_idle++;
+  return 0;
+}
+
+/**
+ * @brief Closes the connections idle for longer than the timeout of the pool.
+ *
+ * @param pool The pool.
+ * @param now The current monotonic time in milliseconds.
+ */
+void upstream_pool_expire(upstream_pool_t* pool, long long now) {
+  if (pool->nb_idle == 0) return;
+
+  for (int i = 0; i < UPSTREAM_POOL_BUCKETS; i++) {
+    upstream_origin_t** link = &pool->buckets[i];
+    while (*link) {
+      upstream_origin_t* origin = *link;
+
+      // The list is ordered by age, the expired connections are at its end
+      upstream_idle_t** idle = &origin->idle;
+      while (*idle && (*idle)->idle_since + pool->idle_timeout > now) idle = &(*idle)->next;
+      while (*idle) {
+        upstream_idle_t* expired = *idle;
+        *idle = expired->next;
+        drop_idle(pool, origin, expired);
+      }
+
+      if (!origin->idle) remove_origin(link);
+      else link = &origin->next;
+    }
+  }
+}
+
+/**
+ * @brief Closes every idle connection and frees the pool.
+ *
+ * @param pool The pool.
+ */
+void free_upstream_pool(upstream_pool_t* pool) {
+  for (int i = 0; i < UPSTREAM_POOL_BUCKETS; i++) {
+    while (pool->buckets[i]) {
+      upstream_origin_t* origin = pool->buckets[i];
+      while (origin->idle) {
+        upstream_idle_t* idle = origin->idle;
+        origin->idle = idle->next;
+        drop_idle(pool, origin, idle);
+      }
+      remove_origin(&pool->buckets[i]);
+    }
+  }
+  free_pool(&pool->entries);
+}
@@ -0,0 +1,198 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file verdict_cache.c
+ * @brief Implementation of the cache of the verdicts of the rules on hosts.
+ */
+
+#include "../includes/verdict_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/**
+ * @brief Initializes an empty cache, the entries are allocated by the first verdict put.
+ *
+ * @param cache The cache.
+ * @param capacity Most hosts kept, 0 keeps none.
+ */
+void init_verdict_cache(verdict_cache_t* cache, size_t capacity) {
+  memset(cache, 0, sizeof(verdict_cache_t));
+  cache->capacity = capacity < UINT32_MAX ? capacity : UINT32_MAX - 1;
+}
+
+/**
+ * @brief Allocates the entries and the index.
+ */
+static int allocate(verdict_cache_t* cache) {
+  size_t nb_slots = 16;
+  while (nb_slots < cache->capacity * 2) nb_slots *= 2;
+  cache->entries = aligned_alloc(64, cache->capacity * sizeof(verdict_entry_t));
+  cache->slots = calloc(nb_slots, sizeof(verdict_slot_t));
+  if (!cache->entries || !cache->slots) {
+    free(cache->entries);
+    free(cache->slots);
+    cache->entries = NULL;
+    cache->slots = NULL;
+    return -1;
+  }
+  cache->nb_slots = nb_slots;
+  return 0;
+}
+
+/**
+ * @brief Forgets every verdict when the rules have changed.
+ *
+ * @return 1 if the cache can hold the verdicts of the generation, 0 otherwise.
+ */
+static int sync_generation(verdict_cache_t* cache, uint64_t generation) {
+  if (!cache->slots) return 0;
+  if (cache->generation == generation) return 1;
+
+  memset(cache->slots, 0, cache->nb_slots * sizeof(verdict_slot_t));
+  cache->nb_entries = 0;
+  cache->hand = 0;
+  cache->generation = generation;
+  return 1;
+}
+
+/**
+ * @brief Finds the slot of the entry of a host.
+ *
+ * @return The slot of the entry, or the free slot where it would be added.
+ */
+static size_t find_slot(const verdict_cache_t* cache, const char* host, size_t len, uint32_t hash) {
+  size_t mask = cache->nb_slots - 1;
+  size_t index = hash & mask;
+  for (; cache->slots[index].entry; index = (index + 1) & mask) {
+    const verdict_slot_t* slot = &cache->slots[index];
+    if (slot->hash != hash) continue;
+    const verdict_entry_t* entry = &cache->entries[slot->entry - 1];
+    if (entry->len == len && strncasecmp(entry->host, host, len) == 0) return index;
+  }
+  return index;
+}
+
+/**
+ * @brief Removes a slot from the index, moving back the slots probed past it.
+ */
+static void remove_slot(verdict_cache_t* cache, size_t index) {
+  size_t mask = cache->nb_slots - 1;
+  for (size_t next = (index + 1) & mask; cache->slots[next].entry; next = (next + 1) & mask) {
+    // A slot moves back into the hole unless its home lies between the hole and it
+    size_t home = cache->slots[next].hash & mask;
+    if (((next - home) & mask) >= ((next - index) & mask)) {
+      cache->slots[index] = cache->slots[next];
+      index = next;
+    }
+  }
+  cache->slots[index].entry = 0;
+}
+
+/**
+ * @brief Frees an entry with the CLOCK policy.
+ *
+ * The hand skips the entries used since it last passed, clearing their bit, and takes the
+ * first one which was not. A host enters unreferenced, so hosts visited once leave before
+ * the ones visited again.
+ *
+ * @return The index of the entry freed, out of the index.
+ */
+static size_t evict(verdict_cache_t* cache) {
+  while (cache->entries[cache->hand].referenced) {
+    cache->entries[cache->hand].referenced = 0;
+    cache->hand = (cache->hand + 1) % cache->capacity;
+  }
+  size_t victim = cache->hand;
+  cache->hand = (cache->hand + 1) % cache->capacity;
+
+  const verdict_entry_t* entry = &cache->entries[victim];
+  remove_slot(cache, find_slot(cache, entry->host, entry->len, entry->hash));
+  return victim;
+}
+
+/**
+ * @brief Looks the verdict on a host up.
+ *
+ * @param cache The cache.
+ * @param generation The generation of the rules the verdict must come from.
+ * @param host The host, without port nor final dot, not necessarily NUL terminated.
+ * @param len The length of the host.
+ * @param hash The hash of the host, ignoring case (see domain_hash()).
+ * @param category Receives the category banning the host, -1 if it is allowed.
+ *
+ * @return 1 if the verdict was cached, 0 otherwise.
+ */
+int verdict_cache_get(verdict_cache_t* cache, uint64_t generation, const char* host, size_t len, uint32_t hash, int* category) {
+  if (len > VERDICT_CACHE_MAX_HOST || !sync_generation(cache, generation)) return 0;
+
+  const verdict_slot_t* slot = &cache->slots[find_slot(cache, host, len, hash)];
+  if (!slot->entry) return 0;
+
+  verdict_entry_t* entry = &cache->entries[slot->entry - 1];
+  entry->referenced = 1;
+  *category = entry->category;
+  return 1;
+}
+
+/**
+ * @brief Keeps the verdict on a host, evicting another one when the cache is full.
+ *
+ * @param cache The cache.
+ * @param generation The generation of the rules the verdict comes from.
+ * @param host The host, without port nor final dot, not necessarily NUL terminated.
+ * @param len The length of the host, longer hosts than VERDICT_CACHE_MAX_HOST are not kept.
+ * @param hash The hash of the host, ignoring case (see domain_hash()).
+ * @param category The category banning the host, -1 if it is allowed.
+ */
+void verdict_cache_put(verdict_cache_t* cache, uint64_t generation, const char* host, size_t len, uint32_t hash, int category) {
+  if (cache->capacity == 0 || len > VERDICT_CACHE_MAX_HOST) return;
+  if (!cache->slots && allocate(cache) != 0) return;
+  sync_generation(cache, generation);
+
+  size_t index = find_slot(cache, host, len, hash);
+  if (cache->slots[index].entry) {
+    cache->entries[cache->slots[index].entry - 1].category = category;
+    return;
+  }
+
+  size_t victim;
+  if (cache->nb_entries < cache->capacity) {
+    victim = cache->nb_entries++;
+  } else {
+    victim = evict(cache);
+    index = find_slot(cache, host, len, hash);
+  }
+
+  verdict_entry_t* entry = &cache->entries[victim];
+  entry->hash = hash;
+  entry->category = category;
+  entry->len = len;
+  entry->referenced = 0;
+  memcpy(entry->host, host, len);
+  cache->slots[index] = (verdict_slot_t){ hash, victim + 1 };
+}
+
+/**
+ * @brief Frees the entries and the index of a cache, which keeps its capacity.
+ *
+ * @param cache The cache.
+ */
+void free_verdict_cache(verdict_cache_t* cache) {
+  free(cache->entries);
+  free(cache->slots);
+  init_verdict_cache(cache, cache->capacity);
+}
@@ -0,0 +1,245 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file word_matcher.c
+ * @brief Implementation of the Aho-Corasick matcher of banned words.
+ */
+
+#include "../includes/word_matcher.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Bit of a transition set when a word ends at the state it leads to.
+ *
+ * The transitions hold the offset of the row of the next state, so the scan neither
+ * multiplies nor loads anything else to learn that nothing matched.
+ */
+#define MATCH_FLAG 0x80000000u
+
+/**
+ * @brief Lowers the case of an ASCII letter.
+ */
+static inline unsigned char fold(unsigned char c) {
+  return c >= 'A' && c <= 'Z' ? c | 0x20 : c;
+}
+
+/**
+ * @brief Initializes an empty matcher.
+ *
+ * @param matcher The matcher.
+ */
+void init_word_matcher(word_matcher_t* matcher) {
+  memset(matcher, 0, sizeof(word_matcher_t));
+}
+
+/**
+ * @brief Adds a word to the matcher, it is matched once the matcher is compiled again.
+ *
+ * @param matcher The matcher.
+ * @param word The word, NUL terminated, kept by the matcher until it is freed.
+ * @param category The index of the category banning the word.
+ *
+ * @return 0 on success, -1 if the word is empty or memory is short.
+ */
+int word_matcher_add(word_matcher_t* matcher, const char* word, uint32_t category) {
+  if (word[0] == '\0') return -1;
+  if (matcher->nb_words == matcher->words_capacity) {
+    size_t capacity = matcher->words_capacity ? matcher->words_capacity * 2 : 16;
+    word_matcher_word_t* words = realloc(matcher->words, capacity * sizeof(word_matcher_word_t));
+    if (!words) return -1;
+    matcher->words = words;
+    matcher->words_capacity = capacity;
+  }
+  matcher->words[matcher->nb_words++] = (word_matcher_word_t){ word, category };
+  return 0;
+}
+
+/**
+ * @brief Frees the tables of the automaton, keeping the words.
+ */
+static void free_tables(word_matcher_t* matcher) {
+  free(matcher->transitions);
+  free(matcher->matches);
+  matcher->transitions = NULL;
+  matcher->matches = NULL;
+  matcher->nb_states = 0;
+}
+
+/**
+ * @brief Builds the automaton of the words added so far.
+ *
+ * The words are inserted in a trie whose rows are indexed by byte class, then the rows
+ * are completed breadth first with the transitions of the failure links, which turns the
+ * trie into a deterministic automaton: the scan never follows a failure link.
+ *
+ * @param matcher The matcher.
+ *
+ * @return 0 on success, -1 if memory is short.
+ */
+int word_matcher_compile(word_matcher_t* matcher) {
+  free_tables(matcher);
+  memset(matcher->classes, 0, sizeof(matcher->classes));
+  matcher->nb_classes = 1;
+  if (matcher->nb_words == 0) return 0;
+
+  size_t max_states = 1;
+  for (size_t i = 0; i < matcher->nb_words; i++) {
+    for (const unsigned char* p = (const unsigned char*)matcher->words[i].word; *p; p++) {
+      unsigned char c = fold(*p);
+      if (!matcher->classes[c]) {
+        matcher->classes[c] = matcher->nb_classes;
+        if (c >= 'a' && c <= 'z') matcher->classes[c & ~0x20] = matcher->nb_classes;
+        matcher->nb_classes++;
+      }
+      max_states++;
+    }
+  }
+
+  size_t width = matcher->nb_classes;
+  if (max_states * width >= MATCH_FLAG) return -1;
+  uint32_t* next = calloc(max_states * width, sizeof(uint32_t));
+  int32_t* matches = malloc(max_states * sizeof(int32_t));
+  uint32_t* fail = malloc(max_states * sizeof(uint32_t));
+  uint32_t* queue = malloc(max_states * sizeof(uint32_t));
+  if (!next || !matches || !fail || !queue) {
+    free(next);
+    free(matches);
+    free(fail);
+    free(queue);
+    return -1;
+  }
+
+  // Trie of the words, 0 marks a missing child since the start state is nobody's child
+  size_t nb_states = 1;
+  matches[0] = -1;
+  for (size_t i = 0; i < matcher->nb_words; i++) {
+    uint32_t state = 0;
+    for (const unsigned char* p = (const unsigned char*)matcher->words[i].word; *p; p++) {
+      uint32_t* slot = &next[state * width + matcher->classes[*p]];
+      if (!*slot) {
+        matches[nb_states] = -1;
+        *slot = nb_states++;
+      }
+      state = *slot;
+    }
+    if (matches[state] < 0) matches[state] = i;
+  }
+
+  // Breadth first, the row of a failure link is complete before it is copied
+  size_t head = 0, tail = 0;
+  for (size_t c = 0; c < width; c++) {
+    if (next[c]) {
+      fail[next[c]] = 0;
+      queue[tail++] = next[c];
+    }
+  }
+  while (head < tail) {
+    uint32_t state = queue[head++];
+    const uint32_t* fallback = &next[fail[state] * width];
+    for (size_t c = 0; c < width; c++) {
+      uint32_t child = next[state * width + c];
+      if (!child) {
+        next[state * width + c] = fallback[c];
+        continue;
+      }
+      fail[child] = fallback[c];
+      if (matches[child] < 0) matches[child] = matches[fail[child]];
+      queue[tail++] = child;
+    }
+  }
+  free(fail);
+  free(queue);
+
+  for (size_t i = 0; i < nb_states * width; i++) {
+    uint32_t state = next[i];
+    next[i] = state * width | (matches[state] >= 0 ? MATCH_FLAG : 0);
+  }
+
+  uint32_t* transitions = realloc(next, nb_states * width * sizeof(uint32_t));
+  matcher->transitions = transitions ? transitions : next;
+  matcher->matches = matches;
+  matcher->nb_states = nb_states;
+  return 0;
+}
+
+/**
+ * @brief Checks an automaton mapped from a file before it scans a text.
+ *
+ * @param matcher The matcher, its words and compiled tables in place.
+ * @param nb_categories The number of categories the words may refer to.
+ *
+ * @return 1 if every transition leads to a state, flagged exactly when a word ends there,
+ *         and every state and word refer to a word and a category; 0 otherwise.
+ */
+int word_matcher_check(const word_matcher_t* matcher, size_t nb_categories) {
+  for (size_t i = 0; i < matcher->nb_words; i++) {
+    if (matcher->words[i].category >= nb_categories) return 0;
+  }
+  for (size_t i = 0; i < matcher->nb_states; i++) {
+    if (matcher->matches[i] < -1 || (matcher->matches[i] >= 0 && (size_t)matcher->matches[i] >= matcher->nb_words)) return 0;
+  }
+  if (!matcher->transitions) return 1;
+
+  size_t width = matcher->nb_classes;
+  for (size_t i = 0; i < matcher->nb_states * width; i++) {
+    uint32_t next = matcher->transitions[i];
+    size_t offset = next & ~MATCH_FLAG;
+    if (offset % width != 0 || offset / width >= matcher->nb_states) return 0;
+    if (!(next & MATCH_FLAG) != (matcher->matches[offset / width] < 0)) return 0;
+  }
+  return 1;
+}
+
+/**
+ * @brief Scans a piece of text for the words, ignoring case.
+ *
+ * @param matcher The compiled matcher.
+ * @param state The state of the automaton, WORD_MATCHER_START before the first piece of a
+ *              text, updated so that the next piece continues the same text.
+ * @param data The piece of text.
+ * @param len The length of the piece.
+ *
+ * @return The index of the first word found in matcher->words, or -1 if none ends in the piece.
+ */
+int word_matcher_scan(const word_matcher_t* matcher, uint32_t* state, const char* data, size_t len) {
+  if (!matcher->transitions) return -1;
+
+  const uint32_t* transitions = matcher->transitions;
+  const uint8_t* classes = matcher->classes;
+  uint32_t offset = *state * matcher->nb_classes;
+  for (size_t i = 0; i < len; i++) {
+    uint32_t next = transitions[offset + classes[(unsigned char)data[i]]];
+    offset = next & ~MATCH_FLAG;
+    if (next & MATCH_FLAG) {
+      *state = offset / matcher->nb_classes;
+      return matcher->matches[*state];
+    }
+  }
+  *state = offset / matcher->nb_classes;
+  return -1;
+}
+
+/**
+ * @brief Frees the words and the automaton of a matcher.
+ *
+ * @param matcher The matcher.
+ */
+void free_word_matcher(word_matcher_t* matcher) {
+  free_tables(matcher);
+  free(matcher->words);
+  init_word_matcher(matcher);
+}
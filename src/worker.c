@@ -0,0 +1,153 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+/**
+ * @file worker.c
+ * @brief Implementation of the worker threads.
+ *
+ * The proxy runs one event loop per worker thread. Every worker binds its own listener
+ * on the configured address with SO_REUSEPORT, accepts its own clients and keeps its own
+ * connection list, so that all the cores of the machine can serve traffic.
+ */
+
+#define _GNU_SOURCE
+
+#include "../includes/worker.h"
+#include "../includes/utils.h"
+#include "../includes/logger.h"
+
+#include <sched.h>
+#include <unistd.h>
+
+/**
+ * @brief Entry point of a worker thread.
+ *
+ * Pins the thread to its CPU if requested, then runs the event loop until the
+ * running flag is cleared.
+ *
+ * @param arg The worker_t of the thread.
+ *
+ * @return Always NULL.
+ */
+static void* worker_main(void* arg) {
+  worker_t* worker = arg;
+
+  if (worker->cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(worker->cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+      WARN("Worker %d could not be pinned to CPU %d\n", worker->id, worker->cpu);
+      Log(LOG_LEVEL_WARN, "[WORKER] Worker %d could not be pinned to CPU %d", worker->id, worker->cpu);
+    } else {
+      Log(LOG_LEVEL_INFO, "[WORKER] Worker %d pinned to CPU %d", worker->id, worker->cpu);
+    }
+  }
+
+  Log(LOG_LEVEL_INFO, "[WORKER] Worker %d running on listener %d", worker->id, worker->listen_fd);
+  if (run_event_loop(&worker->loop, worker->running) != 0) {
+    Log(LOG_LEVEL_ERROR, "[WORKER] Event loop of worker %d stopped on error", worker->id);
+  }
+  return NULL;
+}
+
+/**
+ * @brief Creates the listeners and event loops, then starts the worker threads.
+ *
+ * The maximum number of clients of the configuration is shared between the workers.
+ * On error, the workers already started keep running: the caller clears the running
+ * flag and calls stop_workers().
+ *
+ * @param workers Array of nb_workers workers to start.
+ * @param nb_workers The number of workers.
+ * @param conf The configuration giving the address, port, client limit and CPU pinning.
+ * @param running Flag stopping the workers when cleared.
+ *
+ * @return 0 on success, -1 on error.
+ */
+int start_workers(worker_t* workers, int nb_workers, const config_t* conf, volatile int* running) {
+  int max_per_worker = (conf->max_client + nb_workers - 1) / nb_workers;
+  long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if (nb_cpus < 1) nb_cpus = 1;
+
+  for (int i = 0; i < nb_workers; i++) {
+    workers[i].id = i;
+    workers[i].cpu = -1;
+    workers[i].listen_fd = -1;
+    workers[i].started = 0;
+    workers[i].running = running;
+  }
+
+  for (int i = 0; i < nb_workers; i++) {
+    worker_t* worker = &workers[i];
+    worker->cpu = conf->cpu_affinity ? (int)(i % nb_cpus) : -1;
+
+    worker->listen_fd = init_listen_socket(conf->address, conf->port, max_per_worker);
+    if (worker->listen_fd < 0) {
+      ERROR("Error while creating the socket of worker %d\n", i);
+      Log(LOG_LEVEL_ERROR, "[WORKER] Error while creating the socket of worker %d", i);
+      return -1;
+    }
+
+    if (init_event_loop(&worker->loop, worker->listen_fd, max_per_worker) != 0) {
+      ERROR("Error while creating the event loop of worker %d\n", i);
+      Log(LOG_LEVEL_ERROR, "[WORKER] Error while creating the event loop of worker %d", i);
+      close(worker->listen_fd);
+      worker->listen_fd = -1;
+      return -1;
+    }
+
+    if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+      ERROR("Error while starting worker %d\n", i);
+      Log(LOG_LEVEL_ERROR, "[WORKER] Error while starting worker %d", i);
+      free_event_loop(&worker->loop);
+      close(worker->listen_fd);
+      worker->listen_fd = -1;
+      return -1;
+    }
+    worker->started = 1;
+    INFO("Worker %d started on listener %d\n", i, worker->listen_fd);
+  }
+
+  Log(LOG_LEVEL_INFO, "[WORKER] %d worker(s) started, %d clients max each", nb_workers, max_per_worker);
+  return 0;
+}
+
+/**
+ * @brief Stops the worker threads and releases their resources.
+ *
+ * The running flag must already be cleared: each loop is woken up so that it
+ * notices it, then the thread is joined and its connections are closed.
+ *
+ * @param workers Array of workers given to start_workers().
+ * @param nb_workers The number of workers.
+ */
+void stop_workers(worker_t* workers, int nb_workers) {
+  for (int i = 0; i < nb_workers; i++) {
+    if (workers[i].started) wake_event_loop(&workers[i].loop);
+  }
+
+  for (int i = 0; i < nb_workers; i++) {
+    worker_t* worker = &workers[i];
+    if (!worker->started) continue;
+
+    pthread_join(worker->thread, NULL);
+    free_event_loop(&worker->loop);
+    close(worker->listen_fd);
+    worker->listen_fd = -1;
+    worker->started = 0;
+    INFO("Worker %d stopped\n", i);
+  }
+  Log(LOG_LEVEL_INFO, "[WORKER] Workers stopped");
+}
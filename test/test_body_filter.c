@@ -0,0 +1,194 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "../includes/body_filter.h"
+#include "../includes/utils.h"
+
+/**
+ * @brief Builds the automaton of the test words: "casino" (0) and "forbidden" (1).
+ */
+static void init_matcher(word_matcher_t* matcher) {
+  init_word_matcher(matcher);
+  assert(word_matcher_add(matcher, "casino", 0) == 0);
+  assert(word_matcher_add(matcher, "forbidden", 1) == 0);
+  assert(word_matcher_compile(matcher) == 0);
+}
+
+/**
+ * @brief Feeds a body to a scanner in pieces of the given size.
+ *
+ * @return The index of the word found, or -1.
+ */
+static int feed(body_filter_t* filter, const char* data, size_t len, size_t piece) {
+  for (size_t offset = 0; offset < len; offset += piece) {
+    size_t n = len - offset < piece ? len - offset : piece;
+    int found = body_filter_feed(filter, data + offset, n);
+    if (found >= 0) return found;
+  }
+  return -1;
+}
+
+/**
+ * @brief Compresses a text with zlib, gzip sets the gzip wrapper instead of the zlib one.
+ */
+static size_t compress_text(const char* text, char* out, size_t size, int gzip) {
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  assert(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, gzip ? 16 + MAX_WBITS : MAX_WBITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+  stream.next_in = (Bytef*)text;
+  stream.avail_in = strlen(text);
+  stream.next_out = (Bytef*)out;
+  stream.avail_out = size;
+  assert(deflate(&stream, Z_FINISH) == Z_STREAM_END);
+  size_t len = size - stream.avail_out;
+  deflateEnd(&stream);
+  return len;
+}
+
+void test_body_filter_applies() {
+  INFO("Testing body_filter_applies...\n");
+
+  const char* responses[] = {
+    "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=utf-8\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Type: TEXT/plain\r\nContent-Encoding: gzip\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Type: text/css\r\nContent-Encoding: deflate\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Type: image/png\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Encoding: br\r\n\r\n",
+    "HTTP/1.1 200 OK\r\nContent-Length: 3\r\n\r\n",
+  };
+  const int applies[] = { 1, 1, 1, 0, 0, 0 };
+  const body_coding_t codings[] = { BODY_CODING_IDENTITY, BODY_CODING_GZIP, BODY_CODING_DEFLATE };
+  for (size_t i = 0; i < sizeof(responses) / sizeof(responses[0]); i++) {
+    buffer_chain_t chain;
+    init_buffer_chain(&chain, NULL);
+    assert(buffer_chain_append(&chain, responses[i], strlen(responses[i])) == 0);
+    http_head_t head;
+    assert(parse_http_head(&chain, 1, &head) == 0);
+    body_coding_t coding;
+    assert(body_filter_applies(&head, &coding) == applies[i]);
+    if (applies[i]) assert(coding == codings[i]);
+    buffer_chain_clear(&chain);
+  }
+  INFO("\tsuccess: Text bodies are scanned, unless their coding cannot be decoded\n");
+}
+
+void test_body_filter_identity() {
+  INFO("Testing body_filter_feed on plain bodies...\n");
+
+  word_matcher_t matcher;
+  init_matcher(&matcher);
+  body_filter_t filter;
+  http_body_t framing;
+
+  const char* body = "<html><body>Best online CaSiNo in town</body></html>";
+  init_http_body(&framing, HTTP_BODY_LENGTH, strlen(body));
+  assert(init_body_filter(&filter, &framing, BODY_CODING_IDENTITY, &matcher) == 0);
+  assert(feed(&filter, body, strlen(body), 3) == 0);
+  free_body_filter(&filter);
+  INFO("\tsuccess: Word has been found across reads of 3 bytes\n");
+
+  const char* clean = "<html><body>Nothing to see</body></html>casino";
+  init_http_body(&framing, HTTP_BODY_LENGTH, strlen(clean) - 6);
+  assert(init_body_filter(&filter, &framing, BODY_CODING_IDENTITY, &matcher) == 0);
+  assert(feed(&filter, clean, strlen(clean), 7) == -1);
+  free_body_filter(&filter);
+  INFO("\tsuccess: Bytes past the end of the body have not been scanned\n");
+
+  const char* chunked = "6;ext=casino\r\nforbid\r\n3\r\ndenXXX\r\n0\r\nX-Casino: 1\r\n\r\n";
+  init_http_body(&framing, HTTP_BODY_CHUNKED, 0);
+  assert(init_body_filter(&filter, &framing, BODY_CODING_IDENTITY, &matcher) == 0);
+  assert(feed(&filter, chunked, strlen(chunked), 5) == 1);
+  free_body_filter(&filter);
+
+  const char* framed = "6;ext=casino\r\nfor id\r\n0\r\nX-Casino: 1\r\n\r\n";
+  init_http_body(&framing, HTTP_BODY_CHUNKED, 0);
+  assert(init_body_filter(&filter, &framing, BODY_CODING_IDENTITY, &matcher) == 0);
+  assert(feed(&filter, framed, strlen(framed), 1) == -1);
+  assert(filter.framing.done);
+  free_body_filter(&filter);
+  INFO("\tsuccess: Chunk data has been scanned across chunks, sizes and trailers skipped\n");
+
+  free_word_matcher(&matcher);
+}
+
+void test_body_filter_compressed() {
+  INFO("Testing body_filter_feed on compressed bodies...\n");
+
+  word_matcher_t matcher;
+  init_matcher(&matcher);
+
+  // Long enough to be inflated through several windows, the word at the end
+  static char text[5 * BODY_FILTER_WINDOW];
+  for (size_t i = 0; i + 1 < sizeof(text); i++) text[i] = 'a' + (i * 7 + i / 13) % 26;
+  memcpy(text + sizeof(text) - 8, "casino", 6);
+  text[sizeof(text) - 2] = '\0';
+
+  static char compressed[sizeof(text) * 2];
+  for (int gzip = 0; gzip <= 1; gzip++) {
+    size_t len = compress_text(text, compressed, sizeof(compressed), gzip);
+    http_body_t framing;
+    init_http_body(&framing, HTTP_BODY_LENGTH, len);
+    body_filter_t filter;
+    assert(init_body_filter(&filter, &framing, gzip ? BODY_CODING_GZIP : BODY_CODING_DEFLATE, &matcher) == 0);
+    assert(feed(&filter, compressed, len, 100) == 0);
+    free_body_filter(&filter);
+  }
+  INFO("\tsuccess: Word has been found in gzip and deflate bodies read in pieces\n");
+
+  text[sizeof(text) - 8] = 'k';
+  size_t len = compress_text(text, compressed, sizeof(compressed), 1);
+  // Chunked and compressed: the sizes are removed before inflating
+  static char chunked[sizeof(compressed) + 64];
+  size_t half = len / 2;
+  int n = snprintf(chunked, sizeof(chunked), "%zx\r\n", half);
+  memcpy(chunked + n, compressed, half);
+  n += half;
+  n += snprintf(chunked + n, sizeof(chunked) - n, "\r\n%zx\r\n", len - half);
+  memcpy(chunked + n, compressed + half, len - half);
+  n += len - half;
+  n += snprintf(chunked + n, sizeof(chunked) - n, "\r\n0\r\n\r\n");
+
+  http_body_t framing;
+  init_http_body(&framing, HTTP_BODY_CHUNKED, 0);
+  body_filter_t filter;
+  assert(init_body_filter(&filter, &framing, BODY_CODING_GZIP, &matcher) == 0);
+  assert(feed(&filter, chunked, n, 1000) == -1);
+  assert(!filter.error && filter.framing.done);
+  free_body_filter(&filter);
+  INFO("\tsuccess: Clean chunked gzip body has been inflated entirely\n");
+
+  init_http_body(&framing, HTTP_BODY_LENGTH, 64);
+  assert(init_body_filter(&filter, &framing, BODY_CODING_GZIP, &matcher) == 0);
+  assert(feed(&filter, "this is not gzip, casino", 24, 24) == -1);
+  assert(filter.error);
+  free_body_filter(&filter);
+  INFO("\tsuccess: Body which cannot be inflated has been left alone\n");
+
+  free_word_matcher(&matcher);
+}
+
+int main() {
+  INFO("Running body_filter.c tests...\n");
+
+  test_body_filter_applies();
+  test_body_filter_identity();
+  test_body_filter_compressed();
+
+  return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+#include <assert.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../includes/buffer_chain.h"
+#include "../includes/utils.h"
+
+void test_buffer_chain_append() {
+  INFO("Testing buffer_chain_append...\n");
+
+  buffer_pool_t pool;
+  init_buffer_pool(&pool, BUFFER_SIZE);
+  buffer_chain_t chain;
+  init_buffer_chain(&chain, &pool);
+
+  char data[3 * BUFFER_SIZE];
+  for (size_t i = 0; i < sizeof(data); i++) data[i] = 'a' + i % 26;
+  assert(buffer_chain_append(&chain, data, sizeof(data)) == 0);
+  assert(chain.len == sizeof(data) && chain.nb_segments == 4);
+  assert(pool.nb_used == 4);
+
+  size_t offset = 0;
+  for (buffer_segment_t* segment = chain.head; segment; segment = segment->next) {
+    assert(memcmp(segment->data, data + offset, segment->len) == 0);
+    assert(segment->data[segment->len] == '\0');
+    offset += segment->len;
+  }
+  assert(offset == sizeof(data));
+  INFO("\tsuccess: Bytes have been spread over pooled segments\n");
+
+  buffer_chain_clear(&chain);
+  assert(chain.head == NULL && chain.len == 0 && pool.nb_used == 0);
+  INFO("\tsuccess: Segments have been given back to the pool\n");
+  free_buffer_pool(&pool);
+}
+
+void test_buffer_chain_keep_lines() {
+  INFO("Testing buffer_chain_reserve keeping lines in one segment...\n");
+
+  buffer_chain_t chain;
+  init_buffer_chain(&chain, NULL);
+
+  // Fills the first segment with lines of 100 bytes, the last one cut
+  size_t room;
+  char* dest = buffer_chain_reserve(&chain, 1, &room);
+  assert(dest != NULL && room == BUFFER_SEGMENT_CAPACITY);
+  for (size_t i = 0; i < room; i++) dest[i] = i % 100 == 99 ? '\n' : 'x';
+  buffer_chain_commit(&chain, room);
+  size_t partial = BUFFER_SEGMENT_CAPACITY % 100;
+
+  dest = buffer_chain_reserve(&chain, 1, &room);
+  assert(dest != NULL && chain.nb_segments == 2);
+  assert(chain.head->len == BUFFER_SEGMENT_CAPACITY - partial);
+  assert(chain.head->data[chain.head->len - 1] == '\n');
+  assert(chain.tail->len == partial && room == BUFFER_SEGMENT_CAPACITY - partial);
+  assert(chain.len == BUFFER_SEGMENT_CAPACITY);
+  INFO("\tsuccess: Partial line has been moved to the new segment\n");
+
+  memset(dest, 'y', room);
+  buffer_chain_commit(&chain, room);
+  dest = buffer_chain_reserve(&chain, 1, &room);
+  assert(dest != NULL && chain.nb_segments == 3);
+  assert(chain.tail->len == 0 && room == BUFFER_SEGMENT_CAPACITY);
+  INFO("\tsuccess: Line longer than a segment goes on in the next one\n");
+
+  buffer_chain_clear(&chain);
+}
+
+void test_buffer_chain_send() {
+  INFO("Testing buffer_chain_send...\n");
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  int size = BUFFER_SIZE;
+  setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+  buffer_chain_t chain;
+  init_buffer_chain(&chain, NULL);
+  static char data[256 * 1024];
+  for (size_t i = 0; i < sizeof(data); i++) data[i] = 'a' + i % 26;
+  assert(buffer_chain_append(&chain, data, sizeof(data)) == 0);
+
+  ssize_t sent = buffer_chain_send(&chain, fds[0]);
+  assert(sent > 0 && (size_t)sent < sizeof(data));
+  assert(chain.len == sizeof(data) - sent);
+  INFO("\tsuccess: Full socket has left the rest of the chain queued\n");
+
+  static char received[sizeof(data)];
+  size_t total = 0;
+  while (total < sizeof(data)) {
+    ssize_t bytes = recv(fds[1], received + total, sizeof(received) - total, MSG_DONTWAIT);
+    if (bytes > 0) total += bytes;
+    assert(buffer_chain_send(&chain, fds[0]) >= 0);
+  }
+  assert(chain.len == 0 && chain.head == NULL && chain.nb_segments == 0);
+  assert(memcmp(received, data, sizeof(data)) == 0);
+  INFO("\tsuccess: Chain has been written in order\n");
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+void test_buffer_chain_split() {
+  INFO("Testing buffer_chain_split...\n");
+
+  buffer_pool_t pool;
+  init_buffer_pool(&pool, BUFFER_SIZE);
+  buffer_chain_t chain, rest;
+  init_buffer_chain(&chain, &pool);
+  init_buffer_chain(&rest, &pool);
+
+  char data[3 * BUFFER_SIZE];
+  for (size_t i = 0; i < sizeof(data); i++) data[i] = 'a' + i % 26;
+  assert(buffer_chain_append(&chain, data, sizeof(data)) == 0);
+
+  size_t offset = BUFFER_SEGMENT_CAPACITY + 10;
+  assert(buffer_chain_split(&chain, offset, &rest) == 0);
+  assert(chain.len == offset && chain.nb_segments == 2);
+  assert(chain.tail->len == 10 && chain.tail->next == NULL);
+  assert(rest.len == sizeof(data) - offset && rest.nb_segments == 3);
+
+  size_t checked = 0;
+  for (buffer_segment_t* segment = rest.head; segment; segment = segment->next) {
+    assert(memcmp(segment->data, data + offset + checked, segment->len) == 0);
+    checked += segment->len;
+  }
+  assert(checked == rest.len);
+  INFO("\tsuccess: Bytes past the offset have been moved to the other chain\n");
+
+  assert(buffer_chain_split(&chain, chain.len, &rest) == 0);
+  assert(chain.len == offset && rest.len == sizeof(data) - offset);
+  assert(buffer_chain_split(&chain, 0, &rest) == 0);
+  assert(chain.len == 0 && chain.head == NULL && chain.nb_segments == 0);
+  assert(rest.len == sizeof(data) && pool.nb_used == 5);
+  INFO("\tsuccess: Splits at both ends have kept every byte\n");
+
+  buffer_chain_clear(&rest);
+  assert(pool.nb_used == 0);
+  free_buffer_pool(&pool);
+}
+
+void test_buffer_chain_writer() {
+  INFO("Testing buffer_chain_writer...\n");
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  int size = BUFFER_SIZE;
+  setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+  buffer_chain_t rest;
+  init_buffer_chain(&rest, NULL);
+  buffer_chain_writer_t writer;
+  init_buffer_chain_writer(&writer, fds[0], &rest);
+
+  // More pieces than one vector, more bytes than the socket accepts
+  static char data[256 * 1024];
+  for (size_t i = 0; i < sizeof(data); i++) data[i] = 'a' + i % 26;
+  size_t piece = sizeof(data) / (2 * BUFFER_CHAIN_IOV);
+  for (size_t offset = 0; offset < sizeof(data); offset += piece) buffer_chain_writer_add(&writer, data + offset, piece);
+  ssize_t sent = buffer_chain_writer_flush(&writer);
+  assert(sent > 0 && (size_t)sent < sizeof(data));
+  assert(rest.len == sizeof(data) - sent);
+  INFO("\tsuccess: Bytes not accepted by the socket have been copied to the rest\n");
+
+  static char received[sizeof(data)];
+  size_t total = 0;
+  while (total < sizeof(data)) {
+    ssize_t bytes = recv(fds[1], received + total, sizeof(received) - total, MSG_DONTWAIT);
+    if (bytes > 0) total += bytes;
+    assert(buffer_chain_send(&rest, fds[0]) >= 0);
+  }
+  assert(memcmp(received, data, sizeof(data)) == 0);
+  INFO("\tsuccess: Pieces and rest have been written in order\n");
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+int main() {
+  INFO("Running buffer_chain.c tests...\n");
+
+  test_buffer_chain_append();
+  test_buffer_chain_keep_lines();
+  test_buffer_chain_send();
+  test_buffer_chain_split();
+  test_buffer_chain_writer();
+
+  return 0;
+}
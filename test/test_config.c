@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "../includes/config.h"
 #include "../includes/utils.h"
 
@@ -30,6 +31,15 @@ void create_test_config_file(const char* filename) {
     fprintf(file, "MAX_CLIENT 20\n");
     fprintf(file, "LOGGER_FILENAME test_log.log\n");
     fprintf(file, "RULES_FILENAME test_rules.rules\n");
+    fprintf(file, "WORKERS 4\n");
+    fprintf(file, "CPU_AFFINITY on\n");
+    fprintf(file, "DNS_SERVER 127.0.0.1:5353\n");
+    fprintf(file, "DNS_CACHE_SIZE 64\n");
+    fprintf(file, "MAX_HEADER_SIZE 16384\n");
+    fprintf(file, "UPSTREAM_MAX_IDLE 4\n");
+    fprintf(file, "UPSTREAM_IDLE_TIMEOUT 12\n");
+    fprintf(file, "FILTER_RESPONSES on\n");
+    fprintf(file, "VERDICT_CACHE_SIZE 256\n");
     
     fclose(file);
 }
@@ -59,6 +69,119 @@ void test_init_config() {
     assert(strcmp(config.rules_filename, "test_rules.rules") == 0);
     INFO("\tsuccess: Rules filename has been set correctly\n");
 
+    assert(config.workers == 4);
+    INFO("\tsuccess: Number of workers has been set correctly\n");
+
+    assert(config.cpu_affinity == 1);
+    INFO("\tsuccess: CPU affinity has been set correctly\n");
+
+    assert(strcmp(config.dns_server, "127.0.0.1") == 0 && config.dns_port == 5353);
+    INFO("\tsuccess: DNS server has been set correctly\n");
+
+    assert(config.dns_cache_size == 64);
+    INFO("\tsuccess: DNS cache size has been set correctly\n");
+
+    assert(config.max_header_size == 16384);
+    INFO("\tsuccess: Maximum header size has been set correctly\n");
+
+    assert(config.upstream_max_idle == 4 && config.upstream_idle_timeout == 12);
+    INFO("\tsuccess: Upstream pool settings have been set correctly\n");
+
+    assert(config.filter_responses == 1);
+    INFO("\tsuccess: Response filtering has been enabled\n");
+
+    assert(config.verdict_cache_size == 256);
+    INFO("\tsuccess: Verdict cache size has been set correctly\n");
+
+    remove(config_filename);
+}
+
+void test_reload_config() {
+    INFO("Testing reload_config...\n");
+
+    const char* config_filename = "test_config.cfg";
+    create_test_config_file(config_filename);
+    assert(init_config(config_filename) == 0);
+    assert(current_config() == &config);
+
+    FILE* file = fopen(config_filename, "w");
+    assert(file != NULL);
+    fprintf(file, "PORT 9191\n");
+    fprintf(file, "WORKERS 2\n");
+    fprintf(file, "HEADER_TIMEOUT 3\n");
+    fprintf(file, "RULES_FILENAME other.rules\n");
+    fprintf(file, "MAX_HEADER_SIZE -1\n");
+    fprintf(file, "CONNECT_TIMEOUT 5s\n");
+    fclose(file);
+
+    assert(reload_config(config_filename) == 0);
+    const config_t* conf = current_config();
+    assert(conf != &config);
+    assert(conf->header_timeout == 3 && strcmp(conf->rules_filename, "other.rules") == 0);
+    INFO("\tsuccess: New settings have been published\n");
+
+    assert(conf->max_header_size == 65536 && conf->connect_timeout == 5);
+    INFO("\tsuccess: Sizes and timeouts out of their bounds have been ignored\n");
+
+    assert(conf->filter_responses == 0 && conf->max_header_size == 65536);
+    INFO("\tsuccess: Settings removed from the file have their default value\n");
+
+    assert(conf->port == 9090 && conf->workers == 4 && conf->dns_port == 5353 && conf->verdict_cache_size == 256);
+    assert(config.port == 9090 && config.header_timeout == 10);
+    INFO("\tsuccess: Startup settings have kept their value\n");
+
+    remove(config_filename);
+    assert(reload_config(config_filename) == -1);
+    assert(current_config() == conf);
+    INFO("\tsuccess: Configuration has been kept when the file could not be read\n");
+}
+
+void test_workers_auto() {
+    INFO("Testing WORKERS auto...\n");
+
+    const char* config_filename = "test_config.cfg";
+    long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    FILE* file = fopen(config_filename, "w");
+    assert(file != NULL);
+    fprintf(file, "WORKERS auto\n");
+    fprintf(file, "MAX_CLIENT 20\n");
+    fclose(file);
+    assert(init_config(config_filename) == 0);
+    assert(config.workers == 1);
+    INFO("\tsuccess: A few clients have been left to a single worker\n");
+
+    file = fopen(config_filename, "w");
+    assert(file != NULL);
+    fprintf(file, "MAX_CLIENT %d\n", WORKER_MIN_CLIENTS * 1024);
+    fprintf(file, "WORKERS auto\n");
+    fclose(file);
+    assert(init_config(config_filename) == 0);
+    assert(config.workers == (nb_cpus < 1024 ? nb_cpus : 1024));
+    assert(config.max_client / config.workers >= WORKER_MIN_CLIENTS);
+    INFO("\tsuccess: One worker per CPU has been started, %d clients each\n", config.max_client / config.workers);
+
+    remove(config_filename);
+}
+
+void test_config_bounds() {
+    INFO("Testing the bounds of the sizes and timeouts...\n");
+
+    const char* config_filename = "test_config.cfg";
+    FILE* file = fopen(config_filename, "w");
+    assert(file != NULL);
+    fprintf(file, "MAX_HEADER_SIZE 8192\n");
+    fprintf(file, "UPSTREAM_IDLE_TIMEOUT 60\n");
+    fprintf(file, "MAX_HEADER_SIZE abc\n");
+    fprintf(file, "UPSTREAM_IDLE_TIMEOUT 0\n");
+    fprintf(file, "HEADER_TIMEOUT 999999\n");
+    fclose(file);
+
+    config.header_timeout = 10;
+    assert(init_config(config_filename) == 0);
+    assert(config.max_header_size == 8192 && config.upstream_idle_timeout == 60 && config.header_timeout == 10);
+    INFO("\tsuccess: Values out of their bounds have kept the previous ones\n");
+
     remove(config_filename);
 }
 
@@ -66,6 +189,9 @@ int main() {
     INFO("Running config.c tests...\n");
 
     test_init_config();
+    test_reload_config();
+    test_workers_auto();
+    test_config_bounds();
 
     INFO("Cleaning up after config tests...\n");
     remove("test_log.log");
@@ -0,0 +1,315 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../includes/dns_client.h"
+#include "../includes/utils.h"
+
+/**
+ * @brief Result of the last resolution reported to the test callback.
+ */
+static int nb_calls = 0;
+static void* last_ctx = NULL;
+static int last_status = 0;
+static struct in_addr last_addr;
+static uint32_t last_ttl = 0;
+static char last_host[256];
+
+static void test_callback(void* data, void* ctx, const char* host, int status, const struct in_addr* addr, uint32_t ttl) {
+  (void)data;
+  nb_calls++;
+  last_ctx = ctx;
+  last_status = status;
+  last_ttl = ttl;
+  if (addr) last_addr = *addr;
+  snprintf(last_host, sizeof(last_host), "%s", host);
+}
+
+/**
+ * @brief Opens a UDP socket on a free local port, playing the resolver.
+ */
+static int open_stub_server(int* port) {
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  assert(fd >= 0);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  assert(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+
+  socklen_t len = sizeof(addr);
+  assert(getsockname(fd, (struct sockaddr*)&addr, &len) == 0);
+  *port = ntohs(addr.sin_port);
+  return fd;
+}
+
+/**
+ * @brief Receives a query on the stub and answers it.
+ *
+ * With rcode 0 the answer is a CNAME (ttl 300) followed by an A record 93.184.216.34 (ttl 60).
+ */
+static void answer_query(int stub_fd, int rcode) {
+  unsigned char message[DNS_MAX_MESSAGE];
+  struct sockaddr_in from;
+  socklen_t from_len = sizeof(from);
+
+  struct pollfd pfd = { .fd = stub_fd, .events = POLLIN };
+  assert(poll(&pfd, 1, 1000) == 1);
+  ssize_t len = recvfrom(stub_fd, message, sizeof(message), 0, (struct sockaddr*)&from, &from_len);
+  assert(len > 12);
+
+  message[2] = 0x81;                   // QR + RD
+  message[3] = 0x80 | rcode;           // RA + RCODE
+  if (rcode == 0) {
+    message[7] = 2;                    // ANCOUNT
+    const unsigned char cname[] = { 0xc0, 0x0c, 0, 5, 0, 1, 0, 0, 0x01, 0x2c, 0, 2, 0xc0, 0x0c };
+    const unsigned char a[] = { 0xc0, 0x0c, 0, 1, 0, 1, 0, 0, 0, 60, 0, 4, 93, 184, 216, 34 };
+    memcpy(message + len, cname, sizeof(cname));
+    len += sizeof(cname);
+    memcpy(message + len, a, sizeof(a));
+    len += sizeof(a);
+  }
+  assert(sendto(stub_fd, message, len, 0, (struct sockaddr*)&from, from_len) == len);
+}
+
+/**
+ * @brief Waits for the answer of the stub, then lets the client read it.
+ */
+static void read_answer(dns_client_t* client) {
+  struct pollfd pfd = { .fd = client->fd, .events = POLLIN };
+  assert(poll(&pfd, 1, 1000) == 1);
+  dns_client_read(client);
+}
+
+void test_dns_build_query() {
+  INFO("Testing dns_build_query...\n");
+
+  unsigned char message[DNS_MAX_MESSAGE];
+  int len = dns_build_query(0x1234, "www.example.com", message, sizeof(message));
+  assert(len == 12 + 17 + 4);
+  assert(message[0] == 0x12 && message[1] == 0x34);
+  assert(message[5] == 1);
+  assert(memcmp(message + 12, "\3www\7example\3com\0", 17) == 0);
+  INFO("\tsuccess: Query has been encoded\n");
+
+  assert(dns_build_query(1, "bad..host", message, sizeof(message)) == -1);
+  assert(dns_build_query(1, "", message, sizeof(message)) == -1);
+  INFO("\tsuccess: Invalid hostnames have been rejected\n");
+}
+
+/**
+ * @brief Turns the query for the A record of a host into an answer without record.
+ */
+static size_t build_answer(const char* host, unsigned char* message) {
+  int len = dns_build_query(0x1234, host, message, DNS_MAX_MESSAGE);
+  assert(len > 0);
+  message[2] = 0x81;                   // QR + RD
+  message[3] = 0x80;                   // RA
+  return len;
+}
+
+/**
+ * @brief Appends a record to an answer, its owner and its data already encoded.
+ */
+static size_t add_record(unsigned char* message, size_t len, const char* owner, size_t owner_len, int type, int ttl,
+                         const char* data, size_t data_len) {
+  const unsigned char fixed[10] = { 0, type, 0, 1, 0, 0, ttl >> 8, ttl & 0xff, 0, data_len };
+  memcpy(message + len, owner, owner_len);
+  len += owner_len;
+  memcpy(message + len, fixed, sizeof(fixed));
+  len += sizeof(fixed);
+  memcpy(message + len, data, data_len);
+  message[7]++;                        // ANCOUNT
+  return len + data_len;
+}
+
+#define QNAME "\xc0\x0c", 2
+#define CDN "\3cdn\7example\3net\0", 17
+#define EVIL "\4evil\3com\0", 10
+
+void test_dns_parse_response() {
+  INFO("Testing dns_parse_response...\n");
+
+  uint16_t id;
+  struct in_addr addr;
+  uint32_t ttl;
+  unsigned char truncated[] = { 0x12, 0x34, 0x81, 0x80, 0, 1, 0, 1, 0, 0, 0, 0, 3, 'w' };
+  assert(dns_response_id(truncated, sizeof(truncated), &id) == 0 && id == 0x1234);
+  assert(dns_parse_response(truncated, sizeof(truncated), "www.example.com", &addr, &ttl) == -1);
+  INFO("\tsuccess: Truncated message has been rejected\n");
+
+  unsigned char query[] = { 0x12, 0x34, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0 };
+  assert(dns_response_id(query, sizeof(query), &id) == -1);
+  assert(dns_parse_response(query, sizeof(query), "www.example.com", &addr, &ttl) == -1);
+  INFO("\tsuccess: Query has not been taken for an answer\n");
+
+  unsigned char message[DNS_MAX_MESSAGE];
+  size_t len = build_answer("www.example.com", message);
+  len = add_record(message, len, QNAME, 1, 60, "\1\2\3\4", 4);
+  assert(dns_parse_response(message, len, "WWW.example.com.", &addr, &ttl) == 0);
+  assert(strcmp(inet_ntoa(addr), "1.2.3.4") == 0 && ttl == 60);
+  assert(dns_parse_response(message, len, "www.example.org", &addr, &ttl) == -1);
+  message[12 + 17 + 1] = 28;           // QTYPE AAAA
+  assert(dns_parse_response(message, len, "www.example.com", &addr, &ttl) == -1);
+  INFO("\tsuccess: Answer to another question has been rejected\n");
+
+  len = build_answer("www.example.com", message);
+  len = add_record(message, len, EVIL, 1, 60, "\6\6\6\6", 4);
+  assert(dns_parse_response(message, len, "www.example.com", &addr, &ttl) == 1);
+  INFO("\tsuccess: Address of another host has been ignored\n");
+
+  // The address of the alias comes first, the address of an unrelated host is ignored
+  len = build_answer("www.example.com", message);
+  len = add_record(message, len, EVIL, 1, 10, "\6\6\6\6", 4);
+  len = add_record(message, len, CDN, 1, 60, "\5\6\7\10", 4);
+  len = add_record(message, len, QNAME, 5, 30, CDN);
+  assert(dns_parse_response(message, len, "www.example.com", &addr, &ttl) == 0);
+  assert(strcmp(inet_ntoa(addr), "5.6.7.8") == 0 && ttl == 30);
+  INFO("\tsuccess: Address of the CNAME of the host has been found, with the smallest TTL\n");
+
+  len = build_answer("www.example.com", message);
+  len = add_record(message, len, QNAME, 5, 30, QNAME);
+  assert(dns_parse_response(message, len, "www.example.com", &addr, &ttl) == 1);
+  INFO("\tsuccess: Looping CNAME has ended the resolution\n");
+}
+
+void test_dns_client_resolve() {
+  INFO("Testing dns_client_query with a stub resolver...\n");
+
+  int port;
+  int stub_fd = open_stub_server(&port);
+
+  dns_client_t client;
+  assert(init_dns_client(&client, "127.0.0.1", port, test_callback, NULL) == 0);
+
+  int ctx;
+  nb_calls = 0;
+  assert(dns_client_query(&client, "www.example.com", &ctx) == 0);
+  assert(client.nb_pending == 1 && nb_calls == 0);
+  INFO("\tsuccess: Query has been sent without waiting\n");
+
+  answer_query(stub_fd, 0);
+  read_answer(&client);
+  assert(nb_calls == 1 && last_ctx == &ctx && last_status == 0);
+  assert(strcmp(inet_ntoa(last_addr), "93.184.216.34") == 0);
+  assert(strcmp(last_host, "www.example.com") == 0);
+  assert(last_ttl == 60);
+  assert(client.nb_pending == 0);
+  INFO("\tsuccess: CNAME has been followed to the address, with the smallest TTL\n");
+
+  // A forged answer with the identifier of the pending query asks for another host
+  assert(dns_client_query(&client, "www.example.com", &ctx) == 0);
+  dns_query_t* pending = NULL;
+  for (int i = 0; i < DNS_PENDING_BUCKETS && !pending; i++) pending = client.pending[i];
+  unsigned char forged[DNS_MAX_MESSAGE];
+  size_t forged_len = build_answer("www.evil.com", forged);
+  forged_len = add_record(forged, forged_len, QNAME, 1, 60, "\6\6\6\6", 4);
+  forged[0] = pending->id >> 8;
+  forged[1] = pending->id & 0xff;
+  struct sockaddr_in local;
+  socklen_t local_len = sizeof(local);
+  assert(getsockname(client.fd, (struct sockaddr*)&local, &local_len) == 0);
+  assert(sendto(stub_fd, forged, forged_len, 0, (struct sockaddr*)&local, local_len) == (ssize_t)forged_len);
+  read_answer(&client);
+  assert(nb_calls == 1 && client.nb_pending == 1);
+  answer_query(stub_fd, 0);
+  read_answer(&client);
+  assert(nb_calls == 2 && last_status == 0 && strcmp(inet_ntoa(last_addr), "93.184.216.34") == 0);
+  INFO("\tsuccess: Answer to another question has left the query pending\n");
+
+  assert(dns_client_query(&client, "unknown.example", &ctx) == 0);
+  answer_query(stub_fd, 3);
+  read_answer(&client);
+  assert(nb_calls == 3 && last_status == -1);
+  INFO("\tsuccess: NXDOMAIN has failed the resolution\n");
+
+  free_dns_client(&client);
+  close(stub_fd);
+}
+
+void test_dns_client_expire() {
+  INFO("Testing dns_client_expire...\n");
+
+  int port;
+  int stub_fd = open_stub_server(&port);
+
+  dns_client_t client;
+  assert(init_dns_client(&client, "127.0.0.1", port, test_callback, NULL) == 0);
+
+  int ctx;
+  nb_calls = 0;
+  assert(dns_client_query(&client, "slow.example", &ctx) == 0);
+
+  long long now = 1LL << 50;
+  for (int i = 1; i < DNS_MAX_ATTEMPTS; i++) {
+    dns_client_expire(&client, now);
+    assert(nb_calls == 0 && client.nb_pending == 1);
+    now += DNS_RETRY_MS;
+  }
+  INFO("\tsuccess: Query has been sent again\n");
+
+  dns_client_expire(&client, now);
+  assert(nb_calls == 1 && last_status == -1 && client.nb_pending == 0);
+  INFO("\tsuccess: Resolution has failed after %d attempts\n", DNS_MAX_ATTEMPTS);
+
+  // Every attempt reached the resolver
+  unsigned char message[DNS_MAX_MESSAGE];
+  int received = 0;
+  while (recv(stub_fd, message, sizeof(message), MSG_DONTWAIT) > 0) received++;
+  assert(received == DNS_MAX_ATTEMPTS);
+
+  free_dns_client(&client);
+  close(stub_fd);
+}
+
+void test_dns_client_cancel() {
+  INFO("Testing dns_client_cancel...\n");
+
+  int port;
+  int stub_fd = open_stub_server(&port);
+
+  dns_client_t client;
+  assert(init_dns_client(&client, "127.0.0.1", port, test_callback, NULL) == 0);
+
+  int ctx;
+  nb_calls = 0;
+  assert(dns_client_query(&client, "www.example.com", &ctx) == 0);
+  dns_client_cancel(&client, &ctx);
+  assert(client.nb_pending == 0);
+
+  answer_query(stub_fd, 0);
+  read_answer(&client);
+  assert(nb_calls == 0);
+  INFO("\tsuccess: Answer of a canceled query has been ignored\n");
+
+  free_dns_client(&client);
+  close(stub_fd);
+}
+
+int main() {
+  INFO("Running dns_client.c tests...\n");
+
+  test_dns_build_query();
+  test_dns_parse_response();
+  test_dns_client_resolve();
+  test_dns_client_expire();
+  test_dns_client_cancel();
+
+  return 0;
+}
@@ -17,33 +17,105 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include "../includes/dns_helper.h"
 #include "../includes/utils.h"
 
 void test_init_dns_cache() {
     INFO("Testing init_dns_cache...\n");
-    int result = init_dns_cache();
+    int result = init_dns_cache(2);
     assert(result == 0);
     INFO("\tsuccess: DNS cache initialized successfully\n");
 }
 
+/**
+ * @brief Fills an addrinfo with an IPv4 address on port 80.
+ */
+static void make_addrinfo(struct addrinfo* info, struct sockaddr_in* addr, const char* ipstr) {
+    memset(info, 0, sizeof(struct addrinfo));
+    memset(addr, 0, sizeof(struct sockaddr_in));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(80);
+    inet_pton(AF_INET, ipstr, &addr->sin_addr);
+    info->ai_family = AF_INET;
+    info->ai_socktype = SOCK_STREAM;
+    info->ai_addr = (struct sockaddr*)addr;
+    info->ai_addrlen = sizeof(struct sockaddr_in);
+}
+
 void test_add_and_find_in_cache() {
     INFO("Testing add_in_cache and find_in_cache...\n");
     const char* host = "www.example.com";
     const char* ipstr = "93.184.216.34";
 
     struct addrinfo addr_info;
-    memset(&addr_info, 0, sizeof(struct addrinfo));
+    struct sockaddr_in addr;
+    make_addrinfo(&addr_info, &addr, ipstr);
 
-    int add_result = add_in_cache(host, ipstr, &addr_info);
+    int add_result = add_in_cache(host, ipstr, &addr_info, 60);
     assert(add_result == 0);
     INFO("\tsuccess: Entry added to DNS cache\n");
 
-    dns_cache_entry_t* entry = find_in_cache(host);
-    assert(entry != NULL);
-    assert(strcmp(entry->host, host) == 0);
-    assert(strcmp(entry->ipstr, ipstr) == 0);
+    char found[INET6_ADDRSTRLEN];
+    struct addrinfo* res = NULL;
+    assert(find_in_cache("WWW.Example.com", found, &res) == 0);
+    assert(strcmp(found, ipstr) == 0);
     INFO("\tsuccess: Entry found in DNS cache\n");
+
+    assert(res != NULL && res->ai_addrlen == sizeof(struct sockaddr_in));
+    assert(memcmp(res->ai_addr, &addr, sizeof(addr)) == 0);
+    freeaddrinfo(res);
+    INFO("\tsuccess: Cached addrinfo handed back\n");
+
+    res = NULL;
+    assert(resolve_dns(host, &res, found) == 0);
+    assert(res != NULL && strcmp(found, ipstr) == 0);
+    freeaddrinfo(res);
+    INFO("\tsuccess: resolve_dns served the cached entry\n");
+}
+
+void test_cache_ttl() {
+    INFO("Testing the TTL of the DNS cache...\n");
+    struct addrinfo addr_info;
+    struct sockaddr_in addr;
+    make_addrinfo(&addr_info, &addr, "10.0.0.1");
+    char found[INET6_ADDRSTRLEN];
+
+    assert(add_in_cache("zero.example", "10.0.0.1", &addr_info, 0) == 0);
+    assert(find_in_cache("zero.example", found, NULL) == 1);
+    INFO("\tsuccess: Answer with a TTL of 0 not cached\n");
+
+    assert(add_in_cache("short.example", "10.0.0.1", &addr_info, 1) == 0);
+    assert(find_in_cache("short.example", found, NULL) == 0);
+    usleep(1100 * 1000);
+    assert(find_in_cache("short.example", found, NULL) == 1);
+    INFO("\tsuccess: Entry expired after its TTL\n");
+}
+
+void test_cache_eviction() {
+    INFO("Testing the eviction of the DNS cache...\n");
+    struct addrinfo addr_info;
+    struct sockaddr_in addr;
+    make_addrinfo(&addr_info, &addr, "10.0.0.2");
+    char found[INET6_ADDRSTRLEN];
+
+    // The cache holds 2 entries: www.example.com and first.example
+    assert(add_in_cache("first.example", "10.0.0.2", &addr_info, 60) == 0);
+    assert(dns_cache_count() == 2);
+    assert(find_in_cache("www.example.com", found, NULL) == 0);
+
+    assert(add_in_cache("second.example", "10.0.0.2", &addr_info, 60) == 0);
+    assert(dns_cache_count() == 2);
+    assert(find_in_cache("first.example", found, NULL) == 1);
+    assert(find_in_cache("www.example.com", found, NULL) == 0);
+    assert(find_in_cache("second.example", found, NULL) == 0);
+    INFO("\tsuccess: Least recently used entry evicted\n");
+
+    make_addrinfo(&addr_info, &addr, "10.0.0.3");
+    assert(add_in_cache("second.example", "10.0.0.3", &addr_info, 60) == 0);
+    assert(dns_cache_count() == 2);
+    assert(find_in_cache("second.example", found, NULL) == 0 && strcmp(found, "10.0.0.3") == 0);
+    INFO("\tsuccess: Entry refreshed in place\n");
 }
 
 void test_resolve_dns() {
@@ -59,8 +131,8 @@ void test_resolve_dns() {
     assert(strlen(ipstr) > 0);
     INFO("\tsuccess: IP address obtained: %s\n", ipstr);
 
-    dns_cache_entry_t* entry = find_in_cache(host);
-    assert(entry != NULL);
+    char cached[INET6_ADDRSTRLEN];
+    assert(find_in_cache(host, cached, NULL) == 0);
     INFO("\tsuccess: Entry added to DNS cache after resolution\n");
 
     if (res) {
@@ -79,6 +151,8 @@ int main() {
 
     test_init_dns_cache();
     test_add_and_find_in_cache();
+    test_cache_ttl();
+    test_cache_eviction();
     test_resolve_dns();
     test_free_dns_cache();
 
@@ -0,0 +1,84 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "../includes/domain_filter.h"
+#include "../includes/domain_set.h"
+#include "../includes/utils.h"
+
+static uint64_t host_hash(const char* format, int i) {
+  char host[64];
+  int len = snprintf(host, sizeof(host), format, i);
+  return domain_hash64(host, len);
+}
+
+void test_domain_filter_contains() {
+  INFO("Testing domain_filter_contains...\n");
+
+  domain_filter_t filter;
+  init_domain_filter(&filter);
+  assert(domain_filter_contains(&filter, domain_hash64("a.com", 5)) == 0);
+  assert(domain_filter_size(&filter) == 0 && domain_filter_false_positive_rate(&filter) == 0.0);
+  INFO("\tsuccess: Empty filter has no key\n");
+
+  enum { COUNT = 10000, ABSENT = 100000 };
+  assert(domain_filter_reserve(&filter, COUNT) == 0);
+  assert(((uintptr_t)filter.blocks & 63) == 0);
+  assert(domain_filter_size(&filter) * 8 >= COUNT * DOMAIN_FILTER_BITS_PER_KEY);
+  for (int i = 0; i < COUNT; i++) domain_filter_add(&filter, host_hash("host%d.example.com", i));
+  assert(filter.nb_keys == COUNT);
+  for (int i = 0; i < COUNT; i++) assert(domain_filter_contains(&filter, host_hash("HOST%d.Example.com", i)));
+  INFO("\tsuccess: Every key added has been found, ignoring case\n");
+
+  int false_positives = 0;
+  for (int i = 0; i < ABSENT; i++) false_positives += domain_filter_contains(&filter, host_hash("www-%d.allowed.org", i));
+  double measured = (double)false_positives / ABSENT;
+  double estimated = domain_filter_false_positive_rate(&filter);
+  assert(measured < 0.02 && estimated > 0.0 && estimated < 0.02);
+  assert(measured < 2 * estimated + 0.002 && estimated < 2 * measured + 0.002);
+  INFO("\tsuccess: %.3f%% of false positives, %.3f%% estimated\n", measured * 100, estimated * 100);
+
+  free_domain_filter(&filter);
+  assert(filter.blocks == NULL && filter.nb_blocks == 0 && filter.nb_keys == 0);
+}
+
+void test_domain_filter_reserve() {
+  INFO("Testing domain_filter_reserve...\n");
+
+  domain_filter_t filter;
+  init_domain_filter(&filter);
+  assert(domain_filter_reserve(&filter, 1) == 0 && filter.nb_blocks == 1);
+  domain_filter_add(&filter, domain_hash64("a.com", 5));
+  assert(domain_filter_contains(&filter, domain_hash64("a.com", 5)));
+
+  assert(domain_filter_reserve(&filter, 100) == 0 && filter.nb_keys == 0);
+  assert(domain_filter_false_positive_rate(&filter) == 0.0);
+  INFO("\tsuccess: Filter reserved again has been emptied\n");
+
+  assert(domain_filter_reserve(&filter, 0) == 0 && filter.blocks == NULL);
+  domain_filter_add(&filter, domain_hash64("a.com", 5));
+  assert(filter.nb_keys == 0 && !domain_filter_contains(&filter, domain_hash64("a.com", 5)));
+  INFO("\tsuccess: Filter reserved for no key stays empty\n");
+}
+
+int main() {
+  INFO("Running domain_filter.c tests...\n");
+
+  test_domain_filter_contains();
+  test_domain_filter_reserve();
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../includes/domain_set.h"
+#include "../includes/utils.h"
+
+void test_domain_hash() {
+  INFO("Testing domain_hash...\n");
+
+  assert(domain_hash("WWW.Example.COM", 15) == domain_hash("www.example.com", 15));
+  assert(domain_hash("Scamsite1.com.evil", 18) == domain_hash("scamsite1.com.EVIL", 18));
+  INFO("\tsuccess: Hash ignores the case of letters, across words\n");
+
+  assert(domain_hash("@", 1) != domain_hash("`", 1));
+  assert(domain_hash("[", 1) != domain_hash("{", 1));
+  assert(domain_hash("\xc1", 1) != domain_hash("\xe1", 1));
+  assert(domain_hash("a.com", 5) != domain_hash("a.com\0", 6));
+  INFO("\tsuccess: Bytes other than letters have been kept\n");
+}
+
+void test_domain_set_find() {
+  INFO("Testing domain_set_find...\n");
+
+  domain_set_t set;
+  init_domain_set(&set);
+  assert(domain_set_find(&set, "a.com", 5) == -1);
+  INFO("\tsuccess: Empty set has no domain\n");
+
+  assert(domain_set_add(&set, "scamsite1.com", 1) == 0);
+  assert(domain_set_add(&set, "gamblingsite1.com", 0) == 0);
+  assert(domain_set_add(&set, "SCAMSITE1.com", 2) == 1);
+  assert(set.count == 2);
+  INFO("\tsuccess: Domain added twice keeps its first category\n");
+
+  assert(domain_set_find(&set, "scamsite1.com", 13) == 1);
+  assert(domain_set_find(&set, "ScamSite1.COM", 13) == 1);
+  assert(domain_set_find(&set, "gamblingsite1.com:80", 17) == 0);
+  assert(domain_set_find(&set, "scamsite1.co", 12) == -1);
+  assert(domain_set_find(&set, "www.scamsite1.com", 17) == -1);
+  INFO("\tsuccess: Hosts have been found ignoring case, prefixes and suffixes have not\n");
+
+  char domain[] = "copied.example";
+  assert(domain_set_add(&set, domain, 3) == 0);
+  domain[0] = 'x';
+  assert(domain_set_find(&set, "copied.example", 14) == 3);
+  INFO("\tsuccess: Domain has been copied into the set\n");
+
+  free_domain_set(&set);
+  assert(set.slots == NULL && set.text == NULL && set.count == 0);
+}
+
+void test_domain_set_grow() {
+  INFO("Testing domain_set_add beyond the initial capacity...\n");
+
+  enum { COUNT = 5000 };
+  static char domains[COUNT][32];
+  domain_set_t set;
+  init_domain_set(&set);
+  for (int i = 0; i < COUNT; i++) {
+    snprintf(domains[i], sizeof(domains[i]), "host%d.example.com", i);
+    assert(domain_set_add(&set, domains[i], i) == 0);
+  }
+  assert(set.count == COUNT && set.capacity >= 2 * COUNT);
+  assert((set.capacity & (set.capacity - 1)) == 0);
+  INFO("\tsuccess: Table has grown, staying at most half full\n");
+
+  for (int i = 0; i < COUNT; i++) assert(domain_set_find(&set, domains[i], strlen(domains[i])) == i);
+  assert(domain_set_find(&set, "host5000.example.com", 20) == -1);
+  INFO("\tsuccess: Every domain has been found after the resizes\n");
+
+  assert(domain_set_check(&set, COUNT) && !domain_set_check(&set, COUNT - 1));
+  INFO("\tsuccess: Set has been checked against the number of categories\n");
+
+  size_t capacity = set.capacity;
+  assert(domain_set_reserve(&set, COUNT) == 0 && set.capacity == capacity);
+  free_domain_set(&set);
+
+  assert(domain_set_reserve(&set, COUNT) == 0 && set.capacity >= 2 * COUNT);
+  capacity = set.capacity;
+  for (int i = 0; i < COUNT; i++) assert(domain_set_add(&set, domains[i], i) == 0);
+  assert(set.capacity == capacity);
+  INFO("\tsuccess: Reserved table has not been resized while loading\n");
+  free_domain_set(&set);
+}
+
+int main() {
+  INFO("Running domain_set.c tests...\n");
+
+  test_domain_hash();
+  test_domain_set_find();
+  test_domain_set_grow();
+
+  return 0;
+}
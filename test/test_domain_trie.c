@@ -0,0 +1,108 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../includes/domain_trie.h"
+#include "../includes/utils.h"
+
+/**
+ * @brief Looks a NUL terminated host up in the trie.
+ */
+static int find(const domain_trie_t* trie, const char* host) {
+  return domain_trie_find(trie, host, strlen(host));
+}
+
+void test_domain_trie_find() {
+  INFO("Testing domain_trie_find...\n");
+
+  domain_trie_t trie;
+  init_domain_trie(&trie);
+  assert(find(&trie, "www.scamsite1.com") == -1);
+  INFO("\tsuccess: Empty trie matches no host\n");
+
+  assert(domain_trie_add(&trie, "scamsite1.com", 1) == 0);
+  assert(domain_trie_add(&trie, "ads.example.com", 2) == 0);
+  assert(domain_trie_add(&trie, "example.com", 3) == 0);
+  assert(domain_trie_add(&trie, "Scamsite1.COM", 4) == 1);
+  assert(trie.nb_rules == 3);
+  INFO("\tsuccess: Suffix added twice keeps its first category\n");
+
+  assert(find(&trie, "www.scamsite1.com") == 1);
+  assert(find(&trie, "a.b.CDN.ScamSite1.com") == 1);
+  assert(find(&trie, "scamsite1.com") == -1);
+  assert(find(&trie, "notscamsite1.com") == -1);
+  assert(find(&trie, "scamsite1.com.evil.org") == -1);
+  assert(find(&trie, ".scamsite1.com") == -1);
+  assert(find(&trie, "com") == -1);
+  INFO("\tsuccess: Subdomains have been matched, the suffix itself and lookalikes have not\n");
+
+  assert(find(&trie, "www.example.com") == 3);
+  assert(find(&trie, "x.ads.example.com") == 2);
+  assert(find(&trie, "ads.example.com") == 3);
+  INFO("\tsuccess: Most specific suffix has given the category\n");
+
+  assert(domain_trie_add(&trie, "", 0) == -1);
+  assert(domain_trie_add(&trie, "a..com", 0) == -1);
+  assert(domain_trie_add(&trie, "example.com.", 0) == -1);
+  char long_label[DOMAIN_TRIE_MAX_LABEL + 6];
+  memset(long_label, 'a', DOMAIN_TRIE_MAX_LABEL + 1);
+  strcpy(long_label + DOMAIN_TRIE_MAX_LABEL + 1, ".com");
+  assert(domain_trie_add(&trie, long_label, 0) == -1);
+  assert(trie.nb_rules == 3);
+  INFO("\tsuccess: Suffixes which are not domain names have been refused\n");
+
+  free_domain_trie(&trie);
+  assert(trie.categories == NULL && trie.nb_rules == 0);
+}
+
+void test_domain_trie_grow() {
+  INFO("Testing domain_trie_add beyond the initial capacity...\n");
+
+  enum { COUNT = 3000 };
+  domain_trie_t trie;
+  init_domain_trie(&trie);
+  char suffix[64];
+  for (int i = 0; i < COUNT; i++) {
+    snprintf(suffix, sizeof(suffix), "site%d.%s", i, i % 2 ? "com" : "net");
+    assert(domain_trie_add(&trie, suffix, i) == 0);
+  }
+  assert(trie.nb_rules == COUNT && trie.nb_nodes == COUNT + 3);
+  assert(trie.nb_nodes * 2 <= trie.edges_capacity);
+  INFO("\tsuccess: Arrays have grown, labels shared by the suffixes stored once\n");
+
+  char host[64];
+  for (int i = 0; i < COUNT; i++) {
+    snprintf(host, sizeof(host), "www.site%d.%s", i, i % 2 ? "com" : "net");
+    assert(find(&trie, host) == i);
+    snprintf(host, sizeof(host), "www.site%d.%s", i, i % 2 ? "net" : "com");
+    assert(find(&trie, host) == -1);
+  }
+  INFO("\tsuccess: Every suffix has been found after the resizes\n");
+
+  assert(domain_trie_check(&trie, COUNT) && !domain_trie_check(&trie, COUNT - 1));
+  INFO("\tsuccess: Trie has been checked against the number of categories\n");
+  free_domain_trie(&trie);
+}
+
+int main() {
+  INFO("Running domain_trie.c tests...\n");
+
+  test_domain_trie_find();
+  test_domain_trie_grow();
+
+  return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+#include "../includes/epoch.h"
+#include "../includes/utils.h"
+
+static atomic_int synchronized = 0;
+
+static void* synchronize_thread(void* arg) {
+  (void)arg;
+  epoch_synchronize();
+  atomic_store(&synchronized, 1);
+  return NULL;
+}
+
+void test_epoch_register() {
+  INFO("Testing epoch_register...\n");
+
+  int first = epoch_register();
+  int second = epoch_register();
+  assert(first >= 0 && second >= 0 && first != second);
+  epoch_unregister(first);
+  assert(epoch_register() == first);
+  INFO("\tsuccess: Slot of an unregistered reader has been reused\n");
+
+  epoch_unregister(first);
+  epoch_unregister(second);
+  epoch_unregister(-1);
+}
+
+void test_epoch_synchronize() {
+  INFO("Testing epoch_synchronize...\n");
+
+  int reader = epoch_register();
+  int idle = epoch_register();
+  assert(reader >= 0 && idle >= 0);
+
+  epoch_synchronize();
+  INFO("\tsuccess: Grace period has not waited for readers outside their section\n");
+
+  epoch_enter(reader);
+  pthread_t thread;
+  atomic_store(&synchronized, 0);
+  assert(pthread_create(&thread, NULL, synchronize_thread, NULL) == 0);
+  usleep(50 * 1000);
+  assert(atomic_load(&synchronized) == 0);
+  INFO("\tsuccess: Grace period has waited for the reader in its section\n");
+
+  // Entering again during the grace period sees the new epoch, which does not hold it back
+  epoch_exit(reader);
+  epoch_enter(reader);
+  assert(pthread_join(thread, NULL) == 0);
+  assert(atomic_load(&synchronized) == 1);
+  epoch_exit(reader);
+  INFO("\tsuccess: Grace period has ended once the reader left the section it was in\n");
+
+  epoch_unregister(reader);
+  epoch_unregister(idle);
+}
+
+int main() {
+  INFO("Running epoch.c tests...\n");
+
+  test_epoch_register();
+  test_epoch_synchronize();
+
+  return 0;
+}
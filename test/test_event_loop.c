@@ -0,0 +1,83 @@
+/*
+
+ * MIT License
+ * 
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ * 
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include "../includes/event_loop.h"
+#include "../includes/utils.h"
+
+void test_init_event_loop() {
+  INFO("Testing init_event_loop...\n");
+
+  int listen_fd = init_listen_socket("127.0.0.1", 8090, 5);
+  assert(listen_fd > 0);
+
+  event_loop_t loop;
+  assert(init_event_loop(&loop, listen_fd, 5) == 0);
+  assert(loop.epoll_fd > 0);
+  INFO("\tsuccess: Event loop has been created\n");
+
+  assert(fcntl(listen_fd, F_GETFL, 0) & O_NONBLOCK);
+  INFO("\tsuccess: Listening socket is non-blocking\n");
+
+  free_event_loop(&loop);
+  assert(loop.epoll_fd == -1);
+  INFO("\tsuccess: Event loop has been freed\n");
+
+  close(listen_fd);
+}
+
+void test_close_connection() {
+  INFO("Testing close_connection...\n");
+
+  int listen_fd = init_listen_socket("127.0.0.1", 8090, 5);
+  assert(listen_fd > 0);
+
+  event_loop_t loop;
+  assert(init_event_loop(&loop, listen_fd, 5) == 0);
+
+  connection_t* first = calloc(1, sizeof(connection_t));
+  connection_t* second = calloc(1, sizeof(connection_t));
+  assert(first && second);
+  first->client_fd = first->server_fd = -1;
+  second->client_fd = second->server_fd = -1;
+  first->next = second;
+  second->prev = first;
+  loop.connections = first;
+  loop.nb_connections = 2;
+
+  close_connection(&loop, first);
+  assert(first->closed);
+  assert(loop.connections == second && second->prev == NULL);
+  assert(loop.nb_connections == 1);
+  INFO("\tsuccess: Connection has been unlinked from the loop\n");
+
+  close_connection(&loop, first);
+  assert(loop.nb_connections == 1);
+  INFO("\tsuccess: Closing twice has no effect\n");
+
+  free_event_loop(&loop);
+  close(listen_fd);
+}
+
+int main() {
+  INFO("Running event_loop.c tests...\n");
+
+  test_init_event_loop();
+  test_close_connection();
+
+  return 0;
+}
@@ -31,6 +31,16 @@ void test_is_http_method() {
     INFO("\tsuccess: Invalid method has been recognized as invalid\n");
 }
 
+void test_is_idempotent_method() {
+    INFO("Testing is_idempotent_method...\n");
+
+    assert(is_idempotent_method("GET", 3) && is_idempotent_method("DELETE", 6));
+    INFO("\tsuccess: Idempotent methods have been recognized\n");
+
+    assert(!is_idempotent_method("POST", 4) && !is_idempotent_method("PATCH", 5) && !is_idempotent_method("GETX", 4));
+    INFO("\tsuccess: Other methods have been refused\n");
+}
+
 void test_is_http_request_complete() {
     INFO("Testing is_http_request_complete...\n");
 
@@ -73,6 +83,7 @@ void test_get_http_host() {
 
 int main() {
     test_is_http_method();
+    test_is_idempotent_method();
     test_is_http_request_complete();
     test_get_http_host();
     return 0;
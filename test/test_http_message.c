@@ -0,0 +1,415 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "../includes/http_message.h"
+#include "../includes/utils.h"
+
+/**
+ * @brief Fills a chain the way the proxy reads a head, keeping its lines in single segments.
+ */
+static void fill_chain(buffer_chain_t* chain, const char* data, size_t len) {
+  init_buffer_chain(chain, NULL);
+  while (len > 0) {
+    size_t room;
+    char* dest = buffer_chain_reserve(chain, 1, &room);
+    assert(dest != NULL);
+    if (room > len) room = len;
+    memcpy(dest, data, room);
+    buffer_chain_commit(chain, room);
+    data += room;
+    len -= room;
+  }
+}
+
+void test_find_http_head_end() {
+  INFO("Testing find_http_head_end...\n");
+
+  buffer_chain_t chain;
+  size_t head_len;
+  const char* request = "GET / HTTP/1.1\r\nHost: a\r\n\r\nbody";
+  fill_chain(&chain, request, strlen(request));
+  assert(find_http_head_end(&chain, &head_len) == 1);
+  assert(head_len == strlen(request) - 4);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: End of the head has been found\n");
+
+  const char* partial = "GET / HTTP/1.1\r\nHost: a\r\n";
+  fill_chain(&chain, partial, strlen(partial));
+  assert(find_http_head_end(&chain, &head_len) == 0);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Incomplete head has been detected\n");
+
+  // A header longer than a segment ends right before a segment boundary
+  char large[3 * BUFFER_SIZE];
+  size_t len = snprintf(large, sizeof(large), "GET / HTTP/1.1\r\nCookie: ");
+  size_t cookie_end = BUFFER_SEGMENT_CAPACITY * 2 - 2;
+  memset(large + len, 'c', cookie_end - len);
+  memcpy(large + cookie_end, "\r\n\r\n", 4);
+  fill_chain(&chain, large, cookie_end + 4);
+  assert(chain.nb_segments == 3);
+  assert(find_http_head_end(&chain, &head_len) == 1 && head_len == cookie_end + 4);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Empty line straddling two segments has been found\n");
+}
+
+void test_http_head_scan() {
+  INFO("Testing http_head_scan...\n");
+
+  buffer_chain_t chain;
+  init_buffer_chain(&chain, NULL);
+  http_head_scanner_t scanner;
+  init_http_head_scanner(&scanner);
+
+  // The head arrives one byte at a time, a stray \r\n\r inside does not end it
+  const char* request = "GET / HTTP/1.1\r\nX: a\r\n\rb\r\nHost: a\r\n\r\nbody";
+  size_t expected = strlen(request) - 4;
+  size_t head_len = 0;
+  for (size_t i = 0; i < strlen(request); i++) {
+    size_t room;
+    char* dest = buffer_chain_reserve(&chain, 1, &room);
+    assert(dest != NULL);
+    *dest = request[i];
+    buffer_chain_commit(&chain, 1);
+    int found = http_head_scan(&scanner, &chain, &head_len);
+    assert(found == (i + 1 >= expected));
+    assert(scanner.scanned == (i + 1 < expected ? i + 1 : expected));
+  }
+  assert(head_len == expected);
+  INFO("\tsuccess: Each byte has been scanned once and the end has been found\n");
+  buffer_chain_clear(&chain);
+
+  // The partial line moved to a new segment keeps its offset
+  char large[2 * BUFFER_SIZE];
+  size_t len = snprintf(large, sizeof(large), "GET / HTTP/1.1\r\n");
+  while (len < BUFFER_SEGMENT_CAPACITY + 50) len += snprintf(large + len, sizeof(large) - len, "X-Header: value\r\n");
+  memcpy(large + len, "\r\n", 2);
+  len += 2;
+  init_http_head_scanner(&scanner);
+  size_t done = 0;
+  while (done < len) {
+    size_t room;
+    char* dest = buffer_chain_reserve(&chain, 1, &room);
+    assert(dest != NULL);
+    if (room > 1000) room = 1000;
+    if (room > len - done) room = len - done;
+    memcpy(dest, large + done, room);
+    buffer_chain_commit(&chain, room);
+    done += room;
+    assert(http_head_scan(&scanner, &chain, &head_len) == (done == len));
+  }
+  assert(chain.nb_segments == 2 && head_len == len);
+  INFO("\tsuccess: End has been found across a moved line\n");
+  buffer_chain_clear(&chain);
+}
+
+void test_parse_http_head() {
+  INFO("Testing parse_http_head...\n");
+
+  buffer_chain_t chain;
+  http_head_t head;
+  http_body_t body;
+
+  const char* post = "POST /form HTTP/1.1\r\nHost: a\r\ncontent-length:  42 \r\nConnection: keep-alive, Upgrade\r\n\r\n";
+  fill_chain(&chain, post, strlen(post));
+  assert(parse_http_head(&chain, 0, &head) == 0);
+  assert(head.minor_version == 1 && head.content_length == 42 && !head.head_method);
+  assert(http_head_keep_alive(&head));
+  assert(init_request_body(&body, &head) == 0 && body.kind == HTTP_BODY_LENGTH && body.remaining == 42);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Request with a Content-Length has been parsed\n");
+
+  const char* smuggled = "POST / HTTP/1.1\r\nHost: a\r\nContent-Length: 4\r\nTransfer-Encoding: chunked\r\n\r\n";
+  fill_chain(&chain, smuggled, strlen(smuggled));
+  assert(parse_http_head(&chain, 0, &head) == 0);
+  assert(init_request_body(&body, &head) == -1);
+  buffer_chain_clear(&chain);
+
+  const char* lengths = "POST / HTTP/1.1\r\nContent-Length: 4\r\nContent-Length: 5\r\n\r\n";
+  fill_chain(&chain, lengths, strlen(lengths));
+  assert(parse_http_head(&chain, 0, &head) == -1);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Ambiguous request framing has been refused\n");
+
+  // The head would end at the bare line feed, the scanner at the second request
+  const char* hidden = "GET / HTTP/1.1\r\nHost: ok.com\n\nGET /casino HTTP/1.1\r\nHost: banned.com\r\n\r\n";
+  fill_chain(&chain, hidden, strlen(hidden));
+  size_t head_len;
+  assert(find_http_head_end(&chain, &head_len) == 1 && head_len == strlen(hidden));
+  assert(parse_http_head(&chain, 0, &head) == -1);
+  buffer_chain_clear(&chain);
+
+  const char* bare = "GET / HTTP/1.1\nHost: ok.com\r\n\r\n";
+  fill_chain(&chain, bare, strlen(bare));
+  assert(parse_http_head(&chain, 0, &head) == -1);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Request lines ending with a bare line feed have been refused\n");
+
+  const char* chunked = "HTTP/1.1 200 OK\r\nTransfer-Encoding: gzip, chunked\r\nConnection: close\r\n\r\n";
+  fill_chain(&chain, chunked, strlen(chunked));
+  assert(parse_http_head(&chain, 1, &head) == 0);
+  assert(head.status == 200 && head.chunked && !http_head_keep_alive(&head));
+  init_response_body(&body, &head, 0);
+  assert(body.kind == HTTP_BODY_CHUNKED);
+  init_response_body(&body, &head, 1);
+  assert(body.kind == HTTP_BODY_NONE && body.done);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Chunked response has been parsed, without body for HEAD\n");
+
+  const char* old = "HTTP/1.0 200 OK\r\nServer: x\r\n\r\n";
+  fill_chain(&chain, old, strlen(old));
+  assert(parse_http_head(&chain, 1, &head) == 0);
+  assert(!http_head_keep_alive(&head));
+  init_response_body(&body, &head, 0);
+  assert(body.kind == HTTP_BODY_UNTIL_CLOSE);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: HTTP/1.0 response lasts until close\n");
+
+  const char* garbage = "ICY 200 OK\r\n\r\n";
+  fill_chain(&chain, garbage, strlen(garbage));
+  assert(parse_http_head(&chain, 1, &head) == -1);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Invalid status line has been refused\n");
+}
+
+void test_parse_http_head_index() {
+  INFO("Testing the header index of parse_http_head...\n");
+
+  buffer_chain_t chain;
+  http_head_t head;
+
+  const char* request = "GET http://a.com/x?y HTTP/1.0\r\nhost:  a.com \r\nAccept: */*\r\nContent-Length: 13\r\n\r\nHost: evil.com";
+  fill_chain(&chain, request, strlen(request));
+  assert(parse_http_head(&chain, 0, &head) == 0);
+  assert(head.method.len == 3 && strncmp(head.method.data, "GET", 3) == 0);
+  assert(head.target.len == 16 && strncmp(head.target.data, "http://a.com/x?y", 16) == 0);
+  assert(head.version.len == 8 && head.minor_version == 0);
+  assert(head.nb_headers == 3);
+  assert(head.host.len == 5 && strncmp(head.host.data, "a.com", 5) == 0);
+  assert(head.host.data > chain.head->data && head.host.data < chain.head->data + chain.head->len);
+  const http_header_t* accept = http_head_find(&head, "accept");
+  assert(accept && accept->value.len == 3 && strncmp(accept->value.data, "*/*", 3) == 0);
+  assert(http_head_find(&head, "Cookie") == NULL);
+  INFO("\tsuccess: Request line and headers have been indexed in place, ignoring the body\n");
+
+  const char* bad[] = {
+    "GET / HTTP/1.1\r\nHost: a\r\nHost: b\r\n\r\n",
+    "GET / HTTP/1.1\r\nHost : a\r\n\r\n",
+    "GET / HTTP/1.1\r\nHost: a\r\n folded\r\n\r\n",
+    "GET / HTTP/1.1\r\nNoColon\r\n\r\n",
+    "GET /a b HTTP/1.1\r\nHost: a\r\n\r\n",
+    "GET / HTTP/2.0\r\nHost: a\r\n\r\n",
+  };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    fill_chain(&chain, bad[i], strlen(bad[i]));
+    assert(parse_http_head(&chain, 0, &head) == -1);
+    buffer_chain_clear(&chain);
+  }
+  INFO("\tsuccess: Ambiguous request lines and headers have been refused\n");
+
+  char many[HTTP_MAX_HEADERS * 16 + 64];
+  size_t len = snprintf(many, sizeof(many), "HTTP/1.1 200\r\n");
+  for (int i = 0; i <= HTTP_MAX_HEADERS; i++) len += snprintf(many + len, sizeof(many) - len, "X-%d: v\r\n", i);
+  len += snprintf(many + len, sizeof(many) - len, "\r\n");
+  fill_chain(&chain, many, len);
+  assert(parse_http_head(&chain, 1, &head) == 0);
+  assert(head.status == 200 && head.nb_headers == HTTP_MAX_HEADERS);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Response with more headers than the index has been kept\n");
+}
+
+void test_parse_http_head_long_lines() {
+  INFO("Testing parse_http_head with lines longer than a segment...\n");
+
+  buffer_chain_t chain;
+  http_head_t head;
+  char large[2 * BUFFER_SIZE];
+
+  // The value of Content-Length is padded with white space past the end of the first segment
+  size_t len = snprintf(large, sizeof(large), "POST / HTTP/1.1\r\nHost: a\r\nContent-Length:");
+  memset(large + len, ' ', BUFFER_SIZE);
+  len += BUFFER_SIZE;
+  len += snprintf(large + len, sizeof(large) - len, "5\r\n\r\nhello");
+  fill_chain(&chain, large, len);
+  assert(chain.nb_segments > 1);
+  assert(parse_http_head(&chain, 0, &head) == -1 && head.invalid && head.content_length == -1);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Request with a Content-Length padded across segments has been refused\n");
+
+  const char* names[] = { "Transfer-Encoding", "host", "Connection", "Content-Length " };
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    len = snprintf(large, sizeof(large), "GET / HTTP/1.1\r\nHost: a\r\n%s:", names[i]);
+    memset(large + len, 'x', BUFFER_SIZE);
+    len += BUFFER_SIZE;
+    len += snprintf(large + len, sizeof(large) - len, "\r\n\r\n");
+    fill_chain(&chain, large, len);
+    assert(parse_http_head(&chain, 0, &head) == -1);
+    buffer_chain_clear(&chain);
+  }
+  INFO("\tsuccess: Requests with framing, host or connection headers longer than a segment have been refused\n");
+
+  len = snprintf(large, sizeof(large), "GET / HTTP/1.1\r\nHost: a\r\nCookie: ");
+  memset(large + len, 'c', BUFFER_SIZE);
+  len += BUFFER_SIZE;
+  len += snprintf(large + len, sizeof(large) - len, "\r\nAccept: */*\r\n\r\n");
+  fill_chain(&chain, large, len);
+  assert(parse_http_head(&chain, 0, &head) == 0);
+  assert(head.nb_headers == 2 && http_head_find(&head, "Accept") && !http_head_find(&head, "Cookie"));
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Request with another header longer than a segment has been parsed without it\n");
+
+  len = snprintf(large, sizeof(large), "HTTP/1.1 200 OK\r\nContent-Length:");
+  memset(large + len, ' ', BUFFER_SIZE);
+  len += BUFFER_SIZE;
+  len += snprintf(large + len, sizeof(large) - len, "5\r\n\r\n");
+  fill_chain(&chain, large, len);
+  assert(parse_http_head(&chain, 1, &head) == -1);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Response with a Content-Length padded across segments has been refused\n");
+
+  // A redirect URL longer than a segment
+  len = snprintf(large, sizeof(large), "GET http://a.com/sso?token=");
+  size_t token = len;
+  memset(large + len, 't', BUFFER_SIZE);
+  len += BUFFER_SIZE;
+  size_t target_len = len - 4;
+  len += snprintf(large + len, sizeof(large) - len, " HTTP/1.1\r\nHost: a.com\r\nAccept: */*\r\n\r\n");
+  fill_chain(&chain, large, len);
+  assert(chain.nb_segments == 2);
+  assert(parse_http_head(&chain, 0, &head) == 0);
+  assert(head.start_line && head.start_line_len == target_len + 4 + strlen(" HTTP/1.1\r\n"));
+  assert(head.method.len == 3 && strncmp(head.method.data, "GET", 3) == 0);
+  assert(head.target.len == target_len && memcmp(head.target.data, large + 4, target_len) == 0);
+  assert(head.target.data[token - 4] == 't' && head.minor_version == 1);
+  assert(head.nb_headers == 2 && head.host.len == 5 && strncmp(head.host.data, "a.com", 5) == 0);
+  assert(head.end > chain.head->next->data && head.end < chain.head->next->data + chain.head->next->len);
+  free_http_head(&head);
+  assert(head.start_line == NULL);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Request line longer than a segment has been parsed from a copy\n");
+
+  len = snprintf(large, sizeof(large), "HTTP/1.1 200 ");
+  memset(large + len, 'o', BUFFER_SIZE);
+  len += BUFFER_SIZE;
+  len += snprintf(large + len, sizeof(large) - len, "\r\n\r\n");
+  fill_chain(&chain, large, len);
+  assert(parse_http_head(&chain, 1, &head) == -1 && head.start_line == NULL);
+  buffer_chain_clear(&chain);
+  INFO("\tsuccess: Status line longer than a segment has been refused\n");
+}
+
+void test_http_header_hop_by_hop() {
+  INFO("Testing http_header_hop_by_hop...\n");
+
+  buffer_chain_t chain;
+  http_head_t head;
+
+  const char* request = "GET / HTTP/1.1\r\nHost: a\r\nConnection: close, X-Trace\r\nkeep-alive: 5\r\n"
+                        "Proxy-Connection: close\r\nX-Trace: 1\r\nAccept: */*\r\n\r\n";
+  fill_chain(&chain, request, strlen(request));
+  assert(parse_http_head(&chain, 0, &head) == 0);
+  const int hop_by_hop[] = { 0, 1, 1, 1, 1, 0 };
+  assert(head.nb_headers == 6);
+  for (int i = 0; i < head.nb_headers; i++) assert(http_header_hop_by_hop(&head, &head.headers[i]) == hop_by_hop[i]);
+  INFO("\tsuccess: Connection headers and the headers they name are hop-by-hop\n");
+
+  assert(head.end == strstr(chain.head->data, "\r\n\r\n") + 2);
+  INFO("\tsuccess: Empty line ending the head has been found\n");
+  buffer_chain_clear(&chain);
+}
+
+void test_http_target_origin_form() {
+  INFO("Testing http_target_origin_form...\n");
+
+  const char* targets[] = { "http://a.com/x?y", "HTTP://a.com:8080", "http://a.com?q=1", "/x", "*", "https://a.com/" };
+  const size_t prefixes[] = { 12, 17, 12 };
+  for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+    http_slice_t target = { targets[i], strlen(targets[i]) };
+    size_t prefix_len = 0;
+    int absolute = http_target_origin_form(&target, &prefix_len);
+    assert(absolute == (i < 3));
+    if (absolute) assert(prefix_len == prefixes[i]);
+  }
+  INFO("\tsuccess: Scheme and authority of absolute targets have been found\n");
+}
+
+void test_http_body_chunked() {
+  INFO("Testing a chunked body...\n");
+
+  const char* data = "5;ext=1\r\nhello\r\nA\r\n0123456789\r\n0\r\nTrailer: x\r\n\r\nNEXT";
+  size_t body_len = strlen(data) - 4;
+
+  // Fed one byte at a time, as split by the network
+  http_body_t body;
+  init_http_body(&body, HTTP_BODY_CHUNKED, 0);
+  size_t consumed = 0;
+  for (size_t i = 0; i < strlen(data) && !body.done; i++) consumed += http_body_consume(&body, data + i, 1);
+  assert(body.done && !body.error && consumed == body_len);
+  INFO("\tsuccess: Body has been followed byte by byte\n");
+
+  init_http_body(&body, HTTP_BODY_CHUNKED, 0);
+  assert(http_body_consume(&body, data, strlen(data)) == body_len);
+  assert(body.done);
+  INFO("\tsuccess: Bytes past the body have been left out\n");
+
+  // The data of a chunk is relayed without being looked at
+  init_http_body(&body, HTTP_BODY_CHUNKED, 0);
+  assert(http_body_raw_limit(&body) == 0);
+  assert(http_body_consume(&body, "10\r\n", 4) == 4);
+  assert(http_body_raw_limit(&body) == 16);
+  http_body_skip(&body, 16);
+  assert(http_body_raw_limit(&body) == 0);
+  assert(http_body_consume(&body, "\r\n0\r\n\r\n", 7) == 7 && body.done);
+  INFO("\tsuccess: Chunk data has been skipped\n");
+
+  init_http_body(&body, HTTP_BODY_CHUNKED, 0);
+  assert(http_body_consume(&body, "zz\r\n", 4) == 4);
+  assert(body.error && body.kind == HTTP_BODY_UNTIL_CLOSE);
+  INFO("\tsuccess: Malformed chunk size has been detected\n");
+}
+
+void test_http_body_length() {
+  INFO("Testing a body of known length...\n");
+
+  http_body_t body;
+  init_http_body(&body, HTTP_BODY_LENGTH, 10);
+  assert(http_body_raw_limit(&body) == 10);
+  assert(http_body_consume(&body, "01234", 5) == 5 && !body.done);
+  assert(http_body_consume(&body, "56789GET /", 10) == 5 && body.done);
+  assert(http_body_raw_limit(&body) == 0);
+  INFO("\tsuccess: Body has ended after its length\n");
+
+  init_http_body(&body, HTTP_BODY_LENGTH, 0);
+  assert(body.done);
+  init_http_body(&body, HTTP_BODY_NONE, 0);
+  assert(body.done && http_body_consume(&body, "x", 1) == 0);
+  INFO("\tsuccess: Empty bodies are done at once\n");
+}
+
+int main() {
+  INFO("Running http_message.c tests...\n");
+
+  test_find_http_head_end();
+  test_http_head_scan();
+  test_parse_http_head();
+  test_parse_http_head_index();
+  test_parse_http_head_long_lines();
+  test_http_header_hop_by_hop();
+  test_http_target_origin_form();
+  test_http_body_chunked();
+  test_http_body_length();
+
+  return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+#include <assert.h>
+#include <assert.h>
+#include <string.h>
+#include "../includes/http_scan.h"
+#include "../includes/utils.h"
+
+/**
+ * @brief Levels to compare, the unsupported ones are skipped.
+ */
+static const http_scan_level_t levels[] = { HTTP_SCAN_SCALAR, HTTP_SCAN_SSE2, HTTP_SCAN_AVX2 };
+
+static size_t reference_any(const char* data, size_t len, const char* set) {
+  for (size_t i = 0; i < len; i++) {
+    if (data[i] && strchr(set, data[i])) return i;
+  }
+  return len;
+}
+
+void test_http_scan_byte() {
+  INFO("Testing http_scan_byte at every level...\n");
+
+  // The block is followed by a delimiter that must never be reached
+  char data[200];
+  for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+    if (http_scan_select(levels[l]) != 0) {
+      INFO("\tskipped: %s is not supported\n", http_scan_level_name(levels[l]));
+      continue;
+    }
+    for (size_t start = 0; start < 32; start++) {
+      for (size_t len = 0; start + len < sizeof(data) - 1; len += 7) {
+        memset(data, 'a', sizeof(data));
+        data[start + len] = '\n';
+        assert(http_scan_byte(data + start, len, '\n') == len);
+        for (size_t at = 0; at < len; at += 5) {
+          data[start + at] = '\n';
+          assert(http_scan_byte(data + start, len, '\n') == at);
+          data[start + at] = (char)0x8a;
+          assert(http_scan_byte(data + start, len, '\n') == len);
+          assert(http_scan_byte(data + start, len, (char)0x8a) == at);
+          data[start + at] = 'a';
+        }
+      }
+    }
+    INFO("\tsuccess: %s has found the first byte at every offset and alignment\n", http_scan_level_name(levels[l]));
+  }
+}
+
+void test_http_scan_any() {
+  INFO("Testing http_scan_any at every level...\n");
+
+  const char* lines = "Host: example.com\r\nAccept-Encoding:gzip\r\n";
+  char data[300];
+  for (size_t i = 0; i < sizeof(data); i++) data[i] = lines[i % strlen(lines)];
+  for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+    if (http_scan_select(levels[l]) != 0) continue;
+    const char* sets[] = { ":", "\r\n", ": \t", "\r\n: ", "z" };
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+      for (size_t start = 0; start < 40; start++) {
+        for (size_t len = 0; start + len <= sizeof(data); len += 3) {
+          assert(http_scan_any(data + start, len, sets[s]) == reference_any(data + start, len, sets[s]));
+        }
+      }
+    }
+    assert(http_scan_any(data, sizeof(data), "") == sizeof(data));
+    INFO("\tsuccess: %s has agreed with the reference on every set\n", http_scan_level_name(levels[l]));
+  }
+}
+
+int main() {
+  INFO("Running http_scan.c tests...\n");
+
+  http_scan_level_t best = http_scan_level();
+  INFO("Selected level: %s\n", http_scan_level_name(best));
+  test_http_scan_byte();
+  test_http_scan_any();
+  assert(http_scan_select(best) == 0);
+
+  return 0;
+}
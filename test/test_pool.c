@@ -0,0 +1,108 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <stdalign.h>
+#include <stdint.h>
+#include <string.h>
+#include "../includes/pool.h"
+#include "../includes/server.h"
+#include "../includes/utils.h"
+
+void test_slab_pool() {
+  INFO("Testing the slab pool...\n");
+
+  pool_t pool;
+  init_pool(&pool, sizeof(connection_t));
+
+  void* objects[POOL_SLAB_OBJECTS + 1];
+  for (int i = 0; i <= POOL_SLAB_OBJECTS; i++) {
+    objects[i] = pool_alloc(&pool);
+    assert(objects[i] != NULL);
+    assert((uintptr_t)objects[i] % alignof(max_align_t) == 0);
+    memset(objects[i], 0xff, sizeof(connection_t));
+  }
+  assert(pool.nb_slabs == 2 && pool.nb_used == POOL_SLAB_OBJECTS + 1);
+  INFO("\tsuccess: Objects are carved out of slabs\n");
+
+  pool_free(&pool, objects[3]);
+  assert(pool_alloc(&pool) == objects[3]);
+  assert(pool.nb_slabs == 2);
+  INFO("\tsuccess: Freed object is reused without a new slab\n");
+
+  free_pool(&pool);
+  assert(pool.slabs == NULL && pool.nb_slabs == 0);
+  INFO("\tsuccess: Pool has been freed\n");
+}
+
+void test_buffer_pool() {
+  INFO("Testing the buffer pool...\n");
+
+  buffer_pool_t pool;
+  init_buffer_pool(&pool, BUFFER_SIZE);
+
+  char* first = buffer_pool_get(&pool);
+  assert(first != NULL && pool.nb_used == 1);
+  memset(first, 'x', BUFFER_SIZE);
+  buffer_pool_put(&pool, first);
+  assert(pool.nb_used == 0 && pool.nb_free == 1);
+  assert(buffer_pool_get(&pool) == first);
+  buffer_pool_put(&pool, first);
+  INFO("\tsuccess: Buffer is recycled\n");
+
+  char* buffers[BUFFER_POOL_MAX_FREE + 8];
+  for (int i = 0; i < BUFFER_POOL_MAX_FREE + 8; i++) buffers[i] = buffer_pool_get(&pool);
+  for (int i = 0; i < BUFFER_POOL_MAX_FREE + 8; i++) buffer_pool_put(&pool, buffers[i]);
+  assert(pool.nb_free == BUFFER_POOL_MAX_FREE && pool.nb_used == 0);
+  INFO("\tsuccess: Free buffers are bounded\n");
+
+  free_buffer_pool(&pool);
+  assert(pool.nb_free == 0);
+  INFO("\tsuccess: Buffer pool has been freed\n");
+}
+
+void test_connection_attach_buffer() {
+  INFO("Testing attach_buffer and release_buffer...\n");
+
+  buffer_pool_t pool;
+  init_buffer_pool(&pool, BUFFER_SIZE);
+
+  connection_t conn;
+  memset(&conn, 0, sizeof(connection_t));
+  conn.buffers = &pool;
+  assert(sizeof(connection_t) < 512);
+  INFO("\tsuccess: Idle connection takes %zu bytes\n", sizeof(connection_t));
+
+  assert(attach_buffer(&conn, CONN_SIDE_SERVER) == 0);
+  char* buffer = conn.server_buffer;
+  assert(buffer != NULL && pool.nb_used == 1);
+  assert(attach_buffer(&conn, CONN_SIDE_SERVER) == 0 && conn.server_buffer == buffer);
+  INFO("\tsuccess: Buffer attached once\n");
+
+  release_buffer(&conn, CONN_SIDE_SERVER);
+  assert(conn.server_buffer == NULL && pool.nb_used == 0);
+  INFO("\tsuccess: Buffer given back to the pool\n");
+
+  free_buffer_pool(&pool);
+}
+
+int main() {
+  INFO("Running pool.c tests...\n");
+
+  test_slab_pool();
+  test_buffer_pool();
+  test_connection_attach_buffer();
+
+  return 0;
+}
@@ -82,11 +82,148 @@ void test_free_rules() {
     remove(rules_filename);
 }
 
+void test_is_host_deny() {
+    INFO("Testing is_host_deny...\n");
+
+    const char* rules_filename = "test_rules.rules";
+    create_test_rules_file(rules_filename);
+    assert(init_rules(rules_filename) == 0);
+    assert(rules.domains.count == 2);
+
+    assert(find_host_category(current_rules(), "example.com") == 0);
+    assert(find_host_category(current_rules(), "another-example.com") == 1);
+    assert(find_host_category(current_rules(), "Another-Example.COM") == 1);
+    assert(find_host_category(current_rules(), "example.org") == -1);
+    INFO("\tsuccess: Category of banned hosts has been found\n");
+
+    assert(find_host_category(current_rules(), "example.com:8080") == 0);
+    assert(find_host_category(current_rules(), "example.com.") == 0);
+    assert(find_host_category(current_rules(), "www.example.com") == -1);
+    INFO("\tsuccess: Port and final dot of the host have been ignored\n");
+
+    assert(is_host_deny(NULL, "example.com") == 1);
+    assert(is_host_deny(NULL, "www.example.org") == 0);
+    INFO("\tsuccess: Banned hosts have been denied, others allowed\n");
+
+    free_rules();
+    assert(rules.domains.count == 0);
+    assert(find_host_category(current_rules(), "example.com") == -1);
+    INFO("\tsuccess: No host is denied once the rules are freed\n");
+
+    remove(rules_filename);
+}
+
+void test_is_host_deny_suffix() {
+    INFO("Testing is_host_deny with subdomain rules...\n");
+
+    const char* rules_filename = "test_rules.rules";
+    FILE* file = fopen(rules_filename, "w");
+    assert(file != NULL);
+    fprintf(file, "[scam]\n");
+    fprintf(file, "BAN_DOMAIN *.scamsite1.com\n");
+    fprintf(file, "BAN_DOMAIN *..bad\n");
+    fprintf(file, "[others]\n");
+    fprintf(file, "BAN_DOMAIN cdn.scamsite1.com\n");
+    fclose(file);
+
+    assert(init_rules(rules_filename) == 0);
+    assert(rules.domains.count == 1 && rules.suffixes.nb_rules == 1);
+    INFO("\tsuccess: Invalid suffix rule has been ignored\n");
+
+    assert(find_host_category(current_rules(), "www.scamsite1.com") == 0);
+    assert(find_host_category(current_rules(), "a.b.scamsite1.com:80") == 0);
+    assert(find_host_category(current_rules(), "scamsite1.com") == -1);
+    assert(find_host_category(current_rules(), "cdn.scamsite1.com") == 1);
+    INFO("\tsuccess: Subdomains have been denied, exact domains taking precedence\n");
+
+    assert(rules.filter.nb_keys == 2 && rules.filter.nb_blocks > 0);
+    assert(find_host_category(current_rules(), "x.CDN.ScamSite1.com.") == 0);
+    assert(find_host_category(current_rules(), "scamsite1.com.evil") == -1);
+    INFO("\tsuccess: Domain filter holds the domain and the suffix, and lets their hosts through\n");
+
+    free_rules();
+    assert(rules.suffixes.nb_rules == 0 && rules.filter.blocks == NULL);
+    remove(rules_filename);
+}
+
+void test_find_banned_word() {
+    INFO("Testing find_banned_word...\n");
+
+    const char* rules_filename = "test_rules.rules";
+    create_test_rules_file(rules_filename);
+    assert(init_rules(rules_filename) == 0);
+    assert(rules.words.nb_words == 2);
+
+    const char* word = NULL;
+    assert(find_banned_word(current_rules(), "/top-SECRET/file", 16, &word) == 0);
+    assert(strcmp(word, "secret") == 0);
+    assert(find_banned_word(current_rules(), "/forbidden", 10, &word) == 1);
+    assert(strcmp(word, "forbidden") == 0);
+    assert(find_banned_word(current_rules(), "/forbid", 7, NULL) == -1);
+    INFO("\tsuccess: Banned words have been found with their category\n");
+
+    free_rules();
+    assert(find_banned_word(current_rules(), "/secret", 7, NULL) == -1);
+    INFO("\tsuccess: No word is banned once the rules are freed\n");
+    remove(rules_filename);
+}
+
+void test_reload_rules() {
+    INFO("Testing reload_rules...\n");
+
+    const char* rules_filename = "test_rules.rules";
+    create_test_rules_file(rules_filename);
+    assert(init_rules(rules_filename) == 0);
+    assert(current_rules() == &rules);
+
+    verdict_cache_t verdicts;
+    init_verdict_cache(&verdicts, 16);
+    assert(is_host_deny(&verdicts, "example.com") == 1 && is_host_deny(&verdicts, "example.org") == 0);
+    assert(is_host_deny(&verdicts, "Example.COM:80") == 1 && verdicts.nb_entries == 2);
+    INFO("\tsuccess: Verdicts have been cached by host name\n");
+
+    // A response scanner keeps the words of the rules it started with
+    rules_t* held = acquire_rules();
+    assert(held == &rules);
+
+    FILE* file = fopen(rules_filename, "w");
+    assert(file != NULL);
+    fprintf(file, "[Reloaded]\nBAN_DOMAIN example.org\nBAN_WORD casino\n");
+    fclose(file);
+    assert(reload_rules(rules_filename) == 0);
+    const rules_t* set = current_rules();
+    assert(set != held && set->nb_rules == 1 && strcmp(set->rules[0].name, "Reloaded") == 0);
+    assert(is_host_deny(&verdicts, "example.org") == 1 && is_host_deny(&verdicts, "example.com") == 0);
+    assert(verdicts.generation == set->generation);
+    assert(find_banned_word(set, "/casino", 7, NULL) == 0);
+    INFO("\tsuccess: New rules have been published\n");
+
+    assert(find_host_category(held, "example.com") == 0);
+    assert(find_banned_word(held, "/secret", 7, NULL) == 0);
+    release_rules(held);
+    assert(rules.nb_rules == 0 && rules.rules == NULL);
+    INFO("\tsuccess: Previous rules stayed usable until their last reference was released\n");
+
+    remove(rules_filename);
+    assert(reload_rules(rules_filename) == -1);
+    assert(current_rules() == set && is_host_deny(&verdicts, "example.org") == 1);
+    INFO("\tsuccess: Rules have been kept when the file could not be loaded\n");
+
+    free_rules();
+    assert(current_rules() == &rules && is_host_deny(&verdicts, "example.org") == 0);
+    INFO("\tsuccess: Reloaded rules have been freed, and their cached verdicts forgotten\n");
+    free_verdict_cache(&verdicts);
+}
+
 int main() {
     INFO("Running rules.c tests...\n");
 
     test_init_rules();
     test_free_rules();
+    test_is_host_deny();
+    test_is_host_deny_suffix();
+    test_find_banned_word();
+    test_reload_rules();
 
     INFO("Cleaning up after rules tests...\n");
 
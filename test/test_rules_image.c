@@ -0,0 +1,228 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../includes/rules_image.h"
+#include "../includes/utils.h"
+
+#define RULES_FILENAME "test_rules_image.rules"
+#define IMAGE_FILENAME "test_rules_image.img"
+
+/**
+ * @brief Hosts and texts looked up before and after the image is written.
+ */
+static const char* hosts[] = {
+  "example.com", "EXAMPLE.com:8080", "www.example.com", "another-example.com",
+  "deep.sub.scam.example.org", "scam.example.org", "allowed.net", "[::1]:80"
+};
+static const char* texts[] = { "/top-secret/", "/Forbidden", "/allowed", "/casi", "no" };
+
+static void create_rules_file() {
+  FILE* file = fopen(RULES_FILENAME, "w");
+  assert(file != NULL);
+  fprintf(file, "[Categorie1]\nBAN_DOMAIN example.com\nBAN_WORD secret\n");
+  fprintf(file, "[Categorie2]\nBAN_DOMAIN another-example.com\nBAN_DOMAIN *.scam.example.org\nBAN_WORD forbidden\n");
+  fprintf(file, "[Categorie3]\nBAN_WORD casino\n");
+  fclose(file);
+}
+
+/**
+ * @brief Writes the image of the test rules, returning the lookups of the rules file.
+ */
+static void compile_image(int* host_categories, int* text_categories) {
+  create_rules_file();
+  assert(!is_rules_image(RULES_FILENAME));
+  assert(init_rules(RULES_FILENAME) == 0);
+  assert(rules.image == NULL);
+  for (size_t i = 0; i < sizeof(hosts) / sizeof(hosts[0]); i++) host_categories[i] = find_host_category(current_rules(), hosts[i]);
+  for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+    text_categories[i] = find_banned_word(current_rules(), texts[i], strlen(texts[i]), NULL);
+  }
+  assert(write_rules_image(&rules, IMAGE_FILENAME) == 0);
+  free_rules();
+  remove(RULES_FILENAME);
+}
+
+void test_map_rules_image() {
+  INFO("Testing map_rules_image...\n");
+
+  int host_categories[sizeof(hosts) / sizeof(hosts[0])];
+  int text_categories[sizeof(texts) / sizeof(texts[0])];
+  compile_image(host_categories, text_categories);
+  assert(is_rules_image(IMAGE_FILENAME));
+  INFO("\tsuccess: Image has been written and recognized\n");
+
+  assert(init_rules(IMAGE_FILENAME) == 0);
+  assert(rules.image != NULL);
+  assert(rules.nb_rules == 3);
+  assert(strcmp(rules.rules[0].name, "Categorie1") == 0 && strcmp(rules.rules[2].name, "Categorie3") == 0);
+  assert(rules.filter.nb_keys == 3 && rules.filter.nb_blocks > 0);
+  assert((uintptr_t)rules.filter.blocks % 64 == 0);
+  INFO("\tsuccess: Image has been mapped with the names of the categories\n");
+
+  for (size_t i = 0; i < sizeof(hosts) / sizeof(hosts[0]); i++) {
+    assert(find_host_category(current_rules(), hosts[i]) == host_categories[i]);
+  }
+  assert(host_categories[0] == 0 && host_categories[4] == 1 && host_categories[5] == -1);
+  for (size_t i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+    const char* word = NULL;
+    assert(find_banned_word(current_rules(), texts[i], strlen(texts[i]), &word) == text_categories[i]);
+    if (text_categories[i] >= 0) assert(word != NULL);
+  }
+  assert(text_categories[1] == 1 && text_categories[3] == -1);
+  INFO("\tsuccess: Lookups in the image match those of the rules file\n");
+
+  free_rules();
+  assert(rules.image == NULL && rules.rules == NULL);
+  assert(find_host_category(current_rules(), "example.com") == -1);
+  INFO("\tsuccess: Image has been unmapped\n");
+
+  remove(IMAGE_FILENAME);
+}
+
+/**
+ * @brief Writes an image and checks that it is refused.
+ */
+static void assert_image_refused(const char* image, size_t size) {
+  FILE* file = fopen(IMAGE_FILENAME, "wb");
+  assert(file != NULL && fwrite(image, 1, size, file) == size);
+  fclose(file);
+  assert(init_rules(IMAGE_FILENAME) == -1);
+  assert(rules.image == NULL && rules.rules == NULL && rules.nb_rules == 0);
+}
+
+/**
+ * @brief Returns the first entry of a section of an image.
+ */
+static void* section_of(char* image, rules_image_section_id_t id) {
+  return image + ((rules_image_header_t*)image)->sections[id].offset;
+}
+
+void test_map_rules_image_invalid() {
+  INFO("Testing map_rules_image with invalid images...\n");
+
+  int host_categories[sizeof(hosts) / sizeof(hosts[0])];
+  int text_categories[sizeof(texts) / sizeof(texts[0])];
+  compile_image(host_categories, text_categories);
+
+  FILE* file = fopen(IMAGE_FILENAME, "rb");
+  assert(file != NULL);
+  static char image[1 << 16];
+  size_t size = fread(image, 1, sizeof(image), file);
+  fclose(file);
+  assert(size > sizeof(rules_image_header_t) && size < sizeof(image));
+
+  // Truncated, then of another version
+  file = fopen(IMAGE_FILENAME, "wb");
+  assert(fwrite(image, 1, size - 8, file) == size - 8);
+  fclose(file);
+  assert(init_rules(IMAGE_FILENAME) == -1);
+  assert(rules.image == NULL && rules.nb_rules == 0);
+  INFO("\tsuccess: Truncated image has been refused\n");
+
+  ((rules_image_header_t*)image)->version = RULES_IMAGE_VERSION + 1;
+  file = fopen(IMAGE_FILENAME, "wb");
+  assert(fwrite(image, 1, size, file) == size);
+  fclose(file);
+  assert(init_rules(IMAGE_FILENAME) == -1);
+  assert(rules.image == NULL);
+  INFO("\tsuccess: Image of another version has been refused\n");
+
+  // Entries pointing out of their section or to a category that does not exist
+  ((rules_image_header_t*)image)->version = RULES_IMAGE_VERSION;
+  static char corrupted[sizeof(image)];
+  const rules_image_header_t* header = (const rules_image_header_t*)corrupted;
+
+  memcpy(corrupted, image, size);
+  ((rules_image_header_t*)corrupted)->nb_categories = 4;
+  assert_image_refused(corrupted, size);
+
+  memcpy(corrupted, image, size);
+  ((rules_image_word_t*)section_of(corrupted, RULES_IMAGE_WORDS))[0].text = header->sections[RULES_IMAGE_WORD_TEXT].len;
+  assert_image_refused(corrupted, size);
+
+  memcpy(corrupted, image, size);
+  ((rules_image_word_t*)section_of(corrupted, RULES_IMAGE_WORDS))[1].category = 3;
+  assert_image_refused(corrupted, size);
+
+  memcpy(corrupted, image, size);
+  uint32_t* transitions = section_of(corrupted, RULES_IMAGE_WORD_TRANSITIONS);
+  transitions[0] = (header->sections[RULES_IMAGE_WORD_MATCHES].len / sizeof(int32_t)) * header->nb_classes;
+  assert_image_refused(corrupted, size);
+
+  memcpy(corrupted, image, size);
+  int32_t* matches = section_of(corrupted, RULES_IMAGE_WORD_MATCHES);
+  for (size_t i = 0; i < header->sections[RULES_IMAGE_WORD_MATCHES].len / sizeof(int32_t); i++) {
+    if (matches[i] >= 0) matches[i] = 3;
+  }
+  assert_image_refused(corrupted, size);
+  INFO("\tsuccess: Corrupted words and automaton have been refused\n");
+
+  memcpy(corrupted, image, size);
+  domain_slot_t* slots = section_of(corrupted, RULES_IMAGE_DOMAIN_SLOTS);
+  for (size_t i = 0; i < header->sections[RULES_IMAGE_DOMAIN_SLOTS].len / sizeof(domain_slot_t); i++) {
+    if (slots[i].domain) slots[i].category = 3;
+  }
+  assert_image_refused(corrupted, size);
+
+  memcpy(corrupted, image, size);
+  slots = section_of(corrupted, RULES_IMAGE_DOMAIN_SLOTS);
+  for (size_t i = 0; i < header->sections[RULES_IMAGE_DOMAIN_SLOTS].len / sizeof(domain_slot_t); i++) {
+    if (slots[i].domain) slots[i].domain = header->sections[RULES_IMAGE_DOMAIN_TEXT].len;
+  }
+  assert_image_refused(corrupted, size);
+
+  memcpy(corrupted, image, size);
+  domain_trie_edge_t* edges = section_of(corrupted, RULES_IMAGE_TRIE_EDGES);
+  for (size_t i = 0; i < header->sections[RULES_IMAGE_TRIE_EDGES].len / sizeof(domain_trie_edge_t); i++) {
+    if (edges[i].child) edges[i].child = header->sections[RULES_IMAGE_TRIE_CATEGORIES].len / sizeof(int32_t);
+  }
+  assert_image_refused(corrupted, size);
+
+  memcpy(corrupted, image, size);
+  edges = section_of(corrupted, RULES_IMAGE_TRIE_EDGES);
+  for (size_t i = 0; i < header->sections[RULES_IMAGE_TRIE_EDGES].len / sizeof(domain_trie_edge_t); i++) {
+    if (edges[i].child) edges[i].label = header->sections[RULES_IMAGE_TRIE_LABELS].len - 1;
+  }
+  assert_image_refused(corrupted, size);
+
+  memcpy(corrupted, image, size);
+  int32_t* categories = section_of(corrupted, RULES_IMAGE_TRIE_CATEGORIES);
+  categories[header->sections[RULES_IMAGE_TRIE_CATEGORIES].len / sizeof(int32_t) - 1] = 3;
+  assert_image_refused(corrupted, size);
+  INFO("\tsuccess: Corrupted domain set and suffix trie have been refused\n");
+
+  memcpy(corrupted, image, size);
+  file = fopen(IMAGE_FILENAME, "wb");
+  assert(fwrite(corrupted, 1, size, file) == size);
+  fclose(file);
+  assert(init_rules(IMAGE_FILENAME) == 0 && rules.image != NULL);
+  free_rules();
+
+  free_rules();
+  remove(IMAGE_FILENAME);
+}
+
+int main() {
+  INFO("Running rules_image.c tests...\n");
+
+  test_map_rules_image();
+  test_map_rules_image_invalid();
+
+  return 0;
+}
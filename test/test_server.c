@@ -14,8 +14,12 @@
  */
 
 #include <assert.h>
+#include <fcntl.h>
 #include <arpa/inet.h>
+#include "../includes/config.h"
 #include "../includes/server.h"
+#include "../includes/server_helper.h"
+#include "../includes/rules.h"
 #include "../includes/utils.h"
 
 void test_init_listen_socket() {
@@ -42,24 +46,632 @@ void test_handle_http() {
   snprintf(conn.client_ip, sizeof(conn.client_ip), "127.0.0.1");
 
   const char* valid_request = "GET / HTTP/1.1\r\nHost: example.com\r\n\r\n";
-  strcpy(conn.client_buffer, valid_request);
-  conn.client_buffer_len = strlen(valid_request);
+  assert(buffer_chain_append(&conn.request, valid_request, strlen(valid_request)) == 0);
+  assert(attach_request_head(&conn) == 0);
+  assert(parse_http_head(&conn.request, 0, conn.request_head) == 0);
 
   assert(handle_http(&conn) == 0);
   INFO("\tsuccess: Valid HTTP request has been handled correctly\n");
 
   const char* invalid_request = "GET / HTTP/1.1\r\n\r\n";
-  strcpy(conn.client_buffer, invalid_request);
-  conn.client_buffer_len = strlen(invalid_request);
+  buffer_chain_clear(&conn.request);
+  assert(buffer_chain_append(&conn.request, invalid_request, strlen(invalid_request)) == 0);
+  assert(attach_request_head(&conn) == 0);
+  assert(parse_http_head(&conn.request, 0, conn.request_head) == 0);
 
   assert(handle_http(&conn) == 1);
   INFO("\tsuccess: HTTP request without Host has been correctly rejected\n");
+  buffer_chain_clear(&conn.request);
+  release_request_head(&conn);
+}
+
+void test_handle_connection_incremental() {
+  INFO("Testing handle_connection with a request sent in several parts...\n");
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  connection_t conn;
+  memset(&conn, 0, sizeof(connection_t));
+  conn.client_fd = fds[0];
+  conn.server_fd = -1;
+
+  assert(handle_connection(&conn) == CONN_PENDING);
+  assert(conn.request.head == NULL);
+  INFO("\tsuccess: Nothing received yet, the connection is pending without buffer\n");
+
+  const char* part = "GET / HTTP/1.1\r\nHo";
+  assert(write(fds[1], part, strlen(part)) == (ssize_t)strlen(part));
+  assert(handle_connection(&conn) == CONN_PENDING);
+  assert(conn.request.len == strlen(part));
+  assert(strcmp(conn.request.head->data, part) == 0);
+  INFO("\tsuccess: Partial headers are kept without blocking\n");
+
+  close(fds[1]);
+  assert(handle_connection(&conn) == 1);
+  INFO("\tsuccess: Client closing before the end of its headers is an error\n");
+  buffer_chain_clear(&conn.request);
+  assert(conn.request.head == NULL && conn.request.nb_segments == 0);
+  close(fds[0]);
+
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  memset(&conn, 0, sizeof(connection_t));
+  conn.client_fd = fds[0];
+  conn.server_fd = -1;
+
+  const char* not_http = "SSH-2.0-OpenSSH\r\n";
+  assert(write(fds[1], not_http, strlen(not_http)) == (ssize_t)strlen(not_http));
+  assert(handle_connection(&conn) == 1);
+  INFO("\tsuccess: Unknown protocol is rejected as soon as the method is known\n");
+  buffer_chain_clear(&conn.request);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+void test_handle_http_async_connect() {
+  INFO("Testing handle_http with a non-blocking connect...\n");
+
+  assert(init_regex() == 0);
+  int listen_fd = init_listen_socket("127.0.0.1", 8092, 5);
+  assert(listen_fd > 0);
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  connection_t conn;
+  memset(&conn, 0, sizeof(connection_t));
+  conn.client_fd = fds[0];
+  conn.server_fd = -1;
+  snprintf(conn.client_ip, sizeof(conn.client_ip), "127.0.0.1");
+
+  const char* request = "GET / HTTP/1.1\r\nHost: 127.0.0.1:8092\r\n\r\n";
+  assert(buffer_chain_append(&conn.request, request, strlen(request)) == 0);
+  assert(attach_request_head(&conn) == 0);
+  assert(parse_http_head(&conn.request, 0, conn.request_head) == 0);
+
+  assert(handle_http(&conn) == 0);
+  assert(conn.state == CONN_STATE_CONNECTING);
+  assert(conn.server_fd > 0);
+  assert(strcmp(conn.server_ip, "127.0.0.1") == 0);
+  INFO("\tsuccess: Connection to the server has been started\n");
+
+  int server_side = accept(listen_fd, NULL, NULL);
+  assert(server_side > 0);
+  assert(handle_server_connected(&conn) == 0);
+  assert(conn.state == CONN_STATE_RELAYING);
+  assert(conn.request.len == 0);
+  assert(conn.request.head == NULL);
+
+  const char* expected = "GET / HTTP/1.1\r\nHost: 127.0.0.1:8092\r\nX-Forwarded-For: 127.0.0.1\r\nVia: 1.1 proxy\r\n\r\n";
+  char received[BUFFER_SIZE] = {0};
+  assert(read(server_side, received, sizeof(received)) == (ssize_t)strlen(expected));
+  assert(strcmp(received, expected) == 0);
+  INFO("\tsuccess: Buffered request has been flushed to the server once connected\n");
+
+  assert(conn.splicing && conn.client_pipe[0] >= 0 && conn.server_pipe[1] >= 0);
+  assert(fcntl(conn.client_fd, F_GETFL, 0) & O_NONBLOCK);
+  INFO("\tsuccess: Relay pipes have been opened\n");
+
+  close_relay_pipes(&conn);
+  assert(!conn.splicing);
+  INFO("\tsuccess: Relay pipes have been closed\n");
+  release_request_head(&conn);
+
+  close(server_side);
+  close(conn.server_fd);
+  close(listen_fd);
+  close(fds[0]);
+  close(fds[1]);
+  free_regex();
+}
+
+void test_handle_connection_large_request() {
+  INFO("Testing handle_connection with headers larger than a buffer...\n");
+
+  assert(init_regex() == 0);
+  int listen_fd = init_listen_socket("127.0.0.1", 8093, 5);
+  assert(listen_fd > 0);
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  connection_t conn;
+  memset(&conn, 0, sizeof(connection_t));
+  conn.client_fd = fds[0];
+  conn.server_fd = -1;
+  snprintf(conn.client_ip, sizeof(conn.client_ip), "127.0.0.1");
+
+  // The second cookie is longer than a segment
+  char request[16384];
+  int len = snprintf(request, sizeof(request), "GET / HTTP/1.1\r\nHost: 127.0.0.1:8093\r\n");
+  for (int i = 0; i < 3; i++) {
+    int size = i == 1 ? 6000 : 3000;
+    len += snprintf(request + len, sizeof(request) - len, "Cookie: c%d=", i);
+    memset(request + len, 'a' + i, size);
+    len += size;
+    len += snprintf(request + len, sizeof(request) - len, "\r\n");
+  }
+  len += snprintf(request + len, sizeof(request) - len, "\r\n");
+  assert(len > BUFFER_SIZE);
+  assert(write(fds[1], request, len) == len);
+
+  assert(handle_connection(&conn) == 0);
+  assert(conn.state == CONN_STATE_CONNECTING);
+  assert(conn.request.len == (size_t)len && conn.request.nb_segments > 1);
+  INFO("\tsuccess: Request of %d bytes has been read into %d segments\n", len, conn.request.nb_segments);
+
+  int server_side = accept(listen_fd, NULL, NULL);
+  assert(server_side > 0);
+  assert(handle_server_connected(&conn) == 0);
+  assert(conn.request.len == 0 && conn.request.nb_segments == 0);
+
+  // Only the forwarding headers are added, before the empty line
+  char expected[16384];
+  int expected_len = snprintf(expected, sizeof(expected), "%.*sX-Forwarded-For: 127.0.0.1\r\nVia: 1.1 proxy\r\n\r\n", len - 2, request);
+  char received[16384];
+  int total = 0;
+  while (total < expected_len) {
+    ssize_t bytes = read(server_side, received + total, sizeof(received) - total);
+    assert(bytes > 0);
+    total += bytes;
+  }
+  assert(total == expected_len && memcmp(received, expected, expected_len) == 0);
+  INFO("\tsuccess: Request has been written to the server with its headers unchanged\n");
+
+  close_relay_pipes(&conn);
+  close(server_side);
+  close(conn.server_fd);
+  close(listen_fd);
+  close(fds[0]);
+  close(fds[1]);
+  free_regex();
+}
+
+void test_handle_connection_pipelined() {
+  INFO("Testing handle_connection with pipelined requests...\n");
+
+  assert(init_regex() == 0);
+  int listen_fd = init_listen_socket("127.0.0.1", 8094, 5);
+  assert(listen_fd > 0);
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  connection_t conn;
+  memset(&conn, 0, sizeof(connection_t));
+  conn.client_fd = fds[0];
+  conn.server_fd = -1;
+  snprintf(conn.client_ip, sizeof(conn.client_ip), "127.0.0.1");
+
+  const char* first = "POST /a HTTP/1.1\r\nHost: 127.0.0.1:8094\r\nContent-Length: 4\r\n\r\nbody";
+  const char* second = "GET /b HTTP/1.1\r\nHost: 127.0.0.1:8094\r\n\r\n";
+  char requests[256];
+  int len = snprintf(requests, sizeof(requests), "%s%s", first, second);
+  assert(write(fds[1], requests, len) == len);
+
+  assert(handle_connection(&conn) == 0);
+  assert(conn.state == CONN_STATE_CONNECTING && conn.keep_client && conn.nb_requests == 1);
+  assert(conn.request.len == strlen(first) && conn.request_body.done);
+  assert(conn.pipelined.len == strlen(second));
+  assert(strncmp(conn.pipelined.head->data, second, strlen(second)) == 0);
+  INFO("\tsuccess: Next request has been set aside with the body of the first one read\n");
+
+  close(conn.server_fd);
+  conn.server_fd = -1;
+  start_next_request(&conn);
+  assert(conn.state == CONN_STATE_READING_REQUEST && conn.pipelined.len == 0);
+  assert(handle_connection(&conn) == 0);
+  assert(conn.state == CONN_STATE_CONNECTING && conn.nb_requests == 2);
+  assert(conn.request.len == strlen(second) && conn.request_body.done && conn.pipelined.len == 0);
+  assert(conn.request_head->target.len == 2 && strncmp(conn.request_head->target.data, "/b", 2) == 0);
+  INFO("\tsuccess: Pipelined request has been parsed and routed on its own\n");
+
+  buffer_chain_clear(&conn.request);
+  release_request_head(&conn);
+  close_relay_pipes(&conn);
+  close(conn.server_fd);
+  close(listen_fd);
+  close(fds[0]);
+  close(fds[1]);
+  free_regex();
+}
+
+void test_handle_server_connected_origin_form() {
+  INFO("Testing handle_server_connected with an absolute-form target...\n");
+
+  assert(init_regex() == 0);
+  int listen_fd = init_listen_socket("127.0.0.1", 8095, 5);
+  assert(listen_fd > 0);
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  connection_t conn;
+  memset(&conn, 0, sizeof(connection_t));
+  conn.client_fd = fds[0];
+  conn.server_fd = -1;
+  snprintf(conn.client_ip, sizeof(conn.client_ip), "127.0.0.1");
+
+  const char* request = "POST http://127.0.0.1:8095?q=1 HTTP/1.1\r\nHost: 127.0.0.1:8095\r\nContent-Length: 4\r\n\r\nbody";
+  const char* expected = "POST /?q=1 HTTP/1.1\r\nHost: 127.0.0.1:8095\r\nContent-Length: 4\r\n"
+                         "X-Forwarded-For: 127.0.0.1\r\nVia: 1.1 proxy\r\n\r\nbody";
+  assert(write(fds[1], request, strlen(request)) == (ssize_t)strlen(request));
+  assert(handle_connection(&conn) == 0);
+
+  int server_side = accept(listen_fd, NULL, NULL);
+  assert(server_side > 0);
+  assert(handle_server_connected(&conn) == 0);
+  assert(conn.request.len == 0);
+
+  char received[BUFFER_SIZE] = {0};
+  size_t total = 0;
+  while (total < strlen(expected)) {
+    ssize_t bytes = read(server_side, received + total, sizeof(received) - total);
+    assert(bytes > 0);
+    total += bytes;
+  }
+  assert(total == strlen(expected) && strcmp(received, expected) == 0);
+  INFO("\tsuccess: Request line has been sent in origin form, the client and the proxy recorded\n");
+
+  release_request_head(&conn);
+  close_relay_pipes(&conn);
+  close(server_side);
+  close(conn.server_fd);
+  close(listen_fd);
+  close(fds[0]);
+  close(fds[1]);
+  free_regex();
+}
+
+void test_handle_server_connected_long_target() {
+  INFO("Testing handle_server_connected with a request line longer than a buffer...\n");
+
+  assert(init_regex() == 0);
+  int listen_fd = init_listen_socket("127.0.0.1", 8098, 5);
+  assert(listen_fd > 0);
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  connection_t conn;
+  memset(&conn, 0, sizeof(connection_t));
+  conn.client_fd = fds[0];
+  conn.server_fd = -1;
+  snprintf(conn.client_ip, sizeof(conn.client_ip), "127.0.0.1");
+
+  // A redirect URL spanning two segments, with an absolute-form target
+  char query[BUFFER_SIZE + 1];
+  memset(query, 'q', BUFFER_SIZE);
+  query[BUFFER_SIZE] = '\0';
+  char request[2 * BUFFER_SIZE];
+  int len = snprintf(request, sizeof(request), "GET http://127.0.0.1:8098/sso?r=%s HTTP/1.1\r\nHost: 127.0.0.1:8098\r\n\r\n", query);
+  char expected[2 * BUFFER_SIZE];
+  int expected_len = snprintf(expected, sizeof(expected), "GET /sso?r=%s HTTP/1.1\r\nHost: 127.0.0.1:8098\r\n"
+                              "X-Forwarded-For: 127.0.0.1\r\nVia: 1.1 proxy\r\n\r\n", query);
+  assert(write(fds[1], request, len) == len);
+  assert(handle_connection(&conn) == 0);
+  assert(conn.request.nb_segments == 2 && conn.request_head->start_line != NULL);
+
+  int server_side = accept(listen_fd, NULL, NULL);
+  assert(server_side > 0);
+  assert(handle_server_connected(&conn) == 0);
+  assert(conn.request.len == 0);
+
+  char received[2 * BUFFER_SIZE];
+  int total = 0;
+  while (total < expected_len) {
+    ssize_t bytes = read(server_side, received + total, sizeof(received) - total);
+    assert(bytes > 0);
+    total += bytes;
+  }
+  assert(total == expected_len && memcmp(received, expected, expected_len) == 0);
+  INFO("\tsuccess: Request line of %d bytes has been sent in origin form\n", len);
+
+  release_request_head(&conn);
+  close_relay_pipes(&conn);
+  close(server_side);
+  close(conn.server_fd);
+  close(listen_fd);
+  close(fds[0]);
+  close(fds[1]);
+  free_regex();
+}
+
+/**
+ * @brief Reads a request of known length from the server side of a connection.
+ */
+static void read_request_sent(int server_side, const char* expected) {
+  char received[BUFFER_SIZE] = {0};
+  size_t total = 0;
+  while (total < strlen(expected)) {
+    ssize_t bytes = read(server_side, received + total, sizeof(received) - total);
+    assert(bytes > 0);
+    total += bytes;
+  }
+  assert(total == strlen(expected) && strcmp(received, expected) == 0);
+}
+
+void test_handle_response_reused_closed() {
+  INFO("Testing a reused server connection closed before answering...\n");
+
+  assert(init_regex() == 0);
+  int listen_fd = init_listen_socket("127.0.0.1", 8099, 5);
+  assert(listen_fd > 0);
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(8099);
+  inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+  upstream_pool_t upstreams;
+  init_upstream_pool(&upstreams, 2, 16, 1000);
+
+  const char* requests[] = {
+    "GET http://127.0.0.1:8099/ HTTP/1.1\r\nHost: 127.0.0.1:8099\r\n\r\n",
+    "POST http://127.0.0.1:8099/ HTTP/1.1\r\nHost: 127.0.0.1:8099\r\nContent-Length: 4\r\n\r\nbody",
+  };
+  const char* expected[] = {
+    "GET / HTTP/1.1\r\nHost: 127.0.0.1:8099\r\nX-Forwarded-For: 127.0.0.1\r\nVia: 1.1 proxy\r\n\r\n",
+    "POST / HTTP/1.1\r\nHost: 127.0.0.1:8099\r\nContent-Length: 4\r\nX-Forwarded-For: 127.0.0.1\r\nVia: 1.1 proxy\r\n\r\nbody",
+  };
+  for (int i = 0; i < 2; i++) {
+    // An idle connection the origin closes right after the request is sent on it
+    int idle_fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert(connect(idle_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    int idle_side = accept(listen_fd, NULL, NULL);
+    assert(idle_side > 0);
+    assert(upstream_pool_put(&upstreams, &addr, idle_fd, 0) == 0);
+
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    connection_t conn;
+    memset(&conn, 0, sizeof(connection_t));
+    conn.client_fd = fds[0];
+    conn.server_fd = -1;
+    conn.upstreams = &upstreams;
+    snprintf(conn.client_ip, sizeof(conn.client_ip), "127.0.0.1");
+
+    assert(write(fds[1], requests[i], strlen(requests[i])) == (ssize_t)strlen(requests[i]));
+    assert(handle_connection(&conn) == 0);
+    assert(conn.server_fd == idle_fd && conn.retryable == (i == 0));
+    assert(handle_server_connected(&conn) == 0);
+    read_request_sent(idle_side, expected[i]);
+    close(idle_side);
+
+    if (i == 1) {
+      // Sending a POST again could repeat its effect, the client sees the connection close
+      assert(handle_response(&conn) == 0 && conn.response_body.kind == HTTP_BODY_UNTIL_CLOSE);
+      INFO("\tsuccess: POST has not been sent again\n");
+    } else {
+      assert(handle_response(&conn) == CONN_RETRY);
+      assert(retry_request(&conn) == 0 && !conn.retryable && conn.state == CONN_STATE_CONNECTING);
+      int server_side = accept(listen_fd, NULL, NULL);
+      assert(server_side > 0);
+      assert(handle_server_connected(&conn) == 0 && conn.request.len == 0);
+      read_request_sent(server_side, expected[i]);
+
+      const char* response = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+      assert(write(server_side, response, strlen(response)) == (ssize_t)strlen(response));
+      assert(handle_response(&conn) == 0 && conn.response_started);
+      INFO("\tsuccess: GET has been sent again on a new connection, which answered\n");
+      close(server_side);
+    }
+
+    release_request_head(&conn);
+    close_relay_pipes(&conn);
+    buffer_chain_clear(&conn.request);
+    buffer_chain_clear(&conn.response);
+    close(conn.server_fd);
+    close(fds[0]);
+    close(fds[1]);
+  }
+
+  free_upstream_pool(&upstreams);
+  close(listen_fd);
+  free_regex();
+}
+
+void test_handle_server_connected_forwarding() {
+  INFO("Testing handle_server_connected with hop-by-hop and forwarding headers...\n");
+
+  assert(init_regex() == 0);
+  int listen_fd = init_listen_socket("127.0.0.1", 8096, 5);
+  assert(listen_fd > 0);
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  connection_t conn;
+  memset(&conn, 0, sizeof(connection_t));
+  conn.client_fd = fds[0];
+  conn.server_fd = -1;
+  snprintf(conn.client_ip, sizeof(conn.client_ip), "10.0.0.7");
+
+  const char* request = "GET / HTTP/1.0\r\nHost: 127.0.0.1:8096\r\nConnection: keep-alive, X-Trace\r\n"
+                        "X-Forwarded-For: 192.0.2.1\r\nKeep-Alive: timeout=5\r\nX-Trace: 1\r\n"
+                        "Via: 1.1 edge\r\nProxy-Connection: keep-alive\r\nAccept: */*\r\n\r\n";
+  const char* expected = "GET / HTTP/1.0\r\nHost: 127.0.0.1:8096\r\nX-Forwarded-For: 192.0.2.1, 10.0.0.7\r\n"
+                         "Via: 1.1 edge, 1.0 proxy\r\nAccept: */*\r\n\r\n";
+  assert(write(fds[1], request, strlen(request)) == (ssize_t)strlen(request));
+  assert(handle_connection(&conn) == 0);
+
+  int server_side = accept(listen_fd, NULL, NULL);
+  assert(server_side > 0);
+  assert(handle_server_connected(&conn) == 0);
+
+  char received[BUFFER_SIZE] = {0};
+  size_t total = 0;
+  while (total < strlen(expected)) {
+    ssize_t bytes = read(server_side, received + total, sizeof(received) - total);
+    assert(bytes > 0);
+    total += bytes;
+  }
+  assert(total == strlen(expected) && strcmp(received, expected) == 0);
+  INFO("\tsuccess: Hop-by-hop headers have been dropped, the client and the proxy appended\n");
+
+  release_request_head(&conn);
+  close_relay_pipes(&conn);
+  close(server_side);
+  close(conn.server_fd);
+  close(listen_fd);
+  close(fds[0]);
+  close(fds[1]);
+  free_regex();
+}
+
+void test_handle_http_banned_word() {
+  INFO("Testing handle_http with banned words...\n");
+
+  const char* rules_filename = "test_server.rules";
+  FILE* file = fopen(rules_filename, "w");
+  assert(file != NULL);
+  fprintf(file, "[gambling]\nBAN_WORD casino\n[others]\nBAN_WORD forbidden\n");
+  fclose(file);
+  assert(init_rules(rules_filename) == 0);
+
+  const char* requests[] = {
+    "GET http://127.0.0.1:8097/Online-Casino/ HTTP/1.1\r\nHost: 127.0.0.1:8097\r\n\r\n",
+    "GET / HTTP/1.1\r\nHost: 127.0.0.1:8097\r\nReferer: http://forbidden.example/\r\n\r\n",
+  };
+  for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); i++) {
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    connection_t conn;
+    memset(&conn, 0, sizeof(connection_t));
+    conn.client_fd = fds[0];
+    conn.server_fd = -1;
+    snprintf(conn.client_ip, sizeof(conn.client_ip), "127.0.0.1");
+    assert(buffer_chain_append(&conn.request, requests[i], strlen(requests[i])) == 0);
+    assert(attach_request_head(&conn) == 0);
+    assert(parse_http_head(&conn.request, 0, conn.request_head) == 0);
+
+    assert(handle_http(&conn) == 1);
+    assert(conn.server_fd == -1);
+    char received[64] = {0};
+    assert(read(fds[1], received, sizeof(received) - 1) > 0);
+    assert(strncmp(received, "HTTP/1.1 403", 12) == 0);
+
+    release_request_head(&conn);
+    buffer_chain_clear(&conn.request);
+    close(fds[0]);
+    close(fds[1]);
+  }
+  INFO("\tsuccess: Banned words in the target and the Referer have been refused\n");
+
+  free_rules();
+  remove(rules_filename);
+}
+
+void test_handle_response() {
+  INFO("Testing handle_response...\n");
+
+  int fds[2];
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+  connection_t conn;
+  memset(&conn, 0, sizeof(connection_t));
+  conn.client_fd = -1;
+  conn.server_fd = fds[0];
+  conn.keep_server = 1;
+
+  const char* head = "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n";
+  assert(write(fds[1], head, strlen(head)) == (ssize_t)strlen(head));
+  assert(handle_response(&conn) == CONN_PENDING);
+  assert(!conn.response_started);
+  INFO("\tsuccess: Partial response headers are kept\n");
+
+  const char* rest = "\r\n01234";
+  assert(write(fds[1], rest, strlen(rest)) == (ssize_t)strlen(rest));
+  assert(handle_response(&conn) == 0);
+  assert(conn.response_started && conn.keep_server);
+  assert(conn.response_body.kind == HTTP_BODY_LENGTH && conn.response_body.remaining == 5);
+  INFO("\tsuccess: Body already read has been accounted for\n");
+  buffer_chain_clear(&conn.response);
+
+  memset(&conn, 0, sizeof(connection_t));
+  conn.client_fd = -1;
+  conn.server_fd = fds[0];
+  conn.keep_server = 1;
+  const char* upgrade = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n\r\n";
+  assert(write(fds[1], upgrade, strlen(upgrade)) == (ssize_t)strlen(upgrade));
+  assert(handle_response(&conn) == 0);
+  assert(conn.response_body.kind == HTTP_BODY_UNTIL_CLOSE && !conn.keep_server);
+  INFO("\tsuccess: Switching protocols is relayed until close\n");
+  buffer_chain_clear(&conn.response);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+void test_handle_response_filtered() {
+  INFO("Testing handle_response with a filtered body...\n");
+
+  const char* rules_filename = "test_server.rules";
+  FILE* file = fopen(rules_filename, "w");
+  assert(file != NULL);
+  fprintf(file, "[gambling]\nBAN_WORD casino\n");
+  fclose(file);
+  assert(init_rules(rules_filename) == 0);
+  config.filter_responses = 1;
+
+  const char* responses[] = {
+    "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 40\r\n\r\n<p>Play at our CASINO",
+    "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: 40\r\n\r\n<p>Nothing to see",
+  };
+  for (size_t i = 0; i < sizeof(responses) / sizeof(responses[0]); i++) {
+    int server_fds[2], client_fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, server_fds) == 0);
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, client_fds) == 0);
+
+    connection_t conn;
+    memset(&conn, 0, sizeof(connection_t));
+    conn.client_fd = client_fds[0];
+    conn.server_fd = server_fds[0];
+    conn.keep_server = 1;
+    assert(write(server_fds[1], responses[i], strlen(responses[i])) == (ssize_t)strlen(responses[i]));
+
+    if (i == 0) {
+      assert(handle_response(&conn) == 1);
+      char received[64] = {0};
+      assert(read(client_fds[1], received, sizeof(received) - 1) > 0);
+      assert(strncmp(received, "HTTP/1.1 403", 12) == 0);
+    } else {
+      assert(handle_response(&conn) == 0);
+      assert(conn.response_filter != NULL);
+      assert(filter_response_body(&conn, "...casino...", 12) == 1);
+    }
+    release_response_filter(&conn);
+    assert(conn.response_filter == NULL);
+    buffer_chain_clear(&conn.response);
+    close(server_fds[0]);
+    close(server_fds[1]);
+    close(client_fds[0]);
+    close(client_fds[1]);
+  }
+  INFO("\tsuccess: Banned word blocked the response, or was found in the rest of the body\n");
+
+  config.filter_responses = 0;
+  free_rules();
+  remove(rules_filename);
 }
 
 int main() {
   INFO("Running server.c tests...\n");
 
   test_init_listen_socket();
+  test_handle_connection_incremental();
+  test_handle_http_async_connect();
+  test_handle_connection_large_request();
+  test_handle_connection_pipelined();
+  test_handle_server_connected_origin_form();
+  test_handle_server_connected_long_target();
+  test_handle_server_connected_forwarding();
+  test_handle_http_banned_word();
+  test_handle_response();
+  test_handle_response_filtered();
+  test_handle_response_reused_closed();
   test_handle_http();
 
   return 0;
@@ -17,6 +17,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include "../includes/server_helper.h"
 #include "../includes/utils.h"
 
@@ -81,12 +83,39 @@ void test_multiple_invalid_cases() {
     INFO("\tsuccess: All invalid cases passed\n");
 }
 
+void test_send_non_blocking() {
+    INFO("Testing send_non_blocking...\n");
+
+    int fds[2];
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    static char chunk[65536];
+    memset(chunk, 'x', sizeof(chunk));
+    assert(send_non_blocking(fds[0], chunk, 100) == 100);
+    INFO("\tsuccess: Small buffer sent at once\n");
+
+    // Nobody reads the peer: the socket fills up without blocking
+    ssize_t sent;
+    do {
+        sent = send_non_blocking(fds[0], chunk, sizeof(chunk));
+        assert(sent >= 0);
+    } while (sent == (ssize_t)sizeof(chunk));
+    assert(send_non_blocking(fds[0], chunk, sizeof(chunk)) == 0);
+    INFO("\tsuccess: Partial send reported when the socket is full\n");
+
+    close(fds[1]);
+    assert(send_non_blocking(fds[0], chunk, 100) == -1);
+    INFO("\tsuccess: Error reported once the peer is closed\n");
+    close(fds[0]);
+}
+
 int main() {
     INFO("Running server_helper.c tests...\n");
 
     assert(init_regex() == 0);
     test_multiple_valid_cases();
     test_multiple_invalid_cases();
+    test_send_non_blocking();
     free_regex();
 
     INFO("All tests passed!\n");
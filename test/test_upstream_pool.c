@@ -0,0 +1,110 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../includes/upstream_pool.h"
+#include "../includes/utils.h"
+
+static struct sockaddr_in origin(const char* ip, int port) {
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  inet_pton(AF_INET, ip, &addr.sin_addr);
+  return addr;
+}
+
+void test_upstream_pool_reuse() {
+  INFO("Testing upstream_pool_put and upstream_pool_get...\n");
+
+  upstream_pool_t pool;
+  init_upstream_pool(&pool, 2, 16, 1000);
+  struct sockaddr_in a = origin("10.0.0.1", 80);
+  struct sockaddr_in b = origin("10.0.0.1", 8080);
+
+  int fds[3][2];
+  for (int i = 0; i < 3; i++) assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) == 0);
+
+  assert(upstream_pool_put(&pool, &a, fds[0][0], 0) == 0);
+  assert(upstream_pool_put(&pool, &a, fds[1][0], 10) == 0);
+  assert(upstream_pool_put(&pool, &a, fds[2][0], 20) == -1);
+  assert(pool.nb_idle == 2);
+  INFO("\tsuccess: Idle connections of an origin are capped\n");
+
+  assert(upstream_pool_get(&pool, &b) == -1);
+  assert(upstream_pool_get(&pool, &a) == fds[1][0]);
+  assert(upstream_pool_get(&pool, &a) == fds[0][0]);
+  assert(upstream_pool_get(&pool, &a) == -1);
+  assert(pool.nb_idle == 0);
+  INFO("\tsuccess: Most recent connection of the same origin is reused first\n");
+
+  // The origin closed the connection while it was idle
+  assert(upstream_pool_put(&pool, &b, fds[2][0], 0) == 0);
+  close(fds[2][1]);
+  assert(upstream_pool_get(&pool, &b) == -1);
+  assert(pool.nb_idle == 0);
+  INFO("\tsuccess: Connection closed by the origin has been dropped\n");
+
+  free_upstream_pool(&pool);
+  for (int i = 0; i < 2; i++) {
+    close(fds[i][0]);
+    close(fds[i][1]);
+  }
+}
+
+void test_upstream_pool_expire() {
+  INFO("Testing upstream_pool_expire...\n");
+
+  upstream_pool_t pool;
+  init_upstream_pool(&pool, 4, 16, 1000);
+  struct sockaddr_in a = origin("10.0.0.2", 80);
+
+  int fds[2][2];
+  for (int i = 0; i < 2; i++) assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]) == 0);
+  assert(upstream_pool_put(&pool, &a, fds[0][0], 0) == 0);
+  assert(upstream_pool_put(&pool, &a, fds[1][0], 500) == 0);
+
+  upstream_pool_expire(&pool, 1200);
+  assert(pool.nb_idle == 1);
+  upstream_pool_expire(&pool, 1500);
+  assert(pool.nb_idle == 0);
+  INFO("\tsuccess: Connections idle for too long have been closed\n");
+
+  // The pool closed its sockets, the peers see the end of the stream
+  char byte;
+  assert(read(fds[0][1], &byte, 1) == 0 && read(fds[1][1], &byte, 1) == 0);
+
+  init_upstream_pool(&pool, 0, 16, 1000);
+  assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[0]) == 0);
+  assert(upstream_pool_put(&pool, &a, fds[0][0], 0) == -1);
+  INFO("\tsuccess: Nothing is kept when reuse is disabled\n");
+  free_upstream_pool(&pool);
+
+  close(fds[0][0]);
+  close(fds[0][1]);
+  close(fds[1][1]);
+}
+
+int main() {
+  INFO("Running upstream_pool.c tests...\n");
+
+  test_upstream_pool_reuse();
+  test_upstream_pool_expire();
+
+  return 0;
+}
@@ -0,0 +1,124 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include "../includes/verdict_cache.h"
+#include "../includes/domain_set.h"
+#include "../includes/utils.h"
+
+static void put(verdict_cache_t* cache, uint64_t generation, const char* host, int category) {
+  verdict_cache_put(cache, generation, host, strlen(host), domain_hash(host, strlen(host)), category);
+}
+
+/**
+ * @brief Returns the cached category of a host, -2 if it is not cached.
+ */
+static int get(verdict_cache_t* cache, uint64_t generation, const char* host) {
+  int category;
+  return verdict_cache_get(cache, generation, host, strlen(host), domain_hash(host, strlen(host)), &category) ? category : -2;
+}
+
+void test_verdict_cache_get() {
+  INFO("Testing verdict_cache_get...\n");
+
+  verdict_cache_t cache;
+  init_verdict_cache(&cache, 8);
+  assert(get(&cache, 1, "example.com") == -2 && cache.entries == NULL);
+  INFO("\tsuccess: Empty cache has no verdict\n");
+
+  put(&cache, 1, "example.com", 2);
+  put(&cache, 1, "allowed.org", -1);
+  assert(get(&cache, 1, "example.com") == 2 && get(&cache, 1, "EXAMPLE.Com") == 2);
+  assert(get(&cache, 1, "allowed.org") == -1 && get(&cache, 1, "example.co") == -2);
+  INFO("\tsuccess: Verdicts have been found, ignoring case\n");
+
+  put(&cache, 1, "example.com", 3);
+  assert(get(&cache, 1, "example.com") == 3 && cache.nb_entries == 2);
+  INFO("\tsuccess: Verdict put again has been replaced\n");
+
+  char host[VERDICT_CACHE_MAX_HOST + 2];
+  memset(host, 'a', sizeof(host) - 1);
+  host[sizeof(host) - 1] = '\0';
+  put(&cache, 1, host, 0);
+  assert(get(&cache, 1, host) == -2 && cache.nb_entries == 2);
+  INFO("\tsuccess: Host longer than VERDICT_CACHE_MAX_HOST has not been cached\n");
+
+  assert(get(&cache, 2, "example.com") == -2 && cache.nb_entries == 0);
+  put(&cache, 2, "allowed.org", 1);
+  assert(get(&cache, 2, "allowed.org") == 1 && get(&cache, 1, "allowed.org") == -2);
+  INFO("\tsuccess: Verdicts have been forgotten when the generation changed\n");
+
+  free_verdict_cache(&cache);
+  assert(cache.entries == NULL && cache.capacity == 8);
+
+  init_verdict_cache(&cache, 0);
+  put(&cache, 1, "example.com", 2);
+  assert(get(&cache, 1, "example.com") == -2 && cache.entries == NULL);
+  INFO("\tsuccess: Cache of no entry keeps nothing\n");
+}
+
+void test_verdict_cache_clock() {
+  INFO("Testing the CLOCK eviction of the verdict cache...\n");
+
+  verdict_cache_t cache;
+  init_verdict_cache(&cache, 4);
+  put(&cache, 1, "a.com", 0);
+  put(&cache, 1, "b.com", 1);
+  put(&cache, 1, "c.com", 2);
+  put(&cache, 1, "d.com", 3);
+  assert(get(&cache, 1, "a.com") == 0 && get(&cache, 1, "b.com") == 1);
+
+  put(&cache, 1, "e.com", 4);
+  assert(get(&cache, 1, "c.com") == -2 && get(&cache, 1, "e.com") == 4);
+  assert(get(&cache, 1, "a.com") == 0 && get(&cache, 1, "b.com") == 1 && get(&cache, 1, "d.com") == 3);
+  INFO("\tsuccess: First host not used since the hand passed has been evicted\n");
+
+  // Every host is referenced, the hand clears them all and comes back to the oldest
+  put(&cache, 1, "f.com", 5);
+  assert(cache.nb_entries == 4 && get(&cache, 1, "f.com") == 5);
+  assert((get(&cache, 1, "a.com") == -2) + (get(&cache, 1, "b.com") == -2) + (get(&cache, 1, "d.com") == -2)
+         + (get(&cache, 1, "e.com") == -2) == 1);
+  INFO("\tsuccess: A host has been evicted once every one was referenced\n");
+  free_verdict_cache(&cache);
+
+  enum { CAPACITY = 64, COUNT = 5000 };
+  init_verdict_cache(&cache, CAPACITY);
+  char hosts[COUNT][32];
+  for (int i = 0; i < COUNT; i++) {
+    snprintf(hosts[i], sizeof(hosts[i]), "host%d.example.com", i);
+    put(&cache, 1, hosts[i], i);
+    assert(get(&cache, 1, hosts[i]) == i);
+    if (i % 3 == 0) assert(get(&cache, 1, hosts[i / 2]) == -2 || get(&cache, 1, hosts[i / 2]) == i / 2);
+  }
+  int cached = 0;
+  for (int i = 0; i < COUNT; i++) {
+    int category = get(&cache, 1, hosts[i]);
+    assert(category == -2 || category == i);
+    cached += category == i;
+  }
+  assert(cache.nb_entries == CAPACITY && cached == CAPACITY);
+  INFO("\tsuccess: Index has stayed consistent through %d evictions\n", COUNT - CAPACITY);
+  free_verdict_cache(&cache);
+}
+
+int main() {
+  INFO("Running verdict_cache.c tests...\n");
+
+  test_verdict_cache_get();
+  test_verdict_cache_clock();
+
+  return 0;
+}
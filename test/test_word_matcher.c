@@ -0,0 +1,103 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ *
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../includes/word_matcher.h"
+#include "../includes/utils.h"
+
+/**
+ * @brief Scans a NUL terminated text from the start state.
+ */
+static int scan(const word_matcher_t* matcher, const char* text) {
+  uint32_t state = WORD_MATCHER_START;
+  return word_matcher_scan(matcher, &state, text, strlen(text));
+}
+
+void test_word_matcher_scan() {
+  INFO("Testing word_matcher_scan...\n");
+
+  word_matcher_t matcher;
+  init_word_matcher(&matcher);
+  assert(word_matcher_compile(&matcher) == 0);
+  assert(scan(&matcher, "casino") == -1);
+  INFO("\tsuccess: Matcher without words matches nothing\n");
+
+  assert(word_matcher_add(&matcher, "casino", 0) == 0);
+  assert(word_matcher_add(&matcher, "he", 1) == 0);
+  assert(word_matcher_add(&matcher, "she", 2) == 0);
+  assert(word_matcher_add(&matcher, "hers", 3) == 0);
+  assert(word_matcher_add(&matcher, "", 4) == -1);
+  assert(word_matcher_compile(&matcher) == 0);
+  assert(matcher.nb_words == 4 && matcher.nb_states == 1 + 6 + 2 + 3 + 2);
+
+  assert(scan(&matcher, "/online-CASINO/games") == 0);
+  assert(scan(&matcher, "ushers") == 2);
+  assert(scan(&matcher, "xhx") == -1);
+  assert(scan(&matcher, "casin") == -1);
+  assert(scan(&matcher, "cacasino") == 0);
+  INFO("\tsuccess: Words have been found ignoring case, through the failure links\n");
+
+  uint32_t state = WORD_MATCHER_START;
+  assert(word_matcher_scan(&matcher, &state, "/best-cas", 9) == -1);
+  assert(word_matcher_scan(&matcher, &state, "i", 1) == -1);
+  assert(word_matcher_scan(&matcher, &state, "No/", 3) == 0);
+  INFO("\tsuccess: Word split across pieces has been found\n");
+
+  free_word_matcher(&matcher);
+  assert(matcher.transitions == NULL && matcher.nb_words == 0);
+}
+
+void test_word_matcher_many() {
+  INFO("Testing word_matcher_compile with many words...\n");
+
+  enum { COUNT = 2000 };
+  static char words[COUNT][16];
+  word_matcher_t matcher;
+  init_word_matcher(&matcher);
+  for (int i = 0; i < COUNT; i++) {
+    snprintf(words[i], sizeof(words[i]), "w%dx", i);
+    assert(word_matcher_add(&matcher, words[i], i) == 0);
+  }
+  assert(word_matcher_compile(&matcher) == 0);
+  assert(matcher.nb_classes == 1 + 12);
+  INFO("\tsuccess: Bytes have been reduced to the %zu classes the words use\n", matcher.nb_classes);
+
+  assert(word_matcher_check(&matcher, COUNT) && !word_matcher_check(&matcher, COUNT - 1));
+  matcher.transitions[0] ^= 1;
+  assert(!word_matcher_check(&matcher, COUNT));
+  matcher.transitions[0] ^= 1;
+  INFO("\tsuccess: Automaton has been checked, a transition out of its rows refused\n");
+
+  char text[64];
+  for (int i = 0; i < COUNT; i++) {
+    snprintf(text, sizeof(text), "/path?q=W%dX&y=1", i);
+    int found = scan(&matcher, text);
+    assert(found >= 0 && matcher.words[found].category == (uint32_t)i);
+  }
+  assert(scan(&matcher, "/path?q=w2001x") == -1);
+  INFO("\tsuccess: Each word has been found among %d\n", COUNT);
+  free_word_matcher(&matcher);
+}
+
+int main() {
+  INFO("Running word_matcher.c tests...\n");
+
+  test_word_matcher_scan();
+  test_word_matcher_many();
+
+  return 0;
+}
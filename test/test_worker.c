@@ -0,0 +1,60 @@
+/*
+
+ * MIT License
+ * 
+ * Copyright (c) 2024
+ * Benjamin Grolleau
+ * Alexis Carle
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction.
+ * 
+ * See the LICENSE file for the full license text.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "../includes/worker.h"
+#include "../includes/utils.h"
+
+void test_start_and_stop_workers() {
+  INFO("Testing start_workers and stop_workers...\n");
+
+  config_t conf;
+  memset(&conf, 0, sizeof(conf));
+  strcpy(conf.address, "127.0.0.1");
+  conf.port = 8091;
+  conf.max_client = 10;
+  conf.workers = 3;
+  conf.cpu_affinity = 1;
+
+  volatile int running = 1;
+  worker_t workers[3];
+  assert(start_workers(workers, conf.workers, &conf, &running) == 0);
+  INFO("\tsuccess: Workers have been started\n");
+
+  for (int i = 0; i < conf.workers; i++) {
+    assert(workers[i].started);
+    assert(workers[i].listen_fd > 0);
+    assert(workers[i].loop.max_connections == 4);
+    for (int j = 0; j < i; j++) assert(workers[i].listen_fd != workers[j].listen_fd);
+  }
+  INFO("\tsuccess: Each worker has its own listener on the same port\n");
+
+  running = 0;
+  stop_workers(workers, conf.workers);
+  for (int i = 0; i < conf.workers; i++) {
+    assert(!workers[i].started);
+    assert(workers[i].listen_fd == -1);
+  }
+  INFO("\tsuccess: Workers have been stopped\n");
+}
+
+int main() {
+  INFO("Running worker.c tests...\n");
+
+  test_start_and_stop_workers();
+
+  return 0;
+}